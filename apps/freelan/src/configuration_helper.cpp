@@ -132,10 +132,14 @@ po::options_description get_fscp_options()
 	("fscp.contact", po::value<std::vector<asiotap::endpoint> >()->multitoken()->zero_tokens()->default_value(std::vector<asiotap::endpoint>(), ""), "The address of an host to contact.")
 	("fscp.accept_contact_requests", po::value<bool>()->default_value(true, "yes"), "Whether to accept CONTACT-REQUEST messages.")
 	("fscp.accept_contacts", po::value<bool>()->default_value(true, "yes"), "Whether to accept CONTACT messages.")
+	("fscp.accept_link_tests", po::value<bool>()->default_value(false, "no"), "Whether to answer the link tests of other hosts.")
 	("fscp.dynamic_contact_file", po::value<std::vector<std::string> >()->multitoken()->zero_tokens()->default_value(std::vector<std::string>(), ""), "The certificate of an host to dynamically contact.")
 	("fscp.never_contact", po::value<std::vector<asiotap::ip_network_address> >()->multitoken()->zero_tokens()->default_value(std::vector<asiotap::ip_network_address>(), ""), "A network address to avoid when dynamically contacting hosts.")
 	("fscp.cipher_suite_capability", po::value<std::vector<fscp::cipher_suite_type> >()->multitoken()->zero_tokens()->default_value(fscp::get_default_cipher_suites(), ""), "A cipher suite to allow.")
 	("fscp.elliptic_curve_capability", po::value<std::vector<fscp::elliptic_curve_type> >()->multitoken()->zero_tokens()->default_value(fscp::get_default_elliptic_curves(), ""), "A elliptic curve to allow.")
+	("fscp.buffer_count", po::value<unsigned int>()->default_value(32), "The number of preallocated socket buffers.")
+	("fscp.latency_sampling_rate", po::value<unsigned int>()->default_value(1024), "Measure the latency of one packet out of this many at each stage of the data path. 0 disables the measures.")
+	("fscp.io_uring_enabled", po::value<bool>()->default_value(false, "no"), "Whether to perform the socket I/O through io_uring.")
 	;
 
 	return result;
@@ -173,6 +177,12 @@ po::options_description get_tap_adapter_options()
 	("tap_adapter.name", po::value<std::string>(), "The name of the tap adapter to use or create.")
 	("tap_adapter.mtu", po::value<fl::mtu_type>()->default_value(fl::auto_mtu_type()), "The MTU of the tap adapter.")
 	("tap_adapter.metric", po::value<fl::metric_type>()->default_value(fl::auto_metric_type()), "The metric of the tap adapter.")
+	("tap_adapter.queue_count", po::value<unsigned int>()->default_value(1), "The number of queues to open on the tap adapter.")
+	("tap_adapter.offloading_enabled", po::value<bool>()->default_value(false, "no"), "Whether to enable checksum and segmentation offloading on the tap adapter.")
+	("tap_adapter.read_batch_size", po::value<unsigned int>()->default_value(16), "The maximum number of frames to read from a tap adapter queue at once.")
+	("tap_adapter.io_uring_enabled", po::value<bool>()->default_value(false, "no"), "Whether to perform the tap adapter I/O through io_uring.")
+	("tap_adapter.buffer_count", po::value<unsigned int>()->default_value(8), "The number of preallocated frame buffers.")
+	("tap_adapter.tcp_mss_clamping_enabled", po::value<bool>()->default_value(false, "no"), "Whether to clamp the maximum segment size of TCP connections to the tunnel MTU.")
 	("tap_adapter.ipv4_address_prefix_length", po::value<asiotap::ipv4_network_address>()->default_value(default_ipv4_network_address), "The tap adapter IPv4 address and prefix length.")
 	("tap_adapter.ipv6_address_prefix_length", po::value<asiotap::ipv6_network_address>()->default_value(default_ipv6_network_address), "The tap adapter IPv6 address and prefix length.")
 	("tap_adapter.remote_ipv4_address", po::value<asiotap::ipv4_network_address>(), "The tap adapter IPv4 remote address.")
@@ -183,6 +193,11 @@ po::options_description get_tap_adapter_options()
 	("tap_adapter.dhcp_server_ipv6_address_prefix_length", po::value<asiotap::ipv6_network_address>()->default_value(default_dhcp_ipv6_network_address), "The DHCP proxy server IPv6 address and prefix length.")
 	("tap_adapter.up_script", po::value<fs::path>()->default_value(""), "The tap adapter up script.")
 	("tap_adapter.down_script", po::value<fs::path>()->default_value(""), "The tap adapter down script.")
+	("tap_adapter.pcap_input_file", po::value<fs::path>()->default_value(""), "The pcap file to replay into a virtual tap adapter.")
+	("tap_adapter.pcap_output_file", po::value<fs::path>()->default_value(""), "The pcap file to capture the frames written to a virtual tap adapter to.")
+	("tap_adapter.pcap_replay_rate", po::value<unsigned int>()->default_value(0), "The number of frames replayed per second, or 0 to replay them as fast as possible.")
+	("tap_adapter.pcap_replay_count", po::value<unsigned int>()->default_value(1), "The number of times the frames are replayed, or 0 to replay them forever.")
+	("tap_adapter.pcap_replay_delay", po::value<millisecond_duration>()->default_value(0), "The delay before the replay starts, in milliseconds.")
 	;
 
 	return result;
@@ -207,6 +222,7 @@ po::options_description get_router_options()
 	result.add_options()
 	("router.local_ip_route", po::value<std::vector<asiotap::ip_route> >()->multitoken()->zero_tokens()->default_value(std::vector<asiotap::ip_route>(), ""), "A route to advertise to the other peers.")
 	("router.client_routing_enabled", po::value<bool>()->default_value(true, "yes"), "Whether to enable client routing.")
+	("router.multipath_enabled", po::value<bool>()->default_value(true, "yes"), "Whether to spread the traffic across all the hosts that advertise the best route.")
 	("router.accept_routes_requests", po::value<bool>()->default_value(true, "yes"), "Whether to accept routes requests.")
 	("router.internal_route_acceptance_policy", po::value<fl::router_configuration::internal_route_scope_type>()->default_value(fl::router_configuration::internal_route_scope_type::unicast_in_network), "The internal route acceptance policy.")
 	("router.system_route_acceptance_policy", po::value<fl::router_configuration::system_route_scope_type>()->default_value(fl::router_configuration::system_route_scope_type::none), "The system route acceptance policy.")
@@ -216,6 +232,21 @@ po::options_description get_router_options()
 	return result;
 }
 
+po::options_description get_metrics_options()
+{
+	po::options_description result("Metrics options");
+
+	result.add_options()
+	("metrics.enabled", po::value<bool>()->default_value(false, "no"), "Whether to serve the statistics in the Prometheus text format.")
+	("metrics.listen_on", po::value<asiotap::endpoint>()->default_value(asiotap::ipv4_endpoint(boost::asio::ip::address_v4::loopback(), 12080)), "The loopback endpoint to serve the statistics on.")
+#ifndef WINDOWS
+	("metrics.unix_socket", po::value<fs::path>()->default_value(""), "The Unix domain socket to serve the statistics on, instead of metrics.listen_on.")
+#endif
+	;
+
+	return result;
+}
+
 void setup_configuration(fl::configuration& configuration, const boost::filesystem::path& root, const po::variables_map& vm)
 {
 	typedef fl::security_configuration::cert_type cert_type;
@@ -324,6 +355,7 @@ void setup_configuration(fl::configuration& configuration, const boost::filesyst
 
 	configuration.fscp.accept_contact_requests = vm["fscp.accept_contact_requests"].as<bool>();
 	configuration.fscp.accept_contacts = vm["fscp.accept_contacts"].as<bool>();
+	configuration.fscp.accept_link_tests = vm["fscp.accept_link_tests"].as<bool>();
 	const std::vector<std::string> dynamic_contact_file_list = vm["fscp.dynamic_contact_file"].as<std::vector<std::string> >();
 
 	configuration.fscp.dynamic_contact_list.clear();
@@ -336,6 +368,9 @@ void setup_configuration(fl::configuration& configuration, const boost::filesyst
 	configuration.fscp.never_contact_list = vm["fscp.never_contact"].as<std::vector<asiotap::ip_network_address>>();
 	configuration.fscp.cipher_suite_capabilities = vm["fscp.cipher_suite_capability"].as<std::vector<fscp::cipher_suite_type>>();
 	configuration.fscp.elliptic_curve_capabilities = vm["fscp.elliptic_curve_capability"].as<std::vector<fscp::elliptic_curve_type>>();
+	configuration.fscp.buffer_count = vm["fscp.buffer_count"].as<unsigned int>();
+	configuration.fscp.latency_sampling_rate = vm["fscp.latency_sampling_rate"].as<unsigned int>();
+	configuration.fscp.io_uring_enabled = vm["fscp.io_uring_enabled"].as<bool>();
 
 	// Security options
 	cert_type signature_certificate;
@@ -389,6 +424,12 @@ void setup_configuration(fl::configuration& configuration, const boost::filesyst
 
 	configuration.tap_adapter.mtu = vm["tap_adapter.mtu"].as<fl::mtu_type>();
 	configuration.tap_adapter.metric = vm["tap_adapter.metric"].as<fl::metric_type>();
+	configuration.tap_adapter.queue_count = vm["tap_adapter.queue_count"].as<unsigned int>();
+	configuration.tap_adapter.offloading_enabled = vm["tap_adapter.offloading_enabled"].as<bool>();
+	configuration.tap_adapter.read_batch_size = vm["tap_adapter.read_batch_size"].as<unsigned int>();
+	configuration.tap_adapter.io_uring_enabled = vm["tap_adapter.io_uring_enabled"].as<bool>();
+	configuration.tap_adapter.buffer_count = vm["tap_adapter.buffer_count"].as<unsigned int>();
+	configuration.tap_adapter.tcp_mss_clamping_enabled = vm["tap_adapter.tcp_mss_clamping_enabled"].as<bool>();
 	configuration.tap_adapter.ipv4_address_prefix_length = vm["tap_adapter.ipv4_address_prefix_length"].as<asiotap::ipv4_network_address>();
 	configuration.tap_adapter.ipv6_address_prefix_length = vm["tap_adapter.ipv6_address_prefix_length"].as<asiotap::ipv6_network_address>();
 
@@ -403,6 +444,15 @@ void setup_configuration(fl::configuration& configuration, const boost::filesyst
 	configuration.tap_adapter.dhcp_server_ipv4_address_prefix_length = vm["tap_adapter.dhcp_server_ipv4_address_prefix_length"].as<asiotap::ipv4_network_address>();
 	configuration.tap_adapter.dhcp_server_ipv6_address_prefix_length = vm["tap_adapter.dhcp_server_ipv6_address_prefix_length"].as<asiotap::ipv6_network_address>();
 
+	const fs::path pcap_input_file = vm["tap_adapter.pcap_input_file"].as<fs::path>();
+	const fs::path pcap_output_file = vm["tap_adapter.pcap_output_file"].as<fs::path>();
+
+	configuration.tap_adapter.pcap_input_file = pcap_input_file.empty() ? pcap_input_file : fs::absolute(pcap_input_file, root);
+	configuration.tap_adapter.pcap_output_file = pcap_output_file.empty() ? pcap_output_file : fs::absolute(pcap_output_file, root);
+	configuration.tap_adapter.pcap_replay_rate = vm["tap_adapter.pcap_replay_rate"].as<unsigned int>();
+	configuration.tap_adapter.pcap_replay_count = vm["tap_adapter.pcap_replay_count"].as<unsigned int>();
+	configuration.tap_adapter.pcap_replay_delay = vm["tap_adapter.pcap_replay_delay"].as<millisecond_duration>().to_time_duration();
+
 	// Switch options
 	configuration.switch_.routing_method = vm["switch.routing_method"].as<fl::switch_configuration::routing_method_type>();
 	configuration.switch_.relay_mode_enabled = vm["switch.relay_mode_enabled"].as<bool>();
@@ -412,6 +462,7 @@ void setup_configuration(fl::configuration& configuration, const boost::filesyst
 	configuration.router.local_ip_routes.insert(local_ip_routes.begin(), local_ip_routes.end());
 
 	configuration.router.client_routing_enabled = vm["router.client_routing_enabled"].as<bool>();
+	configuration.router.multipath_enabled = vm["router.multipath_enabled"].as<bool>();
 	configuration.router.accept_routes_requests = vm["router.accept_routes_requests"].as<bool>();
 	configuration.router.internal_route_acceptance_policy = vm["router.internal_route_acceptance_policy"].as<fl::router_configuration::internal_route_scope_type>();
 	configuration.router.system_route_acceptance_policy = vm["router.system_route_acceptance_policy"].as<fl::router_configuration::system_route_scope_type>();
@@ -438,3 +489,39 @@ boost::filesystem::path get_certificate_validation_script(const boost::filesyste
 
 	return certificate_validation_script_file.empty() ? certificate_validation_script_file : fs::absolute(certificate_validation_script_file, root);
 }
+
+metrics_configuration get_metrics_configuration(const boost::filesystem::path& root, const boost::program_options::variables_map& vm)
+{
+	metrics_configuration configuration;
+
+	configuration.enabled = vm["metrics.enabled"].as<bool>();
+
+#ifndef WINDOWS
+	const fs::path unix_socket = vm["metrics.unix_socket"].as<fs::path>();
+
+	if (!unix_socket.empty())
+	{
+		configuration.unix_socket = fs::absolute(unix_socket, root);
+	}
+#else
+	static_cast<void>(root);
+#endif
+
+	if (configuration.enabled && configuration.unix_socket.empty())
+	{
+		boost::asio::io_service io_service;
+		boost::asio::ip::udp::resolver resolver(io_service);
+
+		const boost::asio::ip::udp::endpoint listen_on = boost::apply_visitor(asiotap::endpoint_resolve_visitor(resolver, boost::asio::ip::udp::v4(), boost::asio::ip::udp::resolver::query::numeric_service, "12080"), vm["metrics.listen_on"].as<asiotap::endpoint>());
+
+		// The metrics are not authenticated: they must not be reachable from the network.
+		if (!listen_on.address().is_loopback())
+		{
+			throw std::runtime_error("The metrics endpoint must be a loopback address: " + listen_on.address().to_string());
+		}
+
+		configuration.listen_on = boost::asio::ip::tcp::endpoint(listen_on.address(), listen_on.port());
+	}
+
+	return configuration;
+}
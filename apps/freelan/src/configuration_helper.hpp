@@ -52,6 +52,8 @@
 #include <boost/program_options.hpp>
 #include <boost/filesystem.hpp>
 
+#include "metrics_server.hpp"
+
 /**
  * \brief Get the server options.
  * \return The server options.
@@ -88,6 +90,12 @@ boost::program_options::options_description get_switch_options();
  */
 boost::program_options::options_description get_router_options();
 
+/**
+ * \brief Get the metrics options.
+ * \return The metrics options.
+ */
+boost::program_options::options_description get_metrics_options();
+
 /**
  * \brief Setup a freelan configuration from a variables map.
  * \param configuration The configuration to setup.
@@ -121,4 +129,13 @@ boost::filesystem::path get_tap_adapter_down_script(const boost::filesystem::pat
  */
 boost::filesystem::path get_certificate_validation_script(const boost::filesystem::path& root, const boost::program_options::variables_map& vm);
 
+/**
+ * \brief Get the metrics configuration.
+ * \param root The root directory for file operations.
+ * \param vm The variables map.
+ * \return The metrics configuration.
+ * \warning If the metrics endpoint is not a loopback endpoint, a std::runtime_error is thrown.
+ */
+metrics_configuration get_metrics_configuration(const boost::filesystem::path& root, const boost::program_options::variables_map& vm);
+
 #endif /* CONFIGURATION_HELPER_HPP */
@@ -72,6 +72,7 @@
 #include "tools.hpp"
 #include "system.hpp"
 #include "configuration_helper.hpp"
+#include "metrics_server.hpp"
 #include "colors.hpp"
 
 // This file is generated locally.
@@ -89,6 +90,7 @@ struct cli_configuration
 {
 	cli_configuration() :
 		fl_configuration(),
+		metrics(),
 		debug(false),
 #ifndef WINDOWS
 		thread_count(0),
@@ -100,6 +102,7 @@ struct cli_configuration
 	{}
 
 	fl::configuration fl_configuration;
+	metrics_configuration metrics;
 	bool debug;
 	unsigned int thread_count;
 #ifndef WINDOWS
@@ -183,6 +186,7 @@ bool parse_options(int argc, char** argv, cli_configuration& configuration)
 	configuration_options.add(get_tap_adapter_options());
 	configuration_options.add(get_switch_options());
 	configuration_options.add(get_router_options());
+	configuration_options.add(get_metrics_options());
 
 	visible_options.add(configuration_options);
 	all_options.add(configuration_options);
@@ -403,6 +407,8 @@ bool parse_options(int argc, char** argv, cli_configuration& configuration)
 
 	setup_configuration(configuration.fl_configuration, execution_root_directory, vm);
 
+	configuration.metrics = get_metrics_configuration(execution_root_directory, vm);
+
 	const fs::path tap_adapter_up_script = get_tap_adapter_up_script(execution_root_directory, vm);
 
 	if (!tap_adapter_up_script.empty())
@@ -488,6 +494,15 @@ void run(const cli_configuration& configuration, int& exit_signal)
 
 	core.open();
 
+	// Declared after the core so that it is destroyed first.
+	boost::shared_ptr<metrics_server> metrics;
+
+	if (configuration.metrics.enabled)
+	{
+		metrics.reset(new metrics_server(configuration.metrics, core, logger));
+		metrics->open();
+	}
+
 	signals.async_wait(boost::bind(signal_handler, _1, _2, boost::ref(core), boost::ref(exit_signal)));
 
 	boost::thread_group threads;
@@ -517,6 +532,11 @@ void run(const cli_configuration& configuration, int& exit_signal)
 
 	threads.join_all();
 
+	if (metrics)
+	{
+		metrics->close();
+	}
+
 	logger(fl::LL_IMPORTANT) << "Execution stopped.";
 }
 
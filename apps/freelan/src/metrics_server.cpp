@@ -0,0 +1,741 @@
+/*
+ * freelan - An open, multi-platform software to establish peer-to-peer virtual
+ * private networks.
+ *
+ * Copyright (C) 2010-2011 Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ *
+ * This file is part of freelan.
+ *
+ * freelan is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * freelan is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use freelan in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file metrics_server.cpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief A local endpoint that serves the core statistics in the Prometheus text format.
+ */
+
+#include "metrics_server.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <iomanip>
+#include <sstream>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include <fscp/server_error.hpp>
+
+namespace fs = boost::filesystem;
+namespace fl = freelan;
+
+namespace
+{
+	typedef fscp::server::peer_statistics_type peer_statistics_type;
+	typedef std::map<fscp::server::ep_type, peer_statistics_type> peer_statistics_map;
+
+	const size_t MAX_REQUEST_SIZE = 8192;
+
+	// Connections beyond this are closed as soon as they are accepted.
+	const size_t MAX_CONNECTIONS = 16;
+
+	// The time a client gets to send its request, and then to read the response.
+	const boost::posix_time::time_duration IO_TIMEOUT = boost::posix_time::seconds(5);
+
+	const boost::posix_time::time_duration MAX_LINK_TEST_DURATION = boost::posix_time::seconds(60);
+
+	// Header names are compared in lower case.
+	const std::string LINK_TEST_HEADER = "x-freelan-link-test";
+
+	double to_seconds(const boost::posix_time::time_duration& duration)
+	{
+		return static_cast<double>(duration.total_microseconds()) / 1000000.0;
+	}
+
+	double to_seconds(const fscp::latency_clock::duration& duration)
+	{
+		return std::chrono::duration_cast<std::chrono::duration<double> >(duration).count();
+	}
+
+	void write_header(std::ostream& os, const char* name, const char* type, const char* help)
+	{
+		os << "# HELP " << name << " " << help << "\n";
+		os << "# TYPE " << name << " " << type << "\n";
+	}
+
+	template <typename ValueType>
+	void write_metric(std::ostream& os, const char* name, const char* type, const char* help, ValueType value)
+	{
+		write_header(os, name, type, help);
+
+		os << name << " " << value << "\n";
+	}
+
+	typedef std::map<std::string, std::string> query_type;
+
+	query_type parse_query(const std::string& target)
+	{
+		query_type result;
+		const size_t query_pos = target.find('?');
+
+		if (query_pos == std::string::npos)
+		{
+			return result;
+		}
+
+		std::istringstream iss(target.substr(query_pos + 1));
+		std::string parameter;
+
+		while (std::getline(iss, parameter, '&'))
+		{
+			const size_t equal_pos = parameter.find('=');
+
+			if (equal_pos != std::string::npos)
+			{
+				result[parameter.substr(0, equal_pos)] = parameter.substr(equal_pos + 1);
+			}
+			else if (!parameter.empty())
+			{
+				result[parameter] = std::string();
+			}
+		}
+
+		return result;
+	}
+
+	typedef std::map<std::string, std::string> header_map_type;
+
+	header_map_type parse_headers(std::istream& is)
+	{
+		header_map_type result;
+		std::string line;
+
+		while (std::getline(is, line))
+		{
+			if (!line.empty() && (line[line.size() - 1] == '\r'))
+			{
+				line.erase(line.size() - 1);
+			}
+
+			if (line.empty())
+			{
+				break;
+			}
+
+			const size_t colon_pos = line.find(':');
+
+			if (colon_pos == std::string::npos)
+			{
+				continue;
+			}
+
+			std::string name = line.substr(0, colon_pos);
+			std::transform(name.begin(), name.end(), name.begin(), [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+
+			const size_t value_pos = line.find_first_not_of(" \t", colon_pos + 1);
+			const size_t value_end = line.find_last_not_of(" \t");
+
+			result[name] = (value_pos == std::string::npos) ? std::string() : line.substr(value_pos, value_end - value_pos + 1);
+		}
+
+		return result;
+	}
+
+	// A page that rebinds its own name to a loopback address still sends its own name in the Host header.
+	bool is_local_host(const std::string& host)
+	{
+		std::string name = host;
+
+		if (!name.empty() && (name[0] == '['))
+		{
+			name = name.substr(1, name.find(']') - 1);
+		}
+		else
+		{
+			name = name.substr(0, name.rfind(':'));
+		}
+
+		std::transform(name.begin(), name.end(), name.begin(), [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+
+		if (name == "localhost")
+		{
+			return true;
+		}
+
+		boost::system::error_code ec;
+		const boost::asio::ip::address address = boost::asio::ip::address::from_string(name, ec);
+
+		return (!ec && address.is_loopback());
+	}
+
+	// Endpoints are given as IPV4:PORT or [IPV6]:PORT: the peer must already have a session, so there is nothing to resolve.
+	fl::core::ep_type parse_endpoint(const std::string& str)
+	{
+		const size_t colon_pos = str.rfind(':');
+
+		if ((colon_pos == std::string::npos) || (colon_pos == 0))
+		{
+			throw std::invalid_argument("Missing port in endpoint: " + str);
+		}
+
+		std::string address = str.substr(0, colon_pos);
+
+		if ((address.size() > 2) && (address[0] == '[') && (address[address.size() - 1] == ']'))
+		{
+			address = address.substr(1, address.size() - 2);
+		}
+
+		boost::system::error_code ec;
+		const boost::asio::ip::address ip = boost::asio::ip::address::from_string(address, ec);
+
+		if (ec)
+		{
+			throw std::invalid_argument("Invalid address in endpoint: " + str);
+		}
+
+		return fl::core::ep_type(ip, boost::lexical_cast<uint16_t>(str.substr(colon_pos + 1)));
+	}
+
+	fl::link_test_parameters parse_link_test_parameters(const query_type& query, fl::core::ep_type& peer)
+	{
+		fl::link_test_parameters result;
+
+		const query_type::const_iterator peer_it = query.find("peer");
+
+		if (peer_it == query.end())
+		{
+			throw std::invalid_argument("The peer parameter is mandatory.");
+		}
+
+		peer = parse_endpoint(peer_it->second);
+
+		for (auto&& parameter : query)
+		{
+			if (parameter.first == "mode")
+			{
+				std::istringstream iss(parameter.second);
+
+				if (!(iss >> result.mode))
+				{
+					throw std::invalid_argument("Invalid mode: " + parameter.second);
+				}
+			}
+			else if (parameter.first == "duration")
+			{
+				result.duration = boost::posix_time::milliseconds(static_cast<int64_t>(boost::lexical_cast<double>(parameter.second) * 1000));
+
+				if ((result.duration <= boost::posix_time::time_duration()) || (result.duration > MAX_LINK_TEST_DURATION))
+				{
+					throw std::invalid_argument("The duration must be positive and at most " + boost::lexical_cast<std::string>(MAX_LINK_TEST_DURATION.total_seconds()) + " seconds.");
+				}
+			}
+			else if (parameter.first == "size")
+			{
+				result.payload_size = boost::lexical_cast<size_t>(parameter.second);
+			}
+			else if (parameter.first == "window")
+			{
+				result.window = boost::lexical_cast<size_t>(parameter.second);
+			}
+			else if (parameter.first != "peer")
+			{
+				throw std::invalid_argument("Unknown parameter: " + parameter.first);
+			}
+		}
+
+		if ((result.payload_size < fl::link_test::MIN_PAYLOAD_SIZE) || (result.payload_size > fl::link_test::MAX_PAYLOAD_SIZE))
+		{
+			throw std::invalid_argument("The size must be between " + boost::lexical_cast<std::string>(fl::link_test::MIN_PAYLOAD_SIZE) + " and " + boost::lexical_cast<std::string>(fl::link_test::MAX_PAYLOAD_SIZE) + " bytes.");
+		}
+
+		if (result.window == 0)
+		{
+			throw std::invalid_argument("The window must be positive.");
+		}
+
+		return result;
+	}
+
+	void write_latency_metric(std::ostream& os, const char* stage, const fscp::latency_histogram_snapshot& histogram)
+	{
+		static const std::pair<double, const char*> quantiles[] = {
+			std::make_pair(0.5, "0.5"),
+			std::make_pair(0.9, "0.9"),
+			std::make_pair(0.99, "0.99"),
+			std::make_pair(0.999, "0.999")
+		};
+
+		for (auto&& quantile : quantiles)
+		{
+			os << "freelan_latency_seconds{stage=\"" << stage << "\",quantile=\"" << quantile.second << "\"} " << to_seconds(histogram.value_at_quantile(quantile.first)) << "\n";
+		}
+
+		os << "freelan_latency_seconds_sum{stage=\"" << stage << "\"} " << to_seconds(histogram.sum) << "\n";
+		os << "freelan_latency_seconds_count{stage=\"" << stage << "\"} " << histogram.count << "\n";
+	}
+
+	template <typename Getter>
+	void write_peer_metric(std::ostream& os, const peer_statistics_map& peers, const char* name, const char* type, const char* help, Getter getter)
+	{
+		write_header(os, name, type, help);
+
+		for (auto&& peer : peers)
+		{
+			const auto value = getter(peer.second);
+
+			if (value)
+			{
+				// Endpoints never contain characters that need escaping in a label value.
+				os << name << "{peer=\"" << peer.first << "\"} " << *value << "\n";
+			}
+		}
+	}
+}
+
+void write_link_test_report(std::ostream& os, const fl::core::ep_type& peer, const fl::link_test_result& result)
+{
+	const double seconds = to_seconds(result.duration);
+	const double loss = result.sent_packets ? (static_cast<double>(result.lost_packets) * 100 / result.sent_packets) : 0;
+
+	os << std::fixed << std::setprecision(3);
+
+	os << "peer: " << peer << "\n";
+	os << "mode: " << result.mode << "\n";
+	os << "payload_size: " << result.payload_size << " bytes\n";
+	os << "duration: " << seconds << " s\n";
+	os << "goodput: " << ((seconds > 0) ? (static_cast<double>(result.received_bytes) * 8 / seconds / 1000000) : 0) << " Mbit/s\n";
+	os << "sent: " << result.sent_packets << " messages, " << result.sent_bytes << " bytes\n";
+	os << "received: " << result.received_packets << " messages, " << result.received_bytes << " bytes\n";
+	os << "lost: " << result.lost_packets << " messages (" << loss << "%)\n";
+	os << "reordered: " << result.reordered_packets << " messages\n";
+
+	if (result.round_trip_time.count > 0)
+	{
+		os << "round_trip_time_samples: " << result.round_trip_time.count << "\n";
+		os << "round_trip_time_p50: " << to_seconds(result.round_trip_time.value_at_quantile(0.5)) * 1000 << " ms\n";
+		os << "round_trip_time_p90: " << to_seconds(result.round_trip_time.value_at_quantile(0.9)) * 1000 << " ms\n";
+		os << "round_trip_time_p99: " << to_seconds(result.round_trip_time.value_at_quantile(0.99)) * 1000 << " ms\n";
+		os << "round_trip_time_max: " << to_seconds(result.round_trip_time.value_at_quantile(1.0)) * 1000 << " ms\n";
+	}
+}
+
+void write_prometheus_metrics(std::ostream& os, const fl::core::statistics_type& statistics)
+{
+	os << std::fixed << std::setprecision(9);
+
+	write_metric(os, "freelan_tap_adapter_read_packets_total", "counter", "Frames read from the tap adapter.", statistics.tap_adapter_read.packets);
+	write_metric(os, "freelan_tap_adapter_read_bytes_total", "counter", "Bytes read from the tap adapter.", statistics.tap_adapter_read.bytes);
+	write_metric(os, "freelan_tap_adapter_written_packets_total", "counter", "Frames queued for writing to the tap adapter.", statistics.tap_adapter_written.packets);
+	write_metric(os, "freelan_tap_adapter_written_bytes_total", "counter", "Bytes queued for writing to the tap adapter.", statistics.tap_adapter_written.bytes);
+	write_metric(os, "freelan_tap_adapter_write_queue_depth", "gauge", "Frames waiting to be written to the tap adapter.", statistics.tap_adapter_write_queue_depth);
+	write_metric(os, "freelan_tap_adapter_buffer_heap_allocations_total", "counter", "Tap adapter buffers that did not fit in the preallocated pool.", statistics.tap_adapter_buffer_heap_allocations);
+	write_metric(os, "freelan_proxy_buffer_heap_allocations_total", "counter", "Proxy buffers that did not fit in the preallocated pool.", statistics.proxy_buffer_heap_allocations);
+	write_metric(os, "freelan_switch_dropped_frames_total", "counter", "Frames the switch could not send anywhere.", statistics.switch_dropped_frames);
+	write_metric(os, "freelan_router_dropped_frames_total", "counter", "Frames the router had no route for.", statistics.router_dropped_frames);
+	write_metric(os, "freelan_router_route_cache_hits_total", "counter", "Route lookups answered from the route cache.", statistics.route_cache.hits);
+	write_metric(os, "freelan_router_route_cache_misses_total", "counter", "Route lookups that required a routing table lookup.", statistics.route_cache.misses);
+
+	const fscp::server::statistics_type& server = statistics.server;
+
+	write_metric(os, "freelan_fscp_sent_packets_total", "counter", "Datagrams sent on the FSCP socket.", server.sent.packets);
+	write_metric(os, "freelan_fscp_sent_bytes_total", "counter", "Bytes sent on the FSCP socket.", server.sent.bytes);
+	write_metric(os, "freelan_fscp_received_packets_total", "counter", "Datagrams received on the FSCP socket.", server.received.packets);
+	write_metric(os, "freelan_fscp_received_bytes_total", "counter", "Bytes received on the FSCP socket.", server.received.bytes);
+	write_metric(os, "freelan_fscp_malformed_messages_total", "counter", "Received datagrams that were not valid FSCP messages.", server.malformed_messages);
+	write_metric(os, "freelan_fscp_decryption_failures_total", "counter", "Data messages that could not be decrypted.", server.decryption_failures);
+	write_metric(os, "freelan_fscp_replayed_messages_total", "counter", "Data messages dropped because their sequence number was outdated.", server.replayed_messages);
+	write_metric(os, "freelan_fscp_socket_buffer_heap_allocations_total", "counter", "Socket buffers that did not fit in the preallocated pool.", server.socket_buffer_heap_allocations);
+	write_metric(os, "freelan_fscp_write_queue_depth", "gauge", "Datagrams waiting to be written on the FSCP socket.", server.write_queue_depth);
+	write_metric(os, "freelan_fscp_peers", "gauge", "Known peers.", server.peers.size());
+
+	write_peer_metric(os, server.peers, "freelan_peer_sent_packets_total", "counter", "Data messages sent to the peer.", [](const peer_statistics_type& peer) { return boost::make_optional(peer.sent.packets); });
+	write_peer_metric(os, server.peers, "freelan_peer_sent_bytes_total", "counter", "Bytes sent to the peer, before encryption.", [](const peer_statistics_type& peer) { return boost::make_optional(peer.sent.bytes); });
+	write_peer_metric(os, server.peers, "freelan_peer_received_packets_total", "counter", "Data messages received from the peer.", [](const peer_statistics_type& peer) { return boost::make_optional(peer.received.packets); });
+	write_peer_metric(os, server.peers, "freelan_peer_received_bytes_total", "counter", "Bytes received from the peer, after decryption.", [](const peer_statistics_type& peer) { return boost::make_optional(peer.received.bytes); });
+	write_peer_metric(os, server.peers, "freelan_peer_decryption_failures_total", "counter", "Data messages from the peer that could not be decrypted.", [](const peer_statistics_type& peer) { return boost::make_optional(peer.decryption_failures); });
+	write_peer_metric(os, server.peers, "freelan_peer_replayed_messages_total", "counter", "Data messages from the peer dropped because their sequence number was outdated.", [](const peer_statistics_type& peer) { return boost::make_optional(peer.replayed_messages); });
+	write_peer_metric(os, server.peers, "freelan_peer_session_renewals_total", "counter", "Times the session with the peer was renewed.", [](const peer_statistics_type& peer) { return boost::make_optional(peer.session_renewals); });
+	write_peer_metric(os, server.peers, "freelan_peer_session_age_seconds", "gauge", "Time elapsed since the current session with the peer was established.", [](const peer_statistics_type& peer) {
+		return peer.session_age ? boost::make_optional(to_seconds(*peer.session_age)) : boost::none;
+	});
+	write_peer_metric(os, server.peers, "freelan_peer_round_trip_time_seconds", "gauge", "Round-trip time of the last answered HELLO request to the peer.", [](const peer_statistics_type& peer) {
+		return peer.last_round_trip_time ? boost::make_optional(to_seconds(*peer.last_round_trip_time)) : boost::none;
+	});
+
+	write_header(os, "freelan_latency_seconds", "summary", "Time spent by the sampled packets in each stage of the data path.");
+	write_latency_metric(os, "tap_send_forwarding", statistics.latency.send_forwarding);
+	write_latency_metric(os, "fscp_send_session_queue", server.latency.send_session_queue);
+	write_latency_metric(os, "fscp_send_encryption", server.latency.send_encryption);
+	write_latency_metric(os, "fscp_send_write_queue", server.latency.send_write_queue);
+	write_latency_metric(os, "fscp_send_socket", server.latency.send_socket);
+	write_latency_metric(os, "fscp_receive_session_queue", server.latency.receive_session_queue);
+	write_latency_metric(os, "fscp_receive_decryption", server.latency.receive_decryption);
+	write_latency_metric(os, "fscp_receive_data_queue", server.latency.receive_data_queue);
+	write_latency_metric(os, "tap_receive_forwarding", statistics.latency.receive_forwarding);
+	write_latency_metric(os, "tap_receive_write_queue", statistics.latency.receive_tap_write_queue);
+	write_latency_metric(os, "tap_receive_write", statistics.latency.receive_tap_write);
+}
+
+class metrics_server::connection : public boost::enable_shared_from_this<connection>
+{
+	public:
+
+		typedef boost::asio::generic::stream_protocol::socket socket_type;
+
+		explicit connection(metrics_server& server) :
+			m_server(server),
+			m_socket(server.m_io_service),
+			m_timer(server.m_io_service),
+			m_deadline_generation(0),
+			m_request(MAX_REQUEST_SIZE),
+			m_response()
+		{}
+
+		socket_type& socket()
+		{
+			return m_socket;
+		}
+
+		void start()
+		{
+			arm_timer();
+
+			boost::asio::async_read_until(m_socket, m_request, "\r\n\r\n", boost::bind(&connection::handle_read, shared_from_this(), boost::asio::placeholders::error));
+		}
+
+	private:
+
+		void arm_timer()
+		{
+			m_timer.expires_from_now(IO_TIMEOUT);
+			m_timer.async_wait(boost::bind(&connection::handle_timeout, shared_from_this(), ++m_deadline_generation, boost::asio::placeholders::error));
+		}
+
+		void cancel_timer()
+		{
+			// A timeout handler that is already queued cannot be aborted anymore: the generation change makes it a no-op.
+			++m_deadline_generation;
+
+			m_timer.cancel();
+		}
+
+		void handle_timeout(unsigned int generation, const boost::system::error_code& ec)
+		{
+			if ((ec == boost::asio::error::operation_aborted) || (generation != m_deadline_generation))
+			{
+				return;
+			}
+
+			// The pending read or write completes with operation_aborted.
+			boost::system::error_code close_ec;
+
+			m_socket.close(close_ec);
+
+			m_server.m_connections.erase(shared_from_this());
+		}
+
+		void handle_read(const boost::system::error_code& ec)
+		{
+			if (ec)
+			{
+				// Also covers requests that do not fit in MAX_REQUEST_SIZE.
+				cancel_timer();
+
+				m_server.m_connections.erase(shared_from_this());
+
+				return;
+			}
+
+			// Link tests can legitimately take a while: the deadline only applies to the client side.
+			cancel_timer();
+
+			std::istream is(&m_request);
+			std::string method;
+			std::string target;
+			std::string version;
+
+			is >> method >> target;
+			std::getline(is, version);
+
+			const header_map_type headers = parse_headers(is);
+			const header_map_type::const_iterator host = headers.find("host");
+			const std::string path = target.substr(0, target.find('?'));
+
+			if (path == "/link-test")
+			{
+				// Any web page can make the browser send a GET or a simple POST to us, but it must ask the browser first to add a custom header: we never answer such requests, so only local tools get past this.
+				if (method != "POST")
+				{
+					write_response("405 Method Not Allowed", "Link tests must be started with a POST request.\n");
+				}
+				else if ((headers.find(LINK_TEST_HEADER) == headers.end()) || ((host != headers.end()) && !is_local_host(host->second)))
+				{
+					write_response("403 Forbidden", "Link tests require the X-Freelan-Link-Test header and a local Host header.\n");
+				}
+				else
+				{
+					handle_link_test(target);
+				}
+			}
+			else if (path != "/metrics")
+			{
+				write_response("404 Not Found", "The metrics are served on /metrics and link tests are run on /link-test.\n");
+			}
+			else if (method != "GET")
+			{
+				write_response("405 Method Not Allowed", "The metrics must be fetched with a GET request.\n");
+			}
+			else
+			{
+				// The handler is called from one of the core strands: it only hands the snapshot back to our own thread.
+				//
+				// It must not keep the connection alive: the connection and its socket belong to our io_service.
+				const boost::weak_ptr<connection> weak_self = shared_from_this();
+
+				m_server.m_core.async_get_statistics([weak_self](const fl::core::statistics_type& statistics) {
+					const boost::shared_ptr<connection> self = weak_self.lock();
+
+					if (self)
+					{
+						self->m_server.m_io_service.post(boost::bind(&connection::handle_statistics, self, statistics));
+					}
+				});
+			}
+		}
+
+		void handle_statistics(const fl::core::statistics_type& statistics)
+		{
+			std::ostringstream oss;
+
+			write_prometheus_metrics(oss, statistics);
+
+			write_response("200 OK", oss.str());
+		}
+
+		void handle_link_test(const std::string& target)
+		{
+			fl::core::ep_type peer;
+			fl::link_test_parameters parameters;
+
+			try
+			{
+				parameters = parse_link_test_parameters(parse_query(target), peer);
+			}
+			catch (const std::exception& ex)
+			{
+				write_response("400 Bad Request", std::string(ex.what()) + "\nUsage: /link-test?peer=IP:PORT[&mode=sink|echo][&duration=SECONDS][&size=BYTES][&window=MESSAGES]\n");
+
+				return;
+			}
+
+			// As for the statistics, the handler is called from a core strand and must not keep the connection alive.
+			const boost::weak_ptr<connection> weak_self = shared_from_this();
+
+			m_server.m_core.async_run_link_test(peer, parameters, [weak_self, peer](const boost::system::error_code& ec, const fl::link_test_result& result) {
+				const boost::shared_ptr<connection> self = weak_self.lock();
+
+				if (self)
+				{
+					self->m_server.m_io_service.post(boost::bind(&connection::handle_link_test_result, self, peer, ec, result));
+				}
+			});
+		}
+
+		void handle_link_test_result(const fl::core::ep_type& peer, const boost::system::error_code& ec, const fl::link_test_result& result)
+		{
+			if (ec)
+			{
+				const bool unavailable = (ec == make_error_code(fscp::server_error::no_session_for_host)) || (ec == make_error_code(fscp::server_error::server_offline));
+				std::ostringstream oss;
+
+				oss << "The link test with " << peer << " failed: " << ec.message() << "\n";
+
+				write_response(unavailable ? "503 Service Unavailable" : "500 Internal Server Error", oss.str());
+
+				return;
+			}
+
+			std::ostringstream oss;
+
+			write_link_test_report(oss, peer, result);
+
+			write_response("200 OK", oss.str());
+		}
+
+		void write_response(const std::string& status, const std::string& body)
+		{
+			std::ostringstream oss;
+
+			oss << "HTTP/1.0 " << status << "\r\n";
+			oss << "Content-Type: text/plain; version=0.0.4\r\n";
+			oss << "Content-Length: " << body.size() << "\r\n";
+			oss << "Connection: close\r\n";
+			oss << "\r\n";
+			oss << body;
+
+			m_response = oss.str();
+
+			arm_timer();
+
+			boost::asio::async_write(m_socket, boost::asio::buffer(m_response), boost::bind(&connection::handle_write, shared_from_this(), boost::asio::placeholders::error));
+		}
+
+		void handle_write(const boost::system::error_code&)
+		{
+			cancel_timer();
+
+			boost::system::error_code ec;
+
+			m_socket.shutdown(socket_type::shutdown_both, ec);
+			m_socket.close(ec);
+
+			m_server.m_connections.erase(shared_from_this());
+		}
+
+		metrics_server& m_server;
+		socket_type m_socket;
+		boost::asio::deadline_timer m_timer;
+		unsigned int m_deadline_generation;
+		boost::asio::streambuf m_request;
+		std::string m_response;
+};
+
+template <typename Acceptor>
+void metrics_server::async_accept(boost::shared_ptr<Acceptor> acceptor)
+{
+	const boost::shared_ptr<connection> new_connection = boost::make_shared<connection>(boost::ref(*this));
+
+	acceptor->async_accept(new_connection->socket(), [this, acceptor, new_connection](const boost::system::error_code& ec) {
+		if (ec == boost::asio::error::operation_aborted)
+		{
+			return;
+		}
+
+		if (!ec)
+		{
+			if (m_connections.size() < MAX_CONNECTIONS)
+			{
+				m_connections.insert(new_connection);
+
+				new_connection->start();
+			}
+			else
+			{
+				m_logger(fl::LL_DEBUG) << "Too many metrics connections: closing the new one.";
+
+				boost::system::error_code close_ec;
+				new_connection->socket().close(close_ec);
+			}
+		}
+		else
+		{
+			m_logger(fl::LL_WARNING) << "Failed to accept a metrics connection: " << ec.message();
+		}
+
+		async_accept(acceptor);
+	});
+}
+
+metrics_server::metrics_server(const metrics_configuration& configuration, fl::core& core, const fl::logger& logger) :
+	m_configuration(configuration),
+	m_core(core),
+	m_logger(logger),
+	m_io_service(),
+	m_tcp_acceptor(),
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+	m_unix_acceptor(),
+#endif
+	m_connections(),
+	m_thread()
+{
+}
+
+metrics_server::~metrics_server()
+{
+	close();
+}
+
+void metrics_server::open()
+{
+	if (!m_configuration.unix_socket.empty())
+	{
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+		// A previous instance that did not exit cleanly may have left its socket file behind.
+		boost::system::error_code ec;
+		fs::remove(m_configuration.unix_socket, ec);
+
+		m_unix_acceptor = boost::make_shared<boost::asio::local::stream_protocol::acceptor>(m_io_service, boost::asio::local::stream_protocol::endpoint(m_configuration.unix_socket.string()));
+
+		async_accept(m_unix_acceptor);
+
+		m_logger(fl::LL_INFORMATION) << "Serving metrics on " << m_configuration.unix_socket << ".";
+#else
+		throw std::runtime_error("Unix domain sockets are not supported on this platform.");
+#endif
+	}
+	else
+	{
+		m_tcp_acceptor = boost::make_shared<boost::asio::ip::tcp::acceptor>(m_io_service, m_configuration.listen_on);
+
+		async_accept(m_tcp_acceptor);
+
+		m_logger(fl::LL_INFORMATION) << "Serving metrics on " << m_configuration.listen_on << ".";
+	}
+
+	m_thread = boost::thread(boost::bind(&boost::asio::io_service::run, &m_io_service));
+}
+
+void metrics_server::close()
+{
+	m_io_service.stop();
+
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+
+	m_connections.clear();
+	m_tcp_acceptor.reset();
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+	if (m_unix_acceptor)
+	{
+		m_unix_acceptor.reset();
+
+		boost::system::error_code ec;
+		fs::remove(m_configuration.unix_socket, ec);
+	}
+#endif
+}
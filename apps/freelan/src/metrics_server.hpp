@@ -0,0 +1,161 @@
+/*
+ * freelan - An open, multi-platform software to establish peer-to-peer virtual
+ * private networks.
+ *
+ * Copyright (C) 2010-2011 Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ *
+ * This file is part of freelan.
+ *
+ * freelan is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * freelan is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use freelan in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file metrics_server.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief A local endpoint that serves the core statistics in the Prometheus text format.
+ */
+
+#ifndef METRICS_SERVER_HPP
+#define METRICS_SERVER_HPP
+
+#include <iostream>
+#include <set>
+
+#include <boost/asio.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <freelan/logger.hpp>
+#include <freelan/core.hpp>
+
+/**
+ * \brief The metrics endpoint configuration.
+ */
+struct metrics_configuration
+{
+	metrics_configuration() :
+		enabled(false),
+		listen_on(),
+		unix_socket()
+	{}
+
+	/**
+	 * \brief Whether the metrics endpoint is enabled.
+	 */
+	bool enabled;
+
+	/**
+	 * \brief The loopback TCP endpoint to listen on.
+	 */
+	boost::asio::ip::tcp::endpoint listen_on;
+
+	/**
+	 * \brief The Unix domain socket to listen on instead of listen_on, if not empty.
+	 */
+	boost::filesystem::path unix_socket;
+};
+
+/**
+ * \brief Write the core statistics in the Prometheus text format.
+ * \param os The output stream.
+ * \param statistics The statistics to write.
+ */
+void write_prometheus_metrics(std::ostream& os, const freelan::core::statistics_type& statistics);
+
+/**
+ * \brief Write the result of a link test in a human-readable text format.
+ * \param os The output stream.
+ * \param peer The peer the link was tested with.
+ * \param result The result to write.
+ */
+void write_link_test_report(std::ostream& os, const freelan::core::ep_type& peer, const freelan::link_test_result& result);
+
+/**
+ * \brief A metrics server.
+ *
+ * Answers every HTTP GET request on /metrics with the core statistics.
+ *
+ * A POST request on /link-test runs a link test with a peer and answers with its result once it is done. It must carry the X-Freelan-Link-Test header, which web pages cannot make a browser send without its consent.
+ *
+ * Clients get a few seconds to send their request and to read the response, and only a handful of connections are served at once: the others are closed right away.
+ *
+ * The server runs its own io_service in its own thread: the only work done on the core side is the statistics snapshot, so a slow or stalled scraper never delays the forwarding.
+ */
+class metrics_server
+{
+	public:
+
+		/**
+		 * \brief Create a metrics server.
+		 * \param configuration The configuration.
+		 * \param core The core to get the statistics from. Must outlive the metrics server.
+		 * \param logger The logger.
+		 */
+		metrics_server(const metrics_configuration& configuration, freelan::core& core, const freelan::logger& logger);
+
+		/**
+		 * \brief Stop the metrics server.
+		 */
+		~metrics_server();
+
+		/**
+		 * \brief Start listening and serving requests.
+		 */
+		void open();
+
+		/**
+		 * \brief Stop serving requests.
+		 *
+		 * Must be called once the core io_service is no longer running, so that no statistics snapshot is still in flight.
+		 */
+		void close();
+
+	private:
+
+		class connection;
+
+		template <typename Acceptor>
+		void async_accept(boost::shared_ptr<Acceptor> acceptor);
+
+		metrics_configuration m_configuration;
+		freelan::core& m_core;
+		freelan::logger m_logger;
+		boost::asio::io_service m_io_service;
+		boost::shared_ptr<boost::asio::ip::tcp::acceptor> m_tcp_acceptor;
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+		boost::shared_ptr<boost::asio::local::stream_protocol::acceptor> m_unix_acceptor;
+#endif
+		std::set<boost::shared_ptr<connection> > m_connections;
+		boost::thread m_thread;
+};
+
+#endif /* METRICS_SERVER_HPP */
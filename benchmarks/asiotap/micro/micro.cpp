@@ -0,0 +1,262 @@
+/**
+ * \file micro.cpp
+ * \author Julien Kauffmann <julien.kauffmann@freelan.org>
+ * \brief The asiotap microbenchmarks: checksums and frame parsing.
+ */
+
+#include "benchmark.hpp"
+
+#include <asiotap/osi/checksum.hpp>
+#include <asiotap/osi/checksum_helper.hpp>
+#include <asiotap/osi/checksum_kernel.hpp>
+#include <asiotap/osi/ethernet_builder.hpp>
+#include <asiotap/osi/ethernet_filter.hpp>
+#include <asiotap/osi/ipv4_builder.hpp>
+#include <asiotap/osi/ipv4_filter.hpp>
+#include <asiotap/osi/parser.hpp>
+#include <asiotap/osi/tcp_filter.hpp>
+#include <asiotap/osi/udp_builder.hpp>
+#include <asiotap/osi/udp_filter.hpp>
+
+#include <cstring>
+#include <random>
+
+namespace
+{
+	using namespace asiotap::osi;
+
+	const size_t SIZES[] = { 64, 576, 1500 };
+
+	// The checksum kernels are also measured on jumbo frames and offloaded super-packets.
+	const size_t CHECKSUM_SIZES[] = { 64, 576, 1500, 9000, 65536 };
+
+	const checksum_kernel_type KERNELS[] = { checksum_kernel_type::scalar, checksum_kernel_type::sse2, checksum_kernel_type::avx2, checksum_kernel_type::neon };
+
+	const uint8_t TARGET_ADDRESS[ETHERNET_ADDRESS_SIZE] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+	const uint8_t SENDER_ADDRESS[ETHERNET_ADDRESS_SIZE] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 };
+
+	std::vector<uint8_t> random_bytes(size_t size)
+	{
+		std::vector<uint8_t> result(size);
+		std::mt19937 generator(42);
+
+		for (auto&& byte : result)
+		{
+			byte = static_cast<uint8_t>(generator());
+		}
+
+		return result;
+	}
+
+	// Builds an Ethernet/IPv4 frame around the last payload_size bytes of buffer and returns it.
+	std::vector<uint8_t> make_ipv4_frame(std::vector<uint8_t>& buffer, size_t payload_size, uint8_t protocol)
+	{
+		const boost::asio::mutable_buffer buf = boost::asio::buffer(buffer);
+
+		builder<ipv4_frame> ipv4_builder(buf, payload_size);
+		size_t size = ipv4_builder.write(0, 1, 0, 0, 64, protocol, boost::asio::ip::address_v4::from_string("9.0.0.1"), boost::asio::ip::address_v4::from_string("9.0.0.2"));
+
+		builder<ethernet_frame> ethernet_builder(buf, size);
+		size = ethernet_builder.write(boost::asio::buffer(TARGET_ADDRESS), boost::asio::buffer(SENDER_ADDRESS), IP_PROTOCOL);
+
+		return std::vector<uint8_t>(buffer.end() - size, buffer.end());
+	}
+
+	std::vector<uint8_t> make_udp_frame(size_t payload_size)
+	{
+		std::vector<uint8_t> buffer = random_bytes(payload_size + 64);
+		const boost::asio::mutable_buffer buf = boost::asio::buffer(buffer);
+
+		builder<udp_frame> udp_builder(buf, payload_size);
+		size_t size = udp_builder.write(12000, 12000);
+
+		builder<ipv4_frame> ipv4_builder(buf, size);
+		size = ipv4_builder.write(0, 1, 0, 0, 64, UDP_PROTOCOL, boost::asio::ip::address_v4::from_string("9.0.0.1"), boost::asio::ip::address_v4::from_string("9.0.0.2"));
+		udp_builder.update_checksum(ipv4_builder.get_helper());
+
+		builder<ethernet_frame> ethernet_builder(buf, size);
+		size = ethernet_builder.write(boost::asio::buffer(TARGET_ADDRESS), boost::asio::buffer(SENDER_ADDRESS), IP_PROTOCOL);
+
+		return std::vector<uint8_t>(buffer.end() - size, buffer.end());
+	}
+
+	std::vector<uint8_t> make_tcp_frame(size_t payload_size)
+	{
+		std::vector<uint8_t> buffer = random_bytes(payload_size + sizeof(tcp_frame) + 64);
+
+		// There is no TCP builder: a bare ACK header is enough for parsing.
+		tcp_frame header = tcp_frame();
+		header.source = htons(40000);
+		header.destination = htons(443);
+		header.data_offset = (sizeof(tcp_frame) / 4) << 4;
+		header.flags = 0x10;
+		header.window = htons(65535);
+		std::memcpy(&buffer[buffer.size() - payload_size - sizeof(tcp_frame)], &header, sizeof(header));
+
+		return make_ipv4_frame(buffer, payload_size + sizeof(tcp_frame), TCP_PROTOCOL);
+	}
+
+	bool check_checksums()
+	{
+		const std::vector<uint8_t> buffer = random_bytes(CHECKSUM_SIZES[sizeof(CHECKSUM_SIZES) / sizeof(CHECKSUM_SIZES[0]) - 1] + 1);
+
+		for (checksum_kernel_type kernel : KERNELS)
+		{
+			if (!is_checksum_kernel_supported(kernel))
+			{
+				continue;
+			}
+
+			for (size_t size : CHECKSUM_SIZES)
+			{
+				if (checksum_sum(kernel, &buffer[1], size) != checksum_sum(checksum_kernel_type::scalar, &buffer[1], size))
+				{
+					std::cerr << get_checksum_kernel_name(kernel) << " gives a wrong result for " << size << " bytes" << std::endl;
+
+					return false;
+				}
+			}
+		}
+
+		// RFC 1624: changing a field incrementally must give the same checksum as summing everything again.
+		std::vector<uint8_t> header(buffer.begin(), buffer.begin() + 20);
+		const uint16_t checksum = compute_checksum(reinterpret_cast<const uint16_t*>(&header[0]), header.size());
+		const uint16_t old_value = reinterpret_cast<const uint16_t*>(&header[0])[4];
+		const uint16_t new_value = static_cast<uint16_t>(old_value + 1);
+
+		reinterpret_cast<uint16_t*>(&header[0])[4] = new_value;
+
+		if (update_checksum(checksum, old_value, new_value) != compute_checksum(reinterpret_cast<const uint16_t*>(&header[0]), header.size()))
+		{
+			std::cerr << "The incremental checksum update gives a wrong result" << std::endl;
+
+			return false;
+		}
+
+		return true;
+	}
+
+	void register_checksums()
+	{
+		for (size_t size : CHECKSUM_SIZES)
+		{
+			for (checksum_kernel_type kernel : KERNELS)
+			{
+				if (!is_checksum_kernel_supported(kernel))
+				{
+					continue;
+				}
+
+				benchmark::add(std::string("checksum_sum/") + get_checksum_kernel_name(kernel) + "/" + std::to_string(size), [kernel, size] (benchmark::state& state) {
+					const std::vector<uint8_t> buffer = random_bytes(size + 1);
+					state.set_bytes_per_iteration(size);
+
+					// Frame payloads are usually unaligned.
+					while (state.keep_running())
+					{
+						benchmark::do_not_optimize(checksum_sum(kernel, &buffer[1], size));
+					}
+				});
+			}
+
+			// The kernel that is selected at runtime, through its dispatch.
+			benchmark::add("checksum_sum/" + std::to_string(size), [size] (benchmark::state& state) {
+				const std::vector<uint8_t> buffer = random_bytes(size + 1);
+				state.set_bytes_per_iteration(size);
+
+				while (state.keep_running())
+				{
+					benchmark::do_not_optimize(checksum_sum(&buffer[1], size));
+				}
+			});
+
+			benchmark::add("checksum_helper/" + std::to_string(size), [size] (benchmark::state& state) {
+				const std::vector<uint8_t> buffer = random_bytes(size);
+				state.set_bytes_per_iteration(size);
+
+				while (state.keep_running())
+				{
+					checksum_helper helper;
+					helper.update(reinterpret_cast<const uint16_t*>(&buffer[0]), size);
+					benchmark::do_not_optimize(helper.compute());
+				}
+			});
+		}
+
+		benchmark::add("update_checksum", [] (benchmark::state& state) {
+			uint16_t checksum = 0x1234;
+			uint16_t value = 0;
+
+			while (state.keep_running())
+			{
+				checksum = update_checksum(checksum, value, static_cast<uint16_t>(value + 1));
+				++value;
+			}
+
+			benchmark::do_not_optimize(checksum);
+		});
+	}
+
+	void register_parsers()
+	{
+		for (size_t size : SIZES)
+		{
+			benchmark::add("parser/ethernet_ipv4_udp/" + std::to_string(size), [size] (benchmark::state& state) {
+				const std::vector<uint8_t> frame = make_udp_frame(size);
+				state.set_bytes_per_iteration(frame.size());
+				size_t matches = 0;
+
+				while (state.keep_running())
+				{
+					parser<ethernet_frame, ipv4_frame, udp_frame>::parse(boost::asio::buffer(frame), [&matches] (const_helper<ethernet_frame>, const_helper<ipv4_frame>, const_helper<udp_frame>) { ++matches; });
+				}
+
+				benchmark::do_not_optimize(matches);
+			});
+
+			benchmark::add("parser/ethernet_ipv4_tcp/" + std::to_string(size), [size] (benchmark::state& state) {
+				const std::vector<uint8_t> frame = make_tcp_frame(size);
+				state.set_bytes_per_iteration(frame.size());
+				size_t matches = 0;
+
+				while (state.keep_running())
+				{
+					parser<ethernet_frame, ipv4_frame, tcp_frame>::parse(boost::asio::buffer(frame), [&matches] (const_helper<ethernet_frame>, const_helper<ipv4_frame>, const_helper<tcp_frame>) { ++matches; });
+				}
+
+				benchmark::do_not_optimize(matches);
+			});
+
+			benchmark::add("filter/ethernet_ipv4_udp/" + std::to_string(size), [size] (benchmark::state& state) {
+				const std::vector<uint8_t> frame = make_udp_frame(size);
+				state.set_bytes_per_iteration(frame.size());
+				size_t matches = 0;
+
+				filter<ethernet_frame> ethernet_filter;
+				filter<ipv4_frame, filter<ethernet_frame> > ipv4_filter(ethernet_filter);
+				filter<udp_frame, filter<ipv4_frame, filter<ethernet_frame> > > udp_filter(ipv4_filter);
+				udp_filter.add_handler([&matches] (const_helper<udp_frame>) { ++matches; });
+
+				while (state.keep_running())
+				{
+					ethernet_filter.parse(boost::asio::buffer(frame));
+				}
+
+				benchmark::do_not_optimize(matches);
+			});
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (!check_checksums())
+	{
+		return EXIT_FAILURE;
+	}
+
+	register_checksums();
+	register_parsers();
+
+	return benchmark::main(argc, argv);
+}
@@ -0,0 +1,207 @@
+/**
+ * \file micro.cpp
+ * \author Julien Kauffmann <julien.kauffmann@freelan.org>
+ * \brief The freelan microbenchmarks: switching and routing.
+ */
+
+#include "benchmark.hpp"
+
+#include <freelan/configuration.hpp>
+#include <freelan/port_index.hpp>
+#include <freelan/router.hpp>
+#include <freelan/switch.hpp>
+
+#include <asiotap/osi/ethernet_builder.hpp>
+#include <asiotap/osi/ipv4_builder.hpp>
+#include <asiotap/osi/udp_builder.hpp>
+
+namespace
+{
+	using namespace asiotap::osi;
+
+	const size_t PAYLOAD_SIZE = 1400;
+
+	const unsigned int PORT_COUNTS[] = { 2, 16, 128 };
+
+	const unsigned int ADDRESS_COUNTS[] = { 1, 64, 1024 };
+
+	const unsigned int ROUTE_COUNTS[] = { 1, 64, 4096 };
+
+	const unsigned int THREADS[] = { 1, 4 };
+
+	// The router ports the routes are spread over.
+	const unsigned int ROUTER_PORT_COUNT = 16;
+
+	freelan::port_index_type make_endpoint_port_index(unsigned int index)
+	{
+		return freelan::make_port_index(fscp::server::ep_type(boost::asio::ip::address_v4(0x7f000001), static_cast<unsigned short>(10000 + index)));
+	}
+
+	template <typename HandlerType>
+	void discard_write(boost::asio::const_buffer, HandlerType handler)
+	{
+		handler(boost::system::error_code());
+	}
+
+	boost::array<uint8_t, ETHERNET_ADDRESS_SIZE> make_ethernet_address(unsigned int index)
+	{
+		const boost::array<uint8_t, ETHERNET_ADDRESS_SIZE> result = {{ 0x02, 0x00, static_cast<uint8_t>(index >> 24), static_cast<uint8_t>(index >> 16), static_cast<uint8_t>(index >> 8), static_cast<uint8_t>(index) }};
+
+		return result;
+	}
+
+	// Builds an IPv4/UDP frame, optionally wrapped in an Ethernet frame.
+	std::vector<uint8_t> make_frame(const boost::asio::ip::address_v4& destination, const boost::array<uint8_t, ETHERNET_ADDRESS_SIZE>* target, const boost::array<uint8_t, ETHERNET_ADDRESS_SIZE>* sender)
+	{
+		std::vector<uint8_t> buffer(PAYLOAD_SIZE + 64);
+		const boost::asio::mutable_buffer buf = boost::asio::buffer(buffer);
+
+		builder<udp_frame> udp_builder(buf, PAYLOAD_SIZE);
+		size_t size = udp_builder.write(12000, 12000);
+
+		builder<ipv4_frame> ipv4_builder(buf, size);
+		size = ipv4_builder.write(0, 1, 0, 0, 64, UDP_PROTOCOL, boost::asio::ip::address_v4::from_string("9.0.0.1"), destination);
+		udp_builder.update_checksum(ipv4_builder.get_helper());
+
+		if (target && sender)
+		{
+			builder<ethernet_frame> ethernet_builder(buf, size);
+			size = ethernet_builder.write(boost::asio::buffer(*target), boost::asio::buffer(*sender), IP_PROTOCOL);
+		}
+
+		return std::vector<uint8_t>(buffer.end() - size, buffer.end());
+	}
+
+	void register_switches()
+	{
+		for (unsigned int port_count : PORT_COUNTS)
+		{
+			for (unsigned int address_count : ADDRESS_COUNTS)
+			{
+				benchmark::add("switch_async_write/ports:" + std::to_string(port_count) + "/addresses:" + std::to_string(address_count), [port_count, address_count] (benchmark::state& state) {
+					freelan::switch_ _switch(freelan::switch_configuration(), address_count + 1);
+
+					for (unsigned int i = 0; i < port_count; ++i)
+					{
+						_switch.register_port(make_endpoint_port_index(i), freelan::switch_::port_type(&discard_write<freelan::switch_::port_type::write_handler_type>, 1));
+					}
+
+					const auto handler = [] (const freelan::switch_::multi_write_result_type&) {};
+
+					// Every address but the one of the sending port gets learnt on one of the other ports.
+					const boost::array<uint8_t, ETHERNET_ADDRESS_SIZE> broadcast_address = {{ 0xff, 0xff, 0xff, 0xff, 0xff, 0xff }};
+					const boost::array<uint8_t, ETHERNET_ADDRESS_SIZE> source_address = make_ethernet_address(0);
+					std::vector<std::vector<uint8_t> > frames;
+
+					for (unsigned int i = 1; i <= address_count; ++i)
+					{
+						const boost::array<uint8_t, ETHERNET_ADDRESS_SIZE> address = make_ethernet_address(i);
+						const std::vector<uint8_t> frame = make_frame(boost::asio::ip::address_v4(i), &broadcast_address, &address);
+
+						_switch.async_write(make_endpoint_port_index(1 + i % (port_count - 1)), boost::asio::buffer(frame), handler);
+
+						frames.push_back(make_frame(boost::asio::ip::address_v4(i), &address, &source_address));
+					}
+
+					const freelan::port_index_type source_port = make_endpoint_port_index(0);
+					size_t index = 0;
+					state.set_bytes_per_iteration(frames.front().size());
+
+					while (state.keep_running())
+					{
+						_switch.async_write(source_port, boost::asio::buffer(frames[index]), handler);
+
+						if (++index == frames.size())
+						{
+							index = 0;
+						}
+					}
+				});
+			}
+		}
+	}
+
+	void register_routers()
+	{
+		for (unsigned int route_count : ROUTE_COUNTS)
+		{
+			for (bool spread : { false, true })
+			{
+				for (unsigned int threads : THREADS)
+				{
+					// Routes are 10.x.y.0/24 networks. A single destination is always answered by the route cache, while destinations spread over all the routes are not.
+					const std::string name = "router_async_write/routes:" + std::to_string(route_count) + (spread ? "/destinations:all" : "/destinations:1");
+
+					benchmark::add(name, [route_count, spread] (benchmark::state& state) {
+						static std::map<unsigned int, boost::shared_ptr<freelan::router> > routers;
+						static boost::mutex routers_mutex;
+
+						boost::shared_ptr<freelan::router> _router;
+
+						{
+							// The threads of a run share a router, as the threads of a core do.
+							boost::mutex::scoped_lock lock(routers_mutex);
+
+							boost::shared_ptr<freelan::router>& shared_router = routers[route_count];
+
+							if (!shared_router)
+							{
+								freelan::router_configuration configuration;
+								shared_router = boost::make_shared<freelan::router>(configuration);
+
+								std::vector<asiotap::ip_route_set> routes(ROUTER_PORT_COUNT);
+
+								for (unsigned int i = 0; i < route_count; ++i)
+								{
+									routes[i % ROUTER_PORT_COUNT].insert(asiotap::to_ip_route(boost::asio::ip::address_v4(0x0a000000 | (i << 8)), 24));
+								}
+
+								shared_router->register_port(make_endpoint_port_index(0), freelan::router::port_type(&discard_write<freelan::router::port_type::write_handler_type>, 0));
+
+								for (unsigned int i = 0; i < ROUTER_PORT_COUNT; ++i)
+								{
+									freelan::router::port_type port(&discard_write<freelan::router::port_type::write_handler_type>, 1);
+									port.set_local_routes(routes[i]);
+
+									shared_router->register_port(make_endpoint_port_index(1 + i), port);
+								}
+							}
+
+							_router = shared_router;
+						}
+
+						std::vector<std::vector<uint8_t> > frames;
+
+						for (unsigned int i = 0; i < (spread ? route_count : 1); ++i)
+						{
+							frames.push_back(make_frame(boost::asio::ip::address_v4(0x0a000001 | (i << 8)), NULL, NULL));
+						}
+
+						const freelan::port_index_type source_port = make_endpoint_port_index(0);
+						const auto handler = [] (const boost::system::error_code&) {};
+						size_t index = 0;
+						state.set_bytes_per_iteration(frames.front().size());
+
+						while (state.keep_running())
+						{
+							_router->async_write(source_port, boost::asio::buffer(frames[index]), handler);
+
+							if (++index == frames.size())
+							{
+								index = 0;
+							}
+						}
+					}, threads);
+				}
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	register_switches();
+	register_routers();
+
+	return benchmark::main(argc, argv);
+}
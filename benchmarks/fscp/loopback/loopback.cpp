@@ -0,0 +1,321 @@
+/**
+ * \file loopback.cpp
+ * \author Julien Kauffmann <julien.kauffmann@freelan.org>
+ * \brief A FSCP throughput and latency benchmark over the loopback interface.
+ *
+ * Two servers establish a session on 127.0.0.1, then one of them sends data messages of a fixed payload size to the other, keeping a constant number of messages in flight. Each payload size is measured in turn.
+ *
+ * For each payload size, a summary is written on the standard error and a line of JSON on the standard output, so that results can be tracked over time.
+ */
+
+#include <fscp/fscp.hpp>
+
+#include <cryptoplus/cryptoplus.hpp>
+#include <cryptoplus/error/error_strings.hpp>
+
+#include <boost/asio.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/program_options.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+namespace po = boost::program_options;
+
+namespace
+{
+	// Each payload starts with its sequence number and its send time.
+	const size_t HEADER_SIZE = 2 * sizeof(uint64_t);
+
+	const boost::posix_time::time_duration SESSION_TIMEOUT = boost::posix_time::seconds(10);
+	const boost::posix_time::time_duration STALL_PERIOD = boost::posix_time::milliseconds(100);
+	const boost::posix_time::time_duration DRAIN_PERIOD = boost::posix_time::milliseconds(200);
+
+	struct run_type
+	{
+		run_type(size_t _payload_size, unsigned int window) :
+			payload_size(_payload_size),
+			payloads(window, std::vector<uint8_t>(_payload_size)),
+			running(true),
+			sent(0),
+			received(0),
+			latency()
+		{
+		}
+
+		const size_t payload_size;
+		std::vector<std::vector<uint8_t> > payloads;
+		std::atomic<bool> running;
+		std::atomic<uint64_t> sent;
+		std::atomic<uint64_t> received;
+		fscp::latency_histogram latency;
+	};
+
+	boost::shared_ptr<run_type> current_run;
+
+	void send_one(fscp::server& server, const fscp::server::ep_type& target, const boost::shared_ptr<run_type>& run)
+	{
+		const uint64_t sequence = run->sent.fetch_add(1, std::memory_order_relaxed);
+		const int64_t timestamp = fscp::latency_clock::now().time_since_epoch().count();
+
+		// As at most as many messages as there are payloads are in flight, a payload is never rewritten while it is being sent, unless its message was lost.
+		std::vector<uint8_t>& payload = run->payloads[sequence % run->payloads.size()];
+		std::memcpy(&payload[0], &sequence, sizeof(sequence));
+		std::memcpy(&payload[sizeof(sequence)], &timestamp, sizeof(timestamp));
+
+		// The handler holds the run, and thus the payload, until the message was sent.
+		server.async_send_data(target, fscp::CHANNEL_NUMBER_0, boost::asio::buffer(payload), [run] (const boost::system::error_code&) {});
+	}
+
+	void on_data(fscp::server& server, const fscp::server::ep_type& target, boost::asio::const_buffer data)
+	{
+		const boost::shared_ptr<run_type> run = boost::atomic_load(&current_run);
+
+		if (!run || (boost::asio::buffer_size(data) != run->payload_size))
+		{
+			return;
+		}
+
+		int64_t timestamp;
+		std::memcpy(&timestamp, boost::asio::buffer_cast<const uint8_t*>(data) + sizeof(uint64_t), sizeof(timestamp));
+
+		run->latency.record(fscp::latency_clock::now().time_since_epoch() - fscp::latency_clock::duration(timestamp));
+		run->received.fetch_add(1, std::memory_order_relaxed);
+
+		if (run->running)
+		{
+			send_one(server, target, run);
+		}
+	}
+
+	double to_microseconds(fscp::latency_clock::duration duration)
+	{
+		return std::chrono::duration_cast<std::chrono::duration<double, std::micro> >(duration).count();
+	}
+
+	void measure(fscp::server& server, const fscp::server::ep_type& target, size_t payload_size, unsigned int window, double duration)
+	{
+		const boost::shared_ptr<run_type> run = boost::make_shared<run_type>(payload_size, window);
+		boost::atomic_store(&current_run, run);
+
+		const std::clock_t cpu_start = std::clock();
+		const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+		const boost::posix_time::ptime end = start + boost::posix_time::microseconds(static_cast<int64_t>(duration * 1000000));
+
+		for (unsigned int i = 0; i < window; ++i)
+		{
+			send_one(server, target, run);
+		}
+
+		uint64_t last_received = 0;
+		uint64_t stalls = 0;
+
+		while (boost::posix_time::microsec_clock::universal_time() < end)
+		{
+			boost::this_thread::sleep(STALL_PERIOD);
+
+			const uint64_t received = run->received.load();
+
+			if (received == last_received)
+			{
+				// Datagrams are dropped when the socket buffers are full: without this, lost messages would shrink the window until nothing is in flight anymore.
+				++stalls;
+
+				for (unsigned int i = 0; i < window; ++i)
+				{
+					send_one(server, target, run);
+				}
+			}
+
+			last_received = received;
+		}
+
+		run->running = false;
+
+		const double elapsed = static_cast<double>((boost::posix_time::microsec_clock::universal_time() - start).total_microseconds()) / 1000000;
+		const double cpu = static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+		const uint64_t packets = run->received.load();
+
+		boost::this_thread::sleep(DRAIN_PERIOD);
+		boost::atomic_store(&current_run, boost::shared_ptr<run_type>());
+
+		const uint64_t lost = run->sent.load() - run->received.load();
+		const fscp::latency_histogram_snapshot latency = run->latency.snapshot();
+		const double bytes = static_cast<double>(packets) * payload_size;
+		const double packets_per_second = packets / elapsed;
+		const double gbit_per_second = bytes * 8 / elapsed / 1000000000;
+		const double p50 = to_microseconds(latency.value_at_quantile(0.5));
+		const double p99 = to_microseconds(latency.value_at_quantile(0.99));
+		const double cpu_ns_per_byte = (bytes > 0) ? (cpu * 1000000000 / bytes) : 0;
+
+		std::cerr << "payload " << payload_size << " B: "
+			<< std::fixed << std::setprecision(0) << packets_per_second << " packets/s, "
+			<< std::setprecision(3) << gbit_per_second << " Gbit/s, "
+			<< "p50 " << std::setprecision(1) << p50 << " us, "
+			<< "p99 " << p99 << " us, "
+			<< std::setprecision(2) << cpu_ns_per_byte << " ns CPU/B, "
+			<< lost << " lost" << std::endl;
+
+		std::cout << std::fixed << std::setprecision(6)
+			<< "{\"benchmark\": \"fscp_loopback\""
+			<< ", \"payload_size\": " << payload_size
+			<< ", \"window\": " << window
+			<< ", \"duration_s\": " << elapsed
+			<< ", \"packets\": " << packets
+			<< ", \"lost\": " << lost
+			<< ", \"stalls\": " << stalls
+			<< ", \"packets_per_second\": " << packets_per_second
+			<< ", \"gbit_per_second\": " << gbit_per_second
+			<< ", \"latency_p50_us\": " << p50
+			<< ", \"latency_p99_us\": " << p99
+			<< ", \"cpu_ns_per_byte\": " << cpu_ns_per_byte
+			<< "}" << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	cryptoplus::crypto_initializer crypto_initializer;
+	cryptoplus::algorithms_initializer algorithms_initializer;
+	cryptoplus::error::error_strings_initializer error_strings_initializer;
+
+	po::options_description options("Options");
+	options.add_options()
+		("help,h", "Produce help message.")
+		("payload-size,s", po::value<std::vector<size_t> >()->multitoken()->default_value(std::vector<size_t>{ 64, 512, 1400 }, "64 512 1400"), "The payload sizes to measure, in bytes.")
+		("duration,d", po::value<double>()->default_value(5), "The duration of each measure, in seconds.")
+		("window,w", po::value<unsigned int>()->default_value(64), "The number of messages in flight.")
+		("threads,t", po::value<unsigned int>()->default_value(boost::thread::hardware_concurrency()), "The number of threads that run the servers.")
+		("port,p", po::value<unsigned short>()->default_value(12100), "The port of the first server. The second one listens on the next port.")
+		;
+
+	try
+	{
+		po::variables_map vm;
+		po::store(po::parse_command_line(argc, argv, options), vm);
+		po::notify(vm);
+
+		if (vm.count("help"))
+		{
+			std::cerr << options << std::endl;
+
+			return EXIT_SUCCESS;
+		}
+
+		const std::vector<size_t> payload_sizes = vm["payload-size"].as<std::vector<size_t> >();
+		const double duration = vm["duration"].as<double>();
+		const unsigned int window = std::max(vm["window"].as<unsigned int>(), 1u);
+		const unsigned int thread_count = std::max(vm["threads"].as<unsigned int>(), 1u);
+		const unsigned short port = vm["port"].as<unsigned short>();
+
+		for (auto&& payload_size : payload_sizes)
+		{
+			if (payload_size < HEADER_SIZE)
+			{
+				std::cerr << "Payload sizes must be at least " << HEADER_SIZE << " bytes." << std::endl;
+
+				return EXIT_FAILURE;
+			}
+		}
+
+		using cryptoplus::file;
+
+		const cryptoplus::x509::certificate alice_cert = cryptoplus::x509::certificate::from_certificate(file::open("alice.crt", "r"));
+		const cryptoplus::pkey::pkey alice_key = cryptoplus::pkey::pkey::from_private_key(file::open("alice.key", "r"));
+		const cryptoplus::x509::certificate bob_cert = cryptoplus::x509::certificate::from_certificate(file::open("bob.crt", "r"));
+		const cryptoplus::pkey::pkey bob_key = cryptoplus::pkey::pkey::from_private_key(file::open("bob.key", "r"));
+
+		boost::asio::io_service io_service;
+		boost::shared_ptr<boost::asio::io_service::work> work = boost::make_shared<boost::asio::io_service::work>(io_service);
+
+		fscp::server alice_server(io_service, fscp::identity_store(alice_cert, alice_key));
+		fscp::server bob_server(io_service, fscp::identity_store(bob_cert, bob_key));
+
+		const fscp::server::ep_type alice_endpoint(boost::asio::ip::address_v4::loopback(), port);
+		const fscp::server::ep_type bob_endpoint(boost::asio::ip::address_v4::loopback(), port + 1);
+
+		boost::mutex session_mutex;
+		boost::condition_variable session_condition;
+		unsigned int established_sessions = 0;
+
+		const auto on_session_established = [&] (const fscp::server::ep_type&, bool, const fscp::cipher_suite_type&, const fscp::elliptic_curve_type&) {
+			boost::mutex::scoped_lock lock(session_mutex);
+
+			++established_sessions;
+			session_condition.notify_all();
+		};
+
+		alice_server.set_session_established_callback(on_session_established);
+		bob_server.set_session_established_callback(on_session_established);
+
+		// Bob answers each message to keep the window full: the messages flow from Alice to Bob only.
+		bob_server.set_data_received_callback([&] (const fscp::server::ep_type&, fscp::channel_number_type, fscp::server::shared_buffer_type, boost::asio::const_buffer data) {
+			on_data(alice_server, bob_endpoint, data);
+		});
+
+		alice_server.open(alice_endpoint);
+		bob_server.open(bob_endpoint);
+
+		alice_server.set_presentation(bob_endpoint, bob_cert);
+		bob_server.set_presentation(alice_endpoint, alice_cert);
+
+		boost::thread_group threads;
+
+		for (unsigned int i = 0; i < thread_count; ++i)
+		{
+			threads.create_thread(boost::bind(&boost::asio::io_service::run, &io_service));
+		}
+
+		alice_server.async_request_session(bob_endpoint, [] (const boost::system::error_code&) {});
+		bob_server.async_request_session(alice_endpoint, [] (const boost::system::error_code&) {});
+
+		bool established;
+
+		{
+			boost::mutex::scoped_lock lock(session_mutex);
+
+			const boost::posix_time::ptime deadline = boost::posix_time::microsec_clock::universal_time() + SESSION_TIMEOUT;
+
+			while ((established_sessions < 2) && session_condition.timed_wait(lock, deadline)) {}
+
+			established = (established_sessions >= 2);
+		}
+
+		if (established)
+		{
+			std::cerr << "Session established. Measuring with " << thread_count << " thread(s) and " << window << " message(s) in flight." << std::endl;
+
+			for (auto&& payload_size : payload_sizes)
+			{
+				measure(alice_server, bob_endpoint, payload_size, window, duration);
+			}
+		}
+		else
+		{
+			std::cerr << "Unable to establish a session." << std::endl;
+		}
+
+		alice_server.close();
+		bob_server.close();
+		work.reset();
+		threads.join_all();
+
+		return established ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	catch (std::exception& ex)
+	{
+		std::cerr << "Error: " << ex.what() << std::endl;
+
+		return EXIT_FAILURE;
+	}
+}
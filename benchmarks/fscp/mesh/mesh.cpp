@@ -0,0 +1,748 @@
+/**
+ * \file mesh.cpp
+ * \author Julien Kauffmann <julien.kauffmann@freelan.org>
+ * \brief A FSCP control plane scaling benchmark.
+ *
+ * Many servers run in the same process, on consecutive loopback ports, and connect to each other the way freelan nodes do: a HELLO is answered by a PRESENTATION, and a PRESENTATION by a SESSION_REQUEST. With the full topology, every node knows all the others from the start. With the star topology, the nodes only know the first one and find each other through contact requests sent to it.
+ *
+ * Once every node has a session with every other one, the process CPU time is measured over a few keep-alive periods.
+ *
+ * A summary is written on the standard error and a line of JSON on the standard output, so that results can be compared across mesh sizes.
+ */
+
+#include <fscp/fscp.hpp>
+
+#include <cryptoplus/cryptoplus.hpp>
+#include <cryptoplus/error/error_strings.hpp>
+#include <cryptoplus/hash/message_digest_algorithm.hpp>
+#include <cryptoplus/pkey/rsa_key.hpp>
+#include <cryptoplus/x509/certificate.hpp>
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/optional.hpp>
+#include <boost/program_options.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
+namespace po = boost::program_options;
+
+namespace
+{
+	const boost::posix_time::time_duration SETTLE_PERIOD = boost::posix_time::milliseconds(500);
+
+	enum class topology_type
+	{
+		full,
+		star
+	};
+
+	std::istream& operator>>(std::istream& is, topology_type& value)
+	{
+		std::string str;
+
+		if (is >> str)
+		{
+			if (str == "full")
+			{
+				value = topology_type::full;
+			}
+			else if (str == "star")
+			{
+				value = topology_type::star;
+			}
+			else
+			{
+				is.setstate(std::ios_base::failbit);
+			}
+		}
+
+		return is;
+	}
+
+	std::ostream& operator<<(std::ostream& os, topology_type value)
+	{
+		return os << ((value == topology_type::full) ? "full" : "star");
+	}
+
+	uint64_t resident_memory()
+	{
+#if defined(__linux__)
+		std::ifstream statm("/proc/self/statm");
+		uint64_t size = 0;
+		uint64_t resident = 0;
+
+		if (statm >> size >> resident)
+		{
+			return resident * static_cast<uint64_t>(::sysconf(_SC_PAGESIZE));
+		}
+#endif
+
+		return 0;
+	}
+
+	void raise_file_descriptor_limit()
+	{
+#if !defined(_WIN32)
+		// Each node has its own socket: the default soft limit is often too low for large meshes.
+		struct rlimit limit;
+
+		if ((::getrlimit(RLIMIT_NOFILE, &limit) == 0) && (limit.rlim_cur < limit.rlim_max))
+		{
+			limit.rlim_cur = limit.rlim_max;
+			::setrlimit(RLIMIT_NOFILE, &limit);
+		}
+#endif
+	}
+
+	fscp::identity_store make_identity(unsigned int index, unsigned int key_size)
+	{
+		using namespace cryptoplus;
+
+		const pkey::pkey key = pkey::pkey::from_rsa_key(pkey::rsa_key::generate_private_key(key_size, 17));
+		x509::certificate certificate = x509::certificate::create();
+
+		const std::string cn = "node" + std::to_string(index);
+
+		certificate.set_version(2);
+		certificate.subject().push_back("CN", MBSTRING_ASC, cn.c_str(), static_cast<int>(cn.size()));
+		certificate.set_issuer(certificate.subject());
+		certificate.set_serial_number(asn1::integer::from_long(index + 1));
+		certificate.set_not_before(asn1::utctime::from_ptime(boost::posix_time::second_clock::universal_time() - boost::posix_time::hours(1)));
+		certificate.set_not_after(asn1::utctime::from_ptime(boost::posix_time::second_clock::universal_time() + boost::posix_time::hours(24)));
+		certificate.set_public_key(key);
+		certificate.sign(key, hash::message_digest_algorithm(NID_sha256));
+
+		return fscp::identity_store(certificate, key);
+	}
+
+	double to_milliseconds(fscp::latency_clock::duration duration)
+	{
+		return std::chrono::duration_cast<std::chrono::duration<double, std::milli> >(duration).count();
+	}
+
+	struct node_type : private boost::noncopyable
+	{
+		node_type(boost::asio::io_service& io_service, const fscp::identity_store& identity, const fscp::server::ep_type& _endpoint, size_t node_count) :
+			server(io_service, identity),
+			endpoint(_endpoint),
+			hash(fscp::get_certificate_hash(identity.signature_certificate())),
+			mutex(),
+			wanted(node_count, false),
+			established(node_count, false),
+			last_attempt(node_count),
+			last_contact_request()
+		{
+		}
+
+		fscp::server server;
+		const fscp::server::ep_type endpoint;
+		const fscp::hash_type hash;
+
+		// The following members are protected by the mutex.
+		boost::mutex mutex;
+		std::vector<bool> wanted;
+		std::vector<bool> established;
+		std::vector<fscp::latency_clock::time_point> last_attempt;
+		fscp::latency_clock::time_point last_contact_request;
+	};
+
+	/**
+	 * \brief The mesh of nodes.
+	 *
+	 * A pair of nodes is always contacted by its node of lower index, so that each session is initiated once.
+	 */
+	class mesh_type : private boost::noncopyable
+	{
+		public:
+
+			mesh_type(boost::asio::io_service& io_service, topology_type topology, const boost::posix_time::time_duration& contact_period) :
+				m_io_service(io_service),
+				m_topology(topology),
+				m_contact_period(contact_period),
+				m_contact_strand(io_service),
+				m_contact_timer(io_service),
+				m_nodes(),
+				m_target_sessions(0),
+				m_start(),
+				m_session_times(),
+				m_handshake_times(),
+				m_mutex(),
+				m_condition(),
+				m_full_mesh_time(),
+				m_hello_responses(0),
+				m_hello_failures(0),
+				m_presentations(0),
+				m_contact_requests(0),
+				m_contacts(0),
+				m_established_sessions(0),
+				m_lost_sessions(0)
+			{
+			}
+
+			void add_node(const fscp::identity_store& identity, const fscp::server::ep_type& endpoint, size_t node_count)
+			{
+				m_nodes.push_back(boost::make_shared<node_type>(boost::ref(m_io_service), identity, endpoint, node_count));
+			}
+
+			size_t node_count() const
+			{
+				return m_nodes.size();
+			}
+
+			void open()
+			{
+				const size_t count = m_nodes.size();
+
+				m_target_sessions = count * (count - 1);
+
+				for (size_t index = 0; index < count; ++index)
+				{
+					node_type& node = *m_nodes[index];
+
+					node.server.set_hello_message_received_callback(boost::bind(&mesh_type::on_hello, this, index, _1, _2));
+					node.server.set_presentation_message_received_callback(boost::bind(&mesh_type::on_presentation, this, index, _1, _2, _3, _4));
+					node.server.set_session_established_callback(boost::bind(&mesh_type::on_session_established, this, index, _1, _2));
+					node.server.set_session_lost_callback(boost::bind(&mesh_type::on_session_lost, this));
+					node.server.set_contact_request_received_callback(boost::bind(&mesh_type::on_contact_request, this));
+					node.server.set_contact_received_callback(boost::bind(&mesh_type::on_contact, this, index, _3));
+
+					if (m_topology == topology_type::full)
+					{
+						for (size_t target = index + 1; target < count; ++target)
+						{
+							node.wanted[target] = true;
+						}
+					}
+					else if (index > 0)
+					{
+						node.wanted[0] = true;
+					}
+
+					node.server.open(node.endpoint);
+				}
+			}
+
+			void start()
+			{
+				m_start = fscp::latency_clock::now();
+
+				m_contact_strand.post([this] () {
+					m_contact_timer.expires_from_now(boost::posix_time::time_duration());
+					m_contact_timer.async_wait(m_contact_strand.wrap(boost::bind(&mesh_type::on_contact_timer, this, boost::asio::placeholders::error)));
+				});
+			}
+
+			bool wait_full_mesh(const boost::posix_time::time_duration& timeout)
+			{
+				boost::mutex::scoped_lock lock(m_mutex);
+
+				const boost::posix_time::ptime deadline = boost::posix_time::microsec_clock::universal_time() + timeout;
+
+				while ((m_established_sessions < m_target_sessions) && m_condition.timed_wait(lock, deadline)) {}
+
+				return (m_established_sessions >= m_target_sessions);
+			}
+
+			void stop_contacting()
+			{
+				m_contact_strand.post([this] () { m_contact_timer.cancel(); });
+			}
+
+			void close()
+			{
+				stop_contacting();
+
+				for (auto&& node : m_nodes)
+				{
+					node->server.close();
+				}
+			}
+
+			uint64_t target_sessions() const { return m_target_sessions; }
+			uint64_t established_sessions() const { return m_established_sessions; }
+			uint64_t hello_responses() const { return m_hello_responses; }
+			uint64_t hello_failures() const { return m_hello_failures; }
+			uint64_t presentations() const { return m_presentations; }
+			uint64_t contact_requests() const { return m_contact_requests; }
+			uint64_t contacts() const { return m_contacts; }
+			uint64_t lost_sessions() const { return m_lost_sessions; }
+
+			fscp::latency_clock::duration full_mesh_time() const
+			{
+				boost::mutex::scoped_lock lock(m_mutex);
+
+				return m_full_mesh_time;
+			}
+
+			fscp::latency_histogram_snapshot session_times() const { return m_session_times.snapshot(); }
+			fscp::latency_histogram_snapshot handshake_times() const { return m_handshake_times.snapshot(); }
+
+		private:
+
+			size_t index_of(const fscp::server::ep_type& host) const
+			{
+				const size_t index = host.port() - m_nodes.front()->endpoint.port();
+
+				return (index < m_nodes.size()) && (m_nodes[index]->endpoint == host) ? index : m_nodes.size();
+			}
+
+			void on_contact_timer(const boost::system::error_code& ec)
+			{
+				if (ec == boost::asio::error::operation_aborted)
+				{
+					return;
+				}
+
+				for (size_t index = 0; index < m_nodes.size(); ++index)
+				{
+					contact(index);
+				}
+
+				m_contact_timer.expires_from_now(m_contact_period);
+				m_contact_timer.async_wait(m_contact_strand.wrap(boost::bind(&mesh_type::on_contact_timer, this, boost::asio::placeholders::error)));
+			}
+
+			void contact(size_t index)
+			{
+				node_type& node = *m_nodes[index];
+				const fscp::latency_clock::time_point now = fscp::latency_clock::now();
+				const fscp::latency_clock::duration retry_period = std::chrono::microseconds(m_contact_period.total_microseconds());
+
+				std::vector<size_t> targets;
+				bool request_contacts = false;
+
+				{
+					boost::mutex::scoped_lock lock(node.mutex);
+
+					for (size_t target = 0; target < m_nodes.size(); ++target)
+					{
+						if (node.wanted[target] && !node.established[target] && (node.last_attempt[target].time_since_epoch().count() == 0 || (now - node.last_attempt[target] >= retry_period)))
+						{
+							node.last_attempt[target] = now;
+							targets.push_back(target);
+						}
+					}
+
+					// The hub was asked for the missing nodes when the session with it was established: it may not have known all of them yet.
+					if ((m_topology == topology_type::star) && (index > 0) && node.established[0] && (now - node.last_contact_request >= retry_period))
+					{
+						request_contacts = true;
+					}
+				}
+
+				for (auto&& target : targets)
+				{
+					greet(index, target);
+				}
+
+				if (request_contacts)
+				{
+					send_contact_request(index);
+				}
+			}
+
+			void greet(size_t index, size_t target)
+			{
+				node_type& node = *m_nodes[index];
+
+				node.server.async_greet(m_nodes[target]->endpoint, boost::bind(&mesh_type::on_hello_response, this, index, target, _1));
+			}
+
+			void send_contact_request(size_t index)
+			{
+				node_type& node = *m_nodes[index];
+				fscp::hash_list_type hash_list;
+
+				{
+					boost::mutex::scoped_lock lock(node.mutex);
+
+					node.last_contact_request = fscp::latency_clock::now();
+
+					for (size_t target = 1; target < m_nodes.size(); ++target)
+					{
+						if ((target != index) && !node.established[target])
+						{
+							hash_list.insert(m_nodes[target]->hash);
+						}
+					}
+				}
+
+				if (!hash_list.empty())
+				{
+					++m_contact_requests;
+
+					node.server.async_send_contact_request(m_nodes[0]->endpoint, hash_list, [] (const boost::system::error_code&) {});
+				}
+			}
+
+			void on_hello_response(size_t index, size_t target, const boost::system::error_code& ec)
+			{
+				if (ec)
+				{
+					++m_hello_failures;
+
+					return;
+				}
+
+				++m_hello_responses;
+
+				m_nodes[index]->server.async_introduce_to(m_nodes[target]->endpoint, [] (const boost::system::error_code&) {});
+			}
+
+			bool on_hello(size_t index, const fscp::server::ep_type& sender, bool default_accept)
+			{
+				if (default_accept)
+				{
+					m_nodes[index]->server.async_introduce_to(sender, [] (const boost::system::error_code&) {});
+				}
+
+				return default_accept;
+			}
+
+			bool on_presentation(size_t index, const fscp::server::ep_type& sender, fscp::server::cert_type, fscp::server::presentation_status_type, bool has_session)
+			{
+				if (has_session)
+				{
+					return false;
+				}
+
+				++m_presentations;
+
+				m_nodes[index]->server.async_request_session(sender, [] (const boost::system::error_code&) {});
+
+				return true;
+			}
+
+			void on_session_established(size_t index, const fscp::server::ep_type& host, bool is_new)
+			{
+				const size_t peer = index_of(host);
+
+				if (!is_new || (peer == m_nodes.size()))
+				{
+					return;
+				}
+
+				node_type& node = *m_nodes[index];
+				const fscp::latency_clock::time_point now = fscp::latency_clock::now();
+
+				{
+					boost::mutex::scoped_lock lock(node.mutex);
+
+					if (node.established[peer])
+					{
+						return;
+					}
+
+					node.established[peer] = true;
+
+					if (node.wanted[peer])
+					{
+						m_handshake_times.record(now - node.last_attempt[peer]);
+					}
+				}
+
+				m_session_times.record(now - m_start);
+
+				if ((m_topology == topology_type::star) && (index > 0) && (peer == 0))
+				{
+					send_contact_request(index);
+				}
+
+				if (++m_established_sessions == m_target_sessions)
+				{
+					boost::mutex::scoped_lock lock(m_mutex);
+
+					m_full_mesh_time = now - m_start;
+					m_condition.notify_all();
+				}
+			}
+
+			void on_session_lost()
+			{
+				++m_lost_sessions;
+			}
+
+			bool on_contact_request()
+			{
+				++m_contacts;
+
+				return true;
+			}
+
+			void on_contact(size_t index, const fscp::server::ep_type& answer)
+			{
+				const size_t peer = index_of(answer);
+
+				if (peer == m_nodes.size())
+				{
+					return;
+				}
+
+				node_type& node = *m_nodes[index];
+				bool should_greet = false;
+
+				{
+					boost::mutex::scoped_lock lock(node.mutex);
+
+					// The node of lower index of each pair contacts the other one: both received each other's contact.
+					if ((peer > index) && !node.wanted[peer])
+					{
+						node.wanted[peer] = true;
+						node.last_attempt[peer] = fscp::latency_clock::now();
+						should_greet = true;
+					}
+				}
+
+				if (should_greet)
+				{
+					greet(index, peer);
+				}
+			}
+
+			boost::asio::io_service& m_io_service;
+			const topology_type m_topology;
+			const boost::posix_time::time_duration m_contact_period;
+			boost::asio::io_service::strand m_contact_strand;
+			boost::asio::deadline_timer m_contact_timer;
+			std::vector<boost::shared_ptr<node_type> > m_nodes;
+			uint64_t m_target_sessions;
+			fscp::latency_clock::time_point m_start;
+			fscp::latency_histogram m_session_times;
+			fscp::latency_histogram m_handshake_times;
+			mutable boost::mutex m_mutex;
+			boost::condition_variable m_condition;
+			fscp::latency_clock::duration m_full_mesh_time;
+			std::atomic<uint64_t> m_hello_responses;
+			std::atomic<uint64_t> m_hello_failures;
+			std::atomic<uint64_t> m_presentations;
+			std::atomic<uint64_t> m_contact_requests;
+			std::atomic<uint64_t> m_contacts;
+			std::atomic<uint64_t> m_established_sessions;
+			std::atomic<uint64_t> m_lost_sessions;
+	};
+}
+
+int main(int argc, char** argv)
+{
+	cryptoplus::crypto_initializer crypto_initializer;
+	cryptoplus::algorithms_initializer algorithms_initializer;
+	cryptoplus::error::error_strings_initializer error_strings_initializer;
+
+	po::options_description options("Options");
+	options.add_options()
+		("help,h", "Produce help message.")
+		("nodes,n", po::value<unsigned int>()->default_value(100), "The number of nodes.")
+		("topology", po::value<topology_type>()->default_value(topology_type::full), "The topology: full (every node knows all the others) or star (the nodes only know the first one and ask it for contacts).")
+		("timeout", po::value<unsigned int>()->default_value(300), "The time allowed to build the full mesh, in seconds.")
+		("contact-period", po::value<unsigned int>()->default_value(3000), "The period after which a node contacts again a node it has no session with, in milliseconds.")
+		("keep-alive-periods,k", po::value<unsigned int>()->default_value(3), "The number of keep-alive periods over which the steady state CPU time is measured.")
+		("key-size", po::value<unsigned int>()->default_value(2048), "The size of the RSA keys of the nodes, in bits.")
+		("threads,t", po::value<unsigned int>()->default_value(boost::thread::hardware_concurrency()), "The number of threads that run the nodes.")
+		("port,p", po::value<unsigned short>()->default_value(13000), "The port of the first node. The other ones listen on the next ports.")
+		;
+
+	try
+	{
+		po::variables_map vm;
+		po::store(po::parse_command_line(argc, argv, options), vm);
+		po::notify(vm);
+
+		if (vm.count("help"))
+		{
+			std::cerr << options << std::endl;
+
+			return EXIT_SUCCESS;
+		}
+
+		const unsigned int node_count = vm["nodes"].as<unsigned int>();
+		const topology_type topology = vm["topology"].as<topology_type>();
+		const boost::posix_time::time_duration timeout = boost::posix_time::seconds(vm["timeout"].as<unsigned int>());
+		const boost::posix_time::time_duration contact_period = boost::posix_time::milliseconds(std::max(vm["contact-period"].as<unsigned int>(), 1u));
+		const unsigned int keep_alive_periods = vm["keep-alive-periods"].as<unsigned int>();
+		const unsigned int key_size = vm["key-size"].as<unsigned int>();
+		const unsigned int thread_count = std::max(vm["threads"].as<unsigned int>(), 1u);
+		const unsigned short port = vm["port"].as<unsigned short>();
+
+		if ((node_count < 2) || (port + node_count > 65536))
+		{
+			std::cerr << "The number of nodes must be at least 2 and their ports must fit after the first one." << std::endl;
+
+			return EXIT_FAILURE;
+		}
+
+		raise_file_descriptor_limit();
+
+		std::cerr << "Generating " << node_count << " " << key_size << "-bit identities..." << std::endl;
+
+		// Key generation is by far the slowest step: it is spread over all the threads.
+		std::vector<boost::optional<fscp::identity_store> > identities(node_count);
+
+		{
+			std::atomic<unsigned int> next_index(0);
+			boost::thread_group threads;
+
+			for (unsigned int i = 0; i < thread_count; ++i)
+			{
+				threads.create_thread([&] () {
+					for (unsigned int index = next_index++; index < node_count; index = next_index++)
+					{
+						identities[index] = make_identity(index, key_size);
+					}
+				});
+			}
+
+			threads.join_all();
+		}
+
+		boost::asio::io_service io_service;
+		boost::shared_ptr<boost::asio::io_service::work> work = boost::make_shared<boost::asio::io_service::work>(io_service);
+
+		mesh_type mesh(io_service, topology, contact_period);
+
+		// The bookkeeping of the benchmark itself is allocated before the memory is first measured.
+		const uint64_t initial_memory = resident_memory();
+
+		for (unsigned int index = 0; index < node_count; ++index)
+		{
+			mesh.add_node(*identities[index], fscp::server::ep_type(boost::asio::ip::address_v4::loopback(), static_cast<unsigned short>(port + index)), node_count);
+		}
+
+		mesh.open();
+
+		const uint64_t open_memory = resident_memory();
+
+		boost::thread_group threads;
+
+		for (unsigned int i = 0; i < thread_count; ++i)
+		{
+			threads.create_thread(boost::bind(&boost::asio::io_service::run, &io_service));
+		}
+
+		std::cerr << "Building a " << topology << " mesh of " << node_count << " nodes with " << thread_count << " thread(s)..." << std::endl;
+
+		const std::clock_t mesh_cpu_start = std::clock();
+
+		mesh.start();
+
+		const bool full_mesh = mesh.wait_full_mesh(timeout);
+		const double mesh_cpu = static_cast<double>(std::clock() - mesh_cpu_start) / CLOCKS_PER_SEC;
+
+		mesh.stop_contacting();
+
+		// Let the last handshake messages be processed before measuring the steady state.
+		boost::this_thread::sleep(SETTLE_PERIOD);
+
+		const uint64_t mesh_memory = resident_memory();
+		const uint64_t established_sessions = mesh.established_sessions();
+		const uint64_t pair_count = mesh.target_sessions() / 2;
+
+		double keep_alive_cpu = 0;
+		uint64_t lost_during_keep_alive = 0;
+
+		if (full_mesh && (keep_alive_periods > 0))
+		{
+			std::cerr << "Full mesh reached. Measuring " << keep_alive_periods << " keep-alive period(s)..." << std::endl;
+
+			const uint64_t lost_sessions = mesh.lost_sessions();
+			const std::clock_t cpu_start = std::clock();
+
+			boost::this_thread::sleep(fscp::SESSION_KEEP_ALIVE_PERIOD * static_cast<int>(keep_alive_periods));
+
+			keep_alive_cpu = static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+			lost_during_keep_alive = mesh.lost_sessions() - lost_sessions;
+		}
+
+		mesh.close();
+		work.reset();
+		threads.join_all();
+
+		const fscp::latency_histogram_snapshot session_times = mesh.session_times();
+		const fscp::latency_histogram_snapshot handshake_times = mesh.handshake_times();
+		const double full_mesh_ms = full_mesh ? to_milliseconds(mesh.full_mesh_time()) : 0;
+		const double handshakes_per_second = (full_mesh_ms > 0) ? (pair_count * 1000 / full_mesh_ms) : 0;
+		const double half_mesh_ms = to_milliseconds(session_times.value_at_quantile(0.5));
+		const double handshake_p50_ms = to_milliseconds(handshake_times.value_at_quantile(0.5));
+		const double handshake_p99_ms = to_milliseconds(handshake_times.value_at_quantile(0.99));
+		const double memory_per_node = (static_cast<double>(open_memory) - static_cast<double>(initial_memory)) / node_count;
+		const double memory_per_session = established_sessions ? (static_cast<double>(mesh_memory) - static_cast<double>(open_memory)) / established_sessions : 0;
+		const double cpu_per_handshake_ms = established_sessions ? (mesh_cpu * 2000 / established_sessions) : 0;
+		const double keep_alive_ticks = static_cast<double>(node_count) * keep_alive_periods;
+		const double cpu_per_tick_us = (keep_alive_ticks > 0) ? (keep_alive_cpu * 1000000 / keep_alive_ticks) : 0;
+		const double cpu_per_session_tick_us = cpu_per_tick_us / (node_count - 1);
+
+		if (full_mesh)
+		{
+			std::cerr << "Full mesh in " << std::fixed << std::setprecision(1) << full_mesh_ms << " ms (half of the sessions in " << half_mesh_ms << " ms), "
+				<< std::setprecision(0) << handshakes_per_second << " handshakes/s, "
+				<< "handshake p50 " << std::setprecision(1) << handshake_p50_ms << " ms, "
+				<< "p99 " << handshake_p99_ms << " ms" << std::endl;
+		}
+		else
+		{
+			std::cerr << "No full mesh after " << timeout << ": " << established_sessions << " of " << mesh.target_sessions() << " session endpoint(s) established." << std::endl;
+		}
+
+		std::cerr << "Memory: " << std::fixed << std::setprecision(0) << memory_per_node << " B per node, " << memory_per_session << " B per session. "
+			<< "CPU: " << std::setprecision(2) << cpu_per_handshake_ms << " ms per handshake, "
+			<< cpu_per_tick_us << " us per keep-alive tick (" << cpu_per_session_tick_us << " us per session). "
+			<< mesh.hello_failures() << " failed HELLO(s), " << mesh.lost_sessions() << " lost session(s)." << std::endl;
+
+		std::cout << std::fixed << std::setprecision(6)
+			<< "{\"benchmark\": \"fscp_mesh\""
+			<< ", \"topology\": \"" << topology << "\""
+			<< ", \"nodes\": " << node_count
+			<< ", \"threads\": " << thread_count
+			<< ", \"key_size\": " << key_size
+			<< ", \"full_mesh\": " << (full_mesh ? "true" : "false")
+			<< ", \"sessions\": " << established_sessions
+			<< ", \"full_mesh_ms\": " << full_mesh_ms
+			<< ", \"half_mesh_ms\": " << half_mesh_ms
+			<< ", \"handshakes_per_second\": " << handshakes_per_second
+			<< ", \"handshake_p50_ms\": " << handshake_p50_ms
+			<< ", \"handshake_p99_ms\": " << handshake_p99_ms
+			<< ", \"hello_responses\": " << mesh.hello_responses()
+			<< ", \"hello_failures\": " << mesh.hello_failures()
+			<< ", \"presentations\": " << mesh.presentations()
+			<< ", \"contact_requests\": " << mesh.contact_requests()
+			<< ", \"contacts\": " << mesh.contacts()
+			<< ", \"lost_sessions\": " << mesh.lost_sessions()
+			<< ", \"lost_sessions_keep_alive\": " << lost_during_keep_alive
+			<< ", \"memory_per_node_bytes\": " << memory_per_node
+			<< ", \"memory_per_session_bytes\": " << memory_per_session
+			<< ", \"cpu_per_handshake_ms\": " << cpu_per_handshake_ms
+			<< ", \"cpu_per_keep_alive_tick_us\": " << cpu_per_tick_us
+			<< ", \"cpu_per_session_keep_alive_tick_us\": " << cpu_per_session_tick_us
+			<< "}" << std::endl;
+
+		return full_mesh ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	catch (std::exception& ex)
+	{
+		std::cerr << "Error: " << ex.what() << std::endl;
+
+		return EXIT_FAILURE;
+	}
+}
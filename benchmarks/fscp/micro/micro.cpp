@@ -0,0 +1,257 @@
+/**
+ * \file micro.cpp
+ * \author Julien Kauffmann <julien.kauffmann@freelan.org>
+ * \brief The fscp microbenchmarks: data messages, message parsing and memory pools.
+ */
+
+#include "benchmark.hpp"
+
+#include <fscp/constants.hpp>
+#include <fscp/data_message.hpp>
+#include <fscp/memory_pool.hpp>
+#include <fscp/message.hpp>
+#include <fscp/session_message.hpp>
+
+#include <cryptoplus/cryptoplus.hpp>
+#include <cryptoplus/error/error_strings.hpp>
+
+#include <cstring>
+#include <random>
+#include <stdexcept>
+
+namespace
+{
+	const size_t SIZES[] = { 64, 576, 1500 };
+
+	const unsigned int THREADS[] = { 1, 2, 4, 8 };
+
+	const size_t GARBAGE_PACKET_COUNT = 4096;
+	const size_t GARBAGE_PACKET_SIZE = 64;
+
+	typedef std::vector<std::vector<uint8_t> > packet_list_type;
+
+	std::vector<uint8_t> random_bytes(size_t size)
+	{
+		std::vector<uint8_t> result(size);
+		std::mt19937 generator(42);
+
+		for (auto&& byte : result)
+		{
+			byte = static_cast<uint8_t>(generator());
+		}
+
+		return result;
+	}
+
+	packet_list_type generate_garbage()
+	{
+		std::mt19937 generator(42);
+		packet_list_type result(GARBAGE_PACKET_COUNT, std::vector<uint8_t>(GARBAGE_PACKET_SIZE));
+
+		for (auto&& packet : result)
+		{
+			for (auto&& byte : packet)
+			{
+				byte = static_cast<uint8_t>(generator());
+			}
+
+			// Make sure the generic header is valid half of the time, so that the type specific checks are exercised too.
+			if (generator() % 2)
+			{
+				const uint16_t length = htons(static_cast<uint16_t>(generator() % (GARBAGE_PACKET_SIZE - 4)));
+				std::memcpy(&packet[2], &length, sizeof(length));
+			}
+		}
+
+		return result;
+	}
+
+	size_t parse_throwing(const std::vector<uint8_t>& packet)
+	{
+		size_t valid = 0;
+
+		try
+		{
+			const fscp::message message(&packet[0], packet.size());
+			const fscp::session_message session_message(message);
+
+			static_cast<void>(session_message);
+
+			++valid;
+		}
+		catch (std::runtime_error&)
+		{
+		}
+
+		try
+		{
+			valid += fscp::data_message::parse_contact_map(&packet[0], packet.size()).size();
+		}
+		catch (std::runtime_error&)
+		{
+		}
+
+		return valid;
+	}
+
+	size_t parse_non_throwing(const std::vector<uint8_t>& packet)
+	{
+		size_t valid = 0;
+
+		const boost::optional<fscp::message> message = fscp::message::try_parse(&packet[0], packet.size());
+
+		if (message && fscp::session_message::try_parse(*message))
+		{
+			++valid;
+		}
+
+		const boost::optional<fscp::contact_map_type> contact_map = fscp::data_message::try_parse_contact_map(&packet[0], packet.size());
+
+		if (contact_map)
+		{
+			valid += contact_map->size();
+		}
+
+		return valid;
+	}
+
+	bool check_garbage_parsing()
+	{
+		const packet_list_type packets = generate_garbage();
+
+		for (auto&& packet : packets)
+		{
+			if (parse_throwing(packet) != parse_non_throwing(packet))
+			{
+				std::cerr << "The throwing and non-throwing parsers disagree on a garbage packet" << std::endl;
+
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	void register_garbage_parsing()
+	{
+		// Each iteration parses one packet of a fixed set of random ones, about half of which have a valid generic header.
+		benchmark::add("garbage_parse/throwing", [] (benchmark::state& state) {
+			const packet_list_type packets = generate_garbage();
+			size_t index = 0;
+			size_t valid = 0;
+			state.set_bytes_per_iteration(GARBAGE_PACKET_SIZE);
+
+			while (state.keep_running())
+			{
+				valid += parse_throwing(packets[index++ % packets.size()]);
+			}
+
+			benchmark::do_not_optimize(valid);
+		});
+
+		benchmark::add("garbage_parse/try_parse", [] (benchmark::state& state) {
+			const packet_list_type packets = generate_garbage();
+			size_t index = 0;
+			size_t valid = 0;
+			state.set_bytes_per_iteration(GARBAGE_PACKET_SIZE);
+
+			while (state.keep_running())
+			{
+				valid += parse_non_throwing(packets[index++ % packets.size()]);
+			}
+
+			benchmark::do_not_optimize(valid);
+		});
+	}
+
+	void register_data_messages()
+	{
+		const fscp::cipher_suite_type cipher_suites[] = { fscp::cipher_suite_type::ecdhe_rsa_aes128_gcm_sha256, fscp::cipher_suite_type::ecdhe_rsa_aes256_gcm_sha384 };
+
+		for (size_t size : SIZES)
+		{
+			for (fscp::cipher_suite_type cipher_suite : cipher_suites)
+			{
+				const std::string suffix = cipher_suite.to_string() + "/" + std::to_string(size);
+
+				benchmark::add("data_message_write/" + suffix, [cipher_suite, size] (benchmark::state& state) {
+					const cryptoplus::cipher::cipher_algorithm cipher_algorithm = cipher_suite.to_cipher_algorithm();
+					const std::vector<uint8_t> key = random_bytes(cipher_algorithm.key_length());
+					const std::vector<uint8_t> nonce_prefix = random_bytes(fscp::DEFAULT_NONCE_PREFIX_SIZE);
+					const std::vector<uint8_t> cleartext = random_bytes(size);
+					std::vector<uint8_t> buffer(fscp::SMALL_BLOCK_SIZE);
+					fscp::sequence_number_type sequence_number = 0;
+					state.set_bytes_per_iteration(size);
+
+					while (state.keep_running())
+					{
+						benchmark::do_not_optimize(fscp::data_message::write(&buffer[0], buffer.size(), fscp::CHANNEL_NUMBER_0, ++sequence_number, cipher_algorithm, &cleartext[0], cleartext.size(), &key[0], key.size(), &nonce_prefix[0], nonce_prefix.size()));
+					}
+				});
+
+				benchmark::add("data_message_get_cleartext/" + suffix, [cipher_suite, size] (benchmark::state& state) {
+					const cryptoplus::cipher::cipher_algorithm cipher_algorithm = cipher_suite.to_cipher_algorithm();
+					const std::vector<uint8_t> key = random_bytes(cipher_algorithm.key_length());
+					const std::vector<uint8_t> nonce_prefix = random_bytes(fscp::DEFAULT_NONCE_PREFIX_SIZE);
+					const std::vector<uint8_t> cleartext = random_bytes(size);
+					std::vector<uint8_t> message_buffer(fscp::SMALL_BLOCK_SIZE);
+					std::vector<uint8_t> buffer(fscp::SMALL_BLOCK_SIZE);
+
+					const size_t message_size = fscp::data_message::write(&message_buffer[0], message_buffer.size(), fscp::CHANNEL_NUMBER_0, 1, cipher_algorithm, &cleartext[0], cleartext.size(), &key[0], key.size(), &nonce_prefix[0], nonce_prefix.size());
+					const fscp::data_message message(&message_buffer[0], message_size);
+					state.set_bytes_per_iteration(size);
+
+					while (state.keep_running())
+					{
+						benchmark::do_not_optimize(message.get_cleartext(&buffer[0], buffer.size(), cipher_algorithm, &key[0], key.size(), &nonce_prefix[0], nonce_prefix.size()));
+					}
+				});
+			}
+		}
+	}
+
+	void register_memory_pools()
+	{
+		typedef fscp::memory_pool<fscp::SMALL_BLOCK_SIZE, 32> memory_pool_type;
+
+		// Shared by all the threads of a run, as the socket memory pool of a server is.
+		static memory_pool_type memory_pool;
+
+		for (unsigned int threads : THREADS)
+		{
+			benchmark::add("memory_pool_allocate_deallocate", [] (benchmark::state& state) {
+				while (state.keep_running())
+				{
+					const memory_pool_type::buffer_type buffer = memory_pool.allocate_buffer();
+					benchmark::do_not_optimize(buffer);
+					memory_pool.deallocate_buffer(buffer);
+				}
+			}, threads);
+
+			benchmark::add("memory_pool_allocate_shared_buffer", [] (benchmark::state& state) {
+				while (state.keep_running())
+				{
+					benchmark::do_not_optimize(memory_pool.allocate_shared_buffer());
+				}
+			}, threads);
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	cryptoplus::crypto_initializer crypto_initializer;
+	cryptoplus::algorithms_initializer algorithms_initializer;
+	cryptoplus::error::error_strings_initializer error_strings_initializer;
+
+	if (!check_garbage_parsing())
+	{
+		return EXIT_FAILURE;
+	}
+
+	register_data_messages();
+	register_garbage_parsing();
+	register_memory_pools();
+
+	return benchmark::main(argc, argv);
+}
@@ -0,0 +1,464 @@
+/**
+ * \file benchmark.hpp
+ * \author Julien Kauffmann <julien.kauffmann@freelan.org>
+ * \brief A minimal microbenchmark harness.
+ *
+ * A microbenchmark is a function that repeats the measured operation as long as its state asks to:
+ *
+ *     benchmark::add("checksum/1500", [] (benchmark::state& state) {
+ *         // Setup is not measured.
+ *         while (state.keep_running())
+ *         {
+ *             benchmark::do_not_optimize(compute());
+ *         }
+ *     });
+ *
+ * The harness calibrates the number of iterations so that each measure lasts at least --min-time seconds, repeats the measure --repetitions times and reports the median time per iteration.
+ *
+ * Results can be saved as JSON lines with --json and compared against such a file with --baseline, so that the effect of an optimization is measured on its own.
+ */
+
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <boost/thread/barrier.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace benchmark
+{
+	/**
+	 * \brief The clock used for measures.
+	 */
+	typedef std::chrono::steady_clock clock;
+
+	/**
+	 * \brief Prevent the compiler from optimizing a value away.
+	 * \param value The value.
+	 */
+	template <typename Type>
+	inline void do_not_optimize(const Type& value)
+	{
+#if defined(__GNUC__)
+		asm volatile("" : : "g"(&value) : "memory");
+#else
+		static volatile const void* sink;
+		sink = &value;
+#endif
+	}
+
+	/**
+	 * \brief The state of a running microbenchmark.
+	 */
+	class state
+	{
+		public:
+
+			/**
+			 * \brief Create a state.
+			 * \param _iterations The number of iterations to run.
+			 * \param start_barrier A barrier to wait for before starting the timer, when several threads run the microbenchmark.
+			 */
+			state(uint64_t _iterations, boost::barrier* start_barrier = NULL) :
+				m_iterations(_iterations),
+				m_remaining(_iterations),
+				m_start_barrier(start_barrier),
+				m_started(false),
+				m_start(),
+				m_elapsed(),
+				m_bytes_per_iteration(0)
+			{
+			}
+
+			/**
+			 * \brief Check whether another iteration must be run.
+			 * \return true if another iteration must be run.
+			 *
+			 * The timer starts on the first call and stops when it returns false.
+			 */
+			bool keep_running()
+			{
+				if (!m_started)
+				{
+					m_started = true;
+
+					if (m_start_barrier)
+					{
+						m_start_barrier->wait();
+					}
+
+					m_start = clock::now();
+				}
+
+				if (m_remaining == 0)
+				{
+					m_elapsed += clock::now() - m_start;
+
+					return false;
+				}
+
+				--m_remaining;
+
+				return true;
+			}
+
+			/**
+			 * \brief Stop the timer, to exclude some work from the measure.
+			 */
+			void pause_timing()
+			{
+				m_elapsed += clock::now() - m_start;
+			}
+
+			/**
+			 * \brief Restart the timer after pause_timing().
+			 */
+			void resume_timing()
+			{
+				m_start = clock::now();
+			}
+
+			/**
+			 * \brief Get the number of iterations to run.
+			 * \return The number of iterations.
+			 */
+			uint64_t iterations() const
+			{
+				return m_iterations;
+			}
+
+			/**
+			 * \brief Set the number of bytes processed by each iteration, to report a throughput.
+			 * \param bytes The number of bytes.
+			 */
+			void set_bytes_per_iteration(uint64_t bytes)
+			{
+				m_bytes_per_iteration = bytes;
+			}
+
+			/**
+			 * \brief Get the number of bytes processed by each iteration.
+			 * \return The number of bytes.
+			 */
+			uint64_t bytes_per_iteration() const
+			{
+				return m_bytes_per_iteration;
+			}
+
+			/**
+			 * \brief Get the measured time.
+			 * \return The measured time.
+			 */
+			clock::duration elapsed() const
+			{
+				return m_elapsed;
+			}
+
+		private:
+
+			uint64_t m_iterations;
+			uint64_t m_remaining;
+			boost::barrier* m_start_barrier;
+			bool m_started;
+			clock::time_point m_start;
+			clock::duration m_elapsed;
+			uint64_t m_bytes_per_iteration;
+	};
+
+	/**
+	 * \brief A microbenchmark function.
+	 */
+	typedef std::function<void (state&)> function_type;
+
+	/**
+	 * \brief A registered microbenchmark.
+	 */
+	struct entry_type
+	{
+		std::string name;
+		function_type function;
+		unsigned int threads;
+	};
+
+	/**
+	 * \brief Get the registered microbenchmarks.
+	 * \return The registered microbenchmarks.
+	 */
+	inline std::vector<entry_type>& entries()
+	{
+		static std::vector<entry_type> result;
+
+		return result;
+	}
+
+	/**
+	 * \brief Register a microbenchmark.
+	 * \param name The name of the microbenchmark.
+	 * \param function The microbenchmark function.
+	 * \param threads The number of threads that run function concurrently. Each of them runs all the iterations and the slowest one gives the measure.
+	 */
+	inline void add(const std::string& name, function_type function, unsigned int threads = 1)
+	{
+		const entry_type entry = { threads > 1 ? name + "/threads:" + std::to_string(threads) : name, function, std::max(threads, 1u) };
+
+		entries().push_back(entry);
+	}
+
+	/**
+	 * \brief The result of a measure.
+	 */
+	struct result_type
+	{
+		double ns_per_iteration;
+		uint64_t bytes_per_iteration;
+	};
+
+	/**
+	 * \brief Run a microbenchmark once.
+	 * \param entry The microbenchmark.
+	 * \param iterations The number of iterations.
+	 * \return The result.
+	 */
+	inline result_type run_once(const entry_type& entry, uint64_t iterations)
+	{
+		clock::duration elapsed;
+		uint64_t bytes_per_iteration;
+
+		if (entry.threads == 1)
+		{
+			state _state(iterations);
+			entry.function(_state);
+			elapsed = _state.elapsed();
+			bytes_per_iteration = _state.bytes_per_iteration();
+		}
+		else
+		{
+			boost::barrier start_barrier(entry.threads);
+			std::vector<state> states(entry.threads, state(iterations, &start_barrier));
+			boost::thread_group threads;
+
+			for (auto&& _state : states)
+			{
+				state* const state_ptr = &_state;
+
+				threads.create_thread([&entry, state_ptr] () { entry.function(*state_ptr); });
+			}
+
+			threads.join_all();
+
+			elapsed = clock::duration::zero();
+
+			for (auto&& _state : states)
+			{
+				elapsed = std::max(elapsed, _state.elapsed());
+			}
+
+			bytes_per_iteration = states.front().bytes_per_iteration();
+		}
+
+		const result_type result = { static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / static_cast<double>(iterations), bytes_per_iteration };
+
+		return result;
+	}
+
+	/**
+	 * \brief Read the results saved by a previous run.
+	 * \param path The path of the JSON lines file.
+	 * \return The time per iteration of each microbenchmark, by name.
+	 */
+	inline std::map<std::string, double> read_baseline(const std::string& path)
+	{
+		std::map<std::string, double> result;
+		std::ifstream file(path.c_str());
+		std::string line;
+
+		// Only the lines written by this harness are expected: a real JSON parser is not needed.
+		static const std::string NAME_KEY = "\"name\": \"";
+		static const std::string NS_KEY = "\"ns_per_iteration\": ";
+
+		while (std::getline(file, line))
+		{
+			const size_t name_pos = line.find(NAME_KEY);
+			const size_t ns_pos = line.find(NS_KEY);
+
+			if ((name_pos != std::string::npos) && (ns_pos != std::string::npos))
+			{
+				const size_t name_start = name_pos + NAME_KEY.size();
+				const size_t name_end = line.find('"', name_start);
+
+				result[line.substr(name_start, name_end - name_start)] = std::atof(line.c_str() + ns_pos + NS_KEY.size());
+			}
+		}
+
+		return result;
+	}
+
+	/**
+	 * \brief Run the registered microbenchmarks according to the command line.
+	 * \param argc The argument count.
+	 * \param argv The arguments.
+	 * \return The process exit code.
+	 */
+	inline int main(int argc, char** argv)
+	{
+		std::string filter;
+		std::string json_path;
+		std::string baseline_path;
+		double min_time = 0.2;
+		unsigned int repetitions = 5;
+
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string arg = argv[i];
+			const bool has_value = (i + 1 < argc);
+
+			if ((arg == "--filter") && has_value)
+			{
+				filter = argv[++i];
+			}
+			else if ((arg == "--json") && has_value)
+			{
+				json_path = argv[++i];
+			}
+			else if ((arg == "--baseline") && has_value)
+			{
+				baseline_path = argv[++i];
+			}
+			else if ((arg == "--min-time") && has_value)
+			{
+				min_time = std::atof(argv[++i]);
+			}
+			else if ((arg == "--repetitions") && has_value)
+			{
+				repetitions = std::max(std::atoi(argv[++i]), 1);
+			}
+			else if (arg == "--list")
+			{
+				for (auto&& entry : entries())
+				{
+					std::cout << entry.name << std::endl;
+				}
+
+				return EXIT_SUCCESS;
+			}
+			else
+			{
+				std::cerr << "Usage: " << argv[0] << " [--filter SUBSTRING] [--min-time SECONDS] [--repetitions COUNT] [--json FILE] [--baseline FILE] [--list]" << std::endl;
+
+				return (arg == "--help") ? EXIT_SUCCESS : EXIT_FAILURE;
+			}
+		}
+
+		const std::map<std::string, double> baseline = baseline_path.empty() ? std::map<std::string, double>() : read_baseline(baseline_path);
+		std::ofstream json;
+
+		if (!json_path.empty())
+		{
+			json.open(json_path.c_str());
+
+			if (!json)
+			{
+				std::cerr << "Unable to open " << json_path << " for writing." << std::endl;
+
+				return EXIT_FAILURE;
+			}
+		}
+
+		std::cout << std::left << std::setw(48) << "benchmark" << std::right << std::setw(14) << "ns/iteration" << std::setw(14) << "MB/s" << std::setw(12) << "iterations";
+
+		if (!baseline.empty())
+		{
+			std::cout << std::setw(12) << "baseline";
+		}
+
+		std::cout << std::endl;
+
+		for (auto&& entry : entries())
+		{
+			if (entry.name.find(filter) == std::string::npos)
+			{
+				continue;
+			}
+
+			// Grow the number of iterations until a measure is long enough to be meaningful.
+			uint64_t iterations = 1;
+			result_type result = run_once(entry, iterations);
+
+			while (result.ns_per_iteration * iterations < min_time * 1e9)
+			{
+				const double target = min_time * 1e9 / std::max(result.ns_per_iteration, 1.0);
+
+				iterations = static_cast<uint64_t>(std::min(std::max(target * 1.2, iterations * 2.0), iterations * 100.0));
+				result = run_once(entry, iterations);
+			}
+
+			std::vector<double> measures;
+			measures.push_back(result.ns_per_iteration);
+
+			for (unsigned int i = 1; i < repetitions; ++i)
+			{
+				measures.push_back(run_once(entry, iterations).ns_per_iteration);
+			}
+
+			std::sort(measures.begin(), measures.end());
+
+			const double median = measures[measures.size() / 2];
+			const double mb_per_second = result.bytes_per_iteration ? (result.bytes_per_iteration * 1e3 / median) : 0;
+
+			std::cout << std::left << std::setw(48) << entry.name << std::right << std::fixed << std::setprecision(1) << std::setw(14) << median << std::setw(14);
+
+			if (mb_per_second > 0)
+			{
+				std::cout << mb_per_second;
+			}
+			else
+			{
+				std::cout << "-";
+			}
+
+			std::cout << std::setw(12) << iterations;
+
+			const std::map<std::string, double>::const_iterator reference = baseline.find(entry.name);
+
+			if (reference != baseline.end() && (reference->second > 0))
+			{
+				std::ostringstream delta;
+				delta << std::showpos << std::fixed << std::setprecision(1) << ((median - reference->second) * 100 / reference->second) << "%";
+
+				std::cout << std::setw(12) << delta.str();
+			}
+
+			std::cout << std::endl;
+
+			if (json.is_open())
+			{
+				json << std::fixed << std::setprecision(3)
+					<< "{\"name\": \"" << entry.name << "\""
+					<< ", \"ns_per_iteration\": " << median
+					<< ", \"ns_per_iteration_min\": " << measures.front()
+					<< ", \"ns_per_iteration_max\": " << measures.back()
+					<< ", \"bytes_per_iteration\": " << result.bytes_per_iteration
+					<< ", \"iterations\": " << iterations
+					<< ", \"repetitions\": " << measures.size()
+					<< "}" << std::endl;
+			}
+		}
+
+		return EXIT_SUCCESS;
+	}
+}
+
+#endif /* BENCHMARK_HPP */
@@ -49,6 +49,8 @@
 #include <boost/system/system_error.hpp>
 
 #include <iostream>
+#include <memory>
+#include <vector>
 
 #include "osi/ethernet_address.hpp"
 #include "tap_adapter_layer.hpp"
@@ -103,6 +105,34 @@ namespace asiotap
 				m_descriptor.async_write_some(buffers, handler);
 			}
 
+			/**
+			 * \brief Read some data from the specified queue of the tap adapter.
+			 * \param queue The queue to read from. Must be lower than queue_count().
+			 * \param buffers The buffers into which the data will be read.
+			 * \param handler The handler to be called when the read operation completes.
+			 *
+			 * Operations on different queues may be issued concurrently.
+			 */
+			template <typename MutableBufferSequence, typename ReadHandler>
+			void async_read(size_t queue, const MutableBufferSequence& buffers, ReadHandler handler)
+			{
+				queue_descriptor(queue).async_read_some(buffers, handler);
+			}
+
+			/**
+			 * \brief Write some data to the specified queue of the tap adapter.
+			 * \param queue The queue to write to. Must be lower than queue_count().
+			 * \param buffers One or more buffers to be written to the tap adapter.
+			 * \param handler The handler to be called when the write operation completes.
+			 *
+			 * Operations on different queues may be issued concurrently.
+			 */
+			template <typename ConstBufferSequence, typename WriteHandler>
+			void async_write(size_t queue, const ConstBufferSequence& buffers, WriteHandler handler)
+			{
+				queue_descriptor(queue).async_write_some(buffers, handler);
+			}
+
 			/**
 			 * \brief Read some data from the tap adapter.
 			 * \param buffers The buffers into which the data will be read.
@@ -154,6 +184,11 @@ namespace asiotap
 			 */
 			void cancel()
 			{
+				for (auto&& descriptor : m_queue_descriptors)
+				{
+					descriptor->cancel();
+				}
+
 				m_descriptor.cancel();
 			}
 
@@ -163,6 +198,14 @@ namespace asiotap
 			 */
 			void cancel(boost::system::error_code& ec)
 			{
+				for (auto&& descriptor : m_queue_descriptors)
+				{
+					if (descriptor->cancel(ec))
+					{
+						return;
+					}
+				}
+
 				m_descriptor.cancel(ec);
 			}
 
@@ -202,6 +245,24 @@ namespace asiotap
 				return m_mtu;
 			}
 
+			/**
+			 * \brief Get the number of queues of the device.
+			 * \return The number of queues, which is 1 unless the device was opened with several queues.
+			 */
+			size_t queue_count() const
+			{
+				return m_queue_descriptors.size() + 1;
+			}
+
+			/**
+			 * \brief Check whether checksum and segmentation offloading is enabled.
+			 * \return true if offloading is enabled. In that case, every frame read from or written to the device starts with a osi::vnet_header.
+			 */
+			bool offloading_enabled() const
+			{
+				return m_offloading_enabled;
+			}
+
 			/**
 			 * \brief Get the device ethernet address.
 			 * \return The device ethernet address.
@@ -225,6 +286,13 @@ namespace asiotap
 			 */
 			void close()
 			{
+				for (auto&& descriptor : m_queue_descriptors)
+				{
+					descriptor->close();
+				}
+
+				m_queue_descriptors.clear();
+
 				m_descriptor.close();
 			}
 
@@ -234,6 +302,16 @@ namespace asiotap
 			 */
 			boost::system::error_code close(boost::system::error_code& ec)
 			{
+				for (auto&& descriptor : m_queue_descriptors)
+				{
+					if (descriptor->close(ec))
+					{
+						return ec;
+					}
+				}
+
+				m_queue_descriptors.clear();
+
 				return m_descriptor.close(ec);
 			}
 
@@ -244,7 +322,9 @@ namespace asiotap
 				m_layer(_layer),
 				m_name(),
 				m_mtu(),
-				m_ethernet_address()
+				m_ethernet_address(),
+				m_offloading_enabled(false),
+				m_queue_descriptors()
 			{}
 
 			descriptor_type& descriptor()
@@ -252,6 +332,21 @@ namespace asiotap
 				return m_descriptor;
 			}
 
+			/**
+			 * \brief Add a queue to the device.
+			 * \param handle The native handle of the queue. On success, the tap adapter takes ownership of it.
+			 * \param ec The error code.
+			 */
+			void add_queue(const typename descriptor_type::native_handle_type& handle, boost::system::error_code& ec)
+			{
+				std::unique_ptr<descriptor_type> descriptor(new descriptor_type(m_descriptor.get_io_service()));
+
+				if (!descriptor->assign(handle, ec))
+				{
+					m_queue_descriptors.push_back(std::move(descriptor));
+				}
+			}
+
 			void set_name(const std::string& _name)
 			{
 				m_name = _name;
@@ -267,6 +362,16 @@ namespace asiotap
 				m_ethernet_address = _ethernet_address;
 			}
 
+			void set_offloading(bool _offloading)
+			{
+				m_offloading_enabled = _offloading;
+			}
+
+			descriptor_type& queue_descriptor(size_t queue)
+			{
+				return (queue == 0) ? m_descriptor : *m_queue_descriptors[queue - 1];
+			}
+
 		private:
 
 			descriptor_type m_descriptor;
@@ -274,6 +379,10 @@ namespace asiotap
 			std::string m_name;
 			size_t m_mtu;
 			osi::ethernet_address m_ethernet_address;
+			bool m_offloading_enabled;
+
+			// The queues other than the first one, which is m_descriptor.
+			std::vector<std::unique_ptr<descriptor_type> > m_queue_descriptors;
 
 			friend std::ostream& operator<<(std::ostream& os, const base_tap_adapter& value)
 			{
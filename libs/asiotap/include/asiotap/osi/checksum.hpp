@@ -47,6 +47,8 @@
 
 #include <boost/asio.hpp>
 
+#include <cstring>
+
 #include "osi/checksum_helper.hpp"
 
 namespace asiotap
@@ -69,6 +71,45 @@ namespace asiotap
 
 			return helper.compute();
 		}
+
+		/**
+		 * \brief Update a checksum after a 16-bit field of the checksummed data changed.
+		 * \param checksum The checksum, as stored in the frame.
+		 * \param old_value The previous value of the field, as stored in the frame.
+		 * \param new_value The new value of the field, as stored in the frame.
+		 * \return The updated checksum, as it must be stored in the frame.
+		 *
+		 * This implements the incremental update of RFC 1624 (HC' = ~(~HC + ~m + m')), which avoids summing the whole data again.
+		 */
+		inline uint16_t update_checksum(uint16_t checksum, uint16_t old_value, uint16_t new_value)
+		{
+			uint32_t sum = static_cast<uint16_t>(~checksum) + static_cast<uint32_t>(static_cast<uint16_t>(~old_value)) + new_value;
+
+			sum = (sum & 0xFFFF) + (sum >> 16);
+			sum = (sum & 0xFFFF) + (sum >> 16);
+
+			return static_cast<uint16_t>(~sum);
+		}
+
+		/**
+		 * \brief Update a checksum after a 32-bit field of the checksummed data changed.
+		 * \param checksum The checksum, as stored in the frame.
+		 * \param old_value The previous value of the field, as stored in the frame.
+		 * \param new_value The new value of the field, as stored in the frame.
+		 * \return The updated checksum, as it must be stored in the frame.
+		 *
+		 * The field must start on a 16-bit boundary of the checksummed data, which is the case of IPv4 addresses and TCP sequence numbers.
+		 */
+		inline uint16_t update_checksum(uint16_t checksum, uint32_t old_value, uint32_t new_value)
+		{
+			uint16_t old_words[2];
+			uint16_t new_words[2];
+
+			std::memcpy(old_words, &old_value, sizeof(old_words));
+			std::memcpy(new_words, &new_value, sizeof(new_words));
+
+			return update_checksum(update_checksum(checksum, old_words[0], new_words[0]), old_words[1], new_words[1]);
+		}
 	}
 }
 
@@ -65,8 +65,8 @@ namespace asiotap
 
 				/**
 				 * \brief Update the checksum.
-				 * \param buf The buffer to compute the checksum from.
-				 * \param buf_len The size of buf.
+				 * \param buf The buffer to compute the checksum from. Needs not be aligned.
+				 * \param buf_len The size of buf. May be odd, in which case the last byte is paired with the first byte of the next update.
 				 */
 				void update(const uint16_t* buf, size_t buf_len);
 
@@ -80,11 +80,13 @@ namespace asiotap
 
 				uint32_t m_checksum;
 				uint8_t m_left;
+				bool m_has_left;
 		};
 
 		inline checksum_helper::checksum_helper() :
 			m_checksum(0),
-			m_left(0)
+			m_left(0),
+			m_has_left(false)
 		{
 		}
 	}
@@ -0,0 +1,108 @@
+/*
+ * libasiotap - A portable TAP adapter extension for Boost::ASIO.
+ * Copyright (C) 2010-2011 Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libasiotap.
+ *
+ * libasiotap is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libasiotap is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libasiotap in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file checksum_kernel.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief Vectorized Internet checksum kernels.
+ */
+
+#ifndef ASIOTAP_OSI_CHECKSUM_KERNEL_HPP
+#define ASIOTAP_OSI_CHECKSUM_KERNEL_HPP
+
+#include <cstddef>
+
+#include <stdint.h>
+
+namespace asiotap
+{
+	namespace osi
+	{
+		/**
+		 * \brief The checksum kernels.
+		 */
+		enum class checksum_kernel_type
+		{
+			scalar, /**< The portable 16-bit loop. */
+			sse2, /**< The SSE2 kernel. */
+			avx2, /**< The AVX2 kernel. */
+			neon /**< The NEON kernel. */
+		};
+
+		/**
+		 * \brief Check whether a checksum kernel can run on the current CPU.
+		 * \param kernel The kernel.
+		 * \return true if kernel was compiled in and is supported by the CPU.
+		 */
+		bool is_checksum_kernel_supported(checksum_kernel_type kernel);
+
+		/**
+		 * \brief Get the fastest checksum kernel for the current CPU.
+		 * \return The kernel used by checksum_sum().
+		 *
+		 * The CPU is only probed once.
+		 */
+		checksum_kernel_type get_checksum_kernel();
+
+		/**
+		 * \brief Get the name of a checksum kernel.
+		 * \param kernel The kernel.
+		 * \return The kernel name.
+		 */
+		const char* get_checksum_kernel_name(checksum_kernel_type kernel);
+
+		/**
+		 * \brief Sum the 16-bit words of a buffer.
+		 * \param kernel The kernel to use. Must be supported.
+		 * \param buf The buffer. Needs not be aligned.
+		 * \param buf_len The size of buf. Must be even.
+		 * \return The ones' complement sum of the words, in host byte order, folded to 16 bits.
+		 */
+		uint16_t checksum_sum(checksum_kernel_type kernel, const void* buf, size_t buf_len);
+
+		/**
+		 * \brief Sum the 16-bit words of a buffer using the fastest kernel.
+		 * \param buf The buffer. Needs not be aligned.
+		 * \param buf_len The size of buf. Must be even.
+		 * \return The ones' complement sum of the words, in host byte order, folded to 16 bits.
+		 */
+		uint16_t checksum_sum(const void* buf, size_t buf_len);
+	}
+}
+
+#endif /* ASIOTAP_OSI_CHECKSUM_KERNEL_HPP */
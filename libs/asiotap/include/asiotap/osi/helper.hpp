@@ -46,6 +46,7 @@
 #define ASIOTAP_OSI_HELPER_HPP
 
 #include <boost/asio.hpp>
+#include <boost/optional.hpp>
 
 namespace asiotap
 {
@@ -270,6 +271,26 @@ namespace asiotap
 		template <typename OSIFrameType>
 		mutable_helper<OSIFrameType> helper(boost::asio::mutable_buffer buf);
 
+		/**
+		 * \brief Create a helper from a buffer, if it is large enough.
+		 * \param buf The buffer.
+		 * \return The helper, or nothing if buf is too small to contain the frame.
+		 *
+		 * Unlike helper(), this function never throws and is meant for parsing untrusted input.
+		 */
+		template <typename OSIFrameType>
+		boost::optional<const_helper<OSIFrameType> > try_helper(boost::asio::const_buffer buf);
+
+		/**
+		 * \brief Create a helper from a buffer, if it is large enough.
+		 * \param buf The buffer.
+		 * \return The helper, or nothing if buf is too small to contain the frame.
+		 *
+		 * Unlike helper(), this function never throws and is meant for parsing untrusted input.
+		 */
+		template <typename OSIFrameType>
+		boost::optional<mutable_helper<OSIFrameType> > try_helper(boost::asio::mutable_buffer buf);
+
 		template <class HelperTag, typename OSIFrameType>
 		inline typename _generic_base_helper<HelperTag, OSIFrameType>::buffer_type _generic_base_helper<HelperTag, OSIFrameType>::buffer() const
 		{
@@ -355,6 +376,28 @@ namespace asiotap
 		{
 			return mutable_helper<OSIFrameType>(buf);
 		}
+
+		template <typename OSIFrameType>
+		inline boost::optional<const_helper<OSIFrameType> > try_helper(boost::asio::const_buffer buf)
+		{
+			if (boost::asio::buffer_size(buf) < sizeof(OSIFrameType))
+			{
+				return boost::none;
+			}
+
+			return const_helper<OSIFrameType>(buf);
+		}
+
+		template <typename OSIFrameType>
+		inline boost::optional<mutable_helper<OSIFrameType> > try_helper(boost::asio::mutable_buffer buf)
+		{
+			if (boost::asio::buffer_size(buf) < sizeof(OSIFrameType))
+			{
+				return boost::none;
+			}
+
+			return mutable_helper<OSIFrameType>(buf);
+		}
 	}
 }
 
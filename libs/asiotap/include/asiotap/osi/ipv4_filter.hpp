@@ -51,6 +51,9 @@
 #include "ethernet_helper.hpp"
 #include "ipv4_helper.hpp"
 
+#include <cstddef>
+#include <cstring>
+
 namespace asiotap
 {
 	namespace osi
@@ -104,6 +107,14 @@ namespace asiotap
 		template <>
 		bool frame_parent_match<ipv4_frame>(const_helper<ethernet_frame> parent);
 
+		/**
+		 * \brief Check if the header fields of an IPv4 frame are valid.
+		 * \param version The version.
+		 * \param ihl The Internet Header Length, in words.
+		 * \return true on success.
+		 */
+		bool check_ipv4_header(uint8_t version, uint8_t ihl);
+
 		/**
 		 * \brief Check if a frame is valid.
 		 * \param frame The frame.
@@ -111,6 +122,16 @@ namespace asiotap
 		 */
 		bool check_frame(const_helper<ipv4_frame> frame);
 
+		/**
+		 * \brief Get the destination address of an IPv4 frame without building a helper.
+		 * \param buf The buffer that contains the frame.
+		 * \param destination The destination address. Only set on success.
+		 * \return true if buf contains a valid IPv4 frame, according to the same rules as check_frame().
+		 *
+		 * This function never throws.
+		 */
+		bool peek_ipv4_destination(boost::asio::const_buffer buf, boost::asio::ip::address_v4& destination);
+
 		inline bool check_ipv4_checksum(const_helper<ipv4_frame> helper)
 		{
 			return helper.verify_checksum();
@@ -138,9 +159,36 @@ namespace asiotap
 			return (parent.protocol() == IP_PROTOCOL);
 		}
 
+		inline bool check_ipv4_header(uint8_t version, uint8_t ihl)
+		{
+			return ((version == IP_PROTOCOL_VERSION_4) && (ihl >= 5));
+		}
+
 		inline bool check_frame(const_helper<ipv4_frame> frame)
 		{
-			return ((frame.version() == IP_PROTOCOL_VERSION_4) && (frame.ihl() >= 5));
+			return check_ipv4_header(frame.version(), frame.ihl());
+		}
+
+		inline bool peek_ipv4_destination(boost::asio::const_buffer buf, boost::asio::ip::address_v4& destination)
+		{
+			if (boost::asio::buffer_size(buf) < sizeof(ipv4_frame))
+			{
+				return false;
+			}
+
+			const uint8_t* const data = boost::asio::buffer_cast<const uint8_t*>(buf);
+
+			if (!check_ipv4_header((data[0] & 0xF0) >> 4, (data[0] & 0x0F)))
+			{
+				return false;
+			}
+
+			boost::asio::ip::address_v4::bytes_type raw;
+			std::memcpy(&raw.front(), data + offsetof(ipv4_frame, destination), raw.size());
+
+			destination = boost::asio::ip::address_v4(raw);
+
+			return true;
 		}
 	}
 }
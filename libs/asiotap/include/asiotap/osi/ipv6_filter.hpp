@@ -51,6 +51,9 @@
 #include "ethernet_helper.hpp"
 #include "ipv6_helper.hpp"
 
+#include <cstddef>
+#include <cstring>
+
 namespace asiotap
 {
 	namespace osi
@@ -86,6 +89,13 @@ namespace asiotap
 		template <>
 		bool frame_parent_match<ipv6_frame>(const_helper<ethernet_frame> parent);
 
+		/**
+		 * \brief Check if the header fields of an IPv6 frame are valid.
+		 * \param version The version.
+		 * \return true on success.
+		 */
+		bool check_ipv6_header(uint8_t version);
+
 		/**
 		 * \brief Check if a frame is valid.
 		 * \param frame The frame.
@@ -93,6 +103,16 @@ namespace asiotap
 		 */
 		bool check_frame(const_helper<ipv6_frame> frame);
 
+		/**
+		 * \brief Get the destination address of an IPv6 frame without building a helper.
+		 * \param buf The buffer that contains the frame.
+		 * \param destination The destination address. Only set on success.
+		 * \return true if buf contains a valid IPv6 frame, according to the same rules as check_frame().
+		 *
+		 * This function never throws.
+		 */
+		bool peek_ipv6_destination(boost::asio::const_buffer buf, boost::asio::ip::address_v6& destination);
+
 		template <typename ParentFilterType>
 		inline filter<ipv6_frame, ParentFilterType>::filter(ParentFilterType& _parent) : _filter<ipv6_frame, ParentFilterType>(_parent)
 		{
@@ -104,9 +124,36 @@ namespace asiotap
 			return (parent.protocol() == IPV6_PROTOCOL);
 		}
 
+		inline bool check_ipv6_header(uint8_t version)
+		{
+			return (version == IP_PROTOCOL_VERSION_6);
+		}
+
 		inline bool check_frame(const_helper<ipv6_frame> frame)
 		{
-			return (frame.version() == IP_PROTOCOL_VERSION_6);
+			return check_ipv6_header(frame.version());
+		}
+
+		inline bool peek_ipv6_destination(boost::asio::const_buffer buf, boost::asio::ip::address_v6& destination)
+		{
+			if (boost::asio::buffer_size(buf) < sizeof(ipv6_frame))
+			{
+				return false;
+			}
+
+			const uint8_t* const data = boost::asio::buffer_cast<const uint8_t*>(buf);
+
+			if (!check_ipv6_header((data[0] & 0xF0) >> 4))
+			{
+				return false;
+			}
+
+			boost::asio::ip::address_v6::bytes_type raw;
+			std::memcpy(&raw.front(), data + offsetof(ipv6_frame, destination), raw.size());
+
+			destination = boost::asio::ip::address_v6(raw);
+
+			return true;
 		}
 
 	}
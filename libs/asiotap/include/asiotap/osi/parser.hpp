@@ -0,0 +1,158 @@
+/*
+ * libasiotap - A portable TAP adapter extension for Boost::ASIO.
+ * Copyright (C) 2010-2011 Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libasiotap.
+ *
+ * libasiotap is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libasiotap is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libasiotap in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file parser.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief A compile-time OSI frame parser.
+ */
+
+#ifndef ASIOTAP_OSI_PARSER_HPP
+#define ASIOTAP_OSI_PARSER_HPP
+
+#include "filter.hpp"
+
+#include <boost/asio.hpp>
+
+
+namespace asiotap
+{
+	namespace osi
+	{
+		/**
+		 * \brief A parsing step.
+		 *
+		 * Each step matches one frame type against its parent and hands over to the step of the next frame type.
+		 */
+		template <typename... OSIFrameTypes>
+		struct _parser_step;
+
+		/**
+		 * \brief The final parsing step.
+		 */
+		template <>
+		struct _parser_step<>
+		{
+			/**
+			 * \brief Call the handler with all the parsed frames.
+			 * \param handler The handler.
+			 * \param parent The innermost frame.
+			 * \param helpers The helpers of all the frames, outermost first.
+			 * \return true.
+			 */
+			template <typename Handler, typename ParentOSIFrameType, typename... Helpers>
+			static bool parse(Handler& handler, const_helper<ParentOSIFrameType> parent, Helpers... helpers)
+			{
+				(void)parent;
+
+				handler(helpers...);
+
+				return true;
+			}
+		};
+
+		/**
+		 * \brief An intermediate parsing step.
+		 */
+		template <typename OSIFrameType, typename... OSIFrameTypes>
+		struct _parser_step<OSIFrameType, OSIFrameTypes...>
+		{
+			/**
+			 * \brief Parse the payload of a parent frame.
+			 * \param handler The handler.
+			 * \param parent The parent frame.
+			 * \param helpers The helpers of the frames parsed so far, outermost first.
+			 * \return true if the payload matched all the remaining frame types.
+			 */
+			template <typename Handler, typename ParentOSIFrameType, typename... Helpers>
+			static bool parse(Handler& handler, const_helper<ParentOSIFrameType> parent, Helpers... helpers)
+			{
+				if (!frame_parent_match<OSIFrameType, ParentOSIFrameType>(parent))
+				{
+					return false;
+				}
+
+				const boost::optional<const_helper<OSIFrameType> > helper = try_helper<OSIFrameType>(parent.payload());
+
+				if (!helper || !check_frame(*helper))
+				{
+					return false;
+				}
+
+				return _parser_step<OSIFrameTypes...>::parse(handler, *helper, helpers..., *helper);
+			}
+		};
+
+		/**
+		 * \brief A compile-time frame parser.
+		 * \tparam OSIFrameType The outermost frame type.
+		 * \tparam OSIFrameTypes The encapsulated frame types, from the outermost to the innermost.
+		 *
+		 * Unlike filter, a parser has no state and does not call anything through a function pointer: the whole
+		 * chain of frame types is resolved at compile time. It can be used concurrently from any thread and never
+		 * throws on malformed input.
+		 *
+		 * The same frame_parent_match() and check_frame() functions as for filters are used, so the headers of the
+		 * matching filters must be included.
+		 */
+		template <typename OSIFrameType, typename... OSIFrameTypes>
+		struct parser
+		{
+			/**
+			 * \brief Parse a buffer.
+			 * \param buf The buffer to parse.
+			 * \param handler The handler to call with a const_helper for every frame type, outermost first, if buf matches the whole chain.
+			 * \return true if buf matched the whole chain and handler was called.
+			 */
+			template <typename Handler>
+			static bool parse(boost::asio::const_buffer buf, Handler handler)
+			{
+				const boost::optional<const_helper<OSIFrameType> > helper = try_helper<OSIFrameType>(buf);
+
+				if (!helper || !check_frame(*helper))
+				{
+					return false;
+				}
+
+				return _parser_step<OSIFrameTypes...>::parse(handler, *helper, *helper);
+			}
+		};
+	}
+}
+
+#endif /* ASIOTAP_OSI_PARSER_HPP */
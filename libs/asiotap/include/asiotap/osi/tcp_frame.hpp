@@ -0,0 +1,164 @@
+/*
+ * libasiotap - A portable TAP adapter extension for Boost::ASIO.
+ * Copyright (C) 2010-2011 Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libasiotap.
+ *
+ * libasiotap is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libasiotap is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libasiotap in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file tcp_frame.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief A TCP frame structure.
+ */
+
+#ifndef ASIOTAP_OSI_TCP_FRAME_HPP
+#define ASIOTAP_OSI_TCP_FRAME_HPP
+
+#include "frame.hpp"
+
+namespace asiotap
+{
+	namespace osi
+	{
+#ifdef MSV
+#pragma pack(push, 1)
+#endif
+
+		/**
+		 * \brief The TCP protocol.
+		 */
+		const uint8_t TCP_PROTOCOL = 0x06;
+
+		/**
+		 * \brief The TCP FIN flag.
+		 */
+		const uint8_t TCP_FLAG_FIN = 0x01;
+
+		/**
+		 * \brief The TCP SYN flag.
+		 */
+		const uint8_t TCP_FLAG_SYN = 0x02;
+
+		/**
+		 * \brief The TCP RST flag.
+		 */
+		const uint8_t TCP_FLAG_RST = 0x04;
+
+		/**
+		 * \brief The TCP PSH flag.
+		 */
+		const uint8_t TCP_FLAG_PSH = 0x08;
+
+		/**
+		 * \brief The TCP ACK flag.
+		 */
+		const uint8_t TCP_FLAG_ACK = 0x10;
+
+		/**
+		 * \brief The TCP URG flag.
+		 */
+		const uint8_t TCP_FLAG_URG = 0x20;
+
+		/**
+		 * \brief The TCP ECE flag.
+		 */
+		const uint8_t TCP_FLAG_ECE = 0x40;
+
+		/**
+		 * \brief The TCP CWR flag.
+		 */
+		const uint8_t TCP_FLAG_CWR = 0x80;
+
+		/**
+		 * \brief The TCP end of options list option kind.
+		 */
+		const uint8_t TCP_OPTION_END = 0x00;
+
+		/**
+		 * \brief The TCP no-operation option kind.
+		 */
+		const uint8_t TCP_OPTION_NOP = 0x01;
+
+		/**
+		 * \brief The TCP maximum segment size option kind.
+		 */
+		const uint8_t TCP_OPTION_MSS = 0x02;
+
+		/**
+		 * \brief A TCP frame structure.
+		 */
+		struct tcp_frame
+		{
+			uint16_t source; /**< Source port */
+			uint16_t destination; /**< Destination port */
+			uint32_t sequence; /**< Sequence number */
+			uint32_t acknowledgment; /**< Acknowledgment number */
+			uint8_t data_offset; /**< Header length in 32-bit words, in the upper 4 bits */
+			uint8_t flags; /**< The flags */
+			uint16_t window; /**< The window size */
+			uint16_t checksum; /**< The checksum */
+			uint16_t urgent_pointer; /**< The urgent pointer */
+		} PACKED;
+
+		/**
+		 * \brief A TCP-IPv4 pseudo-header structure.
+		 */
+		struct tcp_ipv4_pseudo_header
+		{
+			struct in_addr ipv4_source; /**< Source IPv4 address */
+			struct in_addr ipv4_destination; /**< Destination IPv4 address */
+			uint8_t reserved; /**< 8 bits reserved field (must be zero) */
+			uint8_t ipv4_protocol; /**< The IPv4 protocol */
+			uint16_t tcp_length; /**< The TCP header and data length */
+		} PACKED;
+
+		/**
+		 * \brief A TCP-IPv6 pseudo-header structure.
+		 */
+		struct tcp_ipv6_pseudo_header
+		{
+			struct in6_addr ipv6_source; /**< Source IPv6 address */
+			struct in6_addr ipv6_destination; /**< Destination IPv6 address */
+			uint32_t tcp_length; /**< The TCP header and data length */
+			uint8_t reserved[3]; /**< 24 bits reserved field (must be zero) */
+			uint8_t ipv6_next_header; /**< The IPv6 next header */
+		} PACKED;
+
+#ifdef MSV
+#pragma pack(pop)
+#endif
+	}
+}
+
+#endif /* ASIOTAP_OSI_TCP_FRAME_HPP */
@@ -0,0 +1,391 @@
+/*
+ * libasiotap - A portable TAP adapter extension for Boost::ASIO.
+ * Copyright (C) 2010-2011 Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libasiotap.
+ *
+ * libasiotap is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libasiotap is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libasiotap in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file tcp_helper.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief A TCP helper class.
+ */
+
+#ifndef ASIOTAP_OSI_TCP_HELPER_HPP
+#define ASIOTAP_OSI_TCP_HELPER_HPP
+
+#include "helper.hpp"
+#include "tcp_frame.hpp"
+
+#include "ipv4_helper.hpp"
+#include "ipv6_helper.hpp"
+
+#include <boost/optional.hpp>
+
+namespace asiotap
+{
+	namespace osi
+	{
+		/**
+		 * \brief The base tcp helper implementation class.
+		 */
+		template <class HelperTag>
+		class _base_helper_impl<HelperTag, tcp_frame> : public _base_helper<HelperTag, tcp_frame>
+		{
+			public:
+
+				/**
+				 * \brief Get the source port.
+				 * \return The source port.
+				 */
+				uint16_t source() const;
+
+				/**
+				 * \brief Get the destination port.
+				 * \return The destination port.
+				 */
+				uint16_t destination() const;
+
+				/**
+				 * \brief Get the sequence number.
+				 * \return The sequence number.
+				 */
+				uint32_t sequence() const;
+
+				/**
+				 * \brief Get the acknowledgment number.
+				 * \return The acknowledgment number.
+				 */
+				uint32_t acknowledgment() const;
+
+				/**
+				 * \brief Get the header length.
+				 * \return The header length, options included, in bytes.
+				 */
+				size_t header_length() const;
+
+				/**
+				 * \brief Get the flags.
+				 * \return The flags.
+				 */
+				uint8_t flags() const;
+
+				/**
+				 * \brief Check whether some flags are set.
+				 * \param _flags The flags to check.
+				 * \return true if all the flags in _flags are set.
+				 */
+				bool has_flags(uint8_t _flags) const;
+
+				/**
+				 * \brief Get the window size.
+				 * \return The window size.
+				 */
+				uint16_t window() const;
+
+				/**
+				 * \brief Get the checksum.
+				 * \return The checksum.
+				 */
+				uint16_t checksum() const;
+
+				/**
+				 * \brief Get the urgent pointer.
+				 * \return The urgent pointer.
+				 */
+				uint16_t urgent_pointer() const;
+
+				/**
+				 * \brief Get the options buffer.
+				 * \return The options.
+				 */
+				typename _base_helper_impl::buffer_type options() const
+				{
+					const size_t frame_size = sizeof(typename _base_helper_impl<HelperTag, tcp_frame>::frame_type);
+
+					return boost::asio::buffer(this->buffer() + frame_size, (header_length() > frame_size) ? header_length() - frame_size : 0);
+				}
+
+				/**
+				 * \brief Get the payload buffer.
+				 * \return The payload.
+				 */
+				typename _base_helper_impl::buffer_type payload() const
+				{
+					return this->buffer() + header_length();
+				}
+
+				/**
+				 * \brief Get the maximum segment size option.
+				 * \return The maximum segment size, if the option is present.
+				 */
+				boost::optional<uint16_t> maximum_segment_size() const;
+
+				/**
+				 * \brief Compute the checksum.
+				 * \param parent_frame The parent frame.
+				 * \return The checksum.
+				 */
+				uint16_t compute_checksum(const_helper<ipv4_frame> parent_frame) const;
+
+				/**
+				 * \brief Compute the checksum.
+				 * \param parent_frame The parent frame.
+				 * \return The checksum.
+				 */
+				uint16_t compute_checksum(const_helper<ipv6_frame> parent_frame) const;
+
+				/**
+				 * \brief Verify the checksum.
+				 * \param parent_frame The parent frame.
+				 * \return true if the checksum is valid.
+				 */
+				bool verify_checksum(const_helper<ipv4_frame> parent_frame) const;
+
+				/**
+				 * \brief Verify the checksum.
+				 * \param parent_frame The parent frame.
+				 * \return true if the checksum is valid.
+				 */
+				bool verify_checksum(const_helper<ipv6_frame> parent_frame) const;
+
+			protected:
+
+				/**
+				 * \brief Create a helper from a frame type structure.
+				 * \param buf The buffer to refer to.
+				 */
+				_base_helper_impl(typename _base_helper_impl::buffer_type buf);
+		};
+
+		/**
+		 * \brief The mutable tcp helper implementation class.
+		 */
+		template <>
+		class _helper_impl<mutable_helper_tag, tcp_frame> : public _base_helper_impl<mutable_helper_tag, tcp_frame>
+		{
+			public:
+
+				/**
+				 * \brief Set the source port.
+				 * \param source The source port.
+				 */
+				void set_source(uint16_t source) const;
+
+				/**
+				 * \brief Set the destination port.
+				 * \param destination The destination port.
+				 */
+				void set_destination(uint16_t destination) const;
+
+				/**
+				 * \brief Set the sequence number.
+				 * \param sequence The sequence number.
+				 */
+				void set_sequence(uint32_t sequence) const;
+
+				/**
+				 * \brief Set the acknowledgment number.
+				 * \param acknowledgment The acknowledgment number.
+				 */
+				void set_acknowledgment(uint32_t acknowledgment) const;
+
+				/**
+				 * \brief Set the flags.
+				 * \param flags The flags.
+				 */
+				void set_flags(uint8_t flags) const;
+
+				/**
+				 * \brief Set the window size.
+				 * \param window The window size.
+				 */
+				void set_window(uint16_t window) const;
+
+				/**
+				 * \brief Set the checksum.
+				 * \param checksum The checksum.
+				 */
+				void set_checksum(uint16_t checksum) const;
+
+				/**
+				 * \brief Set the urgent pointer.
+				 * \param urgent_pointer The urgent pointer.
+				 */
+				void set_urgent_pointer(uint16_t urgent_pointer) const;
+
+				/**
+				 * \brief Lower the maximum segment size option.
+				 * \param max_segment_size The maximum segment size to enforce.
+				 * \return true if the option was present and had to be lowered.
+				 *
+				 * The checksum is updated incrementally, so it stays valid if it was.
+				 */
+				bool clamp_maximum_segment_size(uint16_t max_segment_size) const;
+
+			protected:
+
+				/**
+				 * \brief Create a helper from a frame type structure.
+				 * \param buf The buffer to refer to.
+				 */
+				_helper_impl(_helper_impl::buffer_type buf);
+		};
+
+		template <class HelperTag>
+		inline uint16_t _base_helper_impl<HelperTag, tcp_frame>::source() const
+		{
+			return ntohs(this->frame().source);
+		}
+
+		template <class HelperTag>
+		inline uint16_t _base_helper_impl<HelperTag, tcp_frame>::destination() const
+		{
+			return ntohs(this->frame().destination);
+		}
+
+		template <class HelperTag>
+		inline uint32_t _base_helper_impl<HelperTag, tcp_frame>::sequence() const
+		{
+			return ntohl(this->frame().sequence);
+		}
+
+		template <class HelperTag>
+		inline uint32_t _base_helper_impl<HelperTag, tcp_frame>::acknowledgment() const
+		{
+			return ntohl(this->frame().acknowledgment);
+		}
+
+		template <class HelperTag>
+		inline size_t _base_helper_impl<HelperTag, tcp_frame>::header_length() const
+		{
+			return ((this->frame().data_offset & 0xF0) >> 4) * sizeof(uint32_t);
+		}
+
+		template <class HelperTag>
+		inline uint8_t _base_helper_impl<HelperTag, tcp_frame>::flags() const
+		{
+			return this->frame().flags;
+		}
+
+		template <class HelperTag>
+		inline bool _base_helper_impl<HelperTag, tcp_frame>::has_flags(uint8_t _flags) const
+		{
+			return ((flags() & _flags) == _flags);
+		}
+
+		template <class HelperTag>
+		inline uint16_t _base_helper_impl<HelperTag, tcp_frame>::window() const
+		{
+			return ntohs(this->frame().window);
+		}
+
+		template <class HelperTag>
+		inline uint16_t _base_helper_impl<HelperTag, tcp_frame>::checksum() const
+		{
+			return this->frame().checksum;
+		}
+
+		template <class HelperTag>
+		inline uint16_t _base_helper_impl<HelperTag, tcp_frame>::urgent_pointer() const
+		{
+			return ntohs(this->frame().urgent_pointer);
+		}
+
+		template <class HelperTag>
+		inline bool _base_helper_impl<HelperTag, tcp_frame>::verify_checksum(const_helper<ipv4_frame> parent_frame) const
+		{
+			return this->compute_checksum(parent_frame) == 0x0000;
+		}
+
+		template <class HelperTag>
+		inline bool _base_helper_impl<HelperTag, tcp_frame>::verify_checksum(const_helper<ipv6_frame> parent_frame) const
+		{
+			return this->compute_checksum(parent_frame) == 0x0000;
+		}
+
+		template <class HelperTag>
+		inline _base_helper_impl<HelperTag, tcp_frame>::_base_helper_impl(typename _base_helper_impl<HelperTag, tcp_frame>::buffer_type buf) :
+			_base_helper<HelperTag, tcp_frame>(buf)
+		{
+		}
+
+		inline void _helper_impl<mutable_helper_tag, tcp_frame>::set_source(uint16_t _source) const
+		{
+			this->frame().source = htons(_source);
+		}
+
+		inline void _helper_impl<mutable_helper_tag, tcp_frame>::set_destination(uint16_t _destination) const
+		{
+			this->frame().destination = htons(_destination);
+		}
+
+		inline void _helper_impl<mutable_helper_tag, tcp_frame>::set_sequence(uint32_t _sequence) const
+		{
+			this->frame().sequence = htonl(_sequence);
+		}
+
+		inline void _helper_impl<mutable_helper_tag, tcp_frame>::set_acknowledgment(uint32_t _acknowledgment) const
+		{
+			this->frame().acknowledgment = htonl(_acknowledgment);
+		}
+
+		inline void _helper_impl<mutable_helper_tag, tcp_frame>::set_flags(uint8_t _flags) const
+		{
+			this->frame().flags = _flags;
+		}
+
+		inline void _helper_impl<mutable_helper_tag, tcp_frame>::set_window(uint16_t _window) const
+		{
+			this->frame().window = htons(_window);
+		}
+
+		inline void _helper_impl<mutable_helper_tag, tcp_frame>::set_checksum(uint16_t _checksum) const
+		{
+			this->frame().checksum = _checksum;
+		}
+
+		inline void _helper_impl<mutable_helper_tag, tcp_frame>::set_urgent_pointer(uint16_t _urgent_pointer) const
+		{
+			this->frame().urgent_pointer = htons(_urgent_pointer);
+		}
+
+		inline _helper_impl<mutable_helper_tag, tcp_frame>::_helper_impl(_helper_impl<mutable_helper_tag, tcp_frame>::buffer_type buf) :
+			_base_helper_impl<mutable_helper_tag, tcp_frame>(buf)
+		{
+		}
+	}
+}
+
+#endif /* ASIOTAP_OSI_TCP_HELPER_HPP */
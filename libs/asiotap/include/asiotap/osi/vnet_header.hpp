@@ -0,0 +1,189 @@
+/*
+ * libasiotap - A portable TAP adapter extension for Boost::ASIO.
+ * Copyright (C) 2010-2011 Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libasiotap.
+ *
+ * libasiotap is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libasiotap is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libasiotap in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file vnet_header.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief The virtio-net header of tap adapters with offloading enabled.
+ */
+
+#ifndef ASIOTAP_OSI_VNET_HEADER_HPP
+#define ASIOTAP_OSI_VNET_HEADER_HPP
+
+#include "frame.hpp"
+
+namespace asiotap
+{
+	namespace osi
+	{
+		/**
+		 * \brief The frame only has a partial checksum.
+		 */
+		const uint8_t VNET_HEADER_FLAG_NEEDS_CHECKSUM = 0x01;
+
+		/**
+		 * \brief The frame checksum was already verified.
+		 */
+		const uint8_t VNET_HEADER_FLAG_DATA_VALID = 0x02;
+
+		/**
+		 * \brief The frame is not a super-packet.
+		 */
+		const uint8_t VNET_HEADER_GSO_NONE = 0x00;
+
+		/**
+		 * \brief The frame is a TCP over IPv4 super-packet.
+		 */
+		const uint8_t VNET_HEADER_GSO_TCPV4 = 0x01;
+
+		/**
+		 * \brief The frame is a UDP super-packet.
+		 */
+		const uint8_t VNET_HEADER_GSO_UDP = 0x03;
+
+		/**
+		 * \brief The frame is a TCP over IPv6 super-packet.
+		 */
+		const uint8_t VNET_HEADER_GSO_TCPV6 = 0x04;
+
+		/**
+		 * \brief The super-packet has the ECN bit set. Can be combined with the other GSO types.
+		 */
+		const uint8_t VNET_HEADER_GSO_ECN = 0x80;
+
+#ifdef MSV
+#pragma pack(push, 1)
+#endif
+
+		/**
+		 * \brief A virtio-net header structure.
+		 *
+		 * Unlike the other frame structures, its fields are in host byte order.
+		 */
+		struct vnet_header
+		{
+			uint8_t flags; /**< Flags */
+			uint8_t gso_type; /**< The GSO type */
+			uint16_t header_length; /**< The length of the headers of the super-packet */
+			uint16_t gso_size; /**< The maximum payload size of each segment */
+			uint16_t checksum_start; /**< The offset at which the checksum computation starts */
+			uint16_t checksum_offset; /**< The offset of the checksum field, from checksum_start */
+		} PACKED;
+
+#ifdef MSV
+#pragma pack(pop)
+#endif
+
+		/**
+		 * \brief Get a buffer that contains a virtio-net header that requests no offloading.
+		 * \return The buffer.
+		 */
+		inline boost::asio::const_buffer null_vnet_header_buffer()
+		{
+			static const vnet_header header = {};
+
+			return boost::asio::buffer(&header, sizeof(header));
+		}
+
+		/**
+		 * \brief Complete the partial checksum of a frame.
+		 * \param header The virtio-net header of the frame. Must have the VNET_HEADER_FLAG_NEEDS_CHECKSUM flag.
+		 * \param frame The frame that follows the header.
+		 * \return true on success, false if the checksum location does not fit in the frame.
+		 *
+		 * The checksum field of such frames only contains the checksum of the pseudo-header.
+		 */
+		bool complete_checksum(const vnet_header& header, boost::asio::mutable_buffer frame);
+
+		/**
+		 * \brief Split a TCP super-packet into segments.
+		 *
+		 * Each segment gets a copy of the headers of the super-packet, with its lengths, sequence number, flags and checksums fixed.
+		 */
+		class tcp_segmenter
+		{
+			public:
+
+				/**
+				 * \brief Create a new TCP segmenter.
+				 * \param header The virtio-net header of the super-packet.
+				 * \param frame The super-packet.
+				 * \param network_offset The offset of the IP header in frame.
+				 *
+				 * If the header does not describe a valid TCP super-packet, segment_count() returns 0.
+				 */
+				tcp_segmenter(const vnet_header& header, boost::asio::const_buffer frame, size_t network_offset);
+
+				/**
+				 * \brief Get the number of segments.
+				 * \return The number of segments.
+				 */
+				size_t segment_count() const
+				{
+					return m_segment_count;
+				}
+
+				/**
+				 * \brief Get the size of a segment.
+				 * \param index The index of the segment. Must be lower than segment_count().
+				 * \return The size of the segment, headers included.
+				 */
+				size_t segment_size(size_t index) const;
+
+				/**
+				 * \brief Write a segment.
+				 * \param index The index of the segment. Must be lower than segment_count().
+				 * \param buf The buffer to write the segment into. Must be at least segment_size(index) bytes long.
+				 * \return The segment.
+				 */
+				boost::asio::const_buffer write_segment(size_t index, boost::asio::mutable_buffer buf) const;
+
+			private:
+
+				boost::asio::const_buffer m_frame;
+				bool m_is_ipv4;
+				size_t m_network_offset;
+				size_t m_transport_offset;
+				size_t m_headers_size;
+				size_t m_gso_size;
+				size_t m_segment_count;
+		};
+	}
+}
+
+#endif /* ASIOTAP_OSI_VNET_HEADER_HPP */
@@ -0,0 +1,271 @@
+/*
+ * libasiotap - A portable TAP adapter extension for Boost::ASIO.
+ * Copyright (C) 2010-2011 Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libasiotap.
+ *
+ * libasiotap is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libasiotap is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libasiotap in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file pcap.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief Read and write pcap capture files.
+ */
+
+#ifndef ASIOTAP_PCAP_HPP
+#define ASIOTAP_PCAP_HPP
+
+#include "tap_adapter_layer.hpp"
+#include "error.hpp"
+
+#include <boost/asio.hpp>
+#include <boost/system/system_error.hpp>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+namespace asiotap
+{
+	/**
+	 * \brief The pcap link types that frames can be read from or written as.
+	 */
+	enum class pcap_link_type : uint32_t
+	{
+		ethernet = 1,
+		raw = 101
+	};
+
+	/**
+	 * \brief Get the pcap link type of the frames of a tap adapter layer.
+	 * \param layer The tap adapter layer.
+	 * \return The link type.
+	 */
+	inline pcap_link_type to_pcap_link_type(tap_adapter_layer layer)
+	{
+		return (layer == tap_adapter_layer::ethernet) ? pcap_link_type::ethernet : pcap_link_type::raw;
+	}
+
+	/**
+	 * \brief Read the frames of a pcap capture file.
+	 *
+	 * Both the microsecond and the nanosecond resolution formats are supported, in either byte order. The pcapng format is not.
+	 */
+	class pcap_reader
+	{
+		public:
+
+			/**
+			 * \brief Create a reader.
+			 */
+			pcap_reader();
+
+			/**
+			 * \brief Open a capture file.
+			 * \param path The path of the file.
+			 * \param ec The error code.
+			 */
+			void open(const std::string& path, boost::system::error_code& ec);
+
+			/**
+			 * \brief Open a capture file.
+			 * \param path The path of the file.
+			 *
+			 * On error, a boost::system::system_error is thrown.
+			 */
+			void open(const std::string& path)
+			{
+				boost::system::error_code ec;
+
+				open(path, ec);
+
+				if (ec)
+				{
+					throw boost::system::system_error(ec, path);
+				}
+			}
+
+			/**
+			 * \brief Get the link type of the frames.
+			 * \return The link type. The IPv4 and IPv6 link types are reported as pcap_link_type::raw.
+			 */
+			pcap_link_type link_type() const
+			{
+				return m_link_type;
+			}
+
+			/**
+			 * \brief Read the next frame.
+			 * \param frame The frame. Its previous content is replaced.
+			 * \param ec The error code.
+			 * \return false at the end of the file or on error.
+			 */
+			bool read(std::vector<uint8_t>& frame, boost::system::error_code& ec);
+
+			/**
+			 * \brief Read the next frame.
+			 * \param frame The frame. Its previous content is replaced.
+			 * \return false at the end of the file.
+			 *
+			 * On error, a boost::system::system_error is thrown.
+			 */
+			bool read(std::vector<uint8_t>& frame)
+			{
+				boost::system::error_code ec;
+
+				const bool result = read(frame, ec);
+
+				if (ec)
+				{
+					throw boost::system::system_error(ec);
+				}
+
+				return result;
+			}
+
+		private:
+
+			uint32_t to_host(uint32_t value) const;
+
+			std::ifstream m_file;
+			bool m_swapped;
+			pcap_link_type m_link_type;
+	};
+
+	/**
+	 * \brief Write frames to a pcap capture file.
+	 *
+	 * Frames are timestamped with the current time, with a microsecond resolution.
+	 */
+	class pcap_writer
+	{
+		public:
+
+			/**
+			 * \brief Create a writer.
+			 */
+			pcap_writer();
+
+			/**
+			 * \brief Create a capture file.
+			 * \param path The path of the file. An existing file is overwritten.
+			 * \param _link_type The link type of the frames.
+			 * \param ec The error code.
+			 */
+			void open(const std::string& path, pcap_link_type _link_type, boost::system::error_code& ec);
+
+			/**
+			 * \brief Create a capture file.
+			 * \param path The path of the file. An existing file is overwritten.
+			 * \param _link_type The link type of the frames.
+			 *
+			 * On error, a boost::system::system_error is thrown.
+			 */
+			void open(const std::string& path, pcap_link_type _link_type)
+			{
+				boost::system::error_code ec;
+
+				open(path, _link_type, ec);
+
+				if (ec)
+				{
+					throw boost::system::system_error(ec, path);
+				}
+			}
+
+			/**
+			 * \brief Get the link type of the frames.
+			 * \return The link type.
+			 */
+			pcap_link_type link_type() const
+			{
+				return m_link_type;
+			}
+
+			/**
+			 * \brief Write a frame.
+			 * \param frame The frame.
+			 */
+			void write(boost::asio::const_buffer frame);
+
+			/**
+			 * \brief Flush the written frames to the file.
+			 */
+			void flush()
+			{
+				m_file.flush();
+			}
+
+		private:
+
+			std::ofstream m_file;
+			pcap_link_type m_link_type;
+	};
+
+	/**
+	 * \brief Read all the frames of a pcap capture file, as they must be written to a tap adapter.
+	 * \param path The path of the file.
+	 * \param layer The layer of the tap adapter.
+	 * \param ec The error code.
+	 * \return The frames.
+	 *
+	 * The Ethernet header of IPv4 and IPv6 frames is stripped when layer is tap_adapter_layer::ip and other frames are skipped. Raw IP frames cannot be written to an Ethernet tap adapter.
+	 */
+	std::vector<std::vector<uint8_t> > read_pcap_frames(const std::string& path, tap_adapter_layer layer, boost::system::error_code& ec);
+
+	/**
+	 * \brief Read all the frames of a pcap capture file, as they must be written to a tap adapter.
+	 * \param path The path of the file.
+	 * \param layer The layer of the tap adapter.
+	 * \return The frames.
+	 *
+	 * On error, a boost::system::system_error is thrown.
+	 */
+	inline std::vector<std::vector<uint8_t> > read_pcap_frames(const std::string& path, tap_adapter_layer layer)
+	{
+		boost::system::error_code ec;
+
+		const std::vector<std::vector<uint8_t> > result = read_pcap_frames(path, layer, ec);
+
+		if (ec)
+		{
+			throw boost::system::system_error(ec, path);
+		}
+
+		return result;
+	}
+}
+
+#endif /* ASIOTAP_PCAP_HPP */
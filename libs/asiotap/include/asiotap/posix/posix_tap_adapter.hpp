@@ -49,9 +49,15 @@
 
 #include "posix_route_manager.hpp"
 
+#include <boost/shared_ptr.hpp>
+
 #include <map>
 #include <string>
 
+#ifdef LINUX
+#include <uringplus/uring.hpp>
+#endif
+
 namespace asiotap
 {
 	class posix_tap_adapter : public base_tap_adapter<boost::asio::posix::stream_descriptor>
@@ -72,7 +78,12 @@ namespace asiotap
 			 */
 			posix_tap_adapter(boost::asio::io_service& _io_service, tap_adapter_layer _layer) :
 				base_tap_adapter(_io_service, _layer),
-				m_route_manager(_io_service)
+				m_route_manager(_io_service),
+				m_virtual(false),
+				m_virtual_ip_addresses()
+#if defined(LINUX)
+				, m_uring()
+#endif
 			{}
 
 			/**
@@ -80,6 +91,8 @@ namespace asiotap
 			 */
 			~posix_tap_adapter()
 			{
+				close_io_uring();
+
 				if (is_open())
 				{
 					boost::system::error_code ec;
@@ -96,6 +109,87 @@ namespace asiotap
 			posix_tap_adapter(posix_tap_adapter&&) = default;
 			posix_tap_adapter& operator=(posix_tap_adapter&&) = default;
 
+			using base_tap_adapter::async_read;
+			using base_tap_adapter::async_write;
+
+			/**
+			 * \brief Read some data from the specified queue of the tap adapter.
+			 * \param queue The queue to read from. Must be lower than queue_count().
+			 * \param buffers The buffers into which the data will be read.
+			 * \param handler The handler to be called when the read operation completes.
+			 *
+			 * Operations on different queues may be issued concurrently. If io_uring is enabled, the operation goes through it.
+			 */
+			template <typename MutableBufferSequence, typename ReadHandler>
+			void async_read(size_t queue, const MutableBufferSequence& buffers, ReadHandler handler)
+			{
+#if defined(LINUX)
+				if (m_uring)
+				{
+					m_uring->async_read(queue_descriptor(queue).native_handle(), buffers, handler);
+
+					return;
+				}
+#endif
+
+				base_tap_adapter::async_read(queue, buffers, handler);
+			}
+
+			/**
+			 * \brief Write some data to the specified queue of the tap adapter.
+			 * \param queue The queue to write to. Must be lower than queue_count().
+			 * \param buffers One or more buffers to be written to the tap adapter.
+			 * \param handler The handler to be called when the write operation completes.
+			 *
+			 * Operations on different queues may be issued concurrently. If io_uring is enabled, the operation goes through it.
+			 */
+			template <typename ConstBufferSequence, typename WriteHandler>
+			void async_write(size_t queue, const ConstBufferSequence& buffers, WriteHandler handler)
+			{
+#if defined(LINUX)
+				if (m_uring)
+				{
+					m_uring->async_write(queue_descriptor(queue).native_handle(), buffers, handler);
+
+					return;
+				}
+#endif
+
+				base_tap_adapter::async_write(queue, buffers, handler);
+			}
+
+			/**
+			 * \brief Read some data from the specified queue of the tap adapter, without blocking.
+			 * \param queue The queue to read from. Must be lower than queue_count().
+			 * \param buffers The buffers into which the data will be read.
+			 * \param ec The error code. Set to boost::asio::error::would_block if no frame is pending.
+			 * \return The number of bytes read.
+			 *
+			 * This is meant to drain the frames that are already pending after an asynchronous read completes. Must not be used when io_uring is enabled.
+			 */
+			template <typename MutableBufferSequence>
+			size_t try_read(size_t queue, const MutableBufferSequence& buffers, boost::system::error_code& ec)
+			{
+				// The descriptors are made non-blocking when they are opened.
+				return queue_descriptor(queue).read_some(buffers, ec);
+			}
+
+			/**
+			 * \brief Write some data to the specified queue of the tap adapter, without blocking.
+			 * \param queue The queue to write to. Must be lower than queue_count().
+			 * \param buffers One or more buffers to be written to the tap adapter, as a single frame.
+			 * \param ec The error code. Set to boost::asio::error::would_block if the device cannot take the frame right now.
+			 * \return The number of bytes written.
+			 *
+			 * Must not be used when io_uring is enabled.
+			 */
+			template <typename ConstBufferSequence>
+			size_t try_write(size_t queue, const ConstBufferSequence& buffers, boost::system::error_code& ec)
+			{
+				// The descriptors are made non-blocking when they are opened.
+				return queue_descriptor(queue).write_some(buffers, ec);
+			}
+
 			/**
 			 * \brief Get the associated network manager.
 			 * \return The associated network manager.
@@ -118,12 +212,103 @@ namespace asiotap
 			 */
 			void open(const std::string& name, boost::system::error_code& ec);
 
+			/**
+			 * \brief Open the tap adapter with several queues.
+			 * \param name The name of the tap adapter to open. If name is empty, then the first available tap adapter is opened.
+			 * \param queue_count The number of queues to open. Values greater than 1 are only supported on Linux (3.8 or later), where the kernel spreads the traffic across the queues by flow.
+			 * \param offloading Whether to enable checksum and segmentation offloading. Only supported on Linux. If enabled, every frame read from or written to the device starts with a osi::vnet_header.
+			 * \param ec The error code.
+			 */
+			void open(const std::string& name, unsigned int queue_count, bool offloading, boost::system::error_code& ec);
+
 			/**
 			 * \brief Open the tap adapter.
 			 * \param name The name of the tap adapter to open. If name is empty, then the first available tap adapter is opened.
 			 */
 			void open(const std::string& name = "");
 
+			/**
+			 * \brief Open the tap adapter with several queues.
+			 * \param name The name of the tap adapter to open. If name is empty, then the first available tap adapter is opened.
+			 * \param queue_count The number of queues to open.
+			 * \param offloading Whether to enable checksum and segmentation offloading.
+			 */
+			void open(const std::string& name, unsigned int queue_count, bool offloading = false);
+
+			/**
+			 * \brief Open a virtual tap adapter, that exists only in the process.
+			 * \param name The name to give to the tap adapter.
+			 * \param peer The other end of the tap adapter: the frames written to peer are read from the tap adapter and conversely. Must not be open.
+			 * \param ec The error code.
+			 *
+			 * A virtual tap adapter is a pair of connected local datagram sockets, so it does not require any privilege. It has no system IP configuration and no routes: configure() and set_connected_state() only record their parameters.
+			 */
+			void open_virtual(const std::string& name, descriptor_type& peer, boost::system::error_code& ec);
+
+			/**
+			 * \brief Open a virtual tap adapter, that exists only in the process.
+			 * \param name The name to give to the tap adapter.
+			 * \param peer The other end of the tap adapter: the frames written to peer are read from the tap adapter and conversely. Must not be open.
+			 */
+			void open_virtual(const std::string& name, descriptor_type& peer);
+
+			/**
+			 * \brief Check whether the tap adapter is a virtual one.
+			 * \return true if the tap adapter was opened with open_virtual().
+			 */
+			bool is_virtual() const
+			{
+				return m_virtual;
+			}
+
+#if defined(LINUX)
+			/**
+			 * \brief Perform the queue operations through io_uring rather than the io_service reactor.
+			 * \param entries The size of the submission ring.
+			 * \param ec The error code. Set to boost::asio::error::operation_not_supported if the kernel has no io_uring support.
+			 *
+			 * Must be called after the tap adapter is open and before any operation is started on it.
+			 */
+			void enable_io_uring(unsigned int entries, boost::system::error_code& ec);
+
+			/**
+			 * \brief Register a memory region with io_uring.
+			 * \param region The memory region, typically the one of the memory pool the frames are read into. Must outlive the tap adapter.
+			 * \param ec The error code.
+			 *
+			 * Must be called after enable_io_uring() and before any operation is started.
+			 */
+			void register_buffer(boost::asio::mutable_buffer region, boost::system::error_code& ec);
+#endif
+
+			/**
+			 * \brief Check whether the queue operations go through io_uring.
+			 * \return true if io_uring is enabled.
+			 */
+			bool io_uring_enabled() const
+			{
+#if defined(LINUX)
+				return static_cast<bool>(m_uring);
+#else
+				return false;
+#endif
+			}
+
+			/**
+			 * \brief Cancel all pending asynchronous operations associated with the tap adapter.
+			 */
+			void cancel()
+			{
+#if defined(LINUX)
+				if (m_uring)
+				{
+					m_uring->cancel();
+				}
+#endif
+
+				base_tap_adapter::cancel();
+			}
+
 			/**
 			 * \brief Close the associated descriptor.
 			 */
@@ -135,6 +320,8 @@ namespace asiotap
 
 				// We do nothing with the error code as errors can happen legitimately.
 
+				close_io_uring();
+
 				base_tap_adapter::close();
 			}
 
@@ -146,6 +333,8 @@ namespace asiotap
 			{
 				destroy_device(ec);
 
+				close_io_uring();
+
 				base_tap_adapter::close(ec);
 
 				return ec;
@@ -191,7 +380,25 @@ namespace asiotap
 			void destroy_device();
 			void destroy_device(boost::system::error_code& ec);
 
+			void close_io_uring()
+			{
+#if defined(LINUX)
+				if (m_uring)
+				{
+					// The pending operations must be over before their file descriptors are closed.
+					m_uring->close();
+					m_uring.reset();
+				}
+#endif
+			}
+
 			posix_route_manager m_route_manager;
+			bool m_virtual;
+			ip_network_address_list m_virtual_ip_addresses;
+
+#if defined(LINUX)
+			boost::shared_ptr<uringplus::uring> m_uring;
+#endif
 	};
 }
 
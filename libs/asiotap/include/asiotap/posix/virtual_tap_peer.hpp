@@ -0,0 +1,243 @@
+/*
+ * libasiotap - A portable TAP adapter extension for Boost::ASIO.
+ * Copyright (C) 2010-2011 Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libasiotap.
+ *
+ * libasiotap is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libasiotap is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libasiotap in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file virtual_tap_peer.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief The other end of a virtual tap adapter.
+ */
+
+#ifndef ASIOTAP_POSIX_VIRTUAL_TAP_PEER_HPP
+#define ASIOTAP_POSIX_VIRTUAL_TAP_PEER_HPP
+
+#include "../pcap.hpp"
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+namespace asiotap
+{
+	/**
+	 * \brief The other end of a virtual tap adapter.
+	 *
+	 * Replays a list of frames into the tap adapter, either as fast as the tap adapter reads them or at a fixed rate, and captures the frames written to the tap adapter, to a pcap file and/or to memory.
+	 *
+	 * The setters must be called before start(). The other methods are thread-safe. Instances must be managed by a boost::shared_ptr.
+	 */
+	class virtual_tap_peer : public boost::noncopyable, public boost::enable_shared_from_this<virtual_tap_peer>
+	{
+		public:
+
+			/**
+			 * \brief The descriptor type.
+			 */
+			typedef boost::asio::posix::stream_descriptor descriptor_type;
+
+			/**
+			 * \brief A frame.
+			 */
+			typedef std::vector<uint8_t> frame_type;
+
+			/**
+			 * \brief A list of frames.
+			 */
+			typedef std::vector<frame_type> frame_list_type;
+
+			/**
+			 * \brief A handler called when all the frames were replayed.
+			 */
+			typedef boost::function<void ()> replay_done_handler_type;
+
+			/**
+			 * \brief The statistics.
+			 */
+			struct statistics_type
+			{
+				/**
+				 * \brief The number of frames written to the tap adapter.
+				 */
+				uint64_t frames_replayed;
+
+				/**
+				 * \brief The number of bytes written to the tap adapter.
+				 */
+				uint64_t bytes_replayed;
+
+				/**
+				 * \brief The number of frames read from the tap adapter.
+				 */
+				uint64_t frames_captured;
+
+				/**
+				 * \brief The number of bytes read from the tap adapter.
+				 */
+				uint64_t bytes_captured;
+			};
+
+			/**
+			 * \brief Create a virtual tap peer.
+			 * \param io_service The io_service to use.
+			 *
+			 * Pass descriptor() to posix_tap_adapter::open_virtual() before calling start().
+			 */
+			explicit virtual_tap_peer(boost::asio::io_service& io_service);
+
+			/**
+			 * \brief Get the descriptor.
+			 * \return The descriptor.
+			 */
+			descriptor_type& descriptor()
+			{
+				return m_descriptor;
+			}
+
+			/**
+			 * \brief Set the frames to replay.
+			 * \param frames The frames. They must match the layer of the tap adapter.
+			 */
+			void set_frames(const frame_list_type& frames);
+
+			/**
+			 * \brief Set the replay rate.
+			 * \param frames_per_second The number of frames to replay per second. 0, the default, replays the frames as fast as the tap adapter reads them.
+			 */
+			void set_rate(unsigned int frames_per_second);
+
+			/**
+			 * \brief Set the number of times the frames are replayed.
+			 * \param count The number of times. 0 replays the frames until stop() is called. The default is 1.
+			 */
+			void set_replay_count(unsigned int count);
+
+			/**
+			 * \brief Set a delay before the replay starts.
+			 * \param delay The delay. The default is no delay.
+			 */
+			void set_replay_delay(std::chrono::steady_clock::duration delay);
+
+			/**
+			 * \brief Set the handler to call when all the frames were replayed.
+			 * \param handler The handler.
+			 */
+			void set_replay_done_handler(replay_done_handler_type handler);
+
+			/**
+			 * \brief Capture the frames written to the tap adapter to a pcap file.
+			 * \param writer The pcap writer. Its link type must match the layer of the tap adapter. If null, the frames are not captured to a file.
+			 */
+			void set_capture_writer(boost::shared_ptr<pcap_writer> writer);
+
+			/**
+			 * \brief Capture the frames written to the tap adapter to memory.
+			 * \param enabled Whether to capture the frames to memory. The default is false.
+			 */
+			void set_memory_capture_enabled(bool enabled);
+
+			/**
+			 * \brief Get the frames captured to memory.
+			 * \return The frames, from the oldest to the newest.
+			 */
+			frame_list_type captured_frames() const;
+
+			/**
+			 * \brief Start replaying and capturing the frames.
+			 */
+			void start();
+
+			/**
+			 * \brief Stop replaying and capturing the frames.
+			 *
+			 * The pending operations are cancelled and the descriptor is closed.
+			 */
+			void stop();
+
+			/**
+			 * \brief Get the statistics.
+			 * \return The statistics.
+			 */
+			statistics_type statistics() const;
+
+		private:
+
+			void do_start();
+			void do_stop();
+			void replay_next();
+			void handle_replay_timer(const boost::system::error_code& ec);
+			void handle_replay_write(const boost::system::error_code& ec, size_t bytes_transferred);
+			void capture_next();
+			void handle_capture_read(const boost::system::error_code& ec, size_t bytes_transferred);
+
+			boost::asio::io_service::strand m_strand;
+			descriptor_type m_descriptor;
+			boost::asio::steady_timer m_replay_timer;
+
+			// Only accessed through the strand once the peer is started.
+			frame_list_type m_frames;
+			unsigned int m_rate;
+			unsigned int m_replay_count;
+			std::chrono::steady_clock::duration m_replay_delay;
+			replay_done_handler_type m_replay_done_handler;
+			boost::shared_ptr<pcap_writer> m_capture_writer;
+			bool m_memory_capture_enabled;
+			bool m_started;
+			size_t m_replay_index;
+			unsigned int m_replay_round;
+			uint64_t m_replay_sent;
+			std::chrono::steady_clock::time_point m_replay_start;
+			frame_type m_capture_buffer;
+
+			mutable boost::mutex m_captured_frames_mutex;
+			frame_list_type m_captured_frames;
+
+			std::atomic<uint64_t> m_frames_replayed;
+			std::atomic<uint64_t> m_bytes_replayed;
+			std::atomic<uint64_t> m_frames_captured;
+			std::atomic<uint64_t> m_bytes_captured;
+	};
+}
+
+#endif /* ASIOTAP_POSIX_VIRTUAL_TAP_PEER_HPP */
@@ -47,6 +47,7 @@
 
 #include <iostream>
 #include <iomanip>
+#include <cassert>
 
 namespace asiotap
 {
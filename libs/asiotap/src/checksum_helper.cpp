@@ -44,48 +44,73 @@
 
 #include "osi/checksum_helper.hpp"
 
+#include "osi/checksum_kernel.hpp"
+
+#include <cstring>
+
 namespace asiotap
 {
 	namespace osi
 	{
-		void checksum_helper::update(const uint16_t* buf, size_t buf_len)
+		namespace
 		{
-			if (buf_len > 0)
+			uint16_t make_word(uint8_t first, uint8_t second)
 			{
-				if (m_left != 0)
-				{
-					m_checksum += (static_cast<uint16_t>(m_left) << 8 | *reinterpret_cast<const uint8_t*>(buf));
-					buf_len -= sizeof(uint8_t);
-					m_left = 0;
-				}
+				const uint8_t bytes[2] = { first, second };
+				uint16_t word;
 
-				while (buf_len > 1)
-				{
-					m_checksum += *buf++;
-					buf_len -= sizeof(uint16_t);
-				}
+				std::memcpy(&word, bytes, sizeof(word));
 
-				if (buf_len > 0)
+				return word;
+			}
+
+			uint32_t fold(uint32_t sum)
+			{
+				while (sum >> 16)
 				{
-					m_left = *reinterpret_cast<const uint8_t*>(buf);
+					sum = (sum & 0xFFFF) + (sum >> 16);
 				}
+
+				return sum;
 			}
 		}
 
-		uint32_t checksum_helper::compute()
+		void checksum_helper::update(const uint16_t* buf, size_t buf_len)
 		{
-			if (m_left != 0)
+			const uint8_t* data = reinterpret_cast<const uint8_t*>(buf);
+
+			if (buf_len == 0)
 			{
-				m_checksum += m_left;
-				m_left = 0;
+				return;
 			}
 
-			while (m_checksum >> 16)
+			if (m_has_left)
 			{
-				m_checksum = (m_checksum & 0xFFFF) + (m_checksum >> 16);
+				m_checksum = fold(m_checksum + make_word(m_left, *data));
+				++data;
+				--buf_len;
+				m_has_left = false;
+			}
+
+			m_checksum = fold(m_checksum + checksum_sum(data, buf_len & ~static_cast<size_t>(1)));
+
+			if (buf_len % 2 != 0)
+			{
+				m_left = data[buf_len - 1];
+				m_has_left = true;
+			}
+		}
+
+		uint32_t checksum_helper::compute()
+		{
+			if (m_has_left)
+			{
+				m_checksum = fold(m_checksum + make_word(m_left, 0));
+				m_left = 0;
+				m_has_left = false;
 			}
 
-			return static_cast<uint16_t>(~m_checksum);
+			return static_cast<uint16_t>(~fold(m_checksum));
 		}
 	}
 }
@@ -0,0 +1,332 @@
+/*
+ * libasiotap - A portable TAP adapter extension for Boost::ASIO.
+ * Copyright (C) 2010-2011 Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libasiotap.
+ *
+ * libasiotap is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libasiotap is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libasiotap in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file checksum_kernel.cpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief Vectorized Internet checksum kernels.
+ */
+
+#include "osi/checksum_kernel.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ASIOTAP_CHECKSUM_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64) || (defined(__ARM_NEON) && defined(__arm__))
+#define ASIOTAP_CHECKSUM_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define ASIOTAP_CHECKSUM_TARGET(x) __attribute__((target(x)))
+#else
+#define ASIOTAP_CHECKSUM_TARGET(x)
+#endif
+
+namespace asiotap
+{
+	namespace osi
+	{
+		namespace
+		{
+			// The vector accumulators have 32-bit lanes that each receive two 16-bit words per block: flushing them every that many blocks ensures they never overflow.
+			const size_t MAX_BLOCKS_PER_FLUSH = 16384;
+
+			typedef uint64_t (*sum_function_type)(const uint8_t*, size_t);
+
+			uint16_t fold(uint64_t sum)
+			{
+				while (sum >> 16)
+				{
+					sum = (sum & 0xFFFF) + (sum >> 16);
+				}
+
+				return static_cast<uint16_t>(sum);
+			}
+
+			uint64_t sum_scalar(const uint8_t* data, size_t len)
+			{
+				uint64_t sum = 0;
+
+				for (; len >= sizeof(uint16_t); data += sizeof(uint16_t), len -= sizeof(uint16_t))
+				{
+					uint16_t word;
+					std::memcpy(&word, data, sizeof(word));
+					sum += word;
+				}
+
+				return sum;
+			}
+
+#ifdef ASIOTAP_CHECKSUM_X86
+			ASIOTAP_CHECKSUM_TARGET("sse2")
+			uint64_t sum_sse2(const uint8_t* data, size_t len)
+			{
+				const __m128i zero = _mm_setzero_si128();
+				uint64_t sum = 0;
+
+				while (len >= sizeof(__m128i))
+				{
+					const size_t blocks = std::min(len / sizeof(__m128i), MAX_BLOCKS_PER_FLUSH);
+					__m128i accumulator = zero;
+
+					for (size_t i = 0; i < blocks; ++i, data += sizeof(__m128i))
+					{
+						const __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+
+						accumulator = _mm_add_epi32(accumulator, _mm_unpacklo_epi16(words, zero));
+						accumulator = _mm_add_epi32(accumulator, _mm_unpackhi_epi16(words, zero));
+					}
+
+					len -= blocks * sizeof(__m128i);
+
+					uint32_t lanes[4];
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), accumulator);
+
+					sum += static_cast<uint64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+				}
+
+				return sum + sum_scalar(data, len);
+			}
+
+			ASIOTAP_CHECKSUM_TARGET("avx2")
+			uint64_t sum_avx2(const uint8_t* data, size_t len)
+			{
+				const __m256i zero = _mm256_setzero_si256();
+				uint64_t sum = 0;
+
+				while (len >= sizeof(__m256i))
+				{
+					const size_t blocks = std::min(len / sizeof(__m256i), MAX_BLOCKS_PER_FLUSH);
+					__m256i accumulator = zero;
+
+					for (size_t i = 0; i < blocks; ++i, data += sizeof(__m256i))
+					{
+						const __m256i words = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+
+						accumulator = _mm256_add_epi32(accumulator, _mm256_unpacklo_epi16(words, zero));
+						accumulator = _mm256_add_epi32(accumulator, _mm256_unpackhi_epi16(words, zero));
+					}
+
+					len -= blocks * sizeof(__m256i);
+
+					uint32_t lanes[8];
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), accumulator);
+
+					for (size_t i = 0; i < 8; ++i)
+					{
+						sum += lanes[i];
+					}
+				}
+
+				return sum + sum_sse2(data, len);
+			}
+
+			bool cpu_has_sse2()
+			{
+#if defined(__x86_64__) || defined(_M_X64)
+				return true;
+#elif defined(_MSC_VER)
+				int info[4];
+				__cpuid(info, 1);
+
+				return (info[3] & (1 << 26)) != 0;
+#else
+				return __builtin_cpu_supports("sse2") != 0;
+#endif
+			}
+
+			bool cpu_has_avx2()
+			{
+#if defined(_MSC_VER)
+				int info[4];
+				__cpuid(info, 0);
+
+				if (info[0] < 7)
+				{
+					return false;
+				}
+
+				__cpuid(info, 1);
+
+				// The OS must save the YMM registers on context switches.
+				const bool osxsave = (info[2] & (1 << 27)) != 0;
+
+				if (!osxsave || ((_xgetbv(0) & 0x6) != 0x6))
+				{
+					return false;
+				}
+
+				__cpuidex(info, 7, 0);
+
+				return (info[1] & (1 << 5)) != 0;
+#else
+				return __builtin_cpu_supports("avx2") != 0;
+#endif
+			}
+#endif
+
+#ifdef ASIOTAP_CHECKSUM_NEON
+			uint64_t sum_neon(const uint8_t* data, size_t len)
+			{
+				uint64_t sum = 0;
+
+				while (len >= sizeof(uint16x8_t))
+				{
+					const size_t blocks = std::min(len / sizeof(uint16x8_t), MAX_BLOCKS_PER_FLUSH);
+					uint32x4_t accumulator = vdupq_n_u32(0);
+
+					for (size_t i = 0; i < blocks; ++i, data += sizeof(uint16x8_t))
+					{
+						accumulator = vpadalq_u16(accumulator, vreinterpretq_u16_u8(vld1q_u8(data)));
+					}
+
+					len -= blocks * sizeof(uint16x8_t);
+
+					const uint64x2_t pairs = vpaddlq_u32(accumulator);
+
+					sum += vgetq_lane_u64(pairs, 0) + vgetq_lane_u64(pairs, 1);
+				}
+
+				return sum + sum_scalar(data, len);
+			}
+#endif
+
+			sum_function_type get_sum_function(checksum_kernel_type kernel)
+			{
+				switch (kernel)
+				{
+#ifdef ASIOTAP_CHECKSUM_X86
+					case checksum_kernel_type::sse2:
+						return &sum_sse2;
+					case checksum_kernel_type::avx2:
+						return &sum_avx2;
+#endif
+#ifdef ASIOTAP_CHECKSUM_NEON
+					case checksum_kernel_type::neon:
+						return &sum_neon;
+#endif
+					default:
+						return &sum_scalar;
+				}
+			}
+
+			checksum_kernel_type detect_checksum_kernel()
+			{
+				const checksum_kernel_type kernels[] = {
+					checksum_kernel_type::avx2,
+					checksum_kernel_type::neon,
+					checksum_kernel_type::sse2
+				};
+
+				for (checksum_kernel_type kernel : kernels)
+				{
+					if (is_checksum_kernel_supported(kernel))
+					{
+						return kernel;
+					}
+				}
+
+				return checksum_kernel_type::scalar;
+			}
+		}
+
+		bool is_checksum_kernel_supported(checksum_kernel_type kernel)
+		{
+			switch (kernel)
+			{
+				case checksum_kernel_type::scalar:
+					return true;
+#ifdef ASIOTAP_CHECKSUM_X86
+				case checksum_kernel_type::sse2:
+					return cpu_has_sse2();
+				case checksum_kernel_type::avx2:
+					return cpu_has_avx2();
+#endif
+#ifdef ASIOTAP_CHECKSUM_NEON
+				case checksum_kernel_type::neon:
+					return true;
+#endif
+				default:
+					return false;
+			}
+		}
+
+		checksum_kernel_type get_checksum_kernel()
+		{
+			static const checksum_kernel_type kernel = detect_checksum_kernel();
+
+			return kernel;
+		}
+
+		const char* get_checksum_kernel_name(checksum_kernel_type kernel)
+		{
+			switch (kernel)
+			{
+				case checksum_kernel_type::scalar:
+					return "scalar";
+				case checksum_kernel_type::sse2:
+					return "sse2";
+				case checksum_kernel_type::avx2:
+					return "avx2";
+				case checksum_kernel_type::neon:
+					return "neon";
+			}
+
+			return "unknown";
+		}
+
+		uint16_t checksum_sum(checksum_kernel_type kernel, const void* buf, size_t buf_len)
+		{
+			return fold(get_sum_function(kernel)(static_cast<const uint8_t*>(buf), buf_len));
+		}
+
+		uint16_t checksum_sum(const void* buf, size_t buf_len)
+		{
+			static const sum_function_type sum_function = get_sum_function(get_checksum_kernel());
+
+			return fold(sum_function(static_cast<const uint8_t*>(buf), buf_len));
+		}
+	}
+}
@@ -94,6 +94,14 @@ namespace asiotap
 			{
 				return "The specified IP configuration is invalid";
 			}
+			case asiotap_error::invalid_pcap_file:
+			{
+				return "The file is not a valid pcap capture file";
+			}
+			case asiotap_error::unsupported_pcap_link_type:
+			{
+				return "The pcap capture file link type is not supported";
+			}
 			default:
 			{
 				return "Unknown asiotap error";
@@ -0,0 +1,296 @@
+/*
+ * libasiotap - A portable TAP adapter extension for Boost::ASIO.
+ * Copyright (C) 2010-2011 Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libasiotap.
+ *
+ * libasiotap is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libasiotap is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libasiotap in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file pcap.cpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief Read and write pcap capture files.
+ */
+
+#include "pcap.hpp"
+
+#include "osi/ethernet_frame.hpp"
+#include "osi/ipv4_frame.hpp"
+#include "osi/ipv6_frame.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+
+namespace asiotap
+{
+	namespace
+	{
+		const uint32_t MAGIC_MICROSECONDS = 0xa1b2c3d4;
+		const uint32_t MAGIC_NANOSECONDS = 0xa1b23c4d;
+		const uint16_t VERSION_MAJOR = 2;
+		const uint16_t VERSION_MINOR = 4;
+		const uint32_t SNAPLEN = 65535;
+
+		// Some tools write raw IP captures with these link types instead of pcap_link_type::raw.
+		const uint32_t LINKTYPE_IPV4 = 228;
+		const uint32_t LINKTYPE_IPV6 = 229;
+
+		// Bigger records are most likely garbage: no tap adapter frame is that large.
+		const uint32_t MAX_RECORD_SIZE = 262144;
+
+#pragma pack(push, 1)
+		struct file_header_type
+		{
+			uint32_t magic;
+			uint16_t version_major;
+			uint16_t version_minor;
+			int32_t thiszone;
+			uint32_t sigfigs;
+			uint32_t snaplen;
+			uint32_t network;
+		};
+
+		struct record_header_type
+		{
+			uint32_t ts_sec;
+			uint32_t ts_fraction;
+			uint32_t incl_len;
+			uint32_t orig_len;
+		};
+#pragma pack(pop)
+
+		uint32_t swap_bytes(uint32_t value)
+		{
+			return ((value & 0x000000ff) << 24) | ((value & 0x0000ff00) << 8) | ((value & 0x00ff0000) >> 8) | ((value & 0xff000000) >> 24);
+		}
+	}
+
+	pcap_reader::pcap_reader() :
+		m_file(),
+		m_swapped(false),
+		m_link_type(pcap_link_type::ethernet)
+	{
+	}
+
+	void pcap_reader::open(const std::string& path, boost::system::error_code& ec)
+	{
+		ec = boost::system::error_code();
+
+		m_file.close();
+		m_file.clear();
+		m_file.open(path.c_str(), std::ios::in | std::ios::binary);
+
+		if (!m_file)
+		{
+			ec = boost::system::error_code(errno, boost::system::system_category());
+
+			return;
+		}
+
+		file_header_type header;
+
+		if (!m_file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+		{
+			ec = make_error_code(asiotap_error::invalid_pcap_file);
+
+			return;
+		}
+
+		// The nanosecond resolution only changes the meaning of the timestamps, which are ignored.
+		if ((header.magic == MAGIC_MICROSECONDS) || (header.magic == MAGIC_NANOSECONDS))
+		{
+			m_swapped = false;
+		}
+		else if ((header.magic == swap_bytes(MAGIC_MICROSECONDS)) || (header.magic == swap_bytes(MAGIC_NANOSECONDS)))
+		{
+			m_swapped = true;
+		}
+		else
+		{
+			ec = make_error_code(asiotap_error::invalid_pcap_file);
+
+			return;
+		}
+
+		const uint32_t network = to_host(header.network);
+
+		if (network == static_cast<uint32_t>(pcap_link_type::ethernet))
+		{
+			m_link_type = pcap_link_type::ethernet;
+		}
+		else if ((network == static_cast<uint32_t>(pcap_link_type::raw)) || (network == LINKTYPE_IPV4) || (network == LINKTYPE_IPV6))
+		{
+			m_link_type = pcap_link_type::raw;
+		}
+		else
+		{
+			ec = make_error_code(asiotap_error::unsupported_pcap_link_type);
+
+			return;
+		}
+	}
+
+	bool pcap_reader::read(std::vector<uint8_t>& frame, boost::system::error_code& ec)
+	{
+		ec = boost::system::error_code();
+
+		record_header_type header;
+
+		if (!m_file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+		{
+			// A truncated record header means the capture was interrupted: we just stop there.
+			return false;
+		}
+
+		const uint32_t size = to_host(header.incl_len);
+
+		if (size > MAX_RECORD_SIZE)
+		{
+			ec = make_error_code(asiotap_error::invalid_pcap_file);
+
+			return false;
+		}
+
+		frame.resize(size);
+
+		if ((size > 0) && !m_file.read(reinterpret_cast<char*>(&frame[0]), size))
+		{
+			return false;
+		}
+
+		return true;
+	}
+
+	uint32_t pcap_reader::to_host(uint32_t value) const
+	{
+		return m_swapped ? swap_bytes(value) : value;
+	}
+
+	pcap_writer::pcap_writer() :
+		m_file(),
+		m_link_type(pcap_link_type::ethernet)
+	{
+	}
+
+	void pcap_writer::open(const std::string& path, pcap_link_type _link_type, boost::system::error_code& ec)
+	{
+		ec = boost::system::error_code();
+
+		m_file.close();
+		m_file.clear();
+		m_file.open(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+
+		if (!m_file)
+		{
+			ec = boost::system::error_code(errno, boost::system::system_category());
+
+			return;
+		}
+
+		m_link_type = _link_type;
+
+		const file_header_type header = { MAGIC_MICROSECONDS, VERSION_MAJOR, VERSION_MINOR, 0, 0, SNAPLEN, static_cast<uint32_t>(m_link_type) };
+
+		m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	}
+
+	void pcap_writer::write(boost::asio::const_buffer frame)
+	{
+		const size_t size = std::min<size_t>(boost::asio::buffer_size(frame), SNAPLEN);
+		const auto now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+		const record_header_type header = {
+			static_cast<uint32_t>(now / 1000000),
+			static_cast<uint32_t>(now % 1000000),
+			static_cast<uint32_t>(size),
+			static_cast<uint32_t>(boost::asio::buffer_size(frame))
+		};
+
+		m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		m_file.write(boost::asio::buffer_cast<const char*>(frame), size);
+	}
+
+	std::vector<std::vector<uint8_t> > read_pcap_frames(const std::string& path, tap_adapter_layer layer, boost::system::error_code& ec)
+	{
+		std::vector<std::vector<uint8_t> > result;
+		pcap_reader reader;
+
+		reader.open(path, ec);
+
+		if (ec)
+		{
+			return result;
+		}
+
+		if ((layer == tap_adapter_layer::ethernet) && (reader.link_type() != pcap_link_type::ethernet))
+		{
+			ec = make_error_code(asiotap_error::unsupported_pcap_link_type);
+
+			return result;
+		}
+
+		std::vector<uint8_t> frame;
+
+		while (reader.read(frame, ec))
+		{
+			if ((layer == tap_adapter_layer::ip) && (reader.link_type() == pcap_link_type::ethernet))
+			{
+				if (frame.size() <= sizeof(osi::ethernet_frame))
+				{
+					continue;
+				}
+
+				uint16_t protocol;
+				std::memcpy(&protocol, &frame[offsetof(osi::ethernet_frame, protocol)], sizeof(protocol));
+				protocol = ntohs(protocol);
+
+				if ((protocol != osi::IP_PROTOCOL) && (protocol != osi::IPV6_PROTOCOL))
+				{
+					continue;
+				}
+
+				frame.erase(frame.begin(), frame.begin() + sizeof(osi::ethernet_frame));
+			}
+
+			if (!frame.empty())
+			{
+				result.push_back(frame);
+			}
+		}
+
+		return result;
+	}
+}
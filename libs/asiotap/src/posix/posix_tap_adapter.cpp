@@ -45,6 +45,9 @@
 #include "posix/posix_tap_adapter.hpp"
 
 #include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+
+#include <random>
 
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -52,6 +55,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/socket.h>
 
 #ifdef LINUX
 
@@ -89,6 +93,9 @@ namespace asiotap
 {
 	namespace
 	{
+		const int VIRTUAL_TAP_ADAPTER_BUFFER_SIZE = 4 * 1024 * 1024;
+		const size_t VIRTUAL_TAP_ADAPTER_DEFAULT_MTU = 1500;
+
 		unsigned int netmask_to_prefix_len(in_addr netmask)
 		{
 			uint32_t bits = ~ntohl(netmask.s_addr);
@@ -227,8 +234,14 @@ namespace asiotap
 	}
 
 	void posix_tap_adapter::open(const std::string& _name, boost::system::error_code& ec)
+	{
+		open(_name, 1, false, ec);
+	}
+
+	void posix_tap_adapter::open(const std::string& _name, unsigned int queue_count, bool offloading, boost::system::error_code& ec)
 	{
 		ec = boost::system::error_code();
+		m_virtual = false;
 
 #if defined(LINUX)
 		const std::string dev_name = (layer() == tap_adapter_layer::ethernet) ? "/dev/net/tap" : "/dev/net/tun";
@@ -267,6 +280,28 @@ namespace asiotap
 		ifr.ifr_flags |= IFF_ONE_QUEUE;
 #endif
 
+		if (queue_count > 1)
+		{
+#if defined(IFF_MULTI_QUEUE)
+			ifr.ifr_flags |= IFF_MULTI_QUEUE;
+#else
+			ec = boost::asio::error::operation_not_supported;
+
+			return;
+#endif
+		}
+
+		if (offloading)
+		{
+#if defined(IFF_VNET_HDR) && defined(TUNSETOFFLOAD)
+			ifr.ifr_flags |= IFF_VNET_HDR;
+#else
+			ec = boost::asio::error::operation_not_supported;
+
+			return;
+#endif
+		}
+
 		if (layer() == tap_adapter_layer::ethernet)
 		{
 			ifr.ifr_flags |= IFF_TAP;
@@ -289,6 +324,19 @@ namespace asiotap
 			return;
 		}
 
+#if defined(IFF_VNET_HDR) && defined(TUNSETOFFLOAD)
+		if (offloading)
+		{
+			// Let the kernel hand us partially checksummed TCP super-packets.
+			if (::ioctl(device.native_handle(), TUNSETOFFLOAD, TUN_F_CSUM | TUN_F_TSO4 | TUN_F_TSO6) < 0)
+			{
+				ec = boost::system::error_code(errno, boost::system::system_category());
+
+				return;
+			}
+		}
+#endif
+
 		descriptor_handler socket = open_socket(AF_INET, ec);
 
 		if (!socket.valid())
@@ -331,10 +379,36 @@ namespace asiotap
 			set_ethernet_address(_ethernet_address);
 		}
 
+		// The additional queues are attached to the interface we just created.
+		std::vector<descriptor_handler> queues;
+
+		for (unsigned int i = 1; i < queue_count; ++i)
+		{
+			descriptor_handler queue = open_device(dev_name, ec);
+
+			if (!queue.valid())
+			{
+				return;
+			}
+
+			if (::ioctl(queue.native_handle(), TUNSETIFF, (void *)&ifr) < 0)
+			{
+				ec = boost::system::error_code(errno, boost::system::system_category());
+
+				return;
+			}
+
+			queues.push_back(std::move(queue));
+		}
+
 		set_name(ifr.ifr_name);
 
 #else /* *BSD and Mac OS X */
 
+		// Multiple queues and offloading are Linux features: we just use one plain queue.
+		static_cast<void>(queue_count);
+		offloading = false;
+
 		const std::string dev_type = (layer() == tap_adapter_layer::ethernet) ? "tap" : "tun";
 		std::string interface_name = _name;
 
@@ -442,13 +516,45 @@ namespace asiotap
 		{
 			return;
 		}
+
+		// The descriptors are non-blocking once and for all, so that try_read() and try_write() never change their mode while operations are pending on them.
+		if (descriptor().non_blocking(true, ec))
+		{
+			return;
+		}
+
+#if defined(LINUX)
+		for (auto&& queue : queues)
+		{
+			add_queue(queue.native_handle(), ec);
+
+			if (ec)
+			{
+				return;
+			}
+
+			queue.release();
+
+			if (queue_descriptor(this->queue_count() - 1).non_blocking(true, ec))
+			{
+				return;
+			}
+		}
+#endif
+
+		set_offloading(offloading);
 	}
 
 	void posix_tap_adapter::open(const std::string& _name)
+	{
+		open(_name, 1);
+	}
+
+	void posix_tap_adapter::open(const std::string& _name, unsigned int queue_count, bool offloading)
 	{
 		boost::system::error_code ec;
 
-		open(_name, ec);
+		open(_name, queue_count, offloading, ec);
 
 		if (ec)
 		{
@@ -456,6 +562,137 @@ namespace asiotap
 		}
 	}
 
+	void posix_tap_adapter::open_virtual(const std::string& _name, descriptor_type& peer, boost::system::error_code& ec)
+	{
+		ec = boost::system::error_code();
+
+		int fds[2];
+
+		// Datagram sockets keep the frames boundaries and, once connected, block the writer instead of dropping frames.
+		if (::socketpair(AF_UNIX, SOCK_DGRAM, 0, fds) < 0)
+		{
+			ec = boost::system::error_code(errno, boost::system::system_category());
+
+			return;
+		}
+
+		descriptor_handler device(fds[0]);
+		descriptor_handler peer_device(fds[1]);
+
+		// The default buffers are too small for large frames on some systems and too small for bursts on all of them.
+		const int buffer_size = VIRTUAL_TAP_ADAPTER_BUFFER_SIZE;
+
+		for (int fd : { device.native_handle(), peer_device.native_handle() })
+		{
+			if ((::setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size)) < 0) || (::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size)) < 0))
+			{
+				ec = boost::system::error_code(errno, boost::system::system_category());
+
+				return;
+			}
+		}
+
+		if (peer.assign(peer_device.native_handle(), ec))
+		{
+			return;
+		}
+
+		peer_device.release();
+
+		if (descriptor().assign(device.native_handle(), ec))
+		{
+			boost::system::error_code close_ec;
+			peer.close(close_ec);
+
+			return;
+		}
+
+		device.release();
+
+		if (descriptor().non_blocking(true, ec))
+		{
+			boost::system::error_code close_ec;
+			peer.close(close_ec);
+			descriptor().close(close_ec);
+
+			return;
+		}
+
+		// A random, locally administered, unicast address.
+		osi::ethernet_address _ethernet_address;
+		std::random_device random_device;
+
+		for (auto&& byte : _ethernet_address.data())
+		{
+			byte = static_cast<uint8_t>(random_device());
+		}
+
+		_ethernet_address.data()[0] = (_ethernet_address.data()[0] & 0xfc) | 0x02;
+
+		set_name(_name);
+		set_mtu(VIRTUAL_TAP_ADAPTER_DEFAULT_MTU);
+		set_ethernet_address(_ethernet_address);
+		set_offloading(false);
+		m_virtual = true;
+		m_virtual_ip_addresses.clear();
+	}
+
+	void posix_tap_adapter::open_virtual(const std::string& _name, descriptor_type& peer)
+	{
+		boost::system::error_code ec;
+
+		open_virtual(_name, peer, ec);
+
+		if (ec)
+		{
+			throw boost::system::system_error(ec);
+		}
+	}
+
+#if defined(LINUX)
+	void posix_tap_adapter::enable_io_uring(unsigned int entries, boost::system::error_code& ec)
+	{
+		if (!is_open())
+		{
+			ec = boost::asio::error::bad_descriptor;
+
+			return;
+		}
+
+		const boost::shared_ptr<uringplus::uring> new_uring = boost::make_shared<uringplus::uring>(boost::ref(get_io_service()));
+
+		new_uring->open(entries, ec);
+
+		if (ec)
+		{
+			return;
+		}
+
+		// io_uring does not wait for non-blocking descriptors to be ready: it fails the operations with EAGAIN instead.
+		for (size_t queue = 0; queue < queue_count(); ++queue)
+		{
+			if (queue_descriptor(queue).non_blocking(false, ec))
+			{
+				return;
+			}
+		}
+
+		m_uring = new_uring;
+	}
+
+	void posix_tap_adapter::register_buffer(boost::asio::mutable_buffer region, boost::system::error_code& ec)
+	{
+		if (!m_uring)
+		{
+			ec = boost::asio::error::operation_not_supported;
+
+			return;
+		}
+
+		m_uring->register_buffer(region, ec);
+	}
+#endif
+
 	void posix_tap_adapter::destroy_device()
 	{
 		boost::system::error_code ec;
@@ -471,6 +708,11 @@ namespace asiotap
 	void posix_tap_adapter::destroy_device(boost::system::error_code& ec)
 	{
 #if defined(MACINTOSH) || defined(BSD)
+		if (m_virtual)
+		{
+			return;
+		}
+
 		descriptor_handler socket = open_socket(AF_INET, ec);
 
 		if (!socket.valid())
@@ -494,6 +736,11 @@ namespace asiotap
 
 	void posix_tap_adapter::set_connected_state(bool connected)
 	{
+		if (m_virtual)
+		{
+			return;
+		}
+
 		descriptor_handler socket = open_socket(AF_INET);
 
 		struct ifreq netifr {};
@@ -533,6 +780,11 @@ namespace asiotap
 
 	ip_network_address_list posix_tap_adapter::get_ip_addresses()
 	{
+		if (m_virtual)
+		{
+			return m_virtual_ip_addresses;
+		}
+
 		ip_network_address_list result;
 
 		struct ifaddrs* addrs = nullptr;
@@ -598,6 +850,28 @@ namespace asiotap
 
 	void posix_tap_adapter::configure(const configuration_type& configuration)
 	{
+		if (m_virtual)
+		{
+			m_virtual_ip_addresses.clear();
+
+			if (configuration.ipv4.network_address)
+			{
+				m_virtual_ip_addresses.push_back(*configuration.ipv4.network_address);
+			}
+
+			if (configuration.ipv6.network_address)
+			{
+				m_virtual_ip_addresses.push_back(*configuration.ipv6.network_address);
+			}
+
+			if (configuration.mtu > 0)
+			{
+				set_mtu(configuration.mtu);
+			}
+
+			return;
+		}
+
 		if (configuration.ipv4.network_address)
 		{
 			if (layer() == tap_adapter_layer::ethernet)
@@ -0,0 +1,301 @@
+/*
+ * libasiotap - A portable TAP adapter extension for Boost::ASIO.
+ * Copyright (C) 2010-2011 Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libasiotap.
+ *
+ * libasiotap is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libasiotap is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libasiotap in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file virtual_tap_peer.cpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief The other end of a virtual tap adapter.
+ */
+
+#include "posix/virtual_tap_peer.hpp"
+
+#include <boost/bind.hpp>
+
+namespace asiotap
+{
+	namespace
+	{
+		// Large enough for any frame, including offloaded ones.
+		const size_t CAPTURE_BUFFER_SIZE = 65536;
+	}
+
+	virtual_tap_peer::virtual_tap_peer(boost::asio::io_service& io_service) :
+		m_strand(io_service),
+		m_descriptor(io_service),
+		m_replay_timer(io_service),
+		m_frames(),
+		m_rate(0),
+		m_replay_count(1),
+		m_replay_delay(),
+		m_replay_done_handler(),
+		m_capture_writer(),
+		m_memory_capture_enabled(false),
+		m_started(false),
+		m_replay_index(0),
+		m_replay_round(0),
+		m_replay_sent(0),
+		m_replay_start(),
+		m_capture_buffer(CAPTURE_BUFFER_SIZE),
+		m_captured_frames_mutex(),
+		m_captured_frames(),
+		m_frames_replayed(0),
+		m_bytes_replayed(0),
+		m_frames_captured(0),
+		m_bytes_captured(0)
+	{
+	}
+
+	void virtual_tap_peer::set_frames(const frame_list_type& frames)
+	{
+		m_frames = frames;
+	}
+
+	void virtual_tap_peer::set_rate(unsigned int frames_per_second)
+	{
+		m_rate = frames_per_second;
+	}
+
+	void virtual_tap_peer::set_replay_count(unsigned int count)
+	{
+		m_replay_count = count;
+	}
+
+	void virtual_tap_peer::set_replay_delay(std::chrono::steady_clock::duration delay)
+	{
+		m_replay_delay = delay;
+	}
+
+	void virtual_tap_peer::set_replay_done_handler(replay_done_handler_type handler)
+	{
+		m_replay_done_handler = handler;
+	}
+
+	void virtual_tap_peer::set_capture_writer(boost::shared_ptr<pcap_writer> writer)
+	{
+		m_capture_writer = writer;
+	}
+
+	void virtual_tap_peer::set_memory_capture_enabled(bool enabled)
+	{
+		m_memory_capture_enabled = enabled;
+	}
+
+	virtual_tap_peer::frame_list_type virtual_tap_peer::captured_frames() const
+	{
+		boost::mutex::scoped_lock lock(m_captured_frames_mutex);
+
+		return m_captured_frames;
+	}
+
+	void virtual_tap_peer::start()
+	{
+		m_strand.dispatch(boost::bind(&virtual_tap_peer::do_start, shared_from_this()));
+	}
+
+	void virtual_tap_peer::stop()
+	{
+		m_strand.dispatch(boost::bind(&virtual_tap_peer::do_stop, shared_from_this()));
+	}
+
+	virtual_tap_peer::statistics_type virtual_tap_peer::statistics() const
+	{
+		const statistics_type result = {
+			m_frames_replayed.load(std::memory_order_relaxed),
+			m_bytes_replayed.load(std::memory_order_relaxed),
+			m_frames_captured.load(std::memory_order_relaxed),
+			m_bytes_captured.load(std::memory_order_relaxed)
+		};
+
+		return result;
+	}
+
+	void virtual_tap_peer::do_start()
+	{
+		if (m_started)
+		{
+			return;
+		}
+
+		m_started = true;
+		m_replay_index = 0;
+		m_replay_round = 0;
+		m_replay_sent = 0;
+
+		capture_next();
+
+		if (m_frames.empty())
+		{
+			return;
+		}
+
+		m_replay_start = std::chrono::steady_clock::now() + m_replay_delay;
+
+		if (m_replay_delay > std::chrono::steady_clock::duration::zero())
+		{
+			m_replay_timer.expires_at(m_replay_start);
+			m_replay_timer.async_wait(m_strand.wrap(boost::bind(&virtual_tap_peer::handle_replay_timer, shared_from_this(), boost::asio::placeholders::error)));
+		}
+		else
+		{
+			replay_next();
+		}
+	}
+
+	void virtual_tap_peer::do_stop()
+	{
+		if (!m_started)
+		{
+			return;
+		}
+
+		m_started = false;
+
+		boost::system::error_code ec;
+
+		m_replay_timer.cancel(ec);
+		m_descriptor.cancel(ec);
+		m_descriptor.close(ec);
+
+		if (m_capture_writer)
+		{
+			m_capture_writer->flush();
+		}
+	}
+
+	void virtual_tap_peer::replay_next()
+	{
+		if (!m_started)
+		{
+			return;
+		}
+
+		if (m_replay_index == m_frames.size())
+		{
+			m_replay_index = 0;
+
+			if ((m_replay_count > 0) && (++m_replay_round == m_replay_count))
+			{
+				if (m_replay_done_handler)
+				{
+					m_replay_done_handler();
+				}
+
+				return;
+			}
+		}
+
+		if (m_rate > 0)
+		{
+			// Frames are scheduled from the start of the replay so that timer inaccuracies do not add up.
+			const std::chrono::steady_clock::time_point deadline = m_replay_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(static_cast<double>(m_replay_sent) / m_rate));
+
+			if (deadline > std::chrono::steady_clock::now())
+			{
+				m_replay_timer.expires_at(deadline);
+				m_replay_timer.async_wait(m_strand.wrap(boost::bind(&virtual_tap_peer::handle_replay_timer, shared_from_this(), boost::asio::placeholders::error)));
+
+				return;
+			}
+		}
+
+		const frame_type& frame = m_frames[m_replay_index++];
+
+		m_descriptor.async_write_some(boost::asio::buffer(frame), m_strand.wrap(boost::bind(&virtual_tap_peer::handle_replay_write, shared_from_this(), boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)));
+	}
+
+	void virtual_tap_peer::handle_replay_timer(const boost::system::error_code& ec)
+	{
+		if (ec != boost::asio::error::operation_aborted)
+		{
+			replay_next();
+		}
+	}
+
+	void virtual_tap_peer::handle_replay_write(const boost::system::error_code& ec, size_t bytes_transferred)
+	{
+		if (ec)
+		{
+			// The tap adapter was closed or we were stopped.
+			return;
+		}
+
+		++m_replay_sent;
+		m_frames_replayed.fetch_add(1, std::memory_order_relaxed);
+		m_bytes_replayed.fetch_add(bytes_transferred, std::memory_order_relaxed);
+
+		replay_next();
+	}
+
+	void virtual_tap_peer::capture_next()
+	{
+		if (!m_started)
+		{
+			return;
+		}
+
+		m_descriptor.async_read_some(boost::asio::buffer(m_capture_buffer), m_strand.wrap(boost::bind(&virtual_tap_peer::handle_capture_read, shared_from_this(), boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)));
+	}
+
+	void virtual_tap_peer::handle_capture_read(const boost::system::error_code& ec, size_t bytes_transferred)
+	{
+		if (ec)
+		{
+			// The tap adapter was closed or we were stopped.
+			return;
+		}
+
+		m_frames_captured.fetch_add(1, std::memory_order_relaxed);
+		m_bytes_captured.fetch_add(bytes_transferred, std::memory_order_relaxed);
+
+		if (m_capture_writer)
+		{
+			m_capture_writer->write(boost::asio::buffer(m_capture_buffer, bytes_transferred));
+		}
+
+		if (m_memory_capture_enabled)
+		{
+			const frame_type frame(m_capture_buffer.begin(), m_capture_buffer.begin() + bytes_transferred);
+
+			boost::mutex::scoped_lock lock(m_captured_frames_mutex);
+
+			m_captured_frames.push_back(frame);
+		}
+
+		capture_next();
+	}
+}
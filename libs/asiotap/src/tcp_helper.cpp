@@ -0,0 +1,227 @@
+/*
+ * libasiotap - A portable TAP adapter extension for Boost::ASIO.
+ * Copyright (C) 2010-2011 Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libasiotap.
+ *
+ * libasiotap is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libasiotap is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libasiotap in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file tcp_helper.cpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief A TCP helper class.
+ */
+
+#include "osi/tcp_helper.hpp"
+
+#include "osi/checksum.hpp"
+#include "osi/checksum_helper.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace asiotap
+{
+	namespace osi
+	{
+		namespace
+		{
+			const size_t TCP_OPTION_MSS_LENGTH = 4;
+
+			size_t find_option(const uint8_t* options, size_t options_len, uint8_t kind, size_t length)
+			{
+				size_t offset = 0;
+
+				while (offset < options_len)
+				{
+					const uint8_t current_kind = options[offset];
+
+					if (current_kind == TCP_OPTION_END)
+					{
+						break;
+					}
+
+					if (current_kind == TCP_OPTION_NOP)
+					{
+						++offset;
+
+						continue;
+					}
+
+					if (offset + 1 >= options_len)
+					{
+						break;
+					}
+
+					const size_t current_length = options[offset + 1];
+
+					if ((current_length < 2) || (offset + current_length > options_len))
+					{
+						break;
+					}
+
+					if ((current_kind == kind) && (current_length == length))
+					{
+						return offset;
+					}
+
+					offset += current_length;
+				}
+
+				return options_len;
+			}
+
+			tcp_ipv4_pseudo_header parent_frame_to_pseudo_header(const_helper<ipv4_frame> parent_frame, size_t tcp_length)
+			{
+				tcp_ipv4_pseudo_header pseudo_header;
+				memset(&pseudo_header, 0x00, sizeof(pseudo_header));
+
+				pseudo_header.ipv4_source = parent_frame.frame().source;
+				pseudo_header.ipv4_destination = parent_frame.frame().destination;
+				pseudo_header.ipv4_protocol = parent_frame.frame().protocol;
+				pseudo_header.tcp_length = htons(static_cast<uint16_t>(tcp_length));
+
+				return pseudo_header;
+			}
+
+			tcp_ipv6_pseudo_header parent_frame_to_pseudo_header(const_helper<ipv6_frame> parent_frame, size_t tcp_length)
+			{
+				tcp_ipv6_pseudo_header pseudo_header;
+				memset(&pseudo_header, 0x00, sizeof(pseudo_header));
+
+				pseudo_header.ipv6_source = parent_frame.frame().source;
+				pseudo_header.ipv6_destination = parent_frame.frame().destination;
+				pseudo_header.ipv6_next_header = TCP_PROTOCOL;
+				pseudo_header.tcp_length = htonl(static_cast<uint32_t>(tcp_length));
+
+				return pseudo_header;
+			}
+
+			template <typename HelperType, typename ParentHelperType>
+			uint16_t compute_tcp_checksum(ParentHelperType parent_frame, HelperType tcp_frame)
+			{
+				// The buffer may contain some link-layer padding after the IP payload.
+				const uint16_t* buf = boost::asio::buffer_cast<const uint16_t*>(tcp_frame.buffer());
+				size_t buf_len = std::min(boost::asio::buffer_size(tcp_frame.buffer()), parent_frame.payload_length());
+
+				checksum_helper chk;
+				const auto pseudo_header = parent_frame_to_pseudo_header(parent_frame, buf_len);
+
+				// The pseudo-header is packed: we copy it to aligned words rather than pointing into it.
+				static_assert(sizeof(pseudo_header) % sizeof(uint16_t) == 0, "The pseudo-header must be made of 16-bit words");
+				uint16_t pseudo_header_words[sizeof(pseudo_header) / sizeof(uint16_t)];
+				std::memcpy(pseudo_header_words, &pseudo_header, sizeof(pseudo_header));
+
+				chk.update(pseudo_header_words, sizeof(pseudo_header_words));
+				chk.update(buf, buf_len);
+
+				return chk.compute();
+			}
+		}
+
+		template <class HelperTag>
+		boost::optional<uint16_t> _base_helper_impl<HelperTag, tcp_frame>::maximum_segment_size() const
+		{
+			const uint8_t* const options_buf = boost::asio::buffer_cast<const uint8_t*>(options());
+			const size_t options_len = boost::asio::buffer_size(options());
+			const size_t offset = find_option(options_buf, options_len, TCP_OPTION_MSS, TCP_OPTION_MSS_LENGTH);
+
+			if (offset == options_len)
+			{
+				return boost::none;
+			}
+
+			uint16_t value;
+			std::memcpy(&value, options_buf + offset + 2, sizeof(value));
+
+			return ntohs(value);
+		}
+
+		template <class HelperTag>
+		uint16_t _base_helper_impl<HelperTag, tcp_frame>::compute_checksum(const_helper<ipv4_frame> parent_frame) const
+		{
+			return compute_tcp_checksum(parent_frame, *this);
+		}
+
+		template <class HelperTag>
+		uint16_t _base_helper_impl<HelperTag, tcp_frame>::compute_checksum(const_helper<ipv6_frame> parent_frame) const
+		{
+			return compute_tcp_checksum(parent_frame, *this);
+		}
+
+		template boost::optional<uint16_t> _base_helper_impl<const_helper_tag, tcp_frame>::maximum_segment_size() const;
+		template boost::optional<uint16_t> _base_helper_impl<mutable_helper_tag, tcp_frame>::maximum_segment_size() const;
+		template uint16_t _base_helper_impl<const_helper_tag, tcp_frame>::compute_checksum(const_helper<ipv4_frame>) const;
+		template uint16_t _base_helper_impl<const_helper_tag, tcp_frame>::compute_checksum(const_helper<ipv6_frame>) const;
+		template uint16_t _base_helper_impl<mutable_helper_tag, tcp_frame>::compute_checksum(const_helper<ipv4_frame>) const;
+		template uint16_t _base_helper_impl<mutable_helper_tag, tcp_frame>::compute_checksum(const_helper<ipv6_frame>) const;
+
+		bool _helper_impl<mutable_helper_tag, tcp_frame>::clamp_maximum_segment_size(uint16_t max_segment_size) const
+		{
+			const boost::optional<uint16_t> current = maximum_segment_size();
+
+			if (!current || (*current <= max_segment_size))
+			{
+				return false;
+			}
+
+			uint8_t* const data = boost::asio::buffer_cast<uint8_t*>(buffer());
+			const size_t options_len = boost::asio::buffer_size(options());
+			const size_t value_offset = sizeof(tcp_frame) + find_option(data + sizeof(tcp_frame), options_len, TCP_OPTION_MSS, TCP_OPTION_MSS_LENGTH) + 2;
+
+			// Options are not 16-bit aligned, so we update every checksummed word the value overlaps.
+			const size_t first_word = value_offset & ~static_cast<size_t>(1);
+			const size_t last_word = (value_offset + sizeof(uint16_t) - 1) & ~static_cast<size_t>(1);
+			uint16_t old_words[2];
+			uint16_t new_words[2];
+
+			std::memcpy(old_words, data + first_word, last_word + sizeof(uint16_t) - first_word);
+
+			const uint16_t value = htons(max_segment_size);
+			std::memcpy(data + value_offset, &value, sizeof(value));
+
+			std::memcpy(new_words, data + first_word, last_word + sizeof(uint16_t) - first_word);
+
+			uint16_t _checksum = checksum();
+
+			for (size_t index = 0; index <= (last_word - first_word) / sizeof(uint16_t); ++index)
+			{
+				_checksum = update_checksum(_checksum, old_words[index], new_words[index]);
+			}
+
+			set_checksum(_checksum);
+
+			return true;
+		}
+	}
+}
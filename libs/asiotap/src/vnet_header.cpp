@@ -0,0 +1,254 @@
+/*
+ * libasiotap - A portable TAP adapter extension for Boost::ASIO.
+ * Copyright (C) 2010-2011 Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libasiotap.
+ *
+ * libasiotap is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libasiotap is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libasiotap in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file vnet_header.cpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief The virtio-net header of tap adapters with offloading enabled.
+ */
+
+#include "osi/vnet_header.hpp"
+
+#include "osi/checksum_helper.hpp"
+#include "osi/ipv4_frame.hpp"
+#include "osi/ipv6_frame.hpp"
+#include "osi/tcp_frame.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+namespace asiotap
+{
+	namespace osi
+	{
+		namespace
+		{
+			const size_t TCP_SEQUENCE_OFFSET = offsetof(tcp_frame, sequence);
+			const size_t TCP_DATA_OFFSET_OFFSET = offsetof(tcp_frame, data_offset);
+			const size_t TCP_FLAGS_OFFSET = offsetof(tcp_frame, flags);
+			const size_t TCP_CHECKSUM_OFFSET = offsetof(tcp_frame, checksum);
+			const size_t TCP_MINIMUM_HEADER_SIZE = sizeof(tcp_frame);
+
+			uint16_t read_uint16(const uint8_t* buf)
+			{
+				uint16_t result;
+				std::memcpy(&result, buf, sizeof(result));
+
+				return ntohs(result);
+			}
+
+			void write_uint16(uint8_t* buf, uint16_t value)
+			{
+				value = htons(value);
+				std::memcpy(buf, &value, sizeof(value));
+			}
+
+			uint32_t read_uint32(const uint8_t* buf)
+			{
+				uint32_t result;
+				std::memcpy(&result, buf, sizeof(result));
+
+				return ntohl(result);
+			}
+
+			void write_uint32(uint8_t* buf, uint32_t value)
+			{
+				value = htonl(value);
+				std::memcpy(buf, &value, sizeof(value));
+			}
+		}
+
+		bool complete_checksum(const vnet_header& header, boost::asio::mutable_buffer frame)
+		{
+			uint8_t* const data = boost::asio::buffer_cast<uint8_t*>(frame);
+			const size_t data_size = boost::asio::buffer_size(frame);
+			const size_t checksum_position = header.checksum_start + header.checksum_offset;
+
+			if (checksum_position + sizeof(uint16_t) > data_size)
+			{
+				return false;
+			}
+
+			// The checksum field already contains the pseudo-header checksum, so we just have to sum everything from checksum_start.
+			checksum_helper helper;
+
+			helper.update(reinterpret_cast<const uint16_t*>(data + header.checksum_start), data_size - header.checksum_start);
+
+			const uint16_t checksum = static_cast<uint16_t>(helper.compute());
+			std::memcpy(data + checksum_position, &checksum, sizeof(checksum));
+
+			return true;
+		}
+
+		tcp_segmenter::tcp_segmenter(const vnet_header& header, boost::asio::const_buffer frame, size_t network_offset) :
+			m_frame(frame),
+			m_is_ipv4((header.gso_type & ~VNET_HEADER_GSO_ECN) == VNET_HEADER_GSO_TCPV4),
+			m_network_offset(network_offset),
+			m_transport_offset(header.checksum_start),
+			m_headers_size(0),
+			m_gso_size(header.gso_size),
+			m_segment_count(0)
+		{
+			const uint8_t* const data = boost::asio::buffer_cast<const uint8_t*>(frame);
+			const size_t data_size = boost::asio::buffer_size(frame);
+
+			if (!m_is_ipv4 && ((header.gso_type & ~VNET_HEADER_GSO_ECN) != VNET_HEADER_GSO_TCPV6))
+			{
+				return;
+			}
+
+			if ((m_gso_size == 0) || (m_transport_offset + TCP_MINIMUM_HEADER_SIZE > data_size))
+			{
+				return;
+			}
+
+			if (m_is_ipv4)
+			{
+				if ((m_network_offset + sizeof(ipv4_frame) > m_transport_offset) || (((data[m_network_offset] & 0xF0) >> 4) != IP_PROTOCOL_VERSION_4) || (data[m_network_offset + offsetof(ipv4_frame, protocol)] != TCP_PROTOCOL))
+				{
+					return;
+				}
+			}
+			else
+			{
+				if ((m_network_offset + sizeof(ipv6_frame) > m_transport_offset) || (((data[m_network_offset] & 0xF0) >> 4) != IP_PROTOCOL_VERSION_6))
+				{
+					return;
+				}
+			}
+
+			m_headers_size = m_transport_offset + ((data[m_transport_offset + TCP_DATA_OFFSET_OFFSET] & 0xF0) >> 4) * sizeof(uint32_t);
+
+			// A data offset below 5 words would make the segments overwrite the TCP header with the payload.
+			if ((m_headers_size < m_transport_offset + TCP_MINIMUM_HEADER_SIZE) || (m_headers_size > data_size))
+			{
+				return;
+			}
+
+			const size_t payload_size = data_size - m_headers_size;
+
+			m_segment_count = (payload_size > 0) ? (payload_size + m_gso_size - 1) / m_gso_size : 1;
+		}
+
+		size_t tcp_segmenter::segment_size(size_t index) const
+		{
+			const size_t payload_size = boost::asio::buffer_size(m_frame) - m_headers_size;
+
+			return m_headers_size + std::min(m_gso_size, payload_size - index * m_gso_size);
+		}
+
+		boost::asio::const_buffer tcp_segmenter::write_segment(size_t index, boost::asio::mutable_buffer buf) const
+		{
+			const size_t size = segment_size(index);
+
+			if (boost::asio::buffer_size(buf) < size)
+			{
+				throw std::length_error("buf");
+			}
+
+			const uint8_t* const source = boost::asio::buffer_cast<const uint8_t*>(m_frame);
+			uint8_t* const data = boost::asio::buffer_cast<uint8_t*>(buf);
+			const size_t payload_offset = index * m_gso_size;
+			const size_t segment_payload_size = size - m_headers_size;
+
+			std::memcpy(data, source, m_headers_size);
+			std::memcpy(data + m_headers_size, source + m_headers_size + payload_offset, segment_payload_size);
+
+			uint8_t* const network_header = data + m_network_offset;
+			uint8_t* const transport_header = data + m_transport_offset;
+			const size_t transport_size = size - m_transport_offset;
+
+			checksum_helper helper;
+
+			if (m_is_ipv4)
+			{
+				write_uint16(network_header + offsetof(ipv4_frame, total_length), static_cast<uint16_t>(size - m_network_offset));
+				write_uint16(network_header + offsetof(ipv4_frame, identification), static_cast<uint16_t>(read_uint16(network_header + offsetof(ipv4_frame, identification)) + index));
+				write_uint16(network_header + offsetof(ipv4_frame, header_checksum), 0);
+
+				checksum_helper header_helper;
+				header_helper.update(reinterpret_cast<const uint16_t*>(network_header), (network_header[0] & 0x0F) * sizeof(uint32_t));
+
+				const uint16_t header_checksum = static_cast<uint16_t>(header_helper.compute());
+				std::memcpy(network_header + offsetof(ipv4_frame, header_checksum), &header_checksum, sizeof(header_checksum));
+
+				uint8_t pseudo_header[12] = {};
+				std::memcpy(pseudo_header, network_header + offsetof(ipv4_frame, source), 8);
+				pseudo_header[9] = TCP_PROTOCOL;
+				write_uint16(pseudo_header + 10, static_cast<uint16_t>(transport_size));
+
+				helper.update(reinterpret_cast<const uint16_t*>(pseudo_header), sizeof(pseudo_header));
+			}
+			else
+			{
+				write_uint16(network_header + offsetof(ipv6_frame, payload_length), static_cast<uint16_t>(size - m_network_offset - sizeof(ipv6_frame)));
+
+				uint8_t pseudo_header[40] = {};
+				std::memcpy(pseudo_header, network_header + offsetof(ipv6_frame, source), 32);
+				write_uint32(pseudo_header + 32, static_cast<uint32_t>(transport_size));
+				pseudo_header[39] = TCP_PROTOCOL;
+
+				helper.update(reinterpret_cast<const uint16_t*>(pseudo_header), sizeof(pseudo_header));
+			}
+
+			write_uint32(transport_header + TCP_SEQUENCE_OFFSET, static_cast<uint32_t>(read_uint32(transport_header + TCP_SEQUENCE_OFFSET) + payload_offset));
+
+			// FIN and PSH only belong to the last segment, and CWR only to the first one.
+			if (index + 1 < m_segment_count)
+			{
+				transport_header[TCP_FLAGS_OFFSET] &= ~(TCP_FLAG_FIN | TCP_FLAG_PSH);
+			}
+
+			if (index > 0)
+			{
+				transport_header[TCP_FLAGS_OFFSET] &= ~TCP_FLAG_CWR;
+			}
+
+			write_uint16(transport_header + TCP_CHECKSUM_OFFSET, 0);
+
+			helper.update(reinterpret_cast<const uint16_t*>(transport_header), transport_size);
+
+			const uint16_t checksum = static_cast<uint16_t>(helper.compute());
+			std::memcpy(transport_header + TCP_CHECKSUM_OFFSET, &checksum, sizeof(checksum));
+
+			return boost::asio::buffer(buf, size);
+		}
+	}
+}
@@ -0,0 +1,182 @@
+/*
+ * libfreelan - A C++ library to establish peer-to-peer virtual private
+ * networks.
+ * Copyright (C) 2010-2011 Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libfreelan.
+ *
+ * libfreelan is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libfreelan is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libfreelan in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+
+/**
+ * \file async_log_writer.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief An asynchronous log writer.
+ */
+
+#ifndef ASYNC_LOG_WRITER_HPP
+#define ASYNC_LOG_WRITER_HPP
+
+#include <atomic>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <fscp/statistics.hpp>
+
+#include "logger.hpp"
+
+namespace freelan
+{
+	/**
+	 * \brief An asynchronous log writer.
+	 *
+	 * Log entries are copied into a preallocated lock-free ring buffer and handed to the log handler by a background thread, so that logging never waits for the handler (a console, syslog, ...).
+	 *
+	 * Writing never blocks either: when the ring buffer is full, the entry is dropped and counted. The background thread reports the dropped entries through the handler.
+	 */
+	class async_log_writer : public boost::noncopyable
+	{
+		public:
+
+			/**
+			 * \brief The log handler type.
+			 */
+			typedef logger::log_handler_type log_handler_type;
+
+			/**
+			 * \brief The timestamp type.
+			 */
+			typedef logger::timestamp_type timestamp_type;
+
+			/**
+			 * \brief The default capacity, in entries.
+			 */
+			static const size_t DEFAULT_CAPACITY = 4096;
+
+			/**
+			 * \brief The number of message bytes stored in place in each entry.
+			 *
+			 * Longer messages are stored in an allocated string.
+			 */
+			static const size_t MESSAGE_SIZE = 240;
+
+			/**
+			 * \brief Create a new asynchronous log writer.
+			 * \param handler The function to call, from the background thread, for each log entry.
+			 * \param capacity The capacity of the ring buffer. It is rounded up to a power of two.
+			 *
+			 * Entries written before start() is called are buffered.
+			 */
+			explicit async_log_writer(log_handler_type handler, size_t capacity = DEFAULT_CAPACITY);
+
+			/**
+			 * \brief Destroy the writer.
+			 *
+			 * The pending entries are handled first.
+			 */
+			~async_log_writer();
+
+			/**
+			 * \brief Start the background thread.
+			 *
+			 * Does nothing if it is already running.
+			 */
+			void start();
+
+			/**
+			 * \brief Stop the background thread.
+			 *
+			 * All the entries written so far are handled before this method returns. Entries written afterwards are buffered until the next call to start() or stop().
+			 *
+			 * \warning This method must not be called concurrently from several threads.
+			 */
+			void stop();
+
+			/**
+			 * \brief Write a log entry.
+			 * \param level The log level.
+			 * \param msg The message. It does not need to be null-terminated.
+			 * \param msg_len The length of msg.
+			 * \param timestamp The timestamp.
+			 *
+			 * This method is thread-safe and never blocks.
+			 */
+			void write(log_level level, const char* msg, size_t msg_len, const timestamp_type& timestamp);
+
+			/**
+			 * \brief Get the number of entries that were dropped because the ring buffer was full.
+			 * \return The number of dropped entries.
+			 */
+			uint64_t dropped() const
+			{
+				return m_dropped.value();
+			}
+
+		private:
+
+			struct record_type
+			{
+				std::atomic<size_t> sequence;
+				log_level level;
+				timestamp_type timestamp;
+				size_t size;
+				char message[MESSAGE_SIZE];
+				std::string long_message;
+			};
+
+			bool has_pending() const;
+			void handle_pending();
+			void run();
+
+			const log_handler_type m_handler;
+			const size_t m_capacity;
+			boost::scoped_array<record_type> m_records;
+			std::atomic<size_t> m_enqueue_position;
+			size_t m_dequeue_position;
+			fscp::statistics_counter m_dropped;
+			uint64_t m_reported_dropped;
+
+			boost::mutex m_mutex;
+			boost::condition_variable m_condition;
+			std::atomic<bool> m_sleeping;
+			bool m_stopping;
+			boost::thread m_thread;
+	};
+}
+
+#endif /* ASYNC_LOG_WRITER_HPP */
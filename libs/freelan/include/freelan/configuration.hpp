@@ -229,6 +229,11 @@ namespace freelan
 		 */
 		bool accept_contacts;
 
+		/**
+		 * \brief The "accept link tests" flag.
+		 */
+		bool accept_link_tests;
+
 		/**
 		 * \brief The dynamic contact list.
 		 */
@@ -258,6 +263,21 @@ namespace freelan
 		 * \brief The list of allowed elliptic curves.
 		 */
 		fscp::elliptic_curve_list_type elliptic_curve_capabilities;
+
+		/**
+		 * \brief The number of preallocated socket buffers.
+		 */
+		unsigned int buffer_count;
+
+		/**
+		 * \brief One packet out of latency_sampling_rate has its latency measured at each stage of the data path. 0 disables the measures.
+		 */
+		unsigned int latency_sampling_rate;
+
+		/**
+		 * \brief Whether to perform the socket I/O through io_uring.
+		 */
+		bool io_uring_enabled;
 	};
 
 	/**
@@ -389,6 +409,36 @@ namespace freelan
 		 */
 		metric_type metric;
 
+		/**
+		 * \brief The number of queues to open on the tap adapter.
+		 */
+		unsigned int queue_count;
+
+		/**
+		 * \brief Whether to enable checksum and segmentation offloading on the tap adapter.
+		 */
+		bool offloading_enabled;
+
+		/**
+		 * \brief The maximum number of frames to read from a tap adapter queue at once.
+		 */
+		unsigned int read_batch_size;
+
+		/**
+		 * \brief Whether to perform the tap adapter I/O through io_uring.
+		 */
+		bool io_uring_enabled;
+
+		/**
+		 * \brief The number of preallocated frame buffers.
+		 */
+		unsigned int buffer_count;
+
+		/**
+		 * \brief Whether to clamp the maximum segment size of TCP connections to the tunnel MTU.
+		 */
+		bool tcp_mss_clamping_enabled;
+
 		/**
 		 * \brief The IPv4 tap adapter address.
 		 */
@@ -438,6 +488,33 @@ namespace freelan
 		 * \brief The down script.
 		 */
 		boost::filesystem::path down_script;
+
+		/**
+		 * \brief The pcap file whose frames are replayed into a virtual tap adapter.
+		 *
+		 * If this or pcap_output_file is set, a virtual tap adapter that exists only in the process is used instead of a system one.
+		 */
+		boost::filesystem::path pcap_input_file;
+
+		/**
+		 * \brief The pcap file the frames written to a virtual tap adapter are captured to.
+		 */
+		boost::filesystem::path pcap_output_file;
+
+		/**
+		 * \brief The number of frames replayed per second, or 0 to replay them as fast as they are read.
+		 */
+		unsigned int pcap_replay_rate;
+
+		/**
+		 * \brief The number of times the frames are replayed, or 0 to replay them until the core is closed.
+		 */
+		unsigned int pcap_replay_count;
+
+		/**
+		 * \brief The delay between the opening of the tap adapter and the start of the replay.
+		 */
+		boost::posix_time::time_duration pcap_replay_delay;
 	};
 
 	/**
@@ -492,6 +569,13 @@ namespace freelan
 		 */
 		bool client_routing_enabled;
 
+		/**
+		 * \brief Whether to spread the traffic across all the ports that advertise the best route.
+		 *
+		 * The port is chosen from a hash of the addresses, protocol and ports of each frame, so that all the frames of a given flow take the same path.
+		 */
+		bool multipath_enabled;
+
 		/**
 		 * \brief Whether to accept route requests.
 		 */
@@ -49,20 +49,28 @@
 #include "os.hpp"
 #include "configuration.hpp"
 #include "logger.hpp"
+#include "async_log_writer.hpp"
 #include "switch.hpp"
 #include "router.hpp"
 #include "message.hpp"
 #include "routes_message.hpp"
+#include "link_test.hpp"
+#include "link_test_message.hpp"
 
 #include <fscp/fscp.hpp>
 
 #include <asiotap/asiotap.hpp>
 #include <asiotap/osi/arp_proxy.hpp>
 #include <asiotap/osi/dhcp_proxy.hpp>
-#include <asiotap/osi/complex_filter.hpp>
+#include <asiotap/osi/parser.hpp>
+#include <asiotap/osi/vnet_header.hpp>
 #include <asiotap/route_manager.hpp>
 #include <asiotap/types/ip_route.hpp>
 
+#ifndef WINDOWS
+#include <asiotap/posix/virtual_tap_peer.hpp>
+#endif
+
 #include <cryptoplus/x509/store.hpp>
 #include <cryptoplus/x509/store_context.hpp>
 
@@ -72,7 +80,6 @@
 #include <boost/weak_ptr.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 
-#include <queue>
 #include <set>
 
 namespace freelan
@@ -227,6 +234,111 @@ namespace freelan
 			 */
 			typedef boost::function<void (const asiotap::tap_adapter&)> tap_adapter_handler_type;
 
+			/**
+			 * \brief The latency of each stage of the core data path, for the sampled packets.
+			 */
+			struct latency_statistics_type
+			{
+				/**
+				 * \brief From the tap adapter read to the submission of the frame to the FSCP server.
+				 */
+				fscp::latency_histogram_snapshot send_forwarding;
+
+				/**
+				 * \brief From the FSCP server data callback to the queuing of the frame for the tap adapter.
+				 */
+				fscp::latency_histogram_snapshot receive_forwarding;
+
+				/**
+				 * \brief From the queuing of the frame to the start of its write, in the tap adapter write queue.
+				 */
+				fscp::latency_histogram_snapshot receive_tap_write_queue;
+
+				/**
+				 * \brief The tap adapter write.
+				 */
+				fscp::latency_histogram_snapshot receive_tap_write;
+			};
+
+			/**
+			 * \brief The core statistics.
+			 */
+			struct statistics_type
+			{
+				statistics_type() :
+					server(),
+					tap_adapter_read(),
+					tap_adapter_written(),
+					tap_adapter_write_queue_depth(0),
+					tap_adapter_buffer_heap_allocations(0),
+					proxy_buffer_heap_allocations(0),
+					switch_dropped_frames(0),
+					router_dropped_frames(0),
+					route_cache(),
+					latency()
+				{}
+
+				/**
+				 * \brief The FSCP server statistics, including the per-peer statistics.
+				 */
+				fscp::server::statistics_type server;
+
+				/**
+				 * \brief The frames read from the tap adapter.
+				 */
+				fscp::traffic_statistics_type tap_adapter_read;
+
+				/**
+				 * \brief The frames queued for writing to the tap adapter.
+				 */
+				fscp::traffic_statistics_type tap_adapter_written;
+
+				/**
+				 * \brief The count of frames waiting to be written to the tap adapter.
+				 */
+				uint64_t tap_adapter_write_queue_depth;
+
+				/**
+				 * \brief The count of tap adapter buffers that did not fit in the preallocated pool.
+				 */
+				uint64_t tap_adapter_buffer_heap_allocations;
+
+				/**
+				 * \brief The count of proxy buffers that did not fit in the preallocated pool.
+				 */
+				uint64_t proxy_buffer_heap_allocations;
+
+				/**
+				 * \brief The count of frames the switch could not send anywhere.
+				 */
+				uint64_t switch_dropped_frames;
+
+				/**
+				 * \brief The count of frames the router had no route for.
+				 */
+				uint64_t router_dropped_frames;
+
+				/**
+				 * \brief The route cache statistics.
+				 */
+				router::route_cache_statistics_type route_cache;
+
+				/**
+				 * \brief The latency of each stage of the core data path. The FSCP stages are in the server statistics.
+				 */
+				latency_statistics_type latency;
+			};
+
+			/**
+			 * \brief A statistics handler type.
+			 */
+			typedef boost::function<void (const statistics_type&)> statistics_handler_type;
+
+			/**
+			 * \brief A link test handler type.
+			 */
+			typedef link_test::handler_type link_test_handler_type;
+
 			// Public constants
 
 			/**
@@ -258,15 +370,24 @@ namespace freelan
 			 */
 			core(boost::asio::io_service& io_service, const freelan::configuration& configuration);
 
+			/**
+			 * \brief The destructor.
+			 *
+			 * Handles the pending log entries.
+			 */
+			~core();
+
 			/**
 			 * \brief Set the function to call when a log entry is emitted.
 			 * \param callback The callback.
 			 *
+			 * The callback is called from a dedicated thread, one entry at a time.
+			 *
 			 * \warning This method can only be called when the core is NOT running.
 			 */
 			void set_log_callback(log_handler_type callback)
 			{
-				m_logger.set_callback(callback);
+				m_log_callback = callback;
 			}
 
 			/**
@@ -382,11 +503,42 @@ namespace freelan
 			 */
 			void close();
 
+			/**
+			 * \brief Get the core statistics.
+			 * \param handler The handler to call with the statistics.
+			 *
+			 * The counters are updated on the data path without any synchronization: the snapshot is not consistent across counters.
+			 */
+			void async_get_statistics(statistics_handler_type handler);
+
+			/**
+			 * \brief Run a throughput and latency test with a host.
+			 * \param host The host, with which a session must be established.
+			 * \param parameters The test parameters.
+			 * \param handler The handler to call when the test completes.
+			 *
+			 * The test messages are sent on their own FSCP channel and never reach the tap adapter of the host, which must accept link tests.
+			 */
+			void async_run_link_test(const ep_type& host, const link_test_parameters& parameters, link_test_handler_type handler);
+
+#ifndef WINDOWS
+			/**
+			 * \brief Get the other end of the virtual tap adapter.
+			 * \return The virtual tap peer, or null if the tap adapter is not a virtual one or is not open.
+			 *
+			 * The virtual tap peer gives the replay and capture statistics.
+			 */
+			boost::shared_ptr<asiotap::virtual_tap_peer> virtual_tap_peer() const
+			{
+				return m_virtual_tap_peer;
+			}
+#endif
+
 		private:
 
 			boost::asio::io_service& m_io_service;
 			const freelan::configuration m_configuration;
-			boost::asio::strand m_logger_strand;
+			boost::shared_ptr<async_log_writer> m_log_writer;
 			freelan::logger m_logger;
 
 		private: /* Callbacks */
@@ -477,13 +629,13 @@ namespace freelan
 
 		private: /* TAP adapter */
 
-			typedef asiotap::osi::filter<asiotap::osi::ethernet_frame> ethernet_filter_type;
-			typedef asiotap::osi::complex_filter<asiotap::osi::arp_frame, asiotap::osi::ethernet_frame>::type arp_filter_type;
-			typedef asiotap::osi::complex_filter<asiotap::osi::ipv4_frame, asiotap::osi::ethernet_frame>::type ipv4_filter_type;
-			typedef asiotap::osi::complex_filter<asiotap::osi::udp_frame, asiotap::osi::ipv4_frame, asiotap::osi::ethernet_frame>::type udp_filter_type;
-			typedef asiotap::osi::complex_filter<asiotap::osi::bootp_frame, asiotap::osi::udp_frame, asiotap::osi::ipv4_frame, asiotap::osi::ethernet_frame>::type bootp_filter_type;
-			typedef asiotap::osi::complex_filter<asiotap::osi::dhcp_frame, asiotap::osi::bootp_frame, asiotap::osi::udp_frame, asiotap::osi::ipv4_frame, asiotap::osi::ethernet_frame>::type dhcp_filter_type;
+			typedef asiotap::osi::parser<asiotap::osi::ethernet_frame, asiotap::osi::arp_frame> arp_parser_type;
+			typedef asiotap::osi::parser<asiotap::osi::ethernet_frame, asiotap::osi::ipv4_frame, asiotap::osi::udp_frame, asiotap::osi::bootp_frame, asiotap::osi::dhcp_frame> dhcp_parser_type;
+			typedef asiotap::osi::const_helper<asiotap::osi::ethernet_frame> ethernet_helper_type;
 			typedef asiotap::osi::const_helper<asiotap::osi::arp_frame> arp_helper_type;
+			typedef asiotap::osi::const_helper<asiotap::osi::ipv4_frame> ipv4_helper_type;
+			typedef asiotap::osi::const_helper<asiotap::osi::udp_frame> udp_helper_type;
+			typedef asiotap::osi::const_helper<asiotap::osi::bootp_frame> bootp_helper_type;
 			typedef asiotap::osi::const_helper<asiotap::osi::dhcp_frame> dhcp_helper_type;
 			typedef asiotap::osi::proxy<asiotap::osi::arp_frame> arp_proxy_type;
 			typedef asiotap::osi::proxy<asiotap::osi::dhcp_frame> dhcp_proxy_type;
@@ -491,43 +643,98 @@ namespace freelan
 			typedef fscp::memory_pool<2048, 2> proxy_memory_pool;
 
 			void open_tap_adapter();
+#ifndef WINDOWS
+			void open_virtual_tap_adapter();
+#endif
 			void close_tap_adapter();
 
+			/**
+			 * \brief A pending write on a tap adapter queue.
+			 */
+			struct tap_write_type
+			{
+				tap_write_type(boost::asio::const_buffer _data, io_handler_type _handler, fscp::latency_stamp _stamp) :
+					data(_data),
+					handler(_handler),
+					stamp(_stamp)
+				{}
+
+				boost::asio::const_buffer data;
+				io_handler_type handler;
+				fscp::latency_stamp stamp;
+			};
+
+			/**
+			 * \brief A tap adapter queue.
+			 *
+			 * Each queue has its own read loop and write batch so that the queues are serviced in parallel.
+			 */
+			struct tap_adapter_queue_type
+			{
+				tap_adapter_queue_type(boost::asio::io_service& io_service, size_t _index) :
+					index(_index),
+					strand(io_service),
+					write_strand(io_service),
+					write_mutex(),
+					pending_writes(),
+					write_batch(),
+					write_scheduled(false)
+				{}
+
+				size_t index;
+				boost::asio::strand strand;
+				boost::asio::strand write_strand;
+				boost::mutex write_mutex;
+				std::vector<tap_write_type> pending_writes;
+				std::vector<tap_write_type> write_batch;
+				bool write_scheduled;
+			};
+
+			typedef boost::shared_ptr<tap_adapter_queue_type> tap_adapter_queue_ptr_type;
+
 			void async_get_tap_addresses(ip_network_address_list_handler_type);
 			void async_read_tap();
+			void async_read_tap(tap_adapter_queue_ptr_type);
 
-			template <typename ConstBufferSequence, typename WriteHandler>
-			void async_write_tap(const ConstBufferSequence& data, WriteHandler handler)
-			{
-				void_handler_type write_handler = [this, data, handler](){ m_tap_adapter->async_write(data, handler); };
+			void async_write_tap(boost::asio::const_buffer, io_handler_type);
 
-				m_tap_write_queue_strand.post(boost::bind(&core::push_tap_write, this, write_handler));
-			}
+			tap_adapter_queue_ptr_type get_tap_adapter_queue_for(boost::asio::const_buffer) const;
 
-			void push_tap_write(void_handler_type);
-			void pop_tap_write();
+			void flush_tap_writes(tap_adapter_queue_ptr_type);
 
-			void do_read_tap();
+			void do_read_tap(tap_adapter_queue_ptr_type);
 
-			void do_handle_tap_adapter_read(tap_adapter_memory_pool::shared_buffer_type, const boost::system::error_code&, size_t);
+			void do_handle_tap_adapter_read(tap_adapter_queue_ptr_type, tap_adapter_memory_pool::shared_buffer_type, const boost::system::error_code&, size_t);
+			void do_handle_tap_adapter_data(tap_adapter_memory_pool::shared_buffer_type, boost::asio::mutable_buffer);
+			void do_handle_tap_adapter_offloaded_frame(tap_adapter_memory_pool::shared_buffer_type, boost::asio::mutable_buffer);
+			void do_handle_tap_adapter_frame(tap_adapter_memory_pool::shared_buffer_type, boost::asio::const_buffer);
 			void do_handle_tap_adapter_write(const boost::system::error_code&);
-			void do_handle_arp_frame(const arp_helper_type&);
-			void do_handle_dhcp_frame(const dhcp_helper_type&);
+			void do_handle_arp_frame(ethernet_helper_type, arp_helper_type);
+			void do_handle_dhcp_frame(ethernet_helper_type, ipv4_helper_type, udp_helper_type, bootp_helper_type, dhcp_helper_type);
 			bool do_handle_arp_request(const boost::asio::ip::address_v4&, ethernet_address_type&);
 
 			boost::shared_ptr<asiotap::tap_adapter> m_tap_adapter;
+#ifndef WINDOWS
+			boost::shared_ptr<asiotap::virtual_tap_peer> m_virtual_tap_peer;
+#endif
 			boost::asio::strand m_tap_adapter_strand;
-			boost::asio::strand m_proxies_strand;
 			tap_adapter_memory_pool m_tap_adapter_memory_pool;
-			std::queue<void_handler_type> m_tap_write_queue;
-			boost::asio::strand m_tap_write_queue_strand;
+			std::vector<tap_adapter_queue_ptr_type> m_tap_adapter_queues;
+			const size_t m_tcp_mss_clamping_mtu;
+			fscp::traffic_counter m_tap_adapter_read;
+			fscp::traffic_counter m_tap_adapter_written;
+			fscp::statistics_counter m_tap_adapter_write_queue_depth;
+
+			struct latency_histograms_type
+			{
+				fscp::latency_histogram send_forwarding;
+				fscp::latency_histogram receive_forwarding;
+				fscp::latency_histogram receive_tap_write_queue;
+				fscp::latency_histogram receive_tap_write;
+			};
 
-			ethernet_filter_type m_ethernet_filter;
-			arp_filter_type m_arp_filter;
-			ipv4_filter_type m_ipv4_filter;
-			udp_filter_type m_udp_filter;
-			bootp_filter_type m_bootp_filter;
-			dhcp_filter_type m_dhcp_filter;
+			fscp::latency_sampler m_latency_sampler;
+			latency_histograms_type m_latency;
 
 			boost::scoped_ptr<arp_proxy_type> m_arp_proxy;
 			boost::scoped_ptr<dhcp_proxy_type> m_dhcp_proxy;
@@ -587,24 +794,14 @@ namespace freelan
 				m_router_strand.post(boost::bind(&core::do_clear_client_router_info, this, host, handler));
 			}
 
-			template <typename WriteHandler>
-			void async_write_switch(const port_index_type& index, boost::asio::const_buffer data, WriteHandler handler)
-			{
-				m_router_strand.post(boost::bind(&core::do_write_switch, this, index, data, handler));
-			}
-
-			template <typename WriteHandler>
-			void async_write_router(const port_index_type& index, boost::asio::const_buffer data, WriteHandler handler)
-			{
-				m_router_strand.post(boost::bind(&core::do_write_router, this, index, data, handler));
-			}
-
 			void do_register_switch_port(const ep_type&, void_handler_type);
 			void do_register_router_port(const ep_type&, void_handler_type);
 			void do_unregister_switch_port(const ep_type&, void_handler_type);
 			void do_unregister_router_port(const ep_type&, void_handler_type);
 			void do_save_system_route(const ep_type&, const route_type&, void_handler_type);
 			void do_clear_client_router_info(const ep_type&, void_handler_type);
+
+			// The switch and the router can forward frames from any thread: only their updates go through m_router_strand.
 			void do_write_switch(const port_index_type&, boost::asio::const_buffer, switch_::multi_write_handler_type);
 			void do_write_router(const port_index_type&, boost::asio::const_buffer, router::port_type::write_handler_type);
 
@@ -615,6 +812,42 @@ namespace freelan
 			asiotap::route_manager m_route_manager;
 			boost::optional<routes_message::version_type> m_local_routes_version;
 			client_router_info_map_type m_client_router_info_map;
+
+		private: /* Link tests */
+
+			struct link_test_sink_type
+			{
+				link_test_sink_type() :
+					test_id(),
+					received_packets(0),
+					received_bytes(0),
+					highest_sequence(0),
+					reordered_packets(0)
+				{}
+
+				boost::optional<link_test_message::test_id_type> test_id;
+				uint64_t received_packets;
+				uint64_t received_bytes;
+				uint64_t highest_sequence;
+				uint64_t reordered_packets;
+			};
+
+			typedef std::map<link_test_message::test_id_type, std::pair<ep_type, boost::shared_ptr<link_test> > > link_test_map_type;
+			typedef std::map<ep_type, link_test_sink_type> link_test_sink_map_type;
+
+			void do_handle_link_test_message(const ep_type&, fscp::server::shared_buffer_type, boost::asio::const_buffer);
+			void do_run_link_test(const ep_type&, const link_test_parameters&, link_test_handler_type);
+			void do_handle_link_test_response(const ep_type&, fscp::server::shared_buffer_type, boost::asio::const_buffer);
+			void do_handle_link_test_data(const ep_type&, link_test_message::test_id_type, uint64_t, size_t);
+			void do_handle_link_test_report_request(const ep_type&, link_test_message::test_id_type);
+			void do_cancel_link_tests(const boost::optional<ep_type>&, const boost::system::error_code&);
+
+			boost::asio::strand m_link_test_strand;
+
+			// The following members are only accessed from m_link_test_strand.
+			link_test_message::test_id_type m_next_link_test_id;
+			link_test_map_type m_link_tests;
+			link_test_sink_map_type m_link_test_sinks;
 	};
 }
 
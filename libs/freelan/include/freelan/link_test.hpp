@@ -0,0 +1,320 @@
+/*
+ * libfreelan - A C++ library to establish peer-to-peer virtual private
+ * networks.
+ * Copyright (C) 2010-2011 Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libfreelan.
+ *
+ * libfreelan is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libfreelan is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libfreelan in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+
+/**
+ * \file link_test.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief A throughput and latency test over an established session.
+ */
+
+#ifndef FREELAN_LINK_TEST_HPP
+#define FREELAN_LINK_TEST_HPP
+
+#include "link_test_message.hpp"
+
+#include <fscp/latency.hpp>
+
+#include <boost/asio.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/optional.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <iostream>
+#include <vector>
+
+namespace freelan
+{
+	/**
+	 * \brief The way the far end of a link test handles the data messages.
+	 */
+	enum class link_test_mode
+	{
+		/**
+		 * \brief The far end counts the data messages and reports its counters at the end of the test. The round-trip time is measured with small probes sent alongside the data messages.
+		 */
+		sink,
+
+		/**
+		 * \brief The far end sends every data message back. The data messages themselves measure the round-trip time.
+		 */
+		echo
+	};
+
+	std::ostream& operator<<(std::ostream& os, link_test_mode value);
+	std::istream& operator>>(std::istream& is, link_test_mode& value);
+
+	/**
+	 * \brief The parameters of a link test.
+	 */
+	struct link_test_parameters
+	{
+		link_test_parameters() :
+			mode(link_test_mode::sink),
+			duration(boost::posix_time::seconds(10)),
+			payload_size(1400),
+			window(64)
+		{}
+
+		/**
+		 * \brief The test mode.
+		 */
+		link_test_mode mode;
+
+		/**
+		 * \brief How long data messages are sent.
+		 */
+		boost::posix_time::time_duration duration;
+
+		/**
+		 * \brief The size of each data message, between link_test::MIN_PAYLOAD_SIZE and link_test::MAX_PAYLOAD_SIZE.
+		 */
+		size_t payload_size;
+
+		/**
+		 * \brief The count of data messages in flight. In sink mode, a message is in flight until it was written to the socket. In echo mode, until it was echoed.
+		 */
+		unsigned int window;
+	};
+
+	/**
+	 * \brief The result of a link test.
+	 */
+	struct link_test_result
+	{
+		link_test_result() :
+			mode(link_test_mode::sink),
+			payload_size(0),
+			duration(),
+			sent_packets(0),
+			sent_bytes(0),
+			received_packets(0),
+			received_bytes(0),
+			lost_packets(0),
+			reordered_packets(0),
+			round_trip_time()
+		{}
+
+		/**
+		 * \brief The test mode.
+		 */
+		link_test_mode mode;
+
+		/**
+		 * \brief The size of each data message.
+		 */
+		size_t payload_size;
+
+		/**
+		 * \brief The time during which data messages were sent.
+		 */
+		fscp::latency_clock::duration duration;
+
+		/**
+		 * \brief The count of data messages sent.
+		 */
+		uint64_t sent_packets;
+
+		/**
+		 * \brief The count of data bytes sent.
+		 */
+		uint64_t sent_bytes;
+
+		/**
+		 * \brief The count of data messages that reached the far end (sink) or came back (echo).
+		 */
+		uint64_t received_packets;
+
+		/**
+		 * \brief The count of data bytes that reached the far end (sink) or came back (echo).
+		 */
+		uint64_t received_bytes;
+
+		/**
+		 * \brief The count of data messages missing from the received sequence numbers.
+		 */
+		uint64_t lost_packets;
+
+		/**
+		 * \brief The count of data messages received after a message with a higher sequence number.
+		 */
+		uint64_t reordered_packets;
+
+		/**
+		 * \brief The round-trip time distribution.
+		 */
+		fscp::latency_histogram_snapshot round_trip_time;
+	};
+
+	/**
+	 * \brief The sending end of a link test.
+	 *
+	 * A link test sends data messages to a host for a given duration, then computes the goodput, the loss and the round-trip time distribution from the answers of the host.
+	 *
+	 * All the methods can be called from any thread.
+	 */
+	class link_test : public boost::enable_shared_from_this<link_test>, private boost::noncopyable
+	{
+		public:
+
+			/**
+			 * \brief A simple operation handler.
+			 */
+			typedef boost::function<void (const boost::system::error_code&)> simple_handler_type;
+
+			/**
+			 * \brief The function that sends a message to the host. The buffer must be kept alive until the handler is called.
+			 */
+			typedef boost::function<void (boost::asio::const_buffer, simple_handler_type)> send_function_type;
+
+			/**
+			 * \brief The completion handler. The result is meaningful even when the test fails.
+			 */
+			typedef boost::function<void (const boost::system::error_code&, const link_test_result&)> handler_type;
+
+			/**
+			 * \brief The minimum payload size.
+			 */
+			static const size_t MIN_PAYLOAD_SIZE = link_test_message::HEADER_LENGTH;
+
+			/**
+			 * \brief The maximum payload size.
+			 */
+			static const size_t MAX_PAYLOAD_SIZE = 16384;
+
+			/**
+			 * \brief Create a link test.
+			 * \param io_service The io_service to use.
+			 * \param test_id The test identifier, unique among the tests run by this host.
+			 * \param parameters The parameters.
+			 * \param send_function The function that sends a message to the host.
+			 */
+			link_test(boost::asio::io_service& io_service, link_test_message::test_id_type test_id, const link_test_parameters& parameters, send_function_type send_function);
+
+			/**
+			 * \brief Get the test identifier.
+			 * \return The test identifier.
+			 */
+			link_test_message::test_id_type test_id() const
+			{
+				return m_test_id;
+			}
+
+			/**
+			 * \brief Start the test.
+			 * \param handler The handler to call when the test completes.
+			 */
+			void start(handler_type handler);
+
+			/**
+			 * \brief Stop the test early.
+			 * \param ec The error to report.
+			 */
+			void cancel(const boost::system::error_code& ec);
+
+			/**
+			 * \brief Handle a message received from the host for this test.
+			 * \param message The message. It does not need to outlive the call.
+			 */
+			void handle_message(const link_test_message& message);
+
+		private:
+
+			enum class phase_type
+			{
+				sending,
+				draining,
+				reporting,
+				done
+			};
+
+			struct report_type
+			{
+				uint64_t received_packets;
+				uint64_t received_bytes;
+				uint64_t reordered_packets;
+			};
+
+			void schedule_tick();
+			void do_tick(const boost::system::error_code&);
+			void do_fill();
+			void do_send_data();
+			void do_send_probe();
+			void do_send_report_request();
+			void do_handle_sent(size_t, const boost::system::error_code&);
+			void do_handle_control_sent(const boost::system::error_code&);
+			void do_handle_echo_response(uint64_t, uint64_t, size_t);
+			void do_handle_report(const report_type&);
+			void do_finish(const boost::system::error_code&);
+
+			boost::asio::io_service::strand m_strand;
+			boost::asio::deadline_timer m_timer;
+			const link_test_message::test_id_type m_test_id;
+			const link_test_parameters m_parameters;
+			send_function_type m_send_function;
+			handler_type m_handler;
+
+			// The following members are only accessed from m_strand.
+			phase_type m_phase;
+			std::vector<std::vector<uint8_t> > m_buffers;
+			std::vector<size_t> m_free_buffers;
+			std::vector<uint8_t> m_control_buffer;
+			bool m_control_buffer_busy;
+			fscp::latency_clock::time_point m_start;
+			fscp::latency_clock::time_point m_stop;
+			fscp::latency_clock::time_point m_phase_deadline;
+			fscp::latency_clock::time_point m_last_control;
+			fscp::latency_clock::time_point m_last_progress;
+			uint64_t m_sent_packets;
+			uint64_t m_sent_bytes;
+			uint64_t m_probe_sequence;
+			unsigned int m_in_flight;
+			uint64_t m_received_packets;
+			uint64_t m_received_bytes;
+			uint64_t m_highest_sequence;
+			uint64_t m_reordered_packets;
+			boost::optional<report_type> m_report;
+			fscp::latency_histogram m_round_trip_time;
+	};
+}
+
+#endif /* FREELAN_LINK_TEST_HPP */
@@ -0,0 +1,203 @@
+/*
+ * libfreelan - A C++ library to establish peer-to-peer virtual private
+ * networks.
+ * Copyright (C) 2010-2011 Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libfreelan.
+ *
+ * libfreelan is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libfreelan is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libfreelan in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+
+/**
+ * \file link_test_message.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief The link test messages exchanged by the peers.
+ */
+
+#ifndef FREELAN_LINK_TEST_MESSAGE_HPP
+#define FREELAN_LINK_TEST_MESSAGE_HPP
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace freelan
+{
+	/**
+	 * \brief A link test message.
+	 *
+	 * Link test messages are sent on their own FSCP channel so that they never reach the tap adapter. Each one starts with a type, the identifier of the test, a sequence number and a timestamp. Data and echo messages are then padded to the tested payload size while report messages carry the counters of the receiver.
+	 *
+	 * All the fields are in network byte order. The timestamp is only meaningful to the host that sent the original message.
+	 */
+	class link_test_message
+	{
+		public:
+
+			/**
+			 * \brief The message type.
+			 */
+			enum message_type
+			{
+				MT_DATA = 0x01,
+				MT_ECHO_REQUEST = 0x02,
+				MT_ECHO_RESPONSE = 0x03,
+				MT_REPORT_REQUEST = 0x04,
+				MT_REPORT = 0x05
+			};
+
+			/**
+			 * \brief The test identifier type.
+			 */
+			typedef uint32_t test_id_type;
+
+			/**
+			 * \brief The length of the header.
+			 */
+			static const size_t HEADER_LENGTH = sizeof(uint8_t) + sizeof(test_id_type) + sizeof(uint64_t) + sizeof(uint64_t);
+
+			/**
+			 * \brief The length of a report message.
+			 */
+			static const size_t REPORT_LENGTH = HEADER_LENGTH + 4 * sizeof(uint64_t);
+
+			/**
+			 * \brief Write a link test message to a buffer.
+			 * \param buf The buffer to write to.
+			 * \param buf_len The length of buf.
+			 * \param type The message type.
+			 * \param test_id The test identifier.
+			 * \param sequence The sequence number.
+			 * \param timestamp The timestamp.
+			 * \param size The total size of the message. The bytes after the header are left untouched.
+			 * \return The count of bytes written.
+			 */
+			static size_t write(void* buf, size_t buf_len, message_type type, test_id_type test_id, uint64_t sequence, uint64_t timestamp, size_t size);
+
+			/**
+			 * \brief Write a report message to a buffer.
+			 * \param buf The buffer to write to.
+			 * \param buf_len The length of buf.
+			 * \param test_id The test identifier.
+			 * \param received_packets The count of data messages received.
+			 * \param received_bytes The count of data bytes received.
+			 * \param highest_sequence The highest sequence number received.
+			 * \param reordered_packets The count of data messages received after a message with a higher sequence number.
+			 * \return The count of bytes written.
+			 */
+			static size_t write_report(void* buf, size_t buf_len, test_id_type test_id, uint64_t received_packets, uint64_t received_bytes, uint64_t highest_sequence, uint64_t reordered_packets);
+
+			/**
+			 * \brief Change the type of a message in place.
+			 * \param buf The message buffer, which must contain a valid message.
+			 * \param type The new type.
+			 *
+			 * This is how an echo request is turned into its response without copying it.
+			 */
+			static void set_type(void* buf, message_type type);
+
+			/**
+			 * \brief Create a link_test_message and map it on a buffer.
+			 * \param buf The buffer.
+			 * \param buf_len The buffer length.
+			 *
+			 * If the mapping fails, a std::runtime_error is thrown.
+			 */
+			link_test_message(const void* buf, size_t buf_len);
+
+			/**
+			 * \brief Get the type.
+			 * \return The type.
+			 */
+			message_type type() const;
+
+			/**
+			 * \brief Get the test identifier.
+			 * \return The test identifier.
+			 */
+			test_id_type test_id() const;
+
+			/**
+			 * \brief Get the sequence number.
+			 * \return The sequence number.
+			 */
+			uint64_t sequence() const;
+
+			/**
+			 * \brief Get the timestamp.
+			 * \return The timestamp.
+			 */
+			uint64_t timestamp() const;
+
+			/**
+			 * \brief Get the total size of the message.
+			 * \return The total size of the message, padding included.
+			 */
+			size_t size() const
+			{
+				return m_size;
+			}
+
+			/**
+			 * \brief Get the count of data messages received, from a report message.
+			 * \return The count of data messages received.
+			 */
+			uint64_t received_packets() const;
+
+			/**
+			 * \brief Get the count of data bytes received, from a report message.
+			 * \return The count of data bytes received.
+			 */
+			uint64_t received_bytes() const;
+
+			/**
+			 * \brief Get the highest sequence number received, from a report message.
+			 * \return The highest sequence number received.
+			 */
+			uint64_t highest_sequence() const;
+
+			/**
+			 * \brief Get the count of reordered data messages, from a report message.
+			 * \return The count of reordered data messages.
+			 */
+			uint64_t reordered_packets() const;
+
+		private:
+
+			uint64_t get_uint64(size_t offset) const;
+
+			const uint8_t* m_data;
+			size_t m_size;
+	};
+}
+
+#endif /* FREELAN_LINK_TEST_MESSAGE_HPP */
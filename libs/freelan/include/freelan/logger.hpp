@@ -47,7 +47,8 @@
 #define LOGGER_HPP
 
 #include <iostream>
-#include <sstream>
+#include <streambuf>
+#include <string>
 
 #include <boost/shared_ptr.hpp>
 #include <boost/make_shared.hpp>
@@ -58,6 +59,7 @@
 namespace freelan
 {
 	class logger;
+	class async_log_writer;
 
 	/**
 	 * \brief Log level type.
@@ -78,6 +80,110 @@ namespace freelan
 	 */
 	class null_logger_stream {};
 
+	/**
+	 * \brief A reusable formatting buffer.
+	 *
+	 * Each thread owns one formatter, so that formatting a log entry does not allocate once the buffer has grown to its working size.
+	 */
+	class log_formatter
+	{
+		public:
+
+			/**
+			 * \brief Acquire the formatter of the calling thread.
+			 * \return A formatter, with an empty buffer and the default stream state.
+			 *
+			 * If the formatter of the calling thread is already in use (for instance when a streamed value logs something itself), a new formatter is allocated instead.
+			 */
+			static log_formatter* acquire();
+
+			/**
+			 * \brief Release a formatter.
+			 * \param formatter The formatter, as returned by acquire().
+			 */
+			static void release(log_formatter* formatter);
+
+			/**
+			 * \brief Get the formatting stream.
+			 * \return The formatting stream.
+			 */
+			std::ostream& stream()
+			{
+				return m_stream;
+			}
+
+			/**
+			 * \brief Get the formatted message.
+			 * \return The formatted message. It is not null-terminated.
+			 */
+			const char* data() const
+			{
+				return m_buffer.data();
+			}
+
+			/**
+			 * \brief Get the size of the formatted message.
+			 * \return The size of the formatted message.
+			 */
+			size_t size() const
+			{
+				return m_buffer.size();
+			}
+
+		private:
+
+			class buffer_type : public std::streambuf
+			{
+				public:
+
+					const char* data() const
+					{
+						return m_data.data();
+					}
+
+					size_t size() const
+					{
+						return m_data.size();
+					}
+
+					void clear()
+					{
+						m_data.clear();
+					}
+
+				protected:
+
+					int_type overflow(int_type ch)
+					{
+						if (!traits_type::eq_int_type(ch, traits_type::eof()))
+						{
+							m_data.push_back(traits_type::to_char_type(ch));
+						}
+
+						return traits_type::not_eof(ch);
+					}
+
+					std::streamsize xsputn(const char* s, std::streamsize n)
+					{
+						m_data.append(s, static_cast<size_t>(n));
+
+						return n;
+					}
+
+				private:
+
+					std::string m_data;
+			};
+
+			log_formatter();
+
+			void reset();
+
+			buffer_type m_buffer;
+			std::ostream m_stream;
+			bool m_in_use;
+	};
+
 	/**
 	 * \brief A string logger stream.
 	 */
@@ -92,9 +198,22 @@ namespace freelan
 			 */
 			string_logger_stream(const logger& logger_, log_level level_) :
 				m_logger(logger_),
-				m_level(level_)
+				m_level(level_),
+				m_formatter(NULL)
 			{}
 
+			/**
+			 * \brief Copy a string logger stream.
+			 * \param other The stream to copy. Its pending message, if any, is transferred to the new instance.
+			 */
+			string_logger_stream(const string_logger_stream& other) :
+				m_logger(other.m_logger),
+				m_level(other.m_level),
+				m_formatter(other.m_formatter)
+			{
+				other.m_formatter = NULL;
+			}
+
 			/**
 			 * \brief Destroy the string logger.
 			 */
@@ -107,12 +226,12 @@ namespace freelan
 			template <typename Type>
 			string_logger_stream& operator<<(const Type& value)
 			{
-				if (!m_oss)
+				if (!m_formatter)
 				{
-					m_oss = boost::make_shared<std::ostringstream>();
+					m_formatter = log_formatter::acquire();
 				}
 
-				(*m_oss) << value;
+				m_formatter->stream() << value;
 
 				return *this;
 			}
@@ -121,7 +240,7 @@ namespace freelan
 
 			const logger& m_logger;
 			log_level m_level;
-			boost::shared_ptr<std::ostringstream> m_oss;
+			mutable log_formatter* m_formatter;
 	};
 
 	/**
@@ -306,7 +425,20 @@ namespace freelan
 			 */
 			logger(log_handler_type handler = log_handler_type(), log_level _level = LL_INFORMATION) :
 				m_handler(handler),
-				m_level(_level)
+				m_level(_level),
+				m_writer()
+			{
+			}
+
+			/**
+			 * \brief Create a new logger that writes its entries asynchronously.
+			 * \param writer The writer that will receive the log entries. Any callback set on the logger is then ignored.
+			 * \param _level The desired log level of the logger. Any logging below that level will be silently ignored.
+			 */
+			logger(boost::shared_ptr<async_log_writer> writer, log_level _level = LL_INFORMATION) :
+				m_handler(),
+				m_level(_level),
+				m_writer(writer)
 			{
 			}
 
@@ -348,6 +480,18 @@ namespace freelan
 				return m_level;
 			}
 
+			/**
+			 * \brief Check whether a log level is enabled.
+			 * \param level_ The log level.
+			 * \return true if entries of that level are to be written.
+			 *
+			 * Use this to skip the computation of expensive log arguments.
+			 */
+			bool is_enabled(log_level level_) const
+			{
+				return (level_ >= m_level);
+			}
+
 			/**
 			 * \brief Get a logger stream.
 			 * \param level_ The log level.
@@ -355,7 +499,7 @@ namespace freelan
 			 */
 			stream_type operator()(log_level level_) const
 			{
-				if (level_ >= m_level)
+				if (is_enabled(level_))
 				{
 					return logger_stream_impl(string_logger_stream(*this, level_));
 				}
@@ -373,27 +517,41 @@ namespace freelan
 			 */
 			void log(log_level level_, const std::string& msg, timestamp_type timestamp = boost::posix_time::microsec_clock::universal_time()) const
 			{
-				if (m_handler && (level_ >= m_level))
+				if (m_writer)
+				{
+					log(level_, msg.data(), msg.size(), timestamp);
+				}
+				else if (m_handler && is_enabled(level_))
 				{
 					m_handler(level_, msg, timestamp);
 				}
 			}
 
+			/**
+			 * \brief Log the specified message.
+			 * \param level_ The log level.
+			 * \param msg The message to log. It does not need to be null-terminated.
+			 * \param msg_len The length of msg.
+			 * \param timestamp The timestamp.
+			 */
+			void log(log_level level_, const char* msg, size_t msg_len, timestamp_type timestamp = boost::posix_time::microsec_clock::universal_time()) const;
+
 		private:
 
 			log_handler_type m_handler;
 			log_level m_level;
+			boost::shared_ptr<async_log_writer> m_writer;
 	};
 
 	inline string_logger_stream::~string_logger_stream()
 	{
-		if (m_oss)
+		if (m_formatter)
 		{
-			(*m_oss) << std::flush;
+			m_formatter->stream() << std::flush;
 
-			const std::string msg = (*m_oss).str();
+			m_logger.log(m_level, m_formatter->data(), m_formatter->size());
 
-			m_logger.log(m_level, msg);
+			log_formatter::release(m_formatter);
 		}
 	}
 }
@@ -0,0 +1,162 @@
+/*
+ * libfreelan - A C++ library to establish peer-to-peer virtual private
+ * networks.
+ * Copyright (C) 2010-2011 Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libfreelan.
+ *
+ * libfreelan is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libfreelan is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libfreelan in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file per_thread.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief A value of which each thread gets its own instance.
+ */
+
+#ifndef PER_THREAD_HPP
+#define PER_THREAD_HPP
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace freelan
+{
+	namespace detail
+	{
+		/**
+		 * \brief Allocate an identifier for a per_thread instance.
+		 * \return An identifier that was never returned before.
+		 */
+		uint64_t allocate_per_thread_id();
+
+		/**
+		 * \brief Get the value the current thread registered for an identifier.
+		 * \param id The identifier.
+		 * \return The value, or null if the current thread did not register any.
+		 */
+		void* get_per_thread_value(uint64_t id);
+
+		/**
+		 * \brief Register the value of the current thread for an identifier.
+		 * \param id The identifier.
+		 * \param owner The value owner, only used to forget about the value once it is destroyed.
+		 * \param value The value.
+		 */
+		void set_per_thread_value(uint64_t id, const boost::weak_ptr<void>& owner, void* value);
+	}
+
+	/**
+	 * \brief A value of which each thread gets its own instance.
+	 * \tparam ValueType The value type. Must be default constructible.
+	 *
+	 * Unlike boost::thread_specific_ptr, which identifies its values by its own address, the instances of a thread are found through an identifier that is never reused: a per_thread built where a destroyed one used to be never sees the instances of the latter.
+	 *
+	 * The instances are owned by the per_thread and destroyed with it.
+	 */
+	template <typename ValueType>
+	class per_thread : public boost::noncopyable
+	{
+		public:
+
+			/**
+			 * \brief The value type.
+			 */
+			typedef ValueType value_type;
+
+			/**
+			 * \brief Create a per_thread value.
+			 */
+			per_thread() :
+				m_id(detail::allocate_per_thread_id()),
+				m_mutex(),
+				m_values()
+			{}
+
+			/**
+			 * \brief Get the instance of the current thread.
+			 * \return The instance of the current thread, default constructed the first time.
+			 */
+			value_type& get()
+			{
+				value_type* value = static_cast<value_type*>(detail::get_per_thread_value(m_id));
+
+				if (!value)
+				{
+					const boost::shared_ptr<value_type> new_value = boost::make_shared<value_type>();
+
+					{
+						boost::mutex::scoped_lock lock(m_mutex);
+
+						m_values.push_back(new_value);
+					}
+
+					value = new_value.get();
+					detail::set_per_thread_value(m_id, new_value, value);
+				}
+
+				return *value;
+			}
+
+			/**
+			 * \brief Call a handler on the instances of all threads.
+			 * \param handler The handler, called with a const reference to each instance.
+			 *
+			 * The instances may be in use by their threads at the same time: the handler must only read what is safe to read concurrently.
+			 */
+			template <typename Handler>
+			void for_each(Handler handler) const
+			{
+				boost::mutex::scoped_lock lock(m_mutex);
+
+				for (auto&& value : m_values)
+				{
+					handler(static_cast<const value_type&>(*value));
+				}
+			}
+
+		private:
+
+			const uint64_t m_id;
+			mutable boost::mutex m_mutex;
+			std::vector<boost::shared_ptr<value_type> > m_values;
+	};
+}
+
+#endif /* PER_THREAD_HPP */
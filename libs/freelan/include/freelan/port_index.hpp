@@ -149,7 +149,7 @@ namespace freelan
 			 * \brief Get the associated tap adapter.
 			 * \return The associated tap adapter.
 			 */
-			fscp::server::ep_type endpoint() const { return m_ep; }
+			const fscp::server::ep_type& endpoint() const { return m_ep; }
 
 			friend bool operator<(const endpoint_port_index_type& lhs, const endpoint_port_index_type& rhs)
 			{
@@ -185,6 +185,18 @@ namespace freelan
 	{
 		return endpoint_port_index_type(ep);
 	}
+
+	/**
+	 * \brief Get the endpoint a port index designates.
+	 * \param index The port index.
+	 * \return The endpoint, or NULL if the port index does not designate an endpoint.
+	 */
+	inline const fscp::server::ep_type* port_index_endpoint(const port_index_type& index)
+	{
+		const endpoint_port_index_type* const endpoint_index = boost::get<endpoint_port_index_type>(&index);
+
+		return endpoint_index ? &endpoint_index->endpoint() : NULL;
+	}
 }
 
 #endif /* PORT_INDEX_HPP */
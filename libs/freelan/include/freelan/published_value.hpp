@@ -0,0 +1,209 @@
+/*
+ * libfreelan - A C++ library to establish peer-to-peer virtual private
+ * networks.
+ * Copyright (C) 2010-2011 Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libfreelan.
+ *
+ * libfreelan is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libfreelan is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libfreelan in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+
+/**
+ * \file published_value.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief A value published to many reader threads.
+ */
+
+#ifndef PUBLISHED_VALUE_HPP
+#define PUBLISHED_VALUE_HPP
+
+#include <atomic>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "per_thread.hpp"
+
+namespace freelan
+{
+	/**
+	 * \brief An immutable value that is replaced as a whole and read from any number of threads.
+	 * \tparam ValueType The value type.
+	 *
+	 * Each reader thread keeps its own reference to the current value and only refreshes it when a new value was published: in the steady state, reading costs a single atomic load of the generation and touches no shared reference count.
+	 *
+	 * Refreshing is not lock-free: the first read of each thread after a publish takes the writer lock, once, to copy the new reference.
+	 *
+	 * A thread that stops reading keeps its last value alive until it reads again or until the published_value is destroyed.
+	 */
+	template <typename ValueType>
+	class published_value : public boost::noncopyable
+	{
+		public:
+
+			/**
+			 * \brief The value type.
+			 */
+			typedef ValueType value_type;
+
+			/**
+			 * \brief The pointer type.
+			 */
+			typedef boost::shared_ptr<const value_type> pointer_type;
+
+			/**
+			 * \brief Gives access to the current value for the lifetime of the reader.
+			 *
+			 * Readers may be nested: the inner ones see the same value as the outermost one.
+			 */
+			class reader : public boost::noncopyable
+			{
+				public:
+
+					/**
+					 * \brief Create a reader.
+					 * \param value The published value to read.
+					 */
+					explicit reader(published_value& value) :
+						m_slot(value.acquire_slot())
+					{}
+
+					/**
+					 * \brief Destructor.
+					 */
+					~reader()
+					{
+						--m_slot.readers;
+					}
+
+					/**
+					 * \brief Get the value.
+					 * \return The value.
+					 */
+					const value_type& operator*() const
+					{
+						return *m_slot.value;
+					}
+
+					/**
+					 * \brief Get the value.
+					 * \return The value.
+					 */
+					const value_type* operator->() const
+					{
+						return m_slot.value.get();
+					}
+
+				private:
+
+					typename published_value::slot_type& m_slot;
+			};
+
+			/**
+			 * \brief Create a published value.
+			 * \param value The initial value. Cannot be null.
+			 */
+			explicit published_value(pointer_type value) :
+				m_mutex(),
+				m_value(value),
+				m_generation(1),
+				m_slots()
+			{}
+
+			/**
+			 * \brief Get the current value.
+			 * \return The current value.
+			 *
+			 * Unlike a reader, this takes a lock: it is meant for the writers.
+			 */
+			pointer_type load() const
+			{
+				boost::mutex::scoped_lock lock(m_mutex);
+
+				return m_value;
+			}
+
+			/**
+			 * \brief Publish a new value.
+			 * \param value The new value. Cannot be null.
+			 *
+			 * Readers that exist while this is called keep using the previous value.
+			 */
+			void publish(pointer_type value)
+			{
+				boost::mutex::scoped_lock lock(m_mutex);
+
+				m_value = value;
+				m_generation.fetch_add(1, std::memory_order_release);
+			}
+
+		private:
+
+			struct slot_type
+			{
+				slot_type() :
+					generation(0),
+					readers(0),
+					value()
+				{}
+
+				uint64_t generation;
+				unsigned int readers;
+				pointer_type value;
+			};
+
+			slot_type& acquire_slot()
+			{
+				slot_type* const slot = &m_slots.get();
+
+				// A nested reader must not release the value the outer ones still use.
+				if ((slot->readers++ == 0) && (slot->generation != m_generation.load(std::memory_order_acquire)))
+				{
+					boost::mutex::scoped_lock lock(m_mutex);
+
+					slot->value = m_value;
+					slot->generation = m_generation.load(std::memory_order_relaxed);
+				}
+
+				return *slot;
+			}
+
+			mutable boost::mutex m_mutex;
+			pointer_type m_value;
+			std::atomic<uint64_t> m_generation;
+			per_thread<slot_type> m_slots;
+	};
+}
+
+#endif /* PUBLISHED_VALUE_HPP */
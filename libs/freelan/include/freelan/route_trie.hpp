@@ -0,0 +1,395 @@
+/*
+ * libfreelan - A C++ library to establish peer-to-peer virtual private
+ * networks.
+ * Copyright (C) 2010-2011 Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libfreelan.
+ *
+ * libfreelan is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libfreelan is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libfreelan in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file route_trie.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief A path-compressed prefix trie for IP routes.
+ */
+
+#ifndef ROUTE_TRIE_HPP
+#define ROUTE_TRIE_HPP
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <asiotap/types/ip_network_address.hpp>
+
+namespace freelan
+{
+	/**
+	 * \brief A path-compressed binary trie (Patricia trie) that maps IP network prefixes to values.
+	 * \tparam AddressType The address type.
+	 * \tparam ValueType The value type. Must be less-than comparable.
+	 *
+	 * Several values can be attached to the same prefix: they are kept sorted.
+	 *
+	 * A lookup visits at most one node per bit of prefix and never allocates memory.
+	 *
+	 * The nodes are immutable once inserted: copies of a trie share them, and a change only copies the nodes on the path to the changed prefix.
+	 */
+	template <typename AddressType, typename ValueType>
+	class route_trie
+	{
+		public:
+
+			/**
+			 * \brief The address type.
+			 */
+			typedef AddressType address_type;
+
+			/**
+			 * \brief The network address type.
+			 */
+			typedef asiotap::base_ip_network_address<address_type> network_address_type;
+
+			/**
+			 * \brief The value type.
+			 */
+			typedef ValueType value_type;
+
+			/**
+			 * \brief The list of values attached to a prefix.
+			 */
+			typedef std::vector<value_type> value_list_type;
+
+			/**
+			 * \brief The maximum prefix length.
+			 */
+			static const unsigned int max_prefix_length = network_address_type::single_address_prefix_length;
+
+			/**
+			 * \brief Create an empty trie.
+			 */
+			route_trie() :
+				m_root(),
+				m_size(0)
+			{}
+
+			/**
+			 * \brief Check if the trie is empty.
+			 * \return true if the trie contains no value.
+			 */
+			bool empty() const
+			{
+				return (m_size == 0);
+			}
+
+			/**
+			 * \brief Get the number of values in the trie.
+			 * \return The number of values in the trie.
+			 */
+			size_t size() const
+			{
+				return m_size;
+			}
+
+			/**
+			 * \brief Remove all the values from the trie.
+			 */
+			void clear()
+			{
+				m_root.reset();
+				m_size = 0;
+			}
+
+			/**
+			 * \brief Attach a value to a network prefix.
+			 * \param network The network prefix.
+			 * \param value The value.
+			 *
+			 * If an equivalent value is already attached to the prefix, it is replaced.
+			 */
+			void insert(const network_address_type& network, const value_type& value)
+			{
+				const bytes_type key = network.address().to_bytes();
+				const unsigned int length = std::min<unsigned int>(network.prefix_length(), max_prefix_length);
+
+				m_root = insert_into(m_root, key, length, value);
+			}
+
+			/**
+			 * \brief Detach a value from a network prefix.
+			 * \param network The network prefix.
+			 * \param value The value.
+			 * \return true if the value was found and removed.
+			 */
+			bool erase(const network_address_type& network, const value_type& value)
+			{
+				const bytes_type key = network.address().to_bytes();
+				const unsigned int length = std::min<unsigned int>(network.prefix_length(), max_prefix_length);
+
+				bool erased = false;
+
+				m_root = erase_from(m_root, key, length, value, erased);
+
+				return erased;
+			}
+
+			/**
+			 * \brief Visit the prefixes that contain an address, from the most specific to the least specific.
+			 * \tparam Visitor A callable that takes a const value_list_type& and returns a bool.
+			 * \param addr The address to look for.
+			 * \param visitor The visitor. Returning true from the visitor stops the lookup.
+			 * \return true if the visitor stopped the lookup.
+			 */
+			template <typename Visitor>
+			bool find(const address_type& addr, Visitor visitor) const
+			{
+				const bytes_type key = addr.to_bytes();
+
+				const node_type* matches[max_prefix_length + 1];
+				unsigned int match_count = 0;
+
+				for (const node_type* current = m_root.get(); current; current = current->children[get_bit(key, current->length)].get())
+				{
+					if (common_prefix_length(current->key, key, current->length) < current->length)
+					{
+						break;
+					}
+
+					if (!current->values.empty())
+					{
+						matches[match_count++] = current;
+					}
+
+					if (current->length == max_prefix_length)
+					{
+						break;
+					}
+				}
+
+				while (match_count > 0)
+				{
+					if (visitor(matches[--match_count]->values))
+					{
+						return true;
+					}
+				}
+
+				return false;
+			}
+
+		private:
+
+			typedef typename address_type::bytes_type bytes_type;
+
+			struct node_type;
+
+			typedef boost::shared_ptr<const node_type> node_ptr_type;
+
+			struct node_type
+			{
+				node_type(const bytes_type& _key, unsigned int _length) :
+					key(_key),
+					length(_length),
+					values(),
+					children()
+				{}
+
+				bytes_type key;
+				unsigned int length;
+				value_list_type values;
+				node_ptr_type children[2];
+			};
+
+			static unsigned int get_bit(const bytes_type& key, unsigned int index)
+			{
+				return (key[index / 8] >> (7 - (index % 8))) & 0x01;
+			}
+
+			static unsigned int common_prefix_length(const bytes_type& lhs, const bytes_type& rhs, unsigned int limit)
+			{
+				unsigned int result = 0;
+
+				for (size_t i = 0; (i < lhs.size()) && (result < limit); ++i)
+				{
+					unsigned int diff = lhs[i] ^ rhs[i];
+
+					if (diff == 0)
+					{
+						result += 8;
+					}
+					else
+					{
+						while ((diff & 0x80) == 0)
+						{
+							diff <<= 1;
+							++result;
+						}
+
+						break;
+					}
+				}
+
+				return std::min(result, limit);
+			}
+
+			static bool is_equivalent(const value_type& lhs, const value_type& rhs)
+			{
+				return !(lhs < rhs) && !(rhs < lhs);
+			}
+
+			void add_value(value_list_type& values, const value_type& value)
+			{
+				const typename value_list_type::iterator it = std::lower_bound(values.begin(), values.end(), value);
+
+				if ((it != values.end()) && is_equivalent(*it, value))
+				{
+					*it = value;
+				}
+				else
+				{
+					values.insert(it, value);
+					++m_size;
+				}
+			}
+
+			node_ptr_type insert_into(const node_ptr_type& node, const bytes_type& key, unsigned int length, const value_type& value)
+			{
+				if (!node)
+				{
+					const boost::shared_ptr<node_type> result = boost::make_shared<node_type>(key, length);
+					add_value(result->values, value);
+
+					return result;
+				}
+
+				const unsigned int common = common_prefix_length(node->key, key, std::min(node->length, length));
+
+				if (common < node->length)
+				{
+					// The prefix diverges from the node or contains it: the node becomes the child of a new one.
+					const boost::shared_ptr<node_type> result = boost::make_shared<node_type>(key, common);
+					result->children[get_bit(node->key, common)] = node;
+
+					if (common == length)
+					{
+						add_value(result->values, value);
+					}
+					else
+					{
+						result->children[get_bit(key, common)] = insert_into(node_ptr_type(), key, length, value);
+					}
+
+					return result;
+				}
+
+				const boost::shared_ptr<node_type> result = boost::make_shared<node_type>(*node);
+
+				if (node->length == length)
+				{
+					add_value(result->values, value);
+				}
+				else
+				{
+					node_ptr_type& child = result->children[get_bit(key, node->length)];
+					child = insert_into(child, key, length, value);
+				}
+
+				return result;
+			}
+
+			node_ptr_type erase_from(const node_ptr_type& node, const bytes_type& key, unsigned int length, const value_type& value, bool& erased)
+			{
+				if (!node)
+				{
+					return node;
+				}
+
+				if ((node->length > length) || (common_prefix_length(node->key, key, node->length) < node->length))
+				{
+					return node;
+				}
+
+				boost::shared_ptr<node_type> result;
+
+				if (node->length < length)
+				{
+					const unsigned int bit = get_bit(key, node->length);
+					const node_ptr_type child = erase_from(node->children[bit], key, length, value, erased);
+
+					if (!erased)
+					{
+						return node;
+					}
+
+					result = boost::make_shared<node_type>(*node);
+					result->children[bit] = child;
+				}
+				else
+				{
+					const typename value_list_type::const_iterator it = std::lower_bound(node->values.begin(), node->values.end(), value);
+
+					if ((it == node->values.end()) || !is_equivalent(*it, value))
+					{
+						return node;
+					}
+
+					result = boost::make_shared<node_type>(*node);
+					result->values.erase(result->values.begin() + (it - node->values.begin()));
+					--m_size;
+					erased = true;
+				}
+
+				// A node without values and with less than two children is useless: we merge it with its child, if any.
+				if (result->values.empty())
+				{
+					if (!result->children[0])
+					{
+						return result->children[1];
+					}
+					else if (!result->children[1])
+					{
+						return result->children[0];
+					}
+				}
+
+				return result;
+			}
+
+			node_ptr_type m_root;
+			size_t m_size;
+	};
+}
+
+#endif /* ROUTE_TRIE_HPP */
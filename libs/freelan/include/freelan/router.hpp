@@ -47,28 +47,38 @@
 #define ROUTER_HPP
 
 #include <algorithm>
+#include <atomic>
 #include <map>
 #include <set>
+#include <vector>
 
 #include <boost/asio.hpp>
 #include <boost/array.hpp>
 #include <boost/optional.hpp>
 #include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
 
-#include <asiotap/osi/ipv4_filter.hpp>
-#include <asiotap/osi/ipv6_filter.hpp>
 #include <asiotap/osi/ipv4_frame.hpp>
 #include <asiotap/osi/ipv6_frame.hpp>
 #include <asiotap/types/ip_network_address.hpp>
 
 #include "configuration.hpp"
+#include "per_thread.hpp"
 #include "port_index.hpp"
+#include "published_value.hpp"
+#include "route_trie.hpp"
 #include "routes_message.hpp"
 
+#include <fscp/statistics.hpp>
+
 namespace freelan
 {
 	/**
 	 * \brief A class that represents a router.
+	 *
+	 * The ports and routing tables are published as immutable snapshots: async_write() may be called from any number of threads concurrently while the modifying methods must be serialized by the caller.
+	 *
+	 * A change shares everything it does not touch with the current snapshot: the route tries only copy the nodes on the path of a changed route, and the ports are only copied when a port is registered or unregistered.
 	 */
 	class router
 	{
@@ -103,7 +113,8 @@ namespace freelan
 						m_write_function(),
 						m_local_routes(),
 						m_group(),
-						m_router(NULL)
+						m_router(NULL),
+						m_index()
 					{}
 
 					/**
@@ -115,7 +126,8 @@ namespace freelan
 						m_write_function(write_function),
 						m_local_routes(),
 						m_group(_group),
-						m_router(NULL)
+						m_router(NULL),
+						m_index()
 					{}
 
 					/**
@@ -126,7 +138,8 @@ namespace freelan
 						m_write_function(other.m_write_function),
 						m_local_routes(other.m_local_routes),
 						m_group(other.m_group),
-						m_router(NULL)
+						m_router(NULL),
+						m_index()
 					{}
 
 					/**
@@ -170,12 +183,12 @@ namespace freelan
 
 					void set_local_routes(const asiotap::ip_route_set& _local_routes)
 					{
-						m_local_routes = _local_routes;
-
 						if (m_router)
 						{
-							m_router->invalidate_routes();
+							m_router->update_routes(m_index, m_local_routes, _local_routes);
 						}
+
+						m_local_routes = _local_routes;
 					}
 
 					port_group_type group() const
@@ -185,24 +198,15 @@ namespace freelan
 
 				private:
 
-					void associate_to_router(router* _router)
+					void associate_to_router(router* _router, const port_index_type& index)
 					{
 						m_router = _router;
-
-						if (m_router)
-						{
-							m_router->invalidate_routes();
-						}
+						m_index = index;
 					}
 
 					void dissociate_from_router()
 					{
-						if (m_router)
-						{
-							m_router->invalidate_routes();
-
-							m_router = NULL;
-						}
+						m_router = NULL;
 					}
 
 					friend class router;
@@ -211,6 +215,7 @@ namespace freelan
 					asiotap::ip_route_set m_local_routes;
 					port_group_type m_group;
 					router* m_router;
+					port_index_type m_index;
 			};
 
 			/**
@@ -219,19 +224,54 @@ namespace freelan
 			typedef std::map<port_index_type, port_type> port_list_type;
 
 			/**
-			 * \brief Create a new router.
-			 * \param configuration The router configuration.
+			 * \brief The route cache statistics type.
 			 */
-			router(const router_configuration& configuration) :
-				m_configuration(configuration)
-			{}
+			struct route_cache_statistics_type
+			{
+				route_cache_statistics_type() :
+					hits(0),
+					misses(0)
+				{}
+
+				/**
+				 * \brief Get the cache hit ratio.
+				 * \return The cache hit ratio, between 0 and 1.
+				 */
+				double hit_ratio() const
+				{
+					const uint64_t total = hits + misses;
+
+					return (total > 0) ? static_cast<double>(hits) / total : 0.0;
+				}
+
+				/**
+				 * \brief The number of lookups that were answered from the cache.
+				 */
+				uint64_t hits;
+
+				/**
+				 * \brief The number of lookups that required a routing table lookup.
+				 */
+				uint64_t misses;
+			};
+
+			/**
+			 * \brief The number of entries in the route cache. Must be a power of two.
+			 */
+			static const size_t ROUTE_CACHE_SIZE = 256;
 
 			/**
-			 * \brief Invalidate the routes cache.
+			 * \brief Create a new router.
+			 * \param configuration The router configuration.
 			 */
-			void invalidate_routes()
+			router(const router_configuration& configuration) :
+				m_configuration(configuration),
+				m_ports(),
+				m_routes_generation(1),
+				m_table(boost::make_shared<const table_type>(m_routes_generation)),
+				m_route_caches(),
+				m_dropped_frames()
 			{
-				m_routes = boost::none;
 			}
 
 			/**
@@ -239,13 +279,7 @@ namespace freelan
 			 * \param index The index of the port.
 			 * \param port The port to register. Cannot be null.
 			 */
-			void register_port(port_index_type index, port_type port)
-			{
-				port_type& local_port = (m_ports[index] = port);
-
-				// This takes care of automatically clearing the route cache whenever needed.
-				local_port.associate_to_router(this);
-			}
+			void register_port(port_index_type index, port_type port);
 
 			/**
 			 * \brief Unregister a port.
@@ -253,10 +287,7 @@ namespace freelan
 			 *
 			 * If the port was not registered, nothing is done.
 			 */
-			void unregister_port(port_index_type index)
-			{
-				m_ports.erase(index);
-			}
+			void unregister_port(port_index_type index);
 
 			/**
 			 * \brief Check if the specified port is registered.
@@ -272,6 +303,8 @@ namespace freelan
 			 * \brief Get the port associated to a given index, if it exists.
 			 * \param index The index of the port to get.
 			 * \return A pointer to the port.
+			 *
+			 * Changing the local routes of the returned port publishes new routing tables.
 			 */
 			port_type* get_port(port_index_type index)
 			{
@@ -293,24 +326,190 @@ namespace freelan
 			 */
 			void async_write(port_index_type index, boost::asio::const_buffer data, port_type::write_handler_type handler);
 
+			/**
+			 * \brief Get the route cache statistics.
+			 * \return The route cache statistics, summed over all the threads that routed frames.
+			 */
+			route_cache_statistics_type route_cache_statistics() const;
+
+			/**
+			 * \brief Get the count of dropped frames.
+			 * \return The count of frames that were dropped because no route matched them.
+			 */
+			uint64_t dropped_frame_count() const
+			{
+				return m_dropped_frames.value();
+			}
+
 		private:
 
-			port_list_type::const_iterator get_target_for(port_index_type, boost::asio::const_buffer);
+			template <typename AddressType>
+			struct route_entry_type
+			{
+				route_entry_type(const asiotap::base_ip_route<AddressType>& _route, const port_index_type& _index, const port_type* _port) :
+					route(_route),
+					index(_index),
+					port(_port)
+				{}
+
+				asiotap::base_ip_route<AddressType> route;
+				port_index_type index;
+
+				// Owned by the ports of the table the entry belongs to.
+				const port_type* port;
+
+				friend bool operator<(const route_entry_type& lhs, const route_entry_type& rhs)
+				{
+					if (lhs.route == rhs.route)
+					{
+						return (lhs.index < rhs.index);
+					}
+					else
+					{
+						return (lhs.route < rhs.route);
+					}
+				}
+			};
+
+			typedef route_trie<boost::asio::ip::address_v4, route_entry_type<boost::asio::ip::address_v4> > ipv4_routes_type;
+			typedef route_trie<boost::asio::ip::address_v6, route_entry_type<boost::asio::ip::address_v6> > ipv6_routes_type;
+
+			typedef std::map<port_index_type, boost::shared_ptr<const port_type> > table_port_list_type;
+
+			/**
+			 * \brief An immutable snapshot of the ports and routing tables.
+			 *
+			 * The route entries refer to the ports of the same snapshot. The ports and the route trie nodes never change once published: the copies of a snapshot share them.
+			 */
+			struct table_type
+			{
+				explicit table_type(uint64_t _generation) :
+					generation(_generation),
+					ports(boost::make_shared<const table_port_list_type>()),
+					ipv4_routes(),
+					ipv6_routes()
+				{}
+
+				ipv4_routes_type& routes_for(const boost::asio::ip::address_v4&) { return ipv4_routes; }
+				ipv6_routes_type& routes_for(const boost::asio::ip::address_v6&) { return ipv6_routes; }
+				const ipv4_routes_type& routes_for(const boost::asio::ip::address_v4&) const { return ipv4_routes; }
+				const ipv6_routes_type& routes_for(const boost::asio::ip::address_v6&) const { return ipv6_routes; }
+
+				uint64_t generation;
+				boost::shared_ptr<const table_port_list_type> ports;
+				ipv4_routes_type ipv4_routes;
+				ipv6_routes_type ipv6_routes;
+			};
+
+			class update_route_visitor : public boost::static_visitor<void>
+			{
+				public:
+
+					update_route_visitor(table_type& table, const port_index_type& index, const port_type* port) :
+						m_table(table),
+						m_index(index),
+						m_port(port)
+					{}
+
+					template <typename AddressType>
+					result_type operator()(const asiotap::base_ip_route<AddressType>& route) const
+					{
+						const route_entry_type<AddressType> entry(route, m_index, m_port);
+
+						// The entries are compared on their route and index only, so that erasing does not need the port.
+						if (m_port)
+						{
+							m_table.routes_for(route.network_address().address()).insert(route.network_address(), entry);
+						}
+						else
+						{
+							m_table.routes_for(route.network_address().address()).erase(route.network_address(), entry);
+						}
+					}
+
+				private:
+
+					table_type& m_table;
+					const port_index_type& m_index;
+					const port_type* m_port;
+			};
+
+			template <typename AddressType>
+			struct route_cache_entry_type
+			{
+				route_cache_entry_type() :
+					generation(0),
+					destination(),
+					source_group(),
+					target(nullptr),
+					multipath_entries(nullptr)
+				{}
+
+				// The other fields refer to the table of that generation and are meaningless for any other.
+				uint64_t generation;
+				AddressType destination;
+				port_group_type source_group;
+				const port_type* target;
+
+				// When several ports share the best route, the target depends on the flow and is computed for each frame.
+				const std::vector<route_entry_type<AddressType> >* multipath_entries;
+			};
+
+			typedef boost::array<route_cache_entry_type<boost::asio::ip::address_v4>, ROUTE_CACHE_SIZE> ipv4_route_cache_type;
+			typedef boost::array<route_cache_entry_type<boost::asio::ip::address_v6>, ROUTE_CACHE_SIZE> ipv6_route_cache_type;
+
+			/**
+			 * \brief The route cache of a thread.
+			 *
+			 * Only its owning thread writes to it: the counters are atomic so that route_cache_statistics() can read them from another thread.
+			 */
+			struct route_cache_type
+			{
+				route_cache_type() :
+					ipv4_entries(),
+					ipv6_entries(),
+					hits(0),
+					misses(0)
+				{}
+
+				ipv4_route_cache_type& entries_for(const boost::asio::ip::address_v4&) { return ipv4_entries; }
+				ipv6_route_cache_type& entries_for(const boost::asio::ip::address_v6&) { return ipv6_entries; }
+
+				ipv4_route_cache_type ipv4_entries;
+				ipv6_route_cache_type ipv6_entries;
+				std::atomic<uint64_t> hits;
+				std::atomic<uint64_t> misses;
+			};
+
+			void update_routes(const port_index_type&, const asiotap::ip_route_set&, const asiotap::ip_route_set&);
+
+			template <typename Change>
+			void update_table(Change change);
+
+			const port_type* get_target_for(const table_type&, port_index_type, boost::asio::const_buffer);
+
+			template <typename AddressType>
+			const port_type* get_target_for(const table_type&, port_index_type, const AddressType&, boost::asio::const_buffer);
 
 			template <typename AddressType>
-			port_list_type::const_iterator get_target_for(port_index_type, const AddressType&);
+			const port_type* get_multipath_target(const std::vector<route_entry_type<AddressType> >&, port_group_type, size_t) const;
+
+			bool can_route(port_group_type source_group, const port_type& target) const
+			{
+				return (m_configuration.client_routing_enabled || (source_group != target.group()));
+			}
 
 			router_configuration m_configuration;
 
+			// The authoritative ports, which the published tables are built from.
 			port_list_type m_ports;
 
-			asiotap::osi::filter<asiotap::osi::ipv4_frame> m_ipv4_filter;
-			asiotap::osi::filter<asiotap::osi::ipv6_frame> m_ipv6_filter;
+			uint64_t m_routes_generation;
+			published_value<table_type> m_table;
 
-			typedef std::multimap<asiotap::ip_route, port_index_type> routes_port_type;
+			per_thread<route_cache_type> m_route_caches;
 
-			const routes_port_type& routes() const;
-			mutable boost::optional<routes_port_type> m_routes;
+			fscp::statistics_counter m_dropped_frames;
 	};
 }
 
@@ -52,14 +52,24 @@
 
 #include <boost/asio.hpp>
 #include <boost/array.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include "configuration.hpp"
 #include "port_index.hpp"
+#include "published_value.hpp"
+
+#include <fscp/statistics.hpp>
 
 namespace freelan
 {
 	/**
 	 * \brief A class that represents a switch.
+	 *
+	 * The ports and the ethernet address table are published as immutable snapshots: async_write() may be called from any number of threads concurrently while register_port(), unregister_port() and publish_learnt_addresses() must be serialized by the caller.
+	 *
+	 * The ethernet addresses learnt while switching frames are queued and published in batches by publish_learnt_addresses().
 	 */
 	class switch_
 	{
@@ -85,6 +95,11 @@ namespace freelan
 			 */
 			typedef boost::function<void (const multi_write_result_type&)> multi_write_handler_type;
 
+			/**
+			 * \brief The address learning handler type.
+			 */
+			typedef boost::function<void ()> address_learning_handler_type;
+
 			/**
 			 * \brief A switch port type.
 			 */
@@ -125,7 +140,7 @@ namespace freelan
 					 * \param data The data to write.
 					 * \param handler The handler to call when the write is complete.
 					 */
-					void async_write(boost::asio::const_buffer data, write_handler_type handler)
+					void async_write(boost::asio::const_buffer data, write_handler_type handler) const
 					{
 						m_write_function(data, handler);
 					}
@@ -153,9 +168,34 @@ namespace freelan
 			 */
 			switch_(const switch_configuration& configuration, const unsigned int max_entries = MAX_ENTRIES_DEFAULT) :
 				m_configuration(configuration),
-				m_max_entries(max_entries)
+				m_max_entries(max_entries),
+				m_ports(boost::make_shared<const port_list_type>()),
+				m_ethernet_address_map(boost::make_shared<const ethernet_address_map_type>()),
+				m_address_learning_handler(),
+				m_pending_address_updates(),
+				m_pending_address_updates_mutex(),
+				m_address_publication_mutex(),
+				m_dropped_frames()
 			{}
 
+			/**
+			 * \brief Set the address learning handler.
+			 * \param handler The handler, called from the switching thread when addresses were queued while none were pending. It must arrange for publish_learnt_addresses() to be called.
+			 *
+			 * If no handler is set, the switching thread publishes the addresses itself.
+			 */
+			void set_address_learning_handler(address_learning_handler_type handler)
+			{
+				m_address_learning_handler = handler;
+			}
+
+			/**
+			 * \brief Publish the queued ethernet address updates.
+			 *
+			 * The whole batch costs a single copy of the ethernet address table.
+			 */
+			void publish_learnt_addresses();
+
 			/**
 			 * \brief Register a switch port.
 			 * \param index The index of the port.
@@ -163,7 +203,11 @@ namespace freelan
 			 */
 			void register_port(port_index_type index, port_type port)
 			{
-				m_ports[index] = port;
+				const boost::shared_ptr<port_list_type> ports = boost::make_shared<port_list_type>(*m_ports.load());
+
+				(*ports)[index] = port;
+
+				m_ports.publish(ports);
 			}
 
 			/**
@@ -174,7 +218,11 @@ namespace freelan
 			 */
 			void unregister_port(port_index_type index)
 			{
-				m_ports.erase(index);
+				const boost::shared_ptr<port_list_type> ports = boost::make_shared<port_list_type>(*m_ports.load());
+
+				ports->erase(index);
+
+				m_ports.publish(ports);
 			}
 
 			/**
@@ -184,7 +232,9 @@ namespace freelan
 			 */
 			bool is_registered(port_index_type index) const
 			{
-				return (m_ports.find(index) != m_ports.end());
+				const published_value<port_list_type>::pointer_type ports = m_ports.load();
+
+				return (ports->find(index) != ports->end());
 			}
 
 			/**
@@ -195,23 +245,56 @@ namespace freelan
 			 */
 			void async_write(port_index_type index, boost::asio::const_buffer data, multi_write_handler_type handler);
 
+			/**
+			 * \brief Get the count of dropped frames.
+			 * \return The count of frames that were not switched to any port.
+			 */
+			uint64_t dropped_frame_count() const
+			{
+				return m_dropped_frames.value();
+			}
+
 		private:
 
-			std::set<port_index_type> get_targets_for(port_index_type, boost::asio::const_buffer);
-			std::set<port_index_type> get_targets_for(port_list_type::const_iterator);
+			typedef boost::array<uint8_t, 6> ethernet_address_type;
+			typedef std::map<ethernet_address_type, port_index_type> ethernet_address_map_type;
 
-			switch_configuration m_configuration;
-			unsigned int m_max_entries;
+			struct address_update_type
+			{
+				address_update_type(const port_index_type& _index, bool _learn) :
+					index(_index),
+					learn(_learn)
+				{}
+
+				// When forgetting an address, the update only applies if the address is still associated to this port.
+				port_index_type index;
+				bool learn;
+			};
 
-			port_list_type m_ports;
+			typedef std::map<ethernet_address_type, address_update_type> address_update_map_type;
 
-			typedef boost::array<uint8_t, 6> ethernet_address_type;
-			typedef std::map<ethernet_address_type, port_index_type> ethernet_address_map_type;
+			std::set<port_index_type> get_targets_for(const port_list_type&, port_index_type, boost::asio::const_buffer);
+			std::set<port_index_type> get_targets_for(const port_list_type&, port_list_type::const_iterator);
+
+			void queue_address_update(const ethernet_address_type&, const address_update_type&);
 
 			static ethernet_address_type to_ethernet_address(boost::asio::const_buffer);
 			static bool is_multicast_address(const ethernet_address_type&);
 
-			ethernet_address_map_type m_ethernet_address_map;
+			switch_configuration m_configuration;
+			unsigned int m_max_entries;
+
+			published_value<port_list_type> m_ports;
+			published_value<ethernet_address_map_type> m_ethernet_address_map;
+
+			address_learning_handler_type m_address_learning_handler;
+
+			// The updates found while switching frames, waiting for publish_learnt_addresses().
+			address_update_map_type m_pending_address_updates;
+			boost::mutex m_pending_address_updates_mutex;
+			boost::mutex m_address_publication_mutex;
+
+			fscp::statistics_counter m_dropped_frames;
 	};
 }
 
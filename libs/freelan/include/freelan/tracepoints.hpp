@@ -0,0 +1,105 @@
+/*
+ * libfreelan - A C++ library to establish peer-to-peer virtual private
+ * networks.
+ * Copyright (C) 2010-2011 Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libfreelan.
+ *
+ * libfreelan is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libfreelan is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libfreelan in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+
+/**
+ * \file tracepoints.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief Static tracepoints.
+ *
+ * See fscp/tracepoints.hpp for how tracepoints are compiled and attached to.
+ *
+ * The freelan provider has the following probes:
+ * - tap_read(bytes): a frame was read from the tap adapter.
+ * - tap_write(queue, bytes): a frame is being written to the given queue of the tap adapter.
+ * - switch_forward(sockaddr, socklen, targets, bytes): the switch forwarded a frame from the given port to the given number of ports.
+ * - router_forward(sockaddr, socklen, target_sockaddr, target_socklen, routed, bytes): the router forwarded a frame from a port to another, or dropped it if routed is 0.
+ *
+ * The socket address of a port is NULL, and its length 0, when the port is the tap adapter. The target of the router is also NULL when it dropped the frame.
+ */
+
+#ifndef FREELAN_TRACEPOINTS_HPP
+#define FREELAN_TRACEPOINTS_HPP
+
+#include <fscp/tracepoints.hpp>
+
+#include "port_index.hpp"
+
+/**
+ * \brief Declare a tracepoint in the freelan provider.
+ * \param name The tracepoint name.
+ */
+#define FREELAN_TRACEPOINT(name, ...) FREELAN_PROVIDER_TRACEPOINT(freelan, name, __VA_ARGS__)
+
+/**
+ * \brief Expand a port index into the two tracepoint arguments that describe its endpoint.
+ * \param index The port index.
+ */
+#define FREELAN_TRACEPOINT_PORT(index) FREELAN_TRACEPOINT_OPTIONAL_ENDPOINT(::freelan::port_index_endpoint(index))
+
+/**
+ * \brief Expand an endpoint pointer into the two tracepoint arguments that describe it.
+ * \param ep A pointer to the endpoint. Can be NULL.
+ */
+#define FREELAN_TRACEPOINT_OPTIONAL_ENDPOINT(ep) ::freelan::tracepoint_sockaddr(ep), ::freelan::tracepoint_socklen(ep)
+
+namespace freelan
+{
+	/**
+	 * \brief Get the socket address of an endpoint, as a tracepoint argument.
+	 * \param ep A pointer to the endpoint. Can be NULL.
+	 * \return The socket address, or NULL.
+	 */
+	inline const void* tracepoint_sockaddr(const fscp::server::ep_type* ep)
+	{
+		return ep ? static_cast<const void*>(ep->data()) : NULL;
+	}
+
+	/**
+	 * \brief Get the socket address length of an endpoint, as a tracepoint argument.
+	 * \param ep A pointer to the endpoint. Can be NULL.
+	 * \return The socket address length, or 0.
+	 */
+	inline unsigned int tracepoint_socklen(const fscp::server::ep_type* ep)
+	{
+		return ep ? static_cast<unsigned int>(ep->size()) : 0;
+	}
+}
+
+#endif /* FREELAN_TRACEPOINTS_HPP */
@@ -0,0 +1,255 @@
+/*
+ * libfreelan - A C++ library to establish peer-to-peer virtual private
+ * networks.
+ * Copyright (C) 2010-2011 Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libfreelan.
+ *
+ * libfreelan is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libfreelan is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libfreelan in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+
+/**
+ * \file async_log_writer.cpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief An asynchronous log writer.
+ */
+
+#include "async_log_writer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <boost/lexical_cast.hpp>
+
+namespace freelan
+{
+	namespace
+	{
+		size_t round_up_to_power_of_two(size_t value)
+		{
+			size_t result = 1;
+
+			while (result < value)
+			{
+				result <<= 1;
+			}
+
+			return result;
+		}
+
+		// The background thread wakes up periodically even if no producer notified it, so that a missed notification only delays the entries.
+		const boost::posix_time::time_duration FLUSH_PERIOD = boost::posix_time::milliseconds(250);
+	}
+
+	const size_t async_log_writer::DEFAULT_CAPACITY;
+	const size_t async_log_writer::MESSAGE_SIZE;
+
+	async_log_writer::async_log_writer(log_handler_type handler, size_t capacity) :
+		m_handler(handler),
+		m_capacity(round_up_to_power_of_two(std::max<size_t>(capacity, 2))),
+		m_records(new record_type[m_capacity]),
+		m_enqueue_position(0),
+		m_dequeue_position(0),
+		m_dropped(),
+		m_reported_dropped(0),
+		m_mutex(),
+		m_condition(),
+		m_sleeping(false),
+		m_stopping(false),
+		m_thread()
+	{
+		// A record at index i is free for the producer that gets position i, and ready for the consumer at position i when its sequence is i + 1.
+		for (size_t i = 0; i < m_capacity; ++i)
+		{
+			m_records[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	async_log_writer::~async_log_writer()
+	{
+		stop();
+	}
+
+	void async_log_writer::start()
+	{
+		boost::mutex::scoped_lock lock(m_mutex);
+
+		if (!m_thread.joinable())
+		{
+			m_stopping = false;
+			m_thread = boost::thread(&async_log_writer::run, this);
+		}
+	}
+
+	void async_log_writer::stop()
+	{
+		{
+			boost::mutex::scoped_lock lock(m_mutex);
+
+			m_stopping = true;
+		}
+
+		m_condition.notify_one();
+
+		if (m_thread.joinable())
+		{
+			m_thread.join();
+		}
+
+		// Also handles the entries written while the thread was not running.
+		handle_pending();
+	}
+
+	void async_log_writer::write(log_level level, const char* msg, size_t msg_len, const timestamp_type& timestamp)
+	{
+		size_t position = m_enqueue_position.load(std::memory_order_relaxed);
+		record_type* record;
+
+		for (;;)
+		{
+			record = &m_records[position & (m_capacity - 1)];
+
+			const size_t sequence = record->sequence.load(std::memory_order_acquire);
+
+			if (sequence == position)
+			{
+				if (m_enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (sequence < position)
+			{
+				// The record still holds the entry from the previous lap: the buffer is full.
+				m_dropped.add();
+
+				return;
+			}
+			else
+			{
+				position = m_enqueue_position.load(std::memory_order_relaxed);
+			}
+		}
+
+		record->level = level;
+		record->timestamp = timestamp;
+		record->size = msg_len;
+
+		if (msg_len <= MESSAGE_SIZE)
+		{
+			std::memcpy(record->message, msg, msg_len);
+		}
+		else
+		{
+			record->long_message.assign(msg, msg_len);
+		}
+
+		record->sequence.store(position + 1, std::memory_order_release);
+
+		// Pairs with the fence in run(): either the thread sees the new entry before sleeping, or we see it sleeping.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if (m_sleeping.load(std::memory_order_relaxed))
+		{
+			boost::mutex::scoped_lock lock(m_mutex);
+
+			m_condition.notify_one();
+		}
+	}
+
+	bool async_log_writer::has_pending() const
+	{
+		const record_type& record = m_records[m_dequeue_position & (m_capacity - 1)];
+
+		return (record.sequence.load(std::memory_order_acquire) == m_dequeue_position + 1);
+	}
+
+	void async_log_writer::handle_pending()
+	{
+		while (has_pending())
+		{
+			record_type& record = m_records[m_dequeue_position & (m_capacity - 1)];
+
+			if (m_handler)
+			{
+				if (record.size <= MESSAGE_SIZE)
+				{
+					m_handler(record.level, std::string(record.message, record.size), record.timestamp);
+				}
+				else
+				{
+					m_handler(record.level, record.long_message, record.timestamp);
+
+					std::string().swap(record.long_message);
+				}
+			}
+
+			record.sequence.store(m_dequeue_position + m_capacity, std::memory_order_release);
+			++m_dequeue_position;
+		}
+
+		const uint64_t dropped = m_dropped.value();
+
+		if (dropped != m_reported_dropped)
+		{
+			if (m_handler)
+			{
+				m_handler(LL_WARNING, boost::lexical_cast<std::string>(dropped - m_reported_dropped) + " log entries were dropped as the log buffer was full.", boost::posix_time::microsec_clock::universal_time());
+			}
+
+			m_reported_dropped = dropped;
+		}
+	}
+
+	void async_log_writer::run()
+	{
+		boost::mutex::scoped_lock lock(m_mutex);
+
+		while (!m_stopping)
+		{
+			lock.unlock();
+			handle_pending();
+			lock.lock();
+
+			m_sleeping.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			if (!m_stopping && !has_pending())
+			{
+				m_condition.timed_wait(lock, FLUSH_PERIOD);
+			}
+
+			m_sleeping.store(false, std::memory_order_relaxed);
+		}
+	}
+}
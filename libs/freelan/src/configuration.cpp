@@ -72,8 +72,12 @@ namespace freelan
 		contact_list(),
 		accept_contact_requests(true),
 		accept_contacts(true),
+		accept_link_tests(false),
 		hostname_resolution_protocol(HRP_IPV4),
-		hello_timeout(boost::posix_time::seconds(3))
+		hello_timeout(boost::posix_time::seconds(3)),
+		buffer_count(32),
+		latency_sampling_rate(1024),
+		io_uring_enabled(false)
 	{
 	}
 
@@ -90,6 +94,12 @@ namespace freelan
 	tap_adapter_configuration::tap_adapter_configuration() :
 		enabled(true),
 		type(tap_adapter_type::tap),
+		queue_count(1),
+		offloading_enabled(false),
+		read_batch_size(16),
+		io_uring_enabled(false),
+		buffer_count(8),
+		tcp_mss_clamping_enabled(false),
 		ipv4_address_prefix_length(),
 		ipv6_address_prefix_length(),
 		arp_proxy_enabled(false),
@@ -98,7 +108,12 @@ namespace freelan
 		dhcp_server_ipv4_address_prefix_length(),
 		dhcp_server_ipv6_address_prefix_length(),
 		up_script(),
-		down_script()
+		down_script(),
+		pcap_input_file(),
+		pcap_output_file(),
+		pcap_replay_rate(0),
+		pcap_replay_count(1),
+		pcap_replay_delay(boost::posix_time::seconds(0))
 	{
 	}
 
@@ -111,6 +126,7 @@ namespace freelan
 	router_configuration::router_configuration() :
 		local_ip_routes(),
 		client_routing_enabled(false),
+		multipath_enabled(true),
 		accept_routes_requests(true),
 		internal_route_acceptance_policy(internal_route_scope_type::unicast_in_network),
 		system_route_acceptance_policy(system_route_scope_type::none),
@@ -48,10 +48,12 @@
 #include "client.hpp"
 #include "routes_request_message.hpp"
 #include "routes_message.hpp"
+#include "tracepoints.hpp"
 
 #include <fscp/server_error.hpp>
 
 #include <asiotap/types/ip_network_address.hpp>
+#include <asiotap/osi/tcp_filter.hpp>
 
 #ifdef WINDOWS
 #include <executeplus/windows_system.hpp>
@@ -60,11 +62,15 @@
 #endif
 
 #include <boost/make_shared.hpp>
+#include <boost/array.hpp>
 #include <boost/foreach.hpp>
 #include <boost/thread/future.hpp>
 #include <boost/iterator/transform_iterator.hpp>
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <random>
 
 namespace freelan
 {
@@ -139,84 +145,124 @@ namespace freelan
 			return shared_buffer_handler<SharedBufferType, Handler>(_buffer, _handler);
 		}
 
-		template <typename Handler, typename CausalHandler>
-		class causal_handler
+		unsigned int get_auto_mtu_value()
 		{
-			private:
+			const unsigned int default_mtu_value = 1500;
+			const size_t static_payload_size = 20 + 8 + 4 + 22; // IP + UDP + FSCP HEADER + FSCP DATA HEADER
 
-				class automatic_caller : public boost::noncopyable
-				{
-					public:
+			return default_mtu_value - static_payload_size;
+		}
 
-						automatic_caller(CausalHandler& _handler) :
-							m_auto_handler(_handler)
-						{
-						}
+		static const unsigned int TAP_ADAPTERS_GROUP = 0;
+		static const unsigned int ENDPOINTS_GROUP = 1;
 
-						~automatic_caller()
-						{
-							m_auto_handler();
-						}
+		static const uint16_t ETHERNET_VLAN_PROTOCOL = 0x8100;
+		static const size_t ETHERNET_VLAN_TAG_SIZE = 4;
 
-					private:
+		static const unsigned int TAP_ADAPTER_IO_URING_ENTRIES = 256;
+		static const unsigned int SERVER_IO_URING_ENTRIES = 256;
 
-						CausalHandler& m_auto_handler;
-				};
+		static const std::string VIRTUAL_TAP_ADAPTER_DEFAULT_NAME = "virtual0";
 
-			public:
+		template <typename ConstBufferSequence, typename WriteHandler>
+		void write_tap_frame(asiotap::tap_adapter& tap_adapter, size_t queue, const ConstBufferSequence& buffers, WriteHandler handler)
+		{
+#ifdef WINDOWS
+			tap_adapter.async_write(queue, buffers, handler);
+#else
+			if (tap_adapter.io_uring_enabled())
+			{
+				// The writes of a batch are submitted together.
+				tap_adapter.async_write(queue, buffers, handler);
 
-				typedef void result_type;
+				return;
+			}
 
-				causal_handler(Handler _handler, CausalHandler _causal_handler) :
-					m_handler(_handler),
-					m_causal_handler(_causal_handler)
-				{}
+			// Tap adapters accept writes immediately or drop the frame, so there is no need to wait for the descriptor to be ready.
+			boost::system::error_code ec;
+			const size_t count = tap_adapter.try_write(queue, buffers, ec);
 
-				result_type operator()()
-				{
-					automatic_caller ac(m_causal_handler);
+			handler(ec, count);
+#endif
+		}
 
-					m_handler();
-				}
+		void clamp_tcp_maximum_segment_size(boost::asio::mutable_buffer packet, size_t mtu)
+		{
+			using namespace asiotap::osi;
 
-				template <typename Arg1>
-				result_type operator()(Arg1 arg1)
+			if (buffer_size(packet) == 0)
+			{
+				return;
+			}
+
+			const uint8_t version = (buffer_cast<const uint8_t*>(packet)[0] & 0xF0) >> 4;
+
+			// Too short packets are silently ignored: there is nothing to clamp.
+			if (version == IP_PROTOCOL_VERSION_4)
+			{
+				const boost::optional<mutable_helper<ipv4_frame> > ip = try_helper<ipv4_frame>(packet);
+
+				if (ip && frame_parent_match<tcp_frame>(const_helper<ipv4_frame>(*ip)))
 				{
-					automatic_caller ac(m_causal_handler);
+					const boost::optional<mutable_helper<tcp_frame> > tcp = try_helper<tcp_frame>(ip->payload());
 
-					m_handler(arg1);
+					if (tcp && check_frame(*tcp) && tcp->has_flags(TCP_FLAG_SYN) && (mtu > sizeof(ipv4_frame) + sizeof(tcp_frame)))
+					{
+						tcp->clamp_maximum_segment_size(static_cast<uint16_t>(std::min<size_t>(mtu - sizeof(ipv4_frame) - sizeof(tcp_frame), 0xFFFF)));
+					}
 				}
+			}
+			else if (version == IP_PROTOCOL_VERSION_6)
+			{
+				const boost::optional<mutable_helper<ipv6_frame> > ip = try_helper<ipv6_frame>(packet);
 
-				template <typename Arg1, typename Arg2>
-				result_type operator()(Arg1 arg1, Arg2 arg2)
+				if (ip && frame_parent_match<tcp_frame>(const_helper<ipv6_frame>(*ip)))
 				{
-					automatic_caller ac(m_causal_handler);
+					const boost::optional<mutable_helper<tcp_frame> > tcp = try_helper<tcp_frame>(ip->payload());
 
-					m_handler(arg1, arg2);
+					if (tcp && check_frame(*tcp) && tcp->has_flags(TCP_FLAG_SYN) && (mtu > sizeof(ipv6_frame) + sizeof(tcp_frame)))
+					{
+						tcp->clamp_maximum_segment_size(static_cast<uint16_t>(std::min<size_t>(mtu - sizeof(ipv6_frame) - sizeof(tcp_frame), 0xFFFF)));
+					}
 				}
+			}
+		}
 
-			private:
+		void clamp_tcp_maximum_segment_size(boost::asio::mutable_buffer frame, tap_adapter_configuration::tap_adapter_type type, size_t mtu)
+		{
+			if (type == tap_adapter_configuration::tap_adapter_type::tun)
+			{
+				clamp_tcp_maximum_segment_size(frame, mtu);
 
-				Handler m_handler;
-				CausalHandler m_causal_handler;
-		};
+				return;
+			}
 
-		template <typename Handler, typename CausalHandler>
-		inline causal_handler<Handler, CausalHandler> make_causal_handler(Handler _handler, CausalHandler _causal_handler)
-		{
-			return causal_handler<Handler, CausalHandler>(_handler, _causal_handler);
-		}
+			size_t network_offset = sizeof(asiotap::osi::ethernet_frame);
 
-		unsigned int get_auto_mtu_value()
-		{
-			const unsigned int default_mtu_value = 1500;
-			const size_t static_payload_size = 20 + 8 + 4 + 22; // IP + UDP + FSCP HEADER + FSCP DATA HEADER
+			if (buffer_size(frame) < network_offset)
+			{
+				return;
+			}
 
-			return default_mtu_value - static_payload_size;
-		}
+			uint16_t protocol = ntohs(buffer_cast<const asiotap::osi::ethernet_frame*>(frame)->protocol);
 
-		static const unsigned int TAP_ADAPTERS_GROUP = 0;
-		static const unsigned int ENDPOINTS_GROUP = 1;
+			if (protocol == ETHERNET_VLAN_PROTOCOL)
+			{
+				if (buffer_size(frame) < network_offset + ETHERNET_VLAN_TAG_SIZE)
+				{
+					return;
+				}
+
+				std::memcpy(&protocol, buffer_cast<const uint8_t*>(frame) + network_offset + ETHERNET_VLAN_TAG_SIZE - sizeof(protocol), sizeof(protocol));
+				protocol = ntohs(protocol);
+				network_offset += ETHERNET_VLAN_TAG_SIZE;
+			}
+
+			if ((protocol == asiotap::osi::IP_PROTOCOL) || (protocol == asiotap::osi::IPV6_PROTOCOL))
+			{
+				clamp_tcp_maximum_segment_size(frame + network_offset, mtu);
+			}
+		}
 
 		asiotap::ip_route_set filter_routes(const asiotap::ip_route_set& routes, router_configuration::internal_route_scope_type scope, unsigned int limit, const asiotap::ip_network_address_list& network_addresses)
 		{
@@ -399,8 +445,8 @@ namespace freelan
 	core::core(boost::asio::io_service& io_service, const freelan::configuration& _configuration) :
 		m_io_service(io_service),
 		m_configuration(_configuration),
-		m_logger_strand(m_io_service),
-		m_logger(m_logger_strand.wrap(boost::bind(&core::do_handle_log, this, _1, _2, _3))),
+		m_log_writer(boost::make_shared<async_log_writer>(boost::bind(&core::do_handle_log, this, _1, _2, _3))),
+		m_logger(m_log_writer),
 		m_log_callback(),
 		m_core_opened_callback(),
 		m_core_closed_callback(),
@@ -416,25 +462,31 @@ namespace freelan
 		m_dynamic_contact_timer(m_io_service, DYNAMIC_CONTACT_PERIOD),
 		m_routes_request_timer(m_io_service, ROUTES_REQUEST_PERIOD),
 		m_tap_adapter_strand(m_io_service),
-		m_proxies_strand(m_io_service),
-		m_tap_write_queue_strand(m_io_service),
-		m_arp_filter(m_ethernet_filter),
-		m_ipv4_filter(m_ethernet_filter),
-		m_udp_filter(m_ipv4_filter),
-		m_bootp_filter(m_udp_filter),
-		m_dhcp_filter(m_bootp_filter),
+		m_tap_adapter_queues(),
+		m_tcp_mss_clamping_mtu(m_configuration.tap_adapter.tcp_mss_clamping_enabled ? compute_mtu(m_configuration.tap_adapter.mtu, get_auto_mtu_value()) : 0),
+		m_tap_adapter_read(),
+		m_tap_adapter_written(),
+		m_tap_adapter_write_queue_depth(),
+		m_latency_sampler(m_configuration.fscp.latency_sampling_rate),
+		m_latency(),
 		m_router_strand(m_io_service),
 		m_switch(m_configuration.switch_),
 		m_router(m_configuration.router),
-		m_route_manager(io_service)
+		m_route_manager(io_service),
+		m_link_test_strand(m_io_service),
+		m_next_link_test_id(std::random_device()()),
+		m_link_tests(),
+		m_link_test_sinks()
 	{
 		if (!m_configuration.security.identity)
 		{
 			throw std::runtime_error("No user certificate or private key set. Unable to continue.");
 		}
 
-		m_arp_filter.add_handler(boost::bind(&core::do_handle_arp_frame, this, _1));
-		m_dhcp_filter.add_handler(boost::bind(&core::do_handle_dhcp_frame, this, _1));
+		// The switch publishes the ethernet addresses it learns in batches, from the strand that serializes its updates.
+		m_switch.set_address_learning_handler([this](){
+			m_router_strand.post(boost::bind(&switch_::publish_learnt_addresses, &m_switch));
+		});
 
 		// Setup the route manager.
 		auto route_registration_success_handler = [this](const asiotap::route_manager::route_type& route){
@@ -453,8 +505,15 @@ namespace freelan
 		});
 	}
 
+	core::~core()
+	{
+		m_log_writer->stop();
+	}
+
 	void core::open()
 	{
+		m_log_writer->start();
+
 		m_logger(LL_DEBUG) << "Opening core...";
 
 		open_server();
@@ -471,13 +530,15 @@ namespace freelan
 		close_server();
 
 		m_logger(LL_DEBUG) << "Core closed.";
+
+		m_log_writer->stop();
 	}
 
 	// Private methods
 
 	void core::do_handle_log(log_level level, const std::string& msg, const boost::posix_time::ptime& timestamp)
 	{
-		// All do_handle_log() calls are done within the same strand, so the user does not need to protect his callback with a mutex that might slow things down.
+		// All do_handle_log() calls are done from the log writer thread, so the user does not need to protect his callback with a mutex that might slow things down.
 		if (m_log_callback)
 		{
 			m_log_callback(level, msg, timestamp);
@@ -491,22 +552,27 @@ namespace freelan
 
 	void core::open_server()
 	{
-		m_server = boost::make_shared<fscp::server>(boost::ref(m_io_service), boost::cref(*m_configuration.security.identity));
+		m_server = boost::make_shared<fscp::server>(boost::ref(m_io_service), boost::cref(*m_configuration.security.identity), m_configuration.fscp.buffer_count);
 
-		m_server->set_debug_callback([this] (fscp::server::debug_event event, const std::string& context, const boost::optional<ep_type>& ep) {
+		// The log level cannot change while the core is running: without tracing, the server does not even need to report its debug events.
+		if (m_logger.is_enabled(LL_TRACE))
+		{
+			m_server->set_debug_callback([this] (fscp::server::debug_event event, const std::string& context, const boost::optional<ep_type>& ep) {
 
-			if (ep)
-			{
-				m_logger(LL_TRACE) << context << ": " << event << " (" << *ep << ")";
-			}
-			else
-			{
-				m_logger(LL_TRACE) << context << ": " << event;
-			}
-		});
+				if (ep)
+				{
+					m_logger(LL_TRACE) << context << ": " << event << " (" << *ep << ")";
+				}
+				else
+				{
+					m_logger(LL_TRACE) << context << ": " << event;
+				}
+			});
+		}
 
 		m_server->set_cipher_suites(m_configuration.fscp.cipher_suite_capabilities);
 		m_server->set_elliptic_curves(m_configuration.fscp.elliptic_curve_capabilities);
+		m_server->set_latency_sampling_rate(m_configuration.fscp.latency_sampling_rate);
 
 		m_server->set_hello_message_received_callback(boost::bind(&core::do_handle_hello_received, this, _1, _2));
 		m_server->set_contact_request_received_callback(boost::bind(&core::do_handle_contact_request_received, this, _1, _2, _3, _4));
@@ -571,6 +637,24 @@ namespace freelan
 			m_logger(LL_INFORMATION) << "Configured not to accept requests from: " << network_address;
 		}
 
+#ifdef LINUX
+		if (m_configuration.fscp.io_uring_enabled)
+		{
+			boost::system::error_code ec;
+
+			m_server->enable_io_uring(SERVER_IO_URING_ENTRIES, ec);
+
+			if (ec)
+			{
+				m_logger(LL_WARNING) << "Unable to use io_uring on the socket, using the event loop instead: " << ec.message();
+			}
+			else
+			{
+				m_logger(LL_INFORMATION) << "Using io_uring on the socket.";
+			}
+		}
+#endif
+
 		// Let's open the server.
 		m_server->open(listen_endpoint);
 
@@ -606,6 +690,8 @@ namespace freelan
 		m_dynamic_contact_timer.cancel();
 		m_contact_timer.cancel();
 
+		m_link_test_strand.post(boost::bind(&core::do_cancel_link_tests, this, boost::optional<ep_type>(), boost::system::error_code(boost::asio::error::operation_aborted)));
+
 		m_server->close();
 	}
 
@@ -897,6 +983,13 @@ namespace freelan
 		{
 			async_send_routes_request_to_all();
 
+			if (m_configuration.tap_adapter.type == tap_adapter_configuration::tap_adapter_type::tun)
+			{
+				const auto statistics = m_router.route_cache_statistics();
+
+				m_logger(LL_DEBUG) << "Route cache: " << statistics.hits << " hit(s), " << statistics.misses << " miss(es) (" << static_cast<int>(statistics.hit_ratio() * 100) << "% hit ratio)";
+			}
+
 			m_routes_request_timer.expires_from_now(ROUTES_REQUEST_PERIOD);
 			m_routes_request_timer.async_wait(boost::bind(&core::do_handle_periodic_routes_request, this, boost::asio::placeholders::error));
 		}
@@ -1003,7 +1096,7 @@ namespace freelan
 
 	bool core::do_handle_presentation_received(const ep_type& sender, cert_type sig_cert, fscp::server::presentation_status_type status, bool has_session)
 	{
-		if (m_logger.level() <= LL_DEBUG)
+		if (m_logger.is_enabled(LL_DEBUG))
 		{
 			m_logger(LL_DEBUG) << "Received PRESENTATION from " << sender << ": " << sig_cert.subject().oneline() << ".";
 		}
@@ -1040,7 +1133,7 @@ namespace freelan
 	{
 		m_logger(LL_DEBUG) << "Received SESSION_REQUEST from " << sender << " (default: " << (default_accept ? std::string("accept") : std::string("deny")) << ").";
 
-		if (m_logger.level() <= LL_DEBUG)
+		if (m_logger.is_enabled(LL_DEBUG))
 		{
 			std::ostringstream oss;
 
@@ -1152,6 +1245,8 @@ namespace freelan
 			m_session_lost_callback(host, reason);
 		}
 
+		m_link_test_strand.post(boost::bind(&core::do_cancel_link_tests, this, boost::optional<ep_type>(host), make_error_code(fscp::server_error::no_session_for_host)));
+
 		if (m_configuration.tap_adapter.type == tap_adapter_configuration::tap_adapter_type::tap)
 		{
 			async_unregister_switch_port(host, void_handler_type());
@@ -1170,9 +1265,20 @@ namespace freelan
 		{
 			// Channel 0 contains ethernet/ip frames
 			case fscp::CHANNEL_NUMBER_0:
+			{
+				fscp::latency_stamp stamp = m_latency_sampler.sample();
+
+				if (m_tcp_mss_clamping_mtu > 0)
+				{
+					// The data lies in the buffer we were given and that nobody else references yet, so we can modify it in place.
+					const boost::asio::mutable_buffer frame(const_cast<uint8_t*>(buffer_cast<const uint8_t*>(data)), buffer_size(data));
+
+					clamp_tcp_maximum_segment_size(frame, m_configuration.tap_adapter.type, m_tcp_mss_clamping_mtu);
+				}
+
 				if (m_configuration.tap_adapter.type == tap_adapter_configuration::tap_adapter_type::tap)
 				{
-					async_write_switch(
+					do_write_switch(
 						make_port_index(sender),
 						data,
 						make_shared_buffer_handler(
@@ -1183,7 +1289,7 @@ namespace freelan
 				}
 				else
 				{
-					async_write_router(
+					do_write_router(
 						make_port_index(sender),
 						data,
 						make_shared_buffer_handler(
@@ -1193,7 +1299,10 @@ namespace freelan
 					);
 				}
 
+				stamp.lap(m_latency.receive_forwarding);
+
 				break;
+			}
 			// Channel 1 contains messages
 			case fscp::CHANNEL_NUMBER_1:
 				try
@@ -1207,6 +1316,18 @@ namespace freelan
 					m_logger(LL_WARNING) << "Received incorrectly formatted message from " << sender << ". Error was: " << ex.what();
 				}
 
+				break;
+			// Channel 2 contains link test messages
+			case fscp::CHANNEL_NUMBER_2:
+				try
+				{
+					do_handle_link_test_message(sender, buffer, data);
+				}
+				catch (std::runtime_error& ex)
+				{
+					m_logger(LL_WARNING) << "Received incorrectly formatted link test message from " << sender << ". Error was: " << ex.what();
+				}
+
 				break;
 			default:
 				m_logger(LL_WARNING) << "Received unhandled " << buffer_size(data) << " byte(s) of data on FSCP channel #" << static_cast<int>(channel_number);
@@ -1477,12 +1598,35 @@ namespace freelan
 			m_tap_adapter = boost::make_shared<asiotap::tap_adapter>(boost::ref(m_io_service), tap_adapter_type);
 
 			const auto write_func = [this] (boost::asio::const_buffer data, simple_handler_type handler) {
-				async_write_tap(buffer(data), [handler](const boost::system::error_code& ec, size_t) {
+				async_write_tap(data, [handler](const boost::system::error_code& ec, size_t) {
 					handler(ec);
 				});
 			};
 
+#ifdef WINDOWS
+			if (!m_configuration.tap_adapter.pcap_input_file.empty() || !m_configuration.tap_adapter.pcap_output_file.empty())
+			{
+				m_logger(LL_WARNING) << "Virtual tap adapters are not supported on Windows: ignoring the pcap files.";
+			}
+
 			m_tap_adapter->open(m_configuration.tap_adapter.name);
+#else
+			if (!m_configuration.tap_adapter.pcap_input_file.empty() || !m_configuration.tap_adapter.pcap_output_file.empty())
+			{
+				open_virtual_tap_adapter();
+			}
+			else
+			{
+				m_tap_adapter->open(m_configuration.tap_adapter.name, m_configuration.tap_adapter.queue_count, m_configuration.tap_adapter.offloading_enabled);
+			}
+#endif
+
+			m_tap_adapter_queues.clear();
+
+			for (size_t index = 0; index < m_tap_adapter->queue_count(); ++index)
+			{
+				m_tap_adapter_queues.push_back(boost::make_shared<tap_adapter_queue_type>(boost::ref(m_io_service), index));
+			}
 
 			asiotap::tap_adapter_configuration tap_config;
 
@@ -1491,6 +1635,54 @@ namespace freelan
 
 			m_logger(LL_IMPORTANT) << "Tap adapter \"" << *m_tap_adapter << "\" opened in mode " << m_configuration.tap_adapter.type << " with a MTU set to: " << tap_config.mtu;
 
+			if (m_tap_adapter->queue_count() > 1)
+			{
+				m_logger(LL_INFORMATION) << "Using " << m_tap_adapter->queue_count() << " queues on the tap adapter.";
+			}
+
+			if (m_tap_adapter->offloading_enabled())
+			{
+				m_logger(LL_INFORMATION) << "Checksum and segmentation offloading enabled on the tap adapter.";
+			}
+
+			const size_t link_frame_size = std::max<size_t>(m_tap_adapter->mtu(), tap_config.mtu) + sizeof(asiotap::osi::ethernet_frame) + ETHERNET_VLAN_TAG_SIZE;
+
+			// Offloaded frames can be as large as an IP datagram, regardless of the MTU.
+			const size_t max_frame_size = m_tap_adapter->offloading_enabled() ? fscp::LARGE_BLOCK_SIZE : link_frame_size;
+
+			// Frame buffers that are still in use from a previous opening keep their size until they are released: the reads only get new ones.
+			m_tap_adapter_memory_pool.resize(fscp::get_block_size_class(max_frame_size), m_configuration.tap_adapter.buffer_count);
+
+			m_logger(LL_DEBUG) << "Using " << m_tap_adapter_memory_pool.block_count() << " frame buffers of " << m_tap_adapter_memory_pool.block_size() << " bytes.";
+
+			// Offloaded frames are split before they are sent: the peers only send frames that fit their link.
+			m_server->async_set_maximum_data_size(link_frame_size);
+
+#ifdef LINUX
+			if (m_configuration.tap_adapter.io_uring_enabled)
+			{
+				boost::system::error_code ec;
+
+				m_tap_adapter->enable_io_uring(TAP_ADAPTER_IO_URING_ENTRIES, ec);
+
+				if (ec)
+				{
+					m_logger(LL_WARNING) << "Unable to use io_uring on the tap adapter, using the event loop instead: " << ec.message();
+				}
+				else
+				{
+					m_logger(LL_INFORMATION) << "Using io_uring on the tap adapter.";
+
+					m_tap_adapter->register_buffer(m_tap_adapter_memory_pool.region(), ec);
+
+					if (ec)
+					{
+						m_logger(LL_WARNING) << "Unable to register the tap adapter buffers with io_uring: " << ec.message();
+					}
+				}
+			}
+#endif
+
 			// IPv4 address
 			if (!m_configuration.tap_adapter.ipv4_address_prefix_length.is_null())
 			{
@@ -1634,6 +1826,13 @@ namespace freelan
 			}
 
 			async_read_tap();
+
+#ifndef WINDOWS
+			if (m_virtual_tap_peer)
+			{
+				m_virtual_tap_peer->start();
+			}
+#endif
 		}
 		else
 		{
@@ -1641,6 +1840,56 @@ namespace freelan
 		}
 	}
 
+#ifndef WINDOWS
+	void core::open_virtual_tap_adapter()
+	{
+		m_virtual_tap_peer = boost::make_shared<asiotap::virtual_tap_peer>(boost::ref(m_io_service));
+
+		m_tap_adapter->open_virtual(m_configuration.tap_adapter.name.empty() ? VIRTUAL_TAP_ADAPTER_DEFAULT_NAME : m_configuration.tap_adapter.name, m_virtual_tap_peer->descriptor());
+
+		m_logger(LL_INFORMATION) << "Using a virtual tap adapter.";
+
+		if ((m_configuration.tap_adapter.queue_count > 1) || m_configuration.tap_adapter.offloading_enabled)
+		{
+			m_logger(LL_WARNING) << "Virtual tap adapters have a single queue and no offloading: ignoring the queue count and the offloading settings.";
+		}
+
+		if (!m_configuration.tap_adapter.pcap_input_file.empty())
+		{
+			const asiotap::virtual_tap_peer::frame_list_type frames = asiotap::read_pcap_frames(m_configuration.tap_adapter.pcap_input_file.string(), m_tap_adapter->layer());
+
+			m_logger(LL_INFORMATION) << "Replaying " << frames.size() << " frame(s) from " << m_configuration.tap_adapter.pcap_input_file.string() << ".";
+
+			m_virtual_tap_peer->set_frames(frames);
+			m_virtual_tap_peer->set_rate(m_configuration.tap_adapter.pcap_replay_rate);
+			m_virtual_tap_peer->set_replay_count(m_configuration.tap_adapter.pcap_replay_count);
+			m_virtual_tap_peer->set_replay_delay(std::chrono::microseconds(m_configuration.tap_adapter.pcap_replay_delay.total_microseconds()));
+
+			const boost::weak_ptr<asiotap::virtual_tap_peer> weak_virtual_tap_peer = m_virtual_tap_peer;
+
+			m_virtual_tap_peer->set_replay_done_handler([this, weak_virtual_tap_peer] () {
+				const boost::shared_ptr<asiotap::virtual_tap_peer> virtual_tap_peer = weak_virtual_tap_peer.lock();
+
+				if (virtual_tap_peer)
+				{
+					m_logger(LL_INFORMATION) << "Done replaying " << virtual_tap_peer->statistics().frames_replayed << " frame(s) into the virtual tap adapter.";
+				}
+			});
+		}
+
+		if (!m_configuration.tap_adapter.pcap_output_file.empty())
+		{
+			const boost::shared_ptr<asiotap::pcap_writer> writer = boost::make_shared<asiotap::pcap_writer>();
+
+			writer->open(m_configuration.tap_adapter.pcap_output_file.string(), asiotap::to_pcap_link_type(m_tap_adapter->layer()));
+
+			m_logger(LL_INFORMATION) << "Capturing the frames written to the virtual tap adapter to " << m_configuration.tap_adapter.pcap_output_file.string() << ".";
+
+			m_virtual_tap_peer->set_capture_writer(writer);
+		}
+	}
+#endif
+
 	void core::close_tap_adapter()
 	{
 		// Clear the endpoint routes, if any.
@@ -1667,139 +1916,634 @@ namespace freelan
 			m_tap_adapter->set_connected_state(false);
 
 			m_tap_adapter->close();
+
+#ifndef WINDOWS
+			if (m_virtual_tap_peer)
+			{
+				const asiotap::virtual_tap_peer::statistics_type statistics = m_virtual_tap_peer->statistics();
+
+				m_logger(LL_INFORMATION) << "Virtual tap adapter closed: " << statistics.frames_replayed << " frame(s) replayed, " << statistics.frames_captured << " frame(s) captured.";
+
+				m_virtual_tap_peer->stop();
+				m_virtual_tap_peer.reset();
+			}
+#endif
 		}
 	}
 
-	void core::async_get_tap_addresses(ip_network_address_list_handler_type handler)
+	void core::async_get_statistics(statistics_handler_type handler)
 	{
-		if (m_tap_adapter)
+		statistics_type statistics;
+
+		statistics.tap_adapter_read = m_tap_adapter_read.value();
+		statistics.tap_adapter_written = m_tap_adapter_written.value();
+		statistics.tap_adapter_write_queue_depth = m_tap_adapter_write_queue_depth.value();
+		statistics.tap_adapter_buffer_heap_allocations = m_tap_adapter_memory_pool.heap_allocation_count();
+		statistics.proxy_buffer_heap_allocations = m_proxy_memory_pool.heap_allocation_count();
+		statistics.switch_dropped_frames = m_switch.dropped_frame_count();
+		statistics.router_dropped_frames = m_router.dropped_frame_count();
+		statistics.route_cache = m_router.route_cache_statistics();
+		statistics.latency.send_forwarding = m_latency.send_forwarding.snapshot();
+		statistics.latency.receive_forwarding = m_latency.receive_forwarding.snapshot();
+		statistics.latency.receive_tap_write_queue = m_latency.receive_tap_write_queue.snapshot();
+		statistics.latency.receive_tap_write = m_latency.receive_tap_write.snapshot();
+
+		if (m_server)
 		{
-			m_tap_adapter_strand.post([this, handler](){
-			handler(m_tap_adapter->get_ip_addresses());
+			m_server->async_get_statistics([statistics, handler](const fscp::server::statistics_type& server_statistics) mutable {
+				statistics.server = server_statistics;
+
+				handler(statistics);
 			});
 		}
 		else
 		{
-			handler(asiotap::ip_network_address_list {});
+			handler(statistics);
 		}
 	}
 
-	void core::async_read_tap()
+	void core::async_run_link_test(const ep_type& host, const link_test_parameters& parameters, link_test_handler_type handler)
 	{
-		m_tap_adapter_strand.post(boost::bind(&core::do_read_tap, this));
-	}
+		if ((parameters.payload_size < link_test::MIN_PAYLOAD_SIZE) || (parameters.payload_size > link_test::MAX_PAYLOAD_SIZE) || (parameters.window == 0))
+		{
+			handler(boost::asio::error::invalid_argument, link_test_result());
 
-	void core::push_tap_write(void_handler_type handler)
-	{
-		// All push_write() calls are done in the same strand so the following is thread-safe.
-		if (m_tap_write_queue.empty())
+			return;
+		}
+
+		if (!m_server)
 		{
-			// Nothing is being written, lets start the write immediately.
-			m_tap_adapter_strand.post(make_causal_handler(handler, m_tap_write_queue_strand.wrap(boost::bind(&core::pop_tap_write, this))));
+			handler(make_error_code(fscp::server_error::server_offline), link_test_result());
+
+			return;
 		}
 
-		m_tap_write_queue.push(handler);
+		m_server->async_has_session_with_endpoint(
+			host,
+			[this, host, parameters, handler] (bool has_session)
+			{
+				if (!has_session)
+				{
+					handler(make_error_code(fscp::server_error::no_session_for_host), link_test_result());
+				}
+				else
+				{
+					m_link_test_strand.post(boost::bind(&core::do_run_link_test, this, host, parameters, handler));
+				}
+			}
+		);
 	}
 
-	void core::pop_tap_write()
+	void core::do_handle_link_test_message(const ep_type& sender, fscp::server::shared_buffer_type buffer, boost::asio::const_buffer data)
 	{
-		// All pop_write() calls are done in the same strand so the following is thread-safe.
-		m_tap_write_queue.pop();
+		const link_test_message msg(buffer_cast<const uint8_t*>(data), buffer_size(data));
 
-		if (!m_tap_write_queue.empty())
+		switch (msg.type())
 		{
-			m_tap_adapter_strand.post(make_causal_handler(m_tap_write_queue.front(), m_tap_write_queue_strand.wrap(boost::bind(&core::pop_tap_write, this))));
+			case link_test_message::MT_ECHO_RESPONSE:
+			case link_test_message::MT_REPORT:
+				m_link_test_strand.post(boost::bind(&core::do_handle_link_test_response, this, sender, buffer, data));
+
+				return;
+			case link_test_message::MT_DATA:
+			case link_test_message::MT_ECHO_REQUEST:
+			case link_test_message::MT_REPORT_REQUEST:
+				break;
+			default:
+				m_logger(LL_WARNING) << "Received link test message of unknown type " << static_cast<int>(msg.type()) << " from " << sender << ".";
+
+				return;
 		}
-	}
 
-	void core::do_read_tap()
-	{
-		// All calls to do_read_tap() are done within the m_tap_adapter_strand, so the following is safe.
-		assert(m_tap_adapter);
+		if (!m_configuration.fscp.accept_link_tests)
+		{
+			m_logger(LL_DEBUG) << "Received link test message from " << sender << " but ignoring as specified in the configuration.";
 
-		const tap_adapter_memory_pool::shared_buffer_type receive_buffer = m_tap_adapter_memory_pool.allocate_shared_buffer();
+			return;
+		}
 
-		m_tap_adapter->async_read(
-			buffer(receive_buffer),
-			m_proxies_strand.wrap(
-				boost::bind(
-					&core::do_handle_tap_adapter_read,
-					this,
-					receive_buffer,
-					boost::asio::placeholders::error,
-					boost::asio::placeholders::bytes_transferred
-				)
+		switch (msg.type())
+		{
+			case link_test_message::MT_DATA:
+				m_link_test_strand.post(boost::bind(&core::do_handle_link_test_data, this, sender, msg.test_id(), msg.sequence(), msg.size()));
+
+				break;
+			case link_test_message::MT_ECHO_REQUEST:
+			{
+				// The data lies in the buffer we were given and that nobody else references yet, so we can turn it into the response in place.
+				link_test_message::set_type(const_cast<uint8_t*>(buffer_cast<const uint8_t*>(data)), link_test_message::MT_ECHO_RESPONSE);
+
+				m_server->async_send_data(
+					sender,
+					fscp::CHANNEL_NUMBER_2,
+					data,
+					make_shared_buffer_handler(
+						buffer,
+						&null_simple_write_handler
+					)
+				);
+
+				break;
+			}
+			case link_test_message::MT_REPORT_REQUEST:
+				m_link_test_strand.post(boost::bind(&core::do_handle_link_test_report_request, this, sender, msg.test_id()));
+
+				break;
+			default:
+				break;
+		}
+	}
+
+	void core::do_run_link_test(const ep_type& host, const link_test_parameters& parameters, link_test_handler_type handler)
+	{
+		// All calls to do_run_link_test() are done within the m_link_test_strand, so the following is safe.
+		const link_test_message::test_id_type test_id = m_next_link_test_id++;
+
+		const boost::shared_ptr<link_test> test = boost::make_shared<link_test>(
+			boost::ref(m_io_service),
+			test_id,
+			parameters,
+			boost::bind(&fscp::server::async_send_data, m_server, host, fscp::CHANNEL_NUMBER_2, _1, _2)
+		);
+
+		m_link_tests[test_id] = std::make_pair(host, test);
+
+		m_logger(LL_INFORMATION) << "Starting link test #" << test_id << " with " << host << ": " << parameters.mode << " mode, " << parameters.payload_size << " byte(s) per message, " << parameters.window << " message(s) in flight for " << parameters.duration << ".";
+
+		test->start([this, test_id, host, handler] (const boost::system::error_code& ec, const link_test_result& result) {
+			m_link_test_strand.post([this, test_id] () {
+				m_link_tests.erase(test_id);
+			});
+
+			if (ec)
+			{
+				m_logger(LL_WARNING) << "Link test #" << test_id << " with " << host << " failed: " << ec.message();
+			}
+			else
+			{
+				const double seconds = std::chrono::duration_cast<std::chrono::duration<double> >(result.duration).count();
+
+				m_logger(LL_INFORMATION) << "Link test #" << test_id << " with " << host << " done: " << result.received_bytes << " byte(s) in " << seconds << " s (" << ((seconds > 0) ? (result.received_bytes * 8 / seconds / 1000000) : 0) << " Mbit/s), " << result.lost_packets << " of " << result.sent_packets << " message(s) lost.";
+			}
+
+			if (handler)
+			{
+				handler(ec, result);
+			}
+		});
+	}
+
+	void core::do_handle_link_test_response(const ep_type& sender, fscp::server::shared_buffer_type, boost::asio::const_buffer data)
+	{
+		// All calls to do_handle_link_test_response() are done within the m_link_test_strand, so the following is safe.
+		const link_test_message msg(buffer_cast<const uint8_t*>(data), buffer_size(data));
+		const link_test_map_type::const_iterator test = m_link_tests.find(msg.test_id());
+
+		// Responses to a finished test may still be in flight.
+		if ((test != m_link_tests.end()) && (test->second.first == sender))
+		{
+			test->second.second->handle_message(msg);
+		}
+	}
+
+	void core::do_handle_link_test_data(const ep_type& sender, link_test_message::test_id_type test_id, uint64_t sequence, size_t size)
+	{
+		// All calls to do_handle_link_test_data() are done within the m_link_test_strand, so the following is safe.
+		link_test_sink_type& sink = m_link_test_sinks[sender];
+
+		if (sink.test_id != test_id)
+		{
+			m_logger(LL_INFORMATION) << "Receiving link test #" << test_id << " from " << sender << ".";
+
+			sink = link_test_sink_type();
+			sink.test_id = test_id;
+		}
+
+		if ((sink.received_packets > 0) && (sequence < sink.highest_sequence))
+		{
+			++sink.reordered_packets;
+		}
+		else
+		{
+			sink.highest_sequence = sequence;
+		}
+
+		++sink.received_packets;
+		sink.received_bytes += size;
+	}
+
+	void core::do_handle_link_test_report_request(const ep_type& sender, link_test_message::test_id_type test_id)
+	{
+		// All calls to do_handle_link_test_report_request() are done within the m_link_test_strand, so the following is safe.
+		assert(m_server);
+
+		link_test_sink_type sink;
+		const link_test_sink_map_type::const_iterator sink_it = m_link_test_sinks.find(sender);
+
+		// A test whose data messages were all lost has no sink yet: its report is empty.
+		if ((sink_it != m_link_test_sinks.end()) && (sink_it->second.test_id == test_id))
+		{
+			sink = sink_it->second;
+		}
+
+		m_logger(LL_DEBUG) << "Sending link test #" << test_id << " report to " << sender << ": " << sink.received_packets << " message(s) received.";
+
+		// We take the proxy memory because we don't need much place and the tap_adapter_memory_pool is way more critical.
+		const proxy_memory_pool::shared_buffer_type data_buffer = m_proxy_memory_pool.allocate_shared_buffer();
+
+		const size_t size = link_test_message::write_report(
+			buffer_cast<uint8_t*>(data_buffer),
+			buffer_size(data_buffer),
+			test_id,
+			sink.received_packets,
+			sink.received_bytes,
+			sink.highest_sequence,
+			sink.reordered_packets
+		);
+
+		m_server->async_send_data(
+			sender,
+			fscp::CHANNEL_NUMBER_2,
+			buffer(data_buffer, size),
+			make_shared_buffer_handler(
+				data_buffer,
+				&null_simple_write_handler
 			)
 		);
 	}
 
-	void core::do_handle_tap_adapter_read(tap_adapter_memory_pool::shared_buffer_type receive_buffer, const boost::system::error_code& ec, size_t count)
+	void core::do_cancel_link_tests(const boost::optional<ep_type>& host, const boost::system::error_code& ec)
 	{
-		// All calls to do_read_tap() are done within the m_proxies_strand, so the following is safe.
-		if (ec != boost::asio::error::operation_aborted)
+		// All calls to do_cancel_link_tests() are done within the m_link_test_strand, so the following is safe.
+		for (link_test_map_type::const_iterator test = m_link_tests.begin(); test != m_link_tests.end(); ++test)
 		{
-			// We try to read again, as soon as possible.
-			async_read_tap();
+			if (!host || (test->second.first == *host))
+			{
+				// The completion handler removes the test from the map.
+				test->second.second->cancel(ec);
+			}
+		}
+
+		if (host)
+		{
+			m_link_test_sinks.erase(*host);
+		}
+		else
+		{
+			m_link_test_sinks.clear();
+		}
+	}
+
+	void core::async_get_tap_addresses(ip_network_address_list_handler_type handler)
+	{
+		if (m_tap_adapter)
+		{
+			m_tap_adapter_strand.post([this, handler](){
+			handler(m_tap_adapter->get_ip_addresses());
+			});
+		}
+		else
+		{
+			handler(asiotap::ip_network_address_list {});
+		}
+	}
+
+	void core::async_read_tap()
+	{
+		for (auto&& queue : m_tap_adapter_queues)
+		{
+			async_read_tap(queue);
+		}
+	}
+
+	void core::async_read_tap(tap_adapter_queue_ptr_type queue)
+	{
+		queue->strand.post(boost::bind(&core::do_read_tap, this, queue));
+	}
+
+	core::tap_adapter_queue_ptr_type core::get_tap_adapter_queue_for(boost::asio::const_buffer data) const
+	{
+		assert(!m_tap_adapter_queues.empty());
+
+		if (m_tap_adapter_queues.size() == 1)
+		{
+			return m_tap_adapter_queues.front();
+		}
+
+		// Frames between the same hosts always go through the same queue, so that they are never reordered.
+		const uint8_t* const frame = buffer_cast<const uint8_t*>(data);
+		const size_t frame_size = buffer_size(data);
+
+		size_t offset = 0;
+		size_t length = 0;
+
+		if (m_tap_adapter->layer() == asiotap::tap_adapter_layer::ethernet)
+		{
+			// The target and sender ethernet addresses.
+			length = 12;
+		}
+		else if (frame_size > 0)
+		{
+			if (((frame[0] & 0xF0) >> 4) == asiotap::osi::IP_PROTOCOL_VERSION_4)
+			{
+				offset = 12;
+				length = 8;
+			}
+			else
+			{
+				offset = 8;
+				length = 32;
+			}
+		}
+
+		// FNV-1a: its high bits are well mixed, so we scale the hash rather than taking its modulo.
+		uint32_t hash = 2166136261u;
+
+		for (size_t i = offset; (i < offset + length) && (i < frame_size); ++i)
+		{
+			hash = (hash ^ frame[i]) * 16777619u;
+		}
+
+		return m_tap_adapter_queues[(static_cast<uint64_t>(hash) * m_tap_adapter_queues.size()) >> 32];
+	}
+
+	void core::async_write_tap(boost::asio::const_buffer data, io_handler_type handler)
+	{
+		m_tap_adapter_written.add(buffer_size(data));
+
+		const tap_adapter_queue_ptr_type queue = get_tap_adapter_queue_for(data);
+
+		bool schedule_flush = false;
+
+		{
+			boost::mutex::scoped_lock lock(queue->write_mutex);
+
+			queue->pending_writes.push_back(tap_write_type(data, handler, m_latency_sampler.sample()));
+			m_tap_adapter_write_queue_depth.add();
+
+			// Only one flush is scheduled at a time: it writes everything that was queued until it runs.
+			schedule_flush = !queue->write_scheduled;
+			queue->write_scheduled = true;
+		}
+
+		if (schedule_flush)
+		{
+			queue->write_strand.post(boost::bind(&core::flush_tap_writes, this, queue));
+		}
+	}
+
+	void core::flush_tap_writes(tap_adapter_queue_ptr_type queue)
+	{
+		// All calls to flush_tap_writes() for a given queue are done within its write strand, so the following is safe.
+		{
+			boost::mutex::scoped_lock lock(queue->write_mutex);
+
+			queue->write_batch.swap(queue->pending_writes);
+			queue->write_scheduled = false;
+		}
+
+		m_tap_adapter_write_queue_depth.subtract(queue->write_batch.size());
+
+		for (auto&& write : queue->write_batch)
+		{
+			io_handler_type handler = write.handler;
+
+			if (write.stamp.is_sampled())
+			{
+				write.stamp.lap(m_latency.receive_tap_write_queue);
+				handler = fscp::make_latency_handler(write.stamp, m_latency.receive_tap_write, handler);
+			}
+
+			FREELAN_TRACEPOINT(tap_write, queue->index, buffer_size(write.data));
+
+			if (m_tap_adapter->offloading_enabled())
+			{
+				// The frames we write were already segmented and checksummed: we just have to prepend an empty header.
+				const boost::array<boost::asio::const_buffer, 2> buffers = {{ asiotap::osi::null_vnet_header_buffer(), write.data }};
+
+				write_tap_frame(*m_tap_adapter, queue->index, buffers, handler);
+			}
+			else
+			{
+				write_tap_frame(*m_tap_adapter, queue->index, buffer(write.data), handler);
+			}
 		}
 
+		queue->write_batch.clear();
+	}
+
+	void core::do_read_tap(tap_adapter_queue_ptr_type queue)
+	{
+		// All calls to do_read_tap() for a given queue are done within its strand, so the following is safe.
+		assert(m_tap_adapter);
+
+		const tap_adapter_memory_pool::shared_buffer_type receive_buffer = m_tap_adapter_memory_pool.allocate_shared_buffer();
+
+		// The frames of a queue must be forwarded in the order they were read: the completion runs within the queue strand.
+		const auto handler = queue->strand.wrap(
+			boost::bind(
+				&core::do_handle_tap_adapter_read,
+				this,
+				queue,
+				receive_buffer,
+				boost::asio::placeholders::error,
+				boost::asio::placeholders::bytes_transferred
+			)
+		);
+
+		m_tap_adapter->async_read(queue->index, buffer(receive_buffer), handler);
+	}
+
+	void core::do_handle_tap_adapter_read(tap_adapter_queue_ptr_type queue, tap_adapter_memory_pool::shared_buffer_type receive_buffer, const boost::system::error_code& ec, size_t count)
+	{
+		// All calls to do_handle_tap_adapter_read() for a given queue are done within its strand, so the following is safe.
 		if (!ec)
 		{
-			const boost::asio::const_buffer data = buffer(receive_buffer, count);
+			do_handle_tap_adapter_data(receive_buffer, buffer(receive_buffer, count));
+
+#ifndef WINDOWS
+			// The frames that are already pending are read right away, saving a round-trip through the reactor for each of them.
+			//
+			// With io_uring, the reads do not go through the descriptor and the ring already batches them.
+			for (unsigned int i = 1; (i < m_configuration.tap_adapter.read_batch_size) && !m_tap_adapter->io_uring_enabled(); ++i)
+			{
+				const tap_adapter_memory_pool::shared_buffer_type next_receive_buffer = m_tap_adapter_memory_pool.allocate_shared_buffer();
+
+				boost::system::error_code read_ec;
+				const size_t read_count = m_tap_adapter->try_read(queue->index, buffer(next_receive_buffer), read_ec);
+
+				if (read_ec)
+				{
+					// Either nothing is pending or the next asynchronous read will report the error.
+					break;
+				}
+
+				do_handle_tap_adapter_data(next_receive_buffer, buffer(next_receive_buffer, read_count));
+			}
+#endif
+		}
+		else if (ec != boost::asio::error::operation_aborted)
+		{
+			m_logger(LL_ERROR) << "Read failed on " << m_tap_adapter->name() << ". Error: " << ec.message();
+		}
 
+		if (ec != boost::asio::error::operation_aborted)
+		{
+			// We read again once the pending frames were drained, so that no other read on this queue completes meanwhile.
+			async_read_tap(queue);
+		}
+	}
+
+	void core::do_handle_tap_adapter_data(tap_adapter_memory_pool::shared_buffer_type receive_buffer, boost::asio::mutable_buffer data)
+	{
 #ifdef FREELAN_DEBUG
-			std::cerr << "Read " << buffer_size(data) << " byte(s) on " << *m_tap_adapter << std::endl;
+		std::cerr << "Read " << buffer_size(data) << " byte(s) on " << *m_tap_adapter << std::endl;
 #endif
 
-			if (m_tap_adapter->layer() == asiotap::tap_adapter_layer::ethernet)
+		m_tap_adapter_read.add(buffer_size(data));
+		FREELAN_TRACEPOINT(tap_read, buffer_size(data));
+
+		fscp::latency_stamp stamp = m_latency_sampler.sample();
+
+		if (m_tap_adapter->offloading_enabled())
+		{
+			do_handle_tap_adapter_offloaded_frame(receive_buffer, data);
+		}
+		else
+		{
+			if (m_tcp_mss_clamping_mtu > 0)
 			{
-				bool handled = false;
+				clamp_tcp_maximum_segment_size(data, m_configuration.tap_adapter.type, m_tcp_mss_clamping_mtu);
+			}
 
-				if (m_arp_proxy || m_dhcp_proxy)
-				{
-					// This line will eventually call the filters callbacks.
-					m_ethernet_filter.parse(data);
+			do_handle_tap_adapter_frame(receive_buffer, data);
+		}
 
-					if (m_arp_proxy && m_arp_filter.get_last_helper())
-					{
-						handled = true;
-						m_arp_filter.clear_last_helper();
-					}
+		stamp.lap(m_latency.send_forwarding);
+	}
 
-					if (m_dhcp_proxy && m_dhcp_filter.get_last_helper())
-					{
-						handled = true;
-						m_dhcp_filter.clear_last_helper();
-					}
-				}
+	void core::do_handle_tap_adapter_offloaded_frame(tap_adapter_memory_pool::shared_buffer_type receive_buffer, boost::asio::mutable_buffer data)
+	{
+		using asiotap::osi::vnet_header;
+
+		if (buffer_size(data) < sizeof(vnet_header))
+		{
+			return;
+		}
+
+		vnet_header header;
+		std::memcpy(&header, buffer_cast<const void*>(data), sizeof(header));
 
-				if (!handled)
+		const boost::asio::mutable_buffer frame = data + sizeof(header);
+
+		if (header.gso_type == asiotap::osi::VNET_HEADER_GSO_NONE)
+		{
+			if (header.flags & asiotap::osi::VNET_HEADER_FLAG_NEEDS_CHECKSUM)
+			{
+				if (!asiotap::osi::complete_checksum(header, frame))
 				{
-					async_write_switch(
-						make_port_index(m_tap_adapter),
-						data,
-						make_shared_buffer_handler(
-							receive_buffer,
-							&null_switch_write_handler
-						)
-					);
+					return;
 				}
 			}
-			else
+
+			// Segmentation offloading is never used for SYN packets, so they can only be found here.
+			if (m_tcp_mss_clamping_mtu > 0)
+			{
+				clamp_tcp_maximum_segment_size(frame, m_configuration.tap_adapter.type, m_tcp_mss_clamping_mtu);
+			}
+
+			do_handle_tap_adapter_frame(receive_buffer, frame);
+
+			return;
+		}
+
+		// This is a TCP super-packet: the segments must fit in the tunnel so we split it right away.
+		size_t network_offset = 0;
+
+		if (m_tap_adapter->layer() == asiotap::tap_adapter_layer::ethernet)
+		{
+			network_offset = sizeof(asiotap::osi::ethernet_frame);
+
+			if ((buffer_size(frame) >= network_offset) && (ntohs(buffer_cast<const asiotap::osi::ethernet_frame*>(frame)->protocol) == ETHERNET_VLAN_PROTOCOL))
 			{
-				// This is a TUN interface. We receive either IPv4 or IPv6 frames.
-				async_write_router(
+				network_offset += ETHERNET_VLAN_TAG_SIZE;
+			}
+		}
+
+		const asiotap::osi::tcp_segmenter segmenter(header, frame, network_offset);
+
+		if (segmenter.segment_count() == 0)
+		{
+#ifdef FREELAN_DEBUG
+			std::cerr << "Dropping a super-packet of type " << static_cast<unsigned int>(header.gso_type) << " read on " << *m_tap_adapter << std::endl;
+#endif
+
+			return;
+		}
+
+		// Several segments are written in the same buffer, which lives as long as the last segment written in it.
+		tap_adapter_memory_pool::shared_buffer_type segment_buffer;
+		boost::asio::mutable_buffer available_space;
+
+		for (size_t index = 0; index < segmenter.segment_count(); ++index)
+		{
+			if (buffer_size(available_space) < segmenter.segment_size(index))
+			{
+				segment_buffer = m_tap_adapter_memory_pool.allocate_shared_buffer();
+				available_space = buffer(segment_buffer);
+			}
+
+			const boost::asio::const_buffer segment = segmenter.write_segment(index, available_space);
+			available_space = available_space + buffer_size(segment);
+
+			do_handle_tap_adapter_frame(segment_buffer, segment);
+		}
+	}
+
+	void core::do_handle_tap_adapter_frame(tap_adapter_memory_pool::shared_buffer_type receive_buffer, boost::asio::const_buffer data)
+	{
+		if (m_tap_adapter->layer() == asiotap::tap_adapter_layer::ethernet)
+		{
+			bool handled = false;
+
+			// The parsers have no state: several frames can be handled concurrently.
+			if (m_arp_proxy)
+			{
+				handled = arp_parser_type::parse(data, [this](ethernet_helper_type ethernet_helper, arp_helper_type arp_helper) {
+					do_handle_arp_frame(ethernet_helper, arp_helper);
+				});
+			}
+
+			if (m_dhcp_proxy && !handled)
+			{
+				handled = dhcp_parser_type::parse(data, [this](ethernet_helper_type ethernet_helper, ipv4_helper_type ipv4_helper, udp_helper_type udp_helper, bootp_helper_type bootp_helper, dhcp_helper_type dhcp_helper) {
+					do_handle_dhcp_frame(ethernet_helper, ipv4_helper, udp_helper, bootp_helper, dhcp_helper);
+				});
+			}
+
+			if (!handled)
+			{
+				do_write_switch(
 					make_port_index(m_tap_adapter),
 					data,
 					make_shared_buffer_handler(
 						receive_buffer,
-						&null_router_write_handler
+						&null_switch_write_handler
 					)
 				);
 			}
 		}
-		else if (ec != boost::asio::error::operation_aborted)
+		else
 		{
-			m_logger(LL_ERROR) << "Read failed on " << m_tap_adapter->name() << ". Error: " << ec.message();
+			// This is a TUN interface. We receive either IPv4 or IPv6 frames.
+			do_write_router(
+				make_port_index(m_tap_adapter),
+				data,
+				make_shared_buffer_handler(
+					receive_buffer,
+					&null_router_write_handler
+				)
+			);
 		}
 	}
 
@@ -1814,22 +2558,22 @@ namespace freelan
 		}
 	}
 
-	void core::do_handle_arp_frame(const arp_helper_type& helper)
+	void core::do_handle_arp_frame(ethernet_helper_type ethernet_helper, arp_helper_type arp_helper)
 	{
 		if (m_arp_proxy)
 		{
 			const proxy_memory_pool::shared_buffer_type response_buffer = m_proxy_memory_pool.allocate_shared_buffer();
 
 			const boost::optional<boost::asio::const_buffer> data = m_arp_proxy->process_frame(
-				*m_arp_filter.parent().get_last_helper(),
-				helper,
+				ethernet_helper,
+				arp_helper,
 				buffer(response_buffer)
 			);
 
 			if (data)
 			{
 				async_write_tap(
-					buffer(*data),
+					*data,
 					make_shared_buffer_handler(
 						response_buffer,
 						boost::bind(
@@ -1843,25 +2587,25 @@ namespace freelan
 		}
 	}
 
-	void core::do_handle_dhcp_frame(const dhcp_helper_type& helper)
+	void core::do_handle_dhcp_frame(ethernet_helper_type ethernet_helper, ipv4_helper_type ipv4_helper, udp_helper_type udp_helper, bootp_helper_type bootp_helper, dhcp_helper_type dhcp_helper)
 	{
 		if (m_dhcp_proxy)
 		{
 			const proxy_memory_pool::shared_buffer_type response_buffer = m_proxy_memory_pool.allocate_shared_buffer();
 
 			const boost::optional<boost::asio::const_buffer> data = m_dhcp_proxy->process_frame(
-				*m_dhcp_filter.parent().parent().parent().parent().get_last_helper(),
-				*m_dhcp_filter.parent().parent().parent().get_last_helper(),
-				*m_dhcp_filter.parent().parent().get_last_helper(),
-				*m_dhcp_filter.parent().get_last_helper(),
-				helper,
+				ethernet_helper,
+				ipv4_helper,
+				udp_helper,
+				bootp_helper,
+				dhcp_helper,
 				buffer(response_buffer)
 			);
 
 			if (data)
 			{
 				async_write_tap(
-					buffer(*data),
+					*data,
 					make_shared_buffer_handler(
 						response_buffer,
 						boost::bind(
@@ -1961,13 +2705,13 @@ namespace freelan
 
 	void core::do_write_switch(const port_index_type& index, boost::asio::const_buffer data, switch_::multi_write_handler_type handler)
 	{
-		// All calls to do_write_switch() are done within the m_router_strand, so the following is safe.
+		// Forwarding only reads the published tables, so it is safe from any thread.
 		m_switch.async_write(index, data, handler);
 	}
 
 	void core::do_write_router(const port_index_type& index, boost::asio::const_buffer data, router::port_type::write_handler_type handler)
 	{
-		// All calls to do_write_router() are done within the m_router_strand, so the following is safe.
+		// Forwarding only reads the published tables, so it is safe from any thread.
 		m_router.async_write(index, data, handler);
 	}
 }
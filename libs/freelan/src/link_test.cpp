@@ -0,0 +1,481 @@
+/*
+ * libfreelan - A C++ library to establish peer-to-peer virtual private
+ * networks.
+ * Copyright (C) 2010-2011 Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libfreelan.
+ *
+ * libfreelan is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libfreelan is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libfreelan in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+
+/**
+ * \file link_test.cpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief A throughput and latency test over an established session.
+ */
+
+#include "link_test.hpp"
+
+#include <boost/bind.hpp>
+
+#include <stdexcept>
+#include <string>
+
+namespace freelan
+{
+	namespace
+	{
+		const boost::posix_time::time_duration TICK_PERIOD = boost::posix_time::milliseconds(10);
+
+		// In sink mode, a probe is sent alongside the data messages at most this often.
+		const fscp::latency_clock::duration PROBE_PERIOD = std::chrono::milliseconds(10);
+
+		// In echo mode, if no message came back for that long, the messages in flight are considered lost. Otherwise, lost messages would shrink the window until nothing is in flight anymore.
+		const fscp::latency_clock::duration STALL_PERIOD = std::chrono::milliseconds(200);
+
+		// In echo mode, how long to wait for the messages in flight once the sending stopped.
+		const fscp::latency_clock::duration DRAIN_PERIOD = std::chrono::seconds(1);
+
+		// In sink mode, the report is requested a little after the last data message was sent, so that it does not overtake it.
+		const fscp::latency_clock::duration REPORT_DELAY = std::chrono::milliseconds(100);
+		const fscp::latency_clock::duration REPORT_RETRY_PERIOD = std::chrono::milliseconds(500);
+		const fscp::latency_clock::duration REPORT_TIMEOUT = std::chrono::seconds(3);
+
+		uint64_t to_timestamp(fscp::latency_clock::time_point time_point)
+		{
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(time_point.time_since_epoch()).count());
+		}
+	}
+
+	std::ostream& operator<<(std::ostream& os, link_test_mode value)
+	{
+		switch (value)
+		{
+			case link_test_mode::sink:
+				return os << "sink";
+			case link_test_mode::echo:
+				return os << "echo";
+		}
+
+		return os << "unknown";
+	}
+
+	std::istream& operator>>(std::istream& is, link_test_mode& value)
+	{
+		std::string str;
+
+		if (is >> str)
+		{
+			if (str == "sink")
+			{
+				value = link_test_mode::sink;
+			}
+			else if (str == "echo")
+			{
+				value = link_test_mode::echo;
+			}
+			else
+			{
+				is.setstate(std::ios_base::failbit);
+			}
+		}
+
+		return is;
+	}
+
+	link_test::link_test(boost::asio::io_service& io_service, link_test_message::test_id_type _test_id, const link_test_parameters& parameters, send_function_type send_function) :
+		m_strand(io_service),
+		m_timer(io_service),
+		m_test_id(_test_id),
+		m_parameters(parameters),
+		m_send_function(send_function),
+		m_handler(),
+		m_phase(phase_type::sending),
+		// The buffers are zeroed once and for all: the padding of the messages never carries anything.
+		m_buffers(std::max(parameters.window, 1u), std::vector<uint8_t>(parameters.payload_size)),
+		m_free_buffers(),
+		m_control_buffer(link_test_message::HEADER_LENGTH),
+		m_control_buffer_busy(false),
+		m_start(),
+		m_stop(),
+		m_phase_deadline(),
+		m_last_control(),
+		m_last_progress(),
+		m_sent_packets(0),
+		m_sent_bytes(0),
+		m_probe_sequence(0),
+		m_in_flight(0),
+		m_received_packets(0),
+		m_received_bytes(0),
+		m_highest_sequence(0),
+		m_reordered_packets(0),
+		m_report(),
+		m_round_trip_time()
+	{
+		if ((parameters.payload_size < MIN_PAYLOAD_SIZE) || (parameters.payload_size > MAX_PAYLOAD_SIZE))
+		{
+			throw std::runtime_error("The link test payload size must be between " + std::to_string(MIN_PAYLOAD_SIZE) + " and " + std::to_string(MAX_PAYLOAD_SIZE) + " bytes");
+		}
+
+		for (size_t index = 0; index < m_buffers.size(); ++index)
+		{
+			m_free_buffers.push_back(index);
+		}
+	}
+
+	void link_test::start(handler_type handler)
+	{
+		const boost::shared_ptr<link_test> self = shared_from_this();
+
+		m_strand.dispatch([self, handler] () {
+			self->m_handler = handler;
+			self->m_start = fscp::latency_clock::now();
+			self->m_last_control = self->m_start;
+			self->m_last_progress = self->m_start;
+			self->m_phase_deadline = self->m_start + std::chrono::microseconds(self->m_parameters.duration.total_microseconds());
+
+			self->do_fill();
+			self->schedule_tick();
+		});
+	}
+
+	void link_test::cancel(const boost::system::error_code& ec)
+	{
+		m_strand.post(boost::bind(&link_test::do_finish, shared_from_this(), ec));
+	}
+
+	void link_test::handle_message(const link_test_message& message)
+	{
+		switch (message.type())
+		{
+			case link_test_message::MT_ECHO_RESPONSE:
+				m_strand.post(boost::bind(&link_test::do_handle_echo_response, shared_from_this(), message.sequence(), message.timestamp(), message.size()));
+				break;
+			case link_test_message::MT_REPORT:
+			{
+				const report_type report = { message.received_packets(), message.received_bytes(), message.reordered_packets() };
+
+				m_strand.post(boost::bind(&link_test::do_handle_report, shared_from_this(), report));
+				break;
+			}
+			default:
+				break;
+		}
+	}
+
+	void link_test::schedule_tick()
+	{
+		m_timer.expires_from_now(TICK_PERIOD);
+		m_timer.async_wait(m_strand.wrap(boost::bind(&link_test::do_tick, shared_from_this(), boost::asio::placeholders::error)));
+	}
+
+	void link_test::do_tick(const boost::system::error_code& ec)
+	{
+		if ((ec == boost::asio::error::operation_aborted) || (m_phase == phase_type::done))
+		{
+			return;
+		}
+
+		const fscp::latency_clock::time_point now = fscp::latency_clock::now();
+
+		switch (m_phase)
+		{
+			case phase_type::sending:
+			{
+				if (now >= m_phase_deadline)
+				{
+					m_stop = now;
+
+					if (m_parameters.mode == link_test_mode::sink)
+					{
+						m_phase = phase_type::reporting;
+						m_phase_deadline = now + REPORT_TIMEOUT;
+						m_last_control = now - REPORT_RETRY_PERIOD + REPORT_DELAY;
+					}
+					else
+					{
+						m_phase = phase_type::draining;
+						m_phase_deadline = now + DRAIN_PERIOD;
+
+						if (m_received_packets == m_sent_packets)
+						{
+							do_finish(boost::system::error_code());
+
+							return;
+						}
+					}
+				}
+				else if (m_parameters.mode == link_test_mode::sink)
+				{
+					if (now - m_last_control >= PROBE_PERIOD)
+					{
+						do_send_probe();
+					}
+				}
+				else if ((m_in_flight > 0) && (now - m_last_progress >= STALL_PERIOD))
+				{
+					m_in_flight = 0;
+					m_last_progress = now;
+
+					do_fill();
+				}
+
+				break;
+			}
+			case phase_type::draining:
+			{
+				if (now >= m_phase_deadline)
+				{
+					do_finish(boost::system::error_code());
+
+					return;
+				}
+
+				break;
+			}
+			case phase_type::reporting:
+			{
+				if (now >= m_phase_deadline)
+				{
+					do_finish(boost::asio::error::timed_out);
+
+					return;
+				}
+
+				if (now - m_last_control >= REPORT_RETRY_PERIOD)
+				{
+					do_send_report_request();
+				}
+
+				break;
+			}
+			case phase_type::done:
+				return;
+		}
+
+		schedule_tick();
+	}
+
+	void link_test::do_fill()
+	{
+		while ((m_phase == phase_type::sending) && !m_free_buffers.empty() && ((m_parameters.mode == link_test_mode::sink) || (m_in_flight < m_parameters.window)))
+		{
+			do_send_data();
+		}
+	}
+
+	void link_test::do_send_data()
+	{
+		const size_t index = m_free_buffers.back();
+		m_free_buffers.pop_back();
+
+		std::vector<uint8_t>& buffer = m_buffers[index];
+		const link_test_message::message_type type = (m_parameters.mode == link_test_mode::sink) ? link_test_message::MT_DATA : link_test_message::MT_ECHO_REQUEST;
+
+		link_test_message::write(&buffer[0], buffer.size(), type, m_test_id, m_sent_packets, to_timestamp(fscp::latency_clock::now()), buffer.size());
+
+		++m_sent_packets;
+		m_sent_bytes += buffer.size();
+
+		if (m_parameters.mode == link_test_mode::echo)
+		{
+			++m_in_flight;
+		}
+
+		m_send_function(boost::asio::buffer(buffer), m_strand.wrap(boost::bind(&link_test::do_handle_sent, shared_from_this(), index, _1)));
+	}
+
+	void link_test::do_send_probe()
+	{
+		if (m_control_buffer_busy)
+		{
+			return;
+		}
+
+		m_control_buffer_busy = true;
+		m_last_control = fscp::latency_clock::now();
+
+		link_test_message::write(&m_control_buffer[0], m_control_buffer.size(), link_test_message::MT_ECHO_REQUEST, m_test_id, m_probe_sequence++, to_timestamp(m_last_control), m_control_buffer.size());
+
+		m_send_function(boost::asio::buffer(m_control_buffer), m_strand.wrap(boost::bind(&link_test::do_handle_control_sent, shared_from_this(), _1)));
+	}
+
+	void link_test::do_send_report_request()
+	{
+		if (m_control_buffer_busy)
+		{
+			return;
+		}
+
+		m_control_buffer_busy = true;
+		m_last_control = fscp::latency_clock::now();
+
+		link_test_message::write(&m_control_buffer[0], m_control_buffer.size(), link_test_message::MT_REPORT_REQUEST, m_test_id, 0, to_timestamp(m_last_control), m_control_buffer.size());
+
+		m_send_function(boost::asio::buffer(m_control_buffer), m_strand.wrap(boost::bind(&link_test::do_handle_control_sent, shared_from_this(), _1)));
+	}
+
+	void link_test::do_handle_sent(size_t index, const boost::system::error_code& ec)
+	{
+		m_free_buffers.push_back(index);
+
+		if (ec)
+		{
+			do_finish(ec);
+
+			return;
+		}
+
+		do_fill();
+	}
+
+	void link_test::do_handle_control_sent(const boost::system::error_code& ec)
+	{
+		m_control_buffer_busy = false;
+
+		if (ec)
+		{
+			do_finish(ec);
+		}
+	}
+
+	void link_test::do_handle_echo_response(uint64_t sequence, uint64_t timestamp, size_t size)
+	{
+		if (m_phase == phase_type::done)
+		{
+			return;
+		}
+
+		const fscp::latency_clock::time_point now = fscp::latency_clock::now();
+		const uint64_t now_timestamp = to_timestamp(now);
+
+		if (timestamp <= now_timestamp)
+		{
+			m_round_trip_time.record(std::chrono::nanoseconds(now_timestamp - timestamp));
+		}
+
+		// In sink mode, only the probes are echoed.
+		if (m_parameters.mode == link_test_mode::echo)
+		{
+			if ((m_received_packets > 0) && (sequence < m_highest_sequence))
+			{
+				++m_reordered_packets;
+			}
+			else
+			{
+				m_highest_sequence = sequence;
+			}
+
+			++m_received_packets;
+			m_received_bytes += size;
+			m_last_progress = now;
+
+			if (m_in_flight > 0)
+			{
+				--m_in_flight;
+			}
+
+			if ((m_phase == phase_type::draining) && (m_received_packets >= m_sent_packets))
+			{
+				do_finish(boost::system::error_code());
+			}
+			else
+			{
+				do_fill();
+			}
+		}
+	}
+
+	void link_test::do_handle_report(const report_type& report)
+	{
+		if (m_phase == phase_type::reporting)
+		{
+			m_report = report;
+
+			do_finish(boost::system::error_code());
+		}
+	}
+
+	void link_test::do_finish(const boost::system::error_code& ec)
+	{
+		if (m_phase == phase_type::done)
+		{
+			return;
+		}
+
+		if (m_phase == phase_type::sending)
+		{
+			m_stop = fscp::latency_clock::now();
+		}
+
+		m_phase = phase_type::done;
+
+		boost::system::error_code ignored_ec;
+		m_timer.cancel(ignored_ec);
+
+		link_test_result result;
+
+		result.mode = m_parameters.mode;
+		result.payload_size = m_parameters.payload_size;
+		result.duration = (m_start == fscp::latency_clock::time_point()) ? fscp::latency_clock::duration() : m_stop - m_start;
+		result.sent_packets = m_sent_packets;
+		result.sent_bytes = m_sent_bytes;
+
+		if (m_parameters.mode == link_test_mode::echo)
+		{
+			result.received_packets = m_received_packets;
+			result.received_bytes = m_received_bytes;
+			result.reordered_packets = m_reordered_packets;
+		}
+		else if (m_report)
+		{
+			result.received_packets = m_report->received_packets;
+			result.received_bytes = m_report->received_bytes;
+			result.reordered_packets = m_report->reordered_packets;
+		}
+
+		result.lost_packets = (result.sent_packets > result.received_packets) ? (result.sent_packets - result.received_packets) : 0;
+		result.round_trip_time = m_round_trip_time.snapshot();
+
+		// Nothing is sent anymore: the host no longer needs to be reachable.
+		m_send_function = send_function_type();
+
+		const handler_type handler = m_handler;
+		m_handler = handler_type();
+
+		if (handler)
+		{
+			handler(ec, result);
+		}
+	}
+}
@@ -0,0 +1,161 @@
+/*
+ * libfreelan - A C++ library to establish peer-to-peer virtual private
+ * networks.
+ * Copyright (C) 2010-2011 Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libfreelan.
+ *
+ * libfreelan is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libfreelan is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libfreelan in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+
+/**
+ * \file link_test_message.cpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief The link test messages exchanged by the peers.
+ */
+
+#include "link_test_message.hpp"
+
+#include <fscp/buffer_tools.hpp>
+
+#include <boost/asio.hpp>
+
+#include <stdexcept>
+
+namespace freelan
+{
+	namespace
+	{
+		const size_t TEST_ID_OFFSET = sizeof(uint8_t);
+		const size_t SEQUENCE_OFFSET = TEST_ID_OFFSET + sizeof(link_test_message::test_id_type);
+		const size_t TIMESTAMP_OFFSET = SEQUENCE_OFFSET + sizeof(uint64_t);
+
+		void set_uint64(void* buf, size_t offset, uint64_t value)
+		{
+			fscp::buffer_tools::set<uint32_t>(buf, offset, htonl(static_cast<uint32_t>(value >> 32)));
+			fscp::buffer_tools::set<uint32_t>(buf, offset + sizeof(uint32_t), htonl(static_cast<uint32_t>(value)));
+		}
+	}
+
+	size_t link_test_message::write(void* buf, size_t buf_len, message_type _type, test_id_type _test_id, uint64_t _sequence, uint64_t _timestamp, size_t _size)
+	{
+		if ((_size < HEADER_LENGTH) || (buf_len < _size))
+		{
+			throw std::runtime_error("buf_len");
+		}
+
+		fscp::buffer_tools::set<uint8_t>(buf, 0, static_cast<uint8_t>(_type));
+		fscp::buffer_tools::set<uint32_t>(buf, TEST_ID_OFFSET, htonl(_test_id));
+		set_uint64(buf, SEQUENCE_OFFSET, _sequence);
+		set_uint64(buf, TIMESTAMP_OFFSET, _timestamp);
+
+		return _size;
+	}
+
+	size_t link_test_message::write_report(void* buf, size_t buf_len, test_id_type _test_id, uint64_t _received_packets, uint64_t _received_bytes, uint64_t _highest_sequence, uint64_t _reordered_packets)
+	{
+		write(buf, buf_len, MT_REPORT, _test_id, 0, 0, REPORT_LENGTH);
+
+		set_uint64(buf, HEADER_LENGTH, _received_packets);
+		set_uint64(buf, HEADER_LENGTH + sizeof(uint64_t), _received_bytes);
+		set_uint64(buf, HEADER_LENGTH + 2 * sizeof(uint64_t), _highest_sequence);
+		set_uint64(buf, HEADER_LENGTH + 3 * sizeof(uint64_t), _reordered_packets);
+
+		return REPORT_LENGTH;
+	}
+
+	void link_test_message::set_type(void* buf, message_type _type)
+	{
+		fscp::buffer_tools::set<uint8_t>(buf, 0, static_cast<uint8_t>(_type));
+	}
+
+	link_test_message::link_test_message(const void* buf, size_t buf_len) :
+		m_data(static_cast<const uint8_t*>(buf)),
+		m_size(buf_len)
+	{
+		if (buf_len < HEADER_LENGTH)
+		{
+			throw std::runtime_error("buf_len");
+		}
+
+		if ((type() == MT_REPORT) && (buf_len < REPORT_LENGTH))
+		{
+			throw std::runtime_error("buf_len");
+		}
+	}
+
+	link_test_message::message_type link_test_message::type() const
+	{
+		return static_cast<message_type>(fscp::buffer_tools::get<uint8_t>(m_data, 0));
+	}
+
+	link_test_message::test_id_type link_test_message::test_id() const
+	{
+		return ntohl(fscp::buffer_tools::get<uint32_t>(m_data, TEST_ID_OFFSET));
+	}
+
+	uint64_t link_test_message::sequence() const
+	{
+		return get_uint64(SEQUENCE_OFFSET);
+	}
+
+	uint64_t link_test_message::timestamp() const
+	{
+		return get_uint64(TIMESTAMP_OFFSET);
+	}
+
+	uint64_t link_test_message::received_packets() const
+	{
+		return get_uint64(HEADER_LENGTH);
+	}
+
+	uint64_t link_test_message::received_bytes() const
+	{
+		return get_uint64(HEADER_LENGTH + sizeof(uint64_t));
+	}
+
+	uint64_t link_test_message::highest_sequence() const
+	{
+		return get_uint64(HEADER_LENGTH + 2 * sizeof(uint64_t));
+	}
+
+	uint64_t link_test_message::reordered_packets() const
+	{
+		return get_uint64(HEADER_LENGTH + 3 * sizeof(uint64_t));
+	}
+
+	uint64_t link_test_message::get_uint64(size_t offset) const
+	{
+		return (static_cast<uint64_t>(ntohl(fscp::buffer_tools::get<uint32_t>(m_data, offset))) << 32) | ntohl(fscp::buffer_tools::get<uint32_t>(m_data, offset + sizeof(uint32_t)));
+	}
+}
@@ -45,6 +45,81 @@
 
 #include "logger.hpp"
 
+#include <boost/thread/tss.hpp>
+
+#include "async_log_writer.hpp"
+
 namespace freelan
 {
+	namespace
+	{
+		boost::thread_specific_ptr<log_formatter> thread_formatter;
+	}
+
+	log_formatter* log_formatter::acquire()
+	{
+		log_formatter* formatter = thread_formatter.get();
+
+		if (!formatter)
+		{
+			formatter = new log_formatter();
+			thread_formatter.reset(formatter);
+		}
+		else if (formatter->m_in_use)
+		{
+			formatter = new log_formatter();
+		}
+
+		formatter->m_in_use = true;
+
+		return formatter;
+	}
+
+	void log_formatter::release(log_formatter* formatter)
+	{
+		if (formatter == thread_formatter.get())
+		{
+			formatter->reset();
+		}
+		else
+		{
+			delete formatter;
+		}
+	}
+
+	log_formatter::log_formatter() :
+		m_buffer(),
+		m_stream(&m_buffer),
+		m_in_use(false)
+	{
+	}
+
+	void log_formatter::reset()
+	{
+		m_buffer.clear();
+
+		// Manipulators applied by the previous entry must not leak into the next one.
+		m_stream.clear();
+		m_stream.flags(std::ios_base::skipws | std::ios_base::dec);
+		m_stream.precision(6);
+		m_stream.width(0);
+		m_stream.fill(' ');
+
+		m_in_use = false;
+	}
+
+	void logger::log(log_level level_, const char* msg, size_t msg_len, timestamp_type timestamp) const
+	{
+		if (is_enabled(level_))
+		{
+			if (m_writer)
+			{
+				m_writer->write(level_, msg, msg_len, timestamp);
+			}
+			else if (m_handler)
+			{
+				m_handler(level_, std::string(msg, msg_len), timestamp);
+			}
+		}
+	}
 }
@@ -0,0 +1,123 @@
+/*
+ * libfreelan - A C++ library to establish peer-to-peer virtual private
+ * networks.
+ * Copyright (C) 2010-2011 Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libfreelan.
+ *
+ * libfreelan is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libfreelan is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libfreelan in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file per_thread.cpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief A value of which each thread gets its own instance.
+ */
+
+#include "per_thread.hpp"
+
+#include <atomic>
+#include <map>
+
+#include <boost/thread/tss.hpp>
+
+namespace freelan
+{
+	namespace detail
+	{
+		namespace
+		{
+			struct per_thread_entry_type
+			{
+				boost::weak_ptr<void> owner;
+				void* value;
+			};
+
+			typedef std::map<uint64_t, per_thread_entry_type> per_thread_entry_map;
+
+			std::atomic<uint64_t> next_per_thread_id(1);
+
+			// This one is never destroyed before the threads that use it are done, so keying it by its address is fine.
+			boost::thread_specific_ptr<per_thread_entry_map> per_thread_entries;
+		}
+
+		uint64_t allocate_per_thread_id()
+		{
+			return next_per_thread_id.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void* get_per_thread_value(uint64_t id)
+		{
+			const per_thread_entry_map* const entries = per_thread_entries.get();
+
+			if (entries)
+			{
+				const per_thread_entry_map::const_iterator entry = entries->find(id);
+
+				if (entry != entries->end())
+				{
+					return entry->second.value;
+				}
+			}
+
+			return nullptr;
+		}
+
+		void set_per_thread_value(uint64_t id, const boost::weak_ptr<void>& owner, void* value)
+		{
+			per_thread_entry_map* entries = per_thread_entries.get();
+
+			if (!entries)
+			{
+				entries = new per_thread_entry_map();
+				per_thread_entries.reset(entries);
+			}
+
+			// The identifiers of destroyed instances are never looked up again: this is only to keep the map small.
+			for (per_thread_entry_map::iterator entry = entries->begin(); entry != entries->end();)
+			{
+				if (entry->second.owner.expired())
+				{
+					entry = entries->erase(entry);
+				}
+				else
+				{
+					++entry;
+				}
+			}
+
+			const per_thread_entry_type entry = { owner, value };
+
+			(*entries)[id] = entry;
+		}
+	}
+}
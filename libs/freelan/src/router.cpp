@@ -44,117 +44,357 @@
  */
 
 #include "router.hpp"
+#include "tracepoints.hpp"
 
 #include <cassert>
 
 #include <boost/foreach.hpp>
+#include <boost/functional/hash.hpp>
 
-#include <asiotap/osi/ipv4_helper.hpp>
-#include <asiotap/osi/ipv6_helper.hpp>
+#include <asiotap/osi/ipv4_filter.hpp>
+#include <asiotap/osi/ipv6_filter.hpp>
+#include <asiotap/osi/udp_frame.hpp>
 
 namespace freelan
 {
-	void router::async_write(port_index_type index, boost::asio::const_buffer data, port_type::write_handler_type handler)
+	namespace
 	{
-		const port_list_type::const_iterator port_entry = get_target_for(index, data);
+		const uint8_t TCP_PROTOCOL = 0x06;
+		const uint8_t SCTP_PROTOCOL = 0x84;
 
-#if FREELAN_DEBUG
-		if (port_entry != m_ports.end())
+		/**
+		 * \brief Compute a hash of the flow a frame belongs to.
+		 * \param data The frame. Must be a valid IPv4 or IPv6 frame.
+		 * \return The hash of the source and destination addresses, the protocol and, when available, the source and destination ports.
+		 *
+		 * Fragments only hash their addresses and protocol so that they follow the same path as the rest of their datagram.
+		 */
+		size_t get_flow_hash(boost::asio::const_buffer data)
 		{
-			std::cerr << "Routing " << buffer_size(data) << " byte(s) of data from " << index << " to " << port_entry->first << std::endl;
+			const uint8_t* const frame = boost::asio::buffer_cast<const uint8_t*>(data);
+			const size_t frame_size = boost::asio::buffer_size(data);
+
+			uint8_t protocol;
+			size_t addresses_offset;
+			size_t addresses_size;
+			size_t payload_offset;
+			bool is_fragment;
+
+			if (((frame[0] & 0xF0) >> 4) == asiotap::osi::IP_PROTOCOL_VERSION_4)
+			{
+				protocol = frame[9];
+				addresses_offset = 12;
+				addresses_size = 8;
+				payload_offset = (frame[0] & 0x0F) * sizeof(uint32_t);
+				// The "more fragments" flag or a non-zero fragment offset.
+				is_fragment = ((frame[6] & 0x3F) != 0) || (frame[7] != 0);
+			}
+			else
+			{
+				protocol = frame[6];
+				addresses_offset = 8;
+				addresses_size = 32;
+				payload_offset = 40;
+				// Fragmented IPv6 datagrams have a fragment extension header, which we don't hash ports for.
+				is_fragment = false;
+			}
+
+			size_t seed = 0;
+
+			boost::hash_range(seed, frame + addresses_offset, frame + addresses_offset + addresses_size);
+			boost::hash_combine(seed, protocol);
+
+			if (!is_fragment && ((protocol == TCP_PROTOCOL) || (protocol == asiotap::osi::UDP_PROTOCOL) || (protocol == SCTP_PROTOCOL)))
+			{
+				if (frame_size >= payload_offset + 2 * sizeof(uint16_t))
+				{
+					boost::hash_range(seed, frame + payload_offset, frame + payload_offset + 2 * sizeof(uint16_t));
+				}
+			}
+
+			// The caller picks a port from the low bits of the hash, which boost::hash_combine() does not mix well.
+			uint32_t result = static_cast<uint32_t>(seed) ^ static_cast<uint32_t>(static_cast<uint64_t>(seed) >> 32);
+
+			result ^= result >> 16;
+			result *= 0x85ebca6b;
+			result ^= result >> 13;
+			result *= 0xc2b2ae35;
+			result ^= result >> 16;
+
+			return result;
 		}
-		else
+	}
+
+	void router::register_port(port_index_type index, port_type port)
+	{
+		const port_list_type::const_iterator previous_port_entry = m_ports.find(index);
+		const asiotap::ip_route_set previous_routes = (previous_port_entry != m_ports.end()) ? previous_port_entry->second.local_routes() : asiotap::ip_route_set();
+
+		port_type& local_port = (m_ports[index] = port);
+
+		// This takes care of automatically updating the routing tables whenever needed.
+		local_port.associate_to_router(this, index);
+
+		const boost::shared_ptr<port_type> table_port = boost::make_shared<port_type>(local_port);
+		table_port->m_index = index;
+
+		update_table([&index, &previous_routes, &table_port] (table_type& table) {
+			// The routes of a replaced port refer to its previous instance.
+			for (auto&& route : previous_routes)
+			{
+				boost::apply_visitor(update_route_visitor(table, index, nullptr), route);
+			}
+
+			const boost::shared_ptr<table_port_list_type> ports = boost::make_shared<table_port_list_type>(*table.ports);
+			(*ports)[index] = table_port;
+			table.ports = ports;
+
+			for (auto&& route : table_port->local_routes())
+			{
+				boost::apply_visitor(update_route_visitor(table, index, table_port.get()), route);
+			}
+		});
+	}
+
+	void router::unregister_port(port_index_type index)
+	{
+		const port_list_type::iterator port_entry = m_ports.find(index);
+
+		if (port_entry == m_ports.end())
 		{
-			std::cerr << "Routing " << buffer_size(data) << " byte(s) of data from " << index << ": no route." << std::endl;
+			return;
 		}
-#endif
 
-		if (port_entry != m_ports.end())
+		const asiotap::ip_route_set routes = port_entry->second.local_routes();
+
+		m_ports.erase(port_entry);
+
+		update_table([&index, &routes] (table_type& table) {
+			for (auto&& route : routes)
+			{
+				boost::apply_visitor(update_route_visitor(table, index, nullptr), route);
+			}
+
+			const boost::shared_ptr<table_port_list_type> ports = boost::make_shared<table_port_list_type>(*table.ports);
+			ports->erase(index);
+			table.ports = ports;
+		});
+	}
+
+	void router::update_routes(const port_index_type& index, const asiotap::ip_route_set& old_routes, const asiotap::ip_route_set& new_routes)
+	{
+		// Only the routes that actually changed are updated.
+		std::vector<asiotap::ip_route> removed_routes;
+		std::vector<asiotap::ip_route> added_routes;
+
+		std::set_difference(old_routes.begin(), old_routes.end(), new_routes.begin(), new_routes.end(), std::back_inserter(removed_routes));
+		std::set_difference(new_routes.begin(), new_routes.end(), old_routes.begin(), old_routes.end(), std::back_inserter(added_routes));
+
+		if (removed_routes.empty() && added_routes.empty())
 		{
-			port_entry->second.async_write(data, handler);
+			return;
 		}
+
+		update_table([&index, &removed_routes, &added_routes] (table_type& table) {
+			const table_port_list_type::const_iterator port_entry = table.ports->find(index);
+
+			assert(port_entry != table.ports->end());
+
+			for (auto&& route : removed_routes)
+			{
+				boost::apply_visitor(update_route_visitor(table, index, nullptr), route);
+			}
+
+			for (auto&& route : added_routes)
+			{
+				boost::apply_visitor(update_route_visitor(table, index, port_entry->second.get()), route);
+			}
+		});
 	}
 
-	router::port_list_type::const_iterator router::get_target_for(port_index_type index, boost::asio::const_buffer data)
+	template <typename Change>
+	void router::update_table(Change change)
 	{
-		// Try IPv4 first because it is more likely.
+		// Copying the tables shares the ports and the trie nodes: the change then only copies what it modifies.
+		const boost::shared_ptr<table_type> table = boost::make_shared<table_type>(*m_table.load());
+
+		table->generation = ++m_routes_generation;
 
-		m_ipv4_filter.parse(data);
+		change(*table);
 
-		if (m_ipv4_filter.get_last_helper())
+		m_table.publish(table);
+	}
+
+	router::route_cache_statistics_type router::route_cache_statistics() const
+	{
+		route_cache_statistics_type result;
+
+		m_route_caches.for_each([&result](const route_cache_type& route_cache) {
+			result.hits += route_cache.hits.load(std::memory_order_relaxed);
+			result.misses += route_cache.misses.load(std::memory_order_relaxed);
+		});
+
+		return result;
+	}
+
+	void router::async_write(port_index_type index, boost::asio::const_buffer data, port_type::write_handler_type handler)
+	{
+		// The reader keeps the table alive until we are done with it, even if new tables get published meanwhile.
+		const published_value<table_type>::reader table(m_table);
+		const port_type* const target = get_target_for(*table, index, data);
+
+#if FREELAN_DEBUG
+		if (target)
 		{
-			const boost::asio::ip::address_v4 destination = m_ipv4_filter.get_last_helper()->destination();
+			std::cerr << "Routing " << buffer_size(data) << " byte(s) of data from " << index << " to " << target->m_index << std::endl;
+		}
+		else
+		{
+			std::cerr << "Routing " << buffer_size(data) << " byte(s) of data from " << index << ": no route." << std::endl;
+		}
+#endif
 
-			m_ipv4_filter.clear_last_helper();
+		if (target)
+		{
+			FREELAN_TRACEPOINT(router_forward, FREELAN_TRACEPOINT_PORT(index), FREELAN_TRACEPOINT_PORT(target->m_index), 1, buffer_size(data));
 
-			return get_target_for(index, destination);
+			target->async_write(data, handler);
 		}
 		else
 		{
-			m_ipv6_filter.parse(data);
+			FREELAN_TRACEPOINT(router_forward, FREELAN_TRACEPOINT_PORT(index), FREELAN_TRACEPOINT_OPTIONAL_ENDPOINT(NULL), 0, buffer_size(data));
 
-			if (m_ipv6_filter.get_last_helper())
+			m_dropped_frames.add();
+		}
+	}
+
+	const router::port_type* router::get_target_for(const table_type& table, port_index_type index, boost::asio::const_buffer data)
+	{
+		if (boost::asio::buffer_size(data) > 0)
+		{
+			// The version nibble tells us directly which header we have to peek at.
+			switch ((boost::asio::buffer_cast<const uint8_t*>(data)[0] & 0xF0) >> 4)
 			{
-				const boost::asio::ip::address_v6 destination = m_ipv6_filter.get_last_helper()->destination();
+				case asiotap::osi::IP_PROTOCOL_VERSION_4:
+				{
+					boost::asio::ip::address_v4 destination;
 
-				m_ipv6_filter.clear_last_helper();
+					if (asiotap::osi::peek_ipv4_destination(data, destination))
+					{
+						return get_target_for(table, index, destination, data);
+					}
 
-				return get_target_for(index, destination);
+					break;
+				}
+				case asiotap::osi::IP_PROTOCOL_VERSION_6:
+				{
+					boost::asio::ip::address_v6 destination;
+
+					if (asiotap::osi::peek_ipv6_destination(data, destination))
+					{
+						return get_target_for(table, index, destination, data);
+					}
+
+					break;
+				}
 			}
 		}
 
 		// Frame of other types than IPv4 or IPv6 are silently dropped.
-		return m_ports.end();
+		return nullptr;
 	}
 
 	template <typename AddressType>
-	router::port_list_type::const_iterator router::get_target_for(port_index_type index, const AddressType& dest_addr)
+	const router::port_type* router::get_target_for(const table_type& table, port_index_type index, const AddressType& dest_addr, boost::asio::const_buffer data)
 	{
-		const router::port_list_type::const_iterator source_port_entry = m_ports.find(index);
+		const table_port_list_type::const_iterator source_port_entry = table.ports->find(index);
 
-		if (source_port_entry != m_ports.end())
+		if (source_port_entry != table.ports->end())
 		{
-			const auto& routes_ports = routes();
+			route_cache_type& route_cache = m_route_caches.get();
+			const port_group_type source_group = source_port_entry->second->group();
+			const typename AddressType::bytes_type destination_bytes = dest_addr.to_bytes();
+			route_cache_entry_type<AddressType>& cache_entry = route_cache.entries_for(dest_addr)[boost::hash_range(destination_bytes.begin(), destination_bytes.end()) & (ROUTE_CACHE_SIZE - 1)];
 
-			for (auto&& route_port : routes_ports)
+			if ((cache_entry.generation == table.generation) && (cache_entry.destination == dest_addr) && (cache_entry.source_group == source_group))
 			{
-				if (has_address(route_port.first, dest_addr))
-				{
-					const port_list_type::const_iterator port_entry = m_ports.find(route_port.second);
+				route_cache.hits.fetch_add(1, std::memory_order_relaxed);
 
-					if (m_configuration.client_routing_enabled || (source_port_entry->second.group() != port_entry->second.group()))
-					{
-						return port_entry;
-					}
+				if (cache_entry.multipath_entries)
+				{
+					return get_multipath_target(*cache_entry.multipath_entries, source_group, get_flow_hash(data));
 				}
+
+				return cache_entry.target;
 			}
+
+			route_cache.misses.fetch_add(1, std::memory_order_relaxed);
+
+			const port_type* result = nullptr;
+			const std::vector<route_entry_type<AddressType> >* multipath_entries = nullptr;
+
+			// The routes are visited from the most specific to the least specific one.
+			table.routes_for(dest_addr).find(dest_addr, [this, source_group, data, &result, &multipath_entries] (const std::vector<route_entry_type<AddressType> >& entries) {
+				const size_t count = std::count_if(entries.begin(), entries.end(), [this, source_group] (const route_entry_type<AddressType>& entry) {
+					return can_route(source_group, *entry.port);
+				});
+
+				if (count == 0)
+				{
+					return false;
+				}
+
+				if ((count > 1) && m_configuration.multipath_enabled)
+				{
+					multipath_entries = &entries;
+				}
+
+				result = get_multipath_target(entries, source_group, (count > 1) ? get_flow_hash(data) : 0);
+
+				return true;
+			});
+
+			// Negative results are cached as well, so that unroutable traffic remains cheap.
+			cache_entry.generation = table.generation;
+			cache_entry.destination = dest_addr;
+			cache_entry.source_group = source_group;
+			cache_entry.target = result;
+			cache_entry.multipath_entries = multipath_entries;
+
+			return result;
 		}
 
-		// No route for the current frame so we return an invalid iterator.
-		return m_ports.end();
+		// No route for the current frame.
+		return nullptr;
 	}
 
-	const router::routes_port_type& router::routes() const
+	template <typename AddressType>
+	const router::port_type* router::get_multipath_target(const std::vector<route_entry_type<AddressType> >& entries, port_group_type source_group, size_t flow_hash) const
 	{
-		if (!m_routes)
+		size_t count = 0;
+
+		for (auto&& entry : entries)
 		{
-			// The routes were invalidated, we recompile them.
+			if (can_route(source_group, *entry.port))
+			{
+				++count;
+			}
+		}
 
-			m_routes = routes_port_type();
+		if (count > 0)
+		{
+			// Without multipath, the flow hash is ignored and the first eligible port always wins.
+			size_t choice = m_configuration.multipath_enabled ? (flow_hash % count) : 0;
 
-			// We add all the port routes to the routes list.
-			// These are sorted automatically by the container.
-			for (port_list_type::const_iterator port = m_ports.begin(); port != m_ports.end(); ++port)
+			for (auto&& entry : entries)
 			{
-				const auto& local_routes = port->second.local_routes();
-
-				for (auto&& route : local_routes)
+				if (can_route(source_group, *entry.port) && (choice-- == 0))
 				{
-					m_routes->insert(std::make_pair(route, port->first));
+					return entry.port;
 				}
 			}
 		}
 
-		return *m_routes;
+		return nullptr;
 	}
 }
@@ -44,6 +44,7 @@
  */
 
 #include "switch.hpp"
+#include "tracepoints.hpp"
 
 #include <cassert>
 
@@ -118,7 +119,9 @@ namespace freelan
 	{
 		typedef results_gatherer<port_index_type, boost::system::error_code, multi_write_handler_type> results_gatherer_type;
 
-		const auto targets = get_targets_for(index, data);
+		// The reader keeps the ports alive until we are done with them, even if ports get unregistered meanwhile.
+		const published_value<port_list_type>::reader ports(m_ports);
+		const auto targets = get_targets_for(*ports, index, data);
 
 #if FREELAN_DEBUG
 		if (!targets.empty())
@@ -131,6 +134,13 @@ namespace freelan
 		}
 #endif
 
+		FREELAN_TRACEPOINT(switch_forward, FREELAN_TRACEPOINT_PORT(index), targets.size(), buffer_size(data));
+
+		if (targets.empty())
+		{
+			m_dropped_frames.add();
+		}
+
 		boost::shared_ptr<results_gatherer_type> rg = boost::make_shared<results_gatherer_type>(handler, targets);
 
 		for (auto&& target : targets)
@@ -139,21 +149,21 @@ namespace freelan
 			std::cerr << index << "-> " << target << std::endl;
 #endif
 
-			m_ports[target].async_write(data, boost::bind(&results_gatherer_type::gather, rg, target, _1));
+			ports->find(target)->second.async_write(data, boost::bind(&results_gatherer_type::gather, rg, target, _1));
 		}
 	}
 
-	std::set<port_index_type> switch_::get_targets_for(port_index_type index, boost::asio::const_buffer data)
+	std::set<port_index_type> switch_::get_targets_for(const port_list_type& ports, port_index_type index, boost::asio::const_buffer data)
 	{
-		const port_list_type::iterator source_port_entry = m_ports.find(index);
+		const port_list_type::const_iterator source_port_entry = ports.find(index);
 
-		if (source_port_entry != m_ports.end())
+		if (source_port_entry != ports.end())
 		{
 			switch (m_configuration.routing_method)
 			{
 				case switch_configuration::RM_HUB:
 				{
-					return get_targets_for(source_port_entry);
+					return get_targets_for(ports, source_port_entry);
 				}
 				case switch_configuration::RM_SWITCH:
 				{
@@ -163,49 +173,39 @@ namespace freelan
 
 					if (is_multicast_address(target_address))
 					{
-						return get_targets_for(source_port_entry);
+						return get_targets_for(ports, source_port_entry);
 					}
 					else
 					{
-						m_ethernet_address_map[to_ethernet_address(ethernet_helper.sender())] = index;
-
-						// We exceeded the maximum count for entries: we delete random entries to fix it.
-						while (m_ethernet_address_map.size() > m_max_entries)
-						{
-							ethernet_address_map_type::iterator entry = m_ethernet_address_map.begin();
-
-#if BOOST_VERSION >= 104700
-							boost::random::mt19937 gen;
-
-							std::advance(entry, boost::random::uniform_int_distribution<>(0, static_cast<int>(m_ethernet_address_map.size()) - 1)(gen));
-#else
-							boost::mt19937 gen;
+						const ethernet_address_type sender_address = to_ethernet_address(ethernet_helper.sender());
+						const published_value<ethernet_address_map_type>::reader ethernet_address_map(m_ethernet_address_map);
 
-							boost::variate_generator<boost::mt19937&, boost::uniform_int<> > vgen(gen, boost::uniform_int<>(0, m_ethernet_address_map.size() - 1));
-							std::advance(entry, vgen());
-#endif
+						const ethernet_address_map_type::const_iterator sender_entry = ethernet_address_map->find(sender_address);
 
-							m_ethernet_address_map.erase(entry);
+						// Most frames come from already known addresses: only new or moved addresses require an update.
+						if ((sender_entry == ethernet_address_map->end()) || !(sender_entry->second == index))
+						{
+							queue_address_update(sender_address, address_update_type(index, true));
 						}
 
 						// We look in the ethernet address map
 
-						const ethernet_address_map_type::iterator target_entry = m_ethernet_address_map.find(target_address);
+						const ethernet_address_map_type::const_iterator target_entry = ethernet_address_map->find(target_address);
 
-						if (target_entry == m_ethernet_address_map.end())
+						if (target_entry == ethernet_address_map->end())
 						{
 							// No target entry: we send the message to everybody.
-							return get_targets_for(source_port_entry);
+							return get_targets_for(ports, source_port_entry);
 						}
 
 						const port_index_type target_port_index = target_entry->second;
 
-						if (!is_registered(target_port_index))
+						if (ports.find(target_port_index) == ports.end())
 						{
 							// The port does not exist: we delete the entry and send to everybody.
-							m_ethernet_address_map.erase(target_entry);
+							queue_address_update(target_address, address_update_type(target_port_index, false));
 
-							return get_targets_for(source_port_entry);
+							return get_targets_for(ports, source_port_entry);
 						}
 
 						std::set<port_index_type> targets;
@@ -221,11 +221,11 @@ namespace freelan
 		return std::set<port_index_type>();
 	}
 
-	std::set<port_index_type> switch_::get_targets_for(port_list_type::const_iterator source_port_entry)
+	std::set<port_index_type> switch_::get_targets_for(const port_list_type& ports, port_list_type::const_iterator source_port_entry)
 	{
 		std::set<port_index_type> targets;
 
-		for (port_list_type::const_iterator port_entry = m_ports.begin(); port_entry != m_ports.end(); ++port_entry)
+		for (port_list_type::const_iterator port_entry = ports.begin(); port_entry != ports.end(); ++port_entry)
 		{
 			if (source_port_entry != port_entry)
 			{
@@ -239,6 +239,107 @@ namespace freelan
 		return targets;
 	}
 
+	void switch_::publish_learnt_addresses()
+	{
+		// Only contended when no address learning handler is set and several switching threads publish at once.
+		boost::mutex::scoped_lock publication_lock(m_address_publication_mutex);
+
+		address_update_map_type address_updates;
+
+		{
+			boost::mutex::scoped_lock lock(m_pending_address_updates_mutex);
+
+			address_updates.swap(m_pending_address_updates);
+		}
+
+		if (address_updates.empty())
+		{
+			return;
+		}
+
+		const boost::shared_ptr<ethernet_address_map_type> ethernet_address_map = boost::make_shared<ethernet_address_map_type>(*m_ethernet_address_map.load());
+
+		for (auto&& address_update : address_updates)
+		{
+			if (address_update.second.learn)
+			{
+				(*ethernet_address_map)[address_update.first] = address_update.second.index;
+			}
+			else
+			{
+				const ethernet_address_map_type::iterator entry = ethernet_address_map->find(address_update.first);
+
+				// The address may have been learnt again on another port meanwhile: we only remove the stale entry.
+				if ((entry != ethernet_address_map->end()) && (entry->second == address_update.second.index))
+				{
+					ethernet_address_map->erase(entry);
+				}
+			}
+		}
+
+		// We exceeded the maximum count for entries: we delete random entries to fix it.
+		while (ethernet_address_map->size() > m_max_entries)
+		{
+			ethernet_address_map_type::iterator random_entry = ethernet_address_map->begin();
+
+#if BOOST_VERSION >= 104700
+			boost::random::mt19937 gen;
+
+			std::advance(random_entry, boost::random::uniform_int_distribution<>(0, static_cast<int>(ethernet_address_map->size()) - 1)(gen));
+#else
+			boost::mt19937 gen;
+
+			boost::variate_generator<boost::mt19937&, boost::uniform_int<> > vgen(gen, boost::uniform_int<>(0, ethernet_address_map->size() - 1));
+			std::advance(random_entry, vgen());
+#endif
+
+			ethernet_address_map->erase(random_entry);
+		}
+
+		m_ethernet_address_map.publish(ethernet_address_map);
+	}
+
+	void switch_::queue_address_update(const ethernet_address_type& address, const address_update_type& address_update)
+	{
+		bool was_empty;
+
+		{
+			boost::mutex::scoped_lock lock(m_pending_address_updates_mutex);
+
+			// A peer that sends frames from random addresses must not make the queue grow without bounds: the dropped updates are queued again by the next frames.
+			if (m_pending_address_updates.size() >= m_max_entries)
+			{
+				return;
+			}
+
+			was_empty = m_pending_address_updates.empty();
+
+			const address_update_map_type::iterator entry = m_pending_address_updates.find(address);
+
+			if (entry != m_pending_address_updates.end())
+			{
+				entry->second = address_update;
+			}
+			else
+			{
+				m_pending_address_updates.insert(std::make_pair(address, address_update));
+			}
+		}
+
+		if (m_address_learning_handler)
+		{
+			// Only the first update of a batch needs to schedule the publication.
+			if (was_empty)
+			{
+				m_address_learning_handler();
+			}
+		}
+		else
+		{
+			publish_learnt_addresses();
+		}
+	}
+
 	switch_::ethernet_address_type switch_::to_ethernet_address(boost::asio::const_buffer buf)
 	{
 		assert(boost::asio::buffer_size(buf) == ethernet_address_type::static_size);
@@ -127,6 +127,39 @@ namespace fscp
 			 */
 			static size_t write_keep_alive(void* buf, size_t buf_len, sequence_number_type sequence_number, data_message::calg_t cipher_algorithm, size_t random_len, const void* enc_key, size_t enc_key_len, const void* nonce_prefix, size_t nonce_prefix_len);
 
+			/**
+			 * \brief Get the buffer length that write() and write_keep_alive() require.
+			 * \param cipher_algorithm The cipher algorithm to use.
+			 * \param cleartext_len The data length.
+			 * \return The buffer length.
+			 */
+			static size_t get_buffer_size(data_message::calg_t cipher_algorithm, size_t cleartext_len);
+
+			/**
+			 * \brief Get the buffer length that write_contact_request() requires.
+			 * \param cipher_algorithm The cipher algorithm to use.
+			 * \param hash_list The hash list.
+			 * \return The buffer length.
+			 */
+			static size_t get_contact_request_buffer_size(data_message::calg_t cipher_algorithm, const hash_list_type& hash_list);
+
+			/**
+			 * \brief Get the buffer length that write_contact() requires.
+			 * \param cipher_algorithm The cipher algorithm to use.
+			 * \param contact_map The contact map.
+			 * \return The buffer length.
+			 */
+			static size_t get_contact_buffer_size(data_message::calg_t cipher_algorithm, const contact_map_type& contact_map);
+
+			/**
+			 * \brief Get the size of the data message that write() produces.
+			 * \param cleartext_len The data length.
+			 * \return The message size, header included.
+			 *
+			 * All the cipher suites use GCM, which does not pad the data.
+			 */
+			static size_t get_message_size(size_t cleartext_len);
+
 			/**
 			 * \brief Parse the hash list.
 			 * \param buf The buffer to parse.
@@ -135,6 +168,14 @@ namespace fscp
 			 */
 			static hash_list_type parse_hash_list(const void* buf, size_t buflen);
 
+			/**
+			 * \brief Parse the hash list, without throwing.
+			 * \param buf The buffer to parse.
+			 * \param buflen The length of the buffer to parse.
+			 * \return The hash list, or nothing if buf does not contain a valid hash list.
+			 */
+			static boost::optional<hash_list_type> try_parse_hash_list(const void* buf, size_t buflen);
+
 			/**
 			 * \brief Parse the contact map.
 			 * \param buf The buffer to parse.
@@ -143,6 +184,14 @@ namespace fscp
 			 */
 			static contact_map_type parse_contact_map(const void* buf, size_t buflen);
 
+			/**
+			 * \brief Parse the contact map, without throwing.
+			 * \param buf The buffer to parse.
+			 * \param buflen The length of the buffer to parse.
+			 * \return The contact map, or nothing if buf does not contain a valid contact map.
+			 */
+			static boost::optional<contact_map_type> try_parse_contact_map(const void* buf, size_t buflen);
+
 			/**
 			 * \brief Create a data_message and map it on a buffer.
 			 * \param buf The buffer.
@@ -158,6 +207,13 @@ namespace fscp
 			 */
 			data_message(const message& message);
 
+			/**
+			 * \brief Create a data_message from a message, without throwing.
+			 * \param message The message.
+			 * \return The data_message, or nothing if message is not a valid data_message.
+			 */
+			static boost::optional<data_message> try_parse(const message& message);
+
 			/**
 			 * \brief Get the sequence number.
 			 * \return The sequence number.
@@ -188,6 +244,13 @@ namespace fscp
 			 */
 			size_t ciphertext_size() const;
 
+			/**
+			 * \brief Get the buffer length that get_cleartext() requires.
+			 * \param cipher_algorithm The cipher algorithm to use.
+			 * \return The buffer length.
+			 */
+			size_t get_cleartext_buffer_size(data_message::calg_t cipher_algorithm) const;
+
 			/**
 			 * \brief Get the clear text data, using a given encryption key.
 			 * \param buf The buffer that must receive the data. If buf is NULL, the function returns the expected size of buf.
@@ -227,7 +290,9 @@ namespace fscp
 
 		private:
 
-			void check_format() const;
+			data_message(const message& message, unchecked_tag);
+
+			bool check_format() const;
 	};
 
 	inline sequence_number_type data_message::sequence_number() const
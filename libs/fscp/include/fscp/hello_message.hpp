@@ -89,6 +89,13 @@ namespace fscp
 			 */
 			hello_message(const message& message);
 
+			/**
+			 * \brief Create a hello_message from a message, without throwing.
+			 * \param message The message.
+			 * \return The hello_message, or nothing if message is not a valid hello_message.
+			 */
+			static boost::optional<hello_message> try_parse(const message& message);
+
 			/**
 			 * \brief Get the unique number.
 			 * \return The unique number.
@@ -101,6 +108,12 @@ namespace fscp
 			 * \brief The length of the body.
 			 */
 			static const size_t BODY_LENGTH = 4;
+
+		private:
+
+			hello_message(const message& message, unchecked_tag);
+
+			bool check_format() const;
 	};
 
 	inline uint32_t hello_message::unique_number() const
@@ -0,0 +1,352 @@
+/*
+ * libfscp - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libfscp.
+ *
+ * libfscp is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libfscp is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libfscp in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file latency.hpp
+ * \author Julien Kauffmann <julien.kauffmann@freelan.org>
+ * \brief Latency histograms.
+ */
+
+#ifndef FSCP_LATENCY_HPP
+#define FSCP_LATENCY_HPP
+
+#include "statistics.hpp"
+
+#include <boost/thread/tss.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <utility>
+
+namespace fscp
+{
+	/**
+	 * \brief The clock used to measure latencies.
+	 */
+	typedef std::chrono::steady_clock latency_clock;
+
+	/**
+	 * \brief A latency histogram snapshot.
+	 */
+	struct latency_histogram_snapshot
+	{
+		latency_histogram_snapshot() :
+			counts(),
+			count(0),
+			sum()
+		{}
+
+		/**
+		 * \brief Get the latency below which a given fraction of the samples fall.
+		 * \param quantile The quantile, between 0 and 1.
+		 * \return The latency. Its precision is the one of the histogram buckets.
+		 */
+		latency_clock::duration value_at_quantile(double quantile) const;
+
+		/**
+		 * \brief The count of samples in each bucket.
+		 */
+		std::vector<uint64_t> counts;
+
+		/**
+		 * \brief The count of samples.
+		 */
+		uint64_t count;
+
+		/**
+		 * \brief The sum of the samples.
+		 */
+		latency_clock::duration sum;
+	};
+
+	/**
+	 * \brief A log-linear latency histogram.
+	 *
+	 * Each power of two of nanoseconds is split in SUB_BUCKET_COUNT linear buckets, so that any recorded value is known within 1 / SUB_BUCKET_COUNT of its magnitude, from one nanosecond to MAX_VALUE.
+	 *
+	 * Recording is wait-free and can be done concurrently from any thread.
+	 */
+	class latency_histogram
+	{
+		public:
+
+			/**
+			 * \brief The number of bits of precision of each bucket.
+			 */
+			static const unsigned int SUB_BUCKET_BITS = 4;
+
+			/**
+			 * \brief The number of linear buckets per power of two.
+			 */
+			static const unsigned int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+
+			/**
+			 * \brief The number of powers of two of nanoseconds covered. Larger values are recorded in the last bucket.
+			 */
+			static const unsigned int MAGNITUDE_COUNT = 40;
+
+			/**
+			 * \brief The number of buckets.
+			 */
+			static const size_t BUCKET_COUNT = (MAGNITUDE_COUNT - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+			/**
+			 * \brief Get the bucket of a value.
+			 * \param value The value, in nanoseconds.
+			 * \return The bucket index.
+			 */
+			static size_t bucket_index(uint64_t value);
+
+			/**
+			 * \brief Get the largest value of a bucket.
+			 * \param index The bucket index.
+			 * \return The largest value that is recorded in that bucket, in nanoseconds.
+			 */
+			static uint64_t bucket_upper_bound(size_t index);
+
+			/**
+			 * \brief Create an empty histogram.
+			 */
+			latency_histogram();
+
+			/**
+			 * \brief Record a latency.
+			 * \param latency The latency.
+			 */
+			void record(latency_clock::duration latency);
+
+			/**
+			 * \brief Get a snapshot of the histogram.
+			 * \return The snapshot.
+			 */
+			latency_histogram_snapshot snapshot() const;
+
+		private:
+
+			latency_histogram(const latency_histogram&);
+			latency_histogram& operator=(const latency_histogram&);
+
+			std::atomic<uint64_t> m_counts[BUCKET_COUNT];
+			statistics_counter m_count;
+			statistics_counter m_sum;
+	};
+
+	/**
+	 * \brief The time at which a sampled packet crossed its last stage boundary.
+	 *
+	 * A default-constructed stamp belongs to a packet that is not sampled: all its operations are no-ops.
+	 */
+	class latency_stamp
+	{
+		public:
+
+			/**
+			 * \brief Create a stamp for a packet that is not sampled.
+			 */
+			latency_stamp() :
+				m_time()
+			{}
+
+			/**
+			 * \brief Create a stamp at the current time.
+			 * \return The stamp.
+			 */
+			static latency_stamp now()
+			{
+				latency_stamp result;
+				result.m_time = latency_clock::now();
+
+				return result;
+			}
+
+			/**
+			 * \brief Check if the packet is sampled.
+			 * \return true if the packet is sampled.
+			 */
+			bool is_sampled() const
+			{
+				return (m_time != latency_clock::time_point());
+			}
+
+			/**
+			 * \brief Mark a stage boundary.
+			 * \param histogram The histogram of the stage that just ended.
+			 *
+			 * Records the time elapsed since the previous boundary and starts the next stage.
+			 */
+			void lap(latency_histogram& histogram)
+			{
+				if (is_sampled())
+				{
+					const latency_clock::time_point time = latency_clock::now();
+
+					histogram.record(time - m_time);
+					m_time = time;
+				}
+			}
+
+		private:
+
+			latency_clock::time_point m_time;
+	};
+
+	/**
+	 * \brief Decides which packets get their latency measured.
+	 *
+	 * Each thread counts its own packets down to the next sampled one, so that a packet that is not sampled touches no shared memory.
+	 */
+	class latency_sampler
+	{
+		public:
+
+			/**
+			 * \brief Create a sampler.
+			 * \param rate One packet out of rate is sampled. 0 disables sampling.
+			 */
+			explicit latency_sampler(unsigned int rate = 0) :
+				m_rate(rate),
+				m_countdowns()
+			{}
+
+			/**
+			 * \brief Set the sampling rate.
+			 * \param rate One packet out of rate is sampled. 0 disables sampling.
+			 */
+			void set_rate(unsigned int rate)
+			{
+				m_rate.store(rate, std::memory_order_relaxed);
+			}
+
+			/**
+			 * \brief Get a stamp for a new packet.
+			 * \return A stamp at the current time if the packet is sampled, a stamp for a packet that is not sampled otherwise.
+			 */
+			latency_stamp sample()
+			{
+				const unsigned int rate = m_rate.load(std::memory_order_relaxed);
+
+				if (rate == 0)
+				{
+					return latency_stamp();
+				}
+
+				unsigned int* countdown = m_countdowns.get();
+
+				if (!countdown)
+				{
+					countdown = new unsigned int(rate);
+					m_countdowns.reset(countdown);
+				}
+
+				// A countdown above the rate was started before the rate was lowered.
+				if ((*countdown > 1) && (*countdown <= rate))
+				{
+					--*countdown;
+
+					return latency_stamp();
+				}
+
+				*countdown = rate;
+
+				return latency_stamp::now();
+			}
+
+		private:
+
+			latency_sampler(const latency_sampler&);
+			latency_sampler& operator=(const latency_sampler&);
+
+			std::atomic<unsigned int> m_rate;
+			boost::thread_specific_ptr<unsigned int> m_countdowns;
+	};
+
+	/**
+	 * \brief A handler that marks a stage boundary before calling another handler.
+	 * \tparam Handler The wrapped handler type.
+	 */
+	template <typename Handler>
+	class latency_handler
+	{
+		public:
+
+			/**
+			 * \brief Create a latency handler.
+			 * \param stamp The stamp of the packet.
+			 * \param histogram The histogram of the stage that ends when the handler is called.
+			 * \param handler The handler to call.
+			 */
+			latency_handler(latency_stamp stamp, latency_histogram& histogram, Handler handler) :
+				m_stamp(stamp),
+				m_histogram(&histogram),
+				m_handler(handler)
+			{}
+
+			/**
+			 * \brief Call the handler.
+			 * \param args The arguments to forward to the handler.
+			 */
+			template <typename... Args>
+			void operator()(Args&&... args)
+			{
+				m_stamp.lap(*m_histogram);
+				m_handler(std::forward<Args>(args)...);
+			}
+
+		private:
+
+			latency_stamp m_stamp;
+			latency_histogram* m_histogram;
+			Handler m_handler;
+	};
+
+	/**
+	 * \brief Create a latency handler.
+	 * \param stamp The stamp of the packet.
+	 * \param histogram The histogram of the stage that ends when the handler is called.
+	 * \param handler The handler to call.
+	 * \return The latency handler.
+	 */
+	template <typename Handler>
+	inline latency_handler<Handler> make_latency_handler(latency_stamp stamp, latency_histogram& histogram, Handler handler)
+	{
+		return latency_handler<Handler>(stamp, histogram, handler);
+	}
+}
+
+#endif /* FSCP_LATENCY_HPP */
@@ -45,6 +45,8 @@
 #ifndef MEMORY_POOL_HPP
 #define MEMORY_POOL_HPP
 
+#include "statistics.hpp"
+
 #include <boost/thread/lock_guard.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/thread/mutex.hpp>
@@ -52,7 +54,9 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/iterator/counting_iterator.hpp>
 
+#include <algorithm>
 #include <vector>
+#include <list>
 #include <set>
 #include <new>
 #include <cassert>
@@ -89,6 +93,40 @@ namespace fscp
 	template <size_t BlockSize, unsigned int BlockCount, bool UseHeapFallback>
 	size_t buffer_size(typename memory_pool<BlockSize, BlockCount, UseHeapFallback>::shared_buffer_type);
 
+	/**
+	 * @brief The small block size class: fits a standard Ethernet frame.
+	 */
+	static const size_t SMALL_BLOCK_SIZE = 2048;
+
+	/**
+	 * @brief The jumbo block size class: fits a jumbo Ethernet frame.
+	 */
+	static const size_t JUMBO_BLOCK_SIZE = 9216;
+
+	/**
+	 * @brief The large block size class: fits any datagram.
+	 */
+	static const size_t LARGE_BLOCK_SIZE = 65536;
+
+	/**
+	 * @brief Get the smallest block size class that can hold the specified size.
+	 * @param size The size that a block must hold.
+	 * @return The block size class.
+	 */
+	inline size_t get_block_size_class(size_t size)
+	{
+		if (size <= SMALL_BLOCK_SIZE)
+		{
+			return SMALL_BLOCK_SIZE;
+		}
+		else if (size <= JUMBO_BLOCK_SIZE)
+		{
+			return JUMBO_BLOCK_SIZE;
+		}
+
+		return LARGE_BLOCK_SIZE;
+	}
+
 	/**
 	 * @brief A memory pool.
 	 *
@@ -97,6 +135,8 @@ namespace fscp
 	 * memory_pool is optimized for blocks allocation.
 	 *
 	 * allocation has a constant cost; deallocation has a logarithmic cost.
+	 *
+	 * The template parameters only give the default geometry: the actual block size and block count can be chosen at runtime.
 	 */
 	template <size_t BlockSize = 65536, unsigned int BlockCount = 32, bool UseHeapFallback = true>
 	class memory_pool : public boost::noncopyable
@@ -106,12 +146,12 @@ namespace fscp
 			/**
 			 * @brief The default block size.
 			 */
-			static const size_t block_size = BlockSize;
+			static const size_t default_block_size = BlockSize;
 
 			/**
 			 * @brief The default block count.
 			 */
-			static const unsigned int block_count = BlockCount;
+			static const unsigned int default_block_count = BlockCount;
 
 			/**
 			 * @brief The heap fallback policy.
@@ -193,15 +233,85 @@ namespace fscp
 
 			/**
 			 * @brief Create a memory pool instance.
+			 * @param _block_size The size of each block.
+			 * @param _block_count The number of preallocated blocks.
 			 *
 			 * The internal memory pool occupies exactly block_size * block_count bytes.
 			 */
-			memory_pool() :
-				m_pool(BlockSize * BlockCount),
-				m_available_blocks(boost::counting_iterator<unsigned int>(0), boost::counting_iterator<unsigned int>(BlockCount))
+			explicit memory_pool(size_t _block_size = BlockSize, unsigned int _block_count = BlockCount) :
+				m_block_size(_block_size),
+				m_block_count(_block_count),
+				m_pool(_block_size * _block_count),
+				m_available_blocks(boost::counting_iterator<unsigned int>(0), boost::counting_iterator<unsigned int>(_block_count)),
+				m_retired_pools(),
+				m_heap_allocation_count()
 			{
 			}
 
+			/**
+			 * @brief Get the block size.
+			 * @return The size of each allocated buffer.
+			 */
+			size_t block_size() const
+			{
+				return m_block_size;
+			}
+
+			/**
+			 * @brief Get the block count.
+			 * @return The number of preallocated blocks.
+			 */
+			unsigned int block_count() const
+			{
+				return m_block_count;
+			}
+
+			/**
+			 * @brief Get the count of heap allocations.
+			 * @return The number of allocations that did not fit in the preallocated blocks, since the pool was created.
+			 *
+			 * This method is thread-safe.
+			 */
+			uint64_t heap_allocation_count() const
+			{
+				return m_heap_allocation_count.value();
+			}
+
+			/**
+			 * @brief Change the pool geometry.
+			 * @param _block_size The new size of each block.
+			 * @param _block_count The new number of preallocated blocks.
+			 *
+			 * The next allocations get blocks of the new size right away. Blocks that are still in use keep their memory until the last of them is deallocated.
+			 *
+			 * This method is thread-safe but any previously obtained region() is invalidated.
+			 */
+			void resize(size_t _block_size, unsigned int _block_count)
+			{
+				// Declared first so that the memory is released once the lock is.
+				pool_type released_pool;
+
+				boost::lock_guard<boost::mutex> guard(m_pool_mutex);
+
+				const unsigned int blocks_in_use = m_block_count - static_cast<unsigned int>(m_available_blocks.size());
+
+				if (blocks_in_use > 0)
+				{
+					m_retired_pools.push_back(retired_pool_type());
+					m_retired_pools.back().pool.swap(m_pool);
+					m_retired_pools.back().blocks_in_use = blocks_in_use;
+				}
+				else
+				{
+					released_pool.swap(m_pool);
+				}
+
+				pool_type(_block_size * _block_count).swap(m_pool);
+				available_blocks_type(boost::counting_iterator<unsigned int>(0), boost::counting_iterator<unsigned int>(_block_count)).swap(m_available_blocks);
+				m_block_size = _block_size;
+				m_block_count = _block_count;
+			}
+
 			/**
 			 * @brief Allocate a shared buffer.
 			 * @return The allocated shared buffer.
@@ -213,6 +323,18 @@ namespace fscp
 				return shared_buffer_type(new scoped_buffer_type(*this, allocate_buffer()));
 			}
 
+			/**
+			 * @brief Wrap a buffer into a shared buffer.
+			 * @param buffer A buffer obtained from allocate_buffer(). The shared buffer takes its ownership.
+			 * @return The shared buffer.
+			 *
+			 * This method is thread-safe.
+			 */
+			shared_buffer_type adopt_shared_buffer(buffer_type buffer)
+			{
+				return shared_buffer_type(new scoped_buffer_type(*this, buffer));
+			}
+
 			/**
 			 * @brief Allocate a buffer.
 			 * @return The allocated buffer.
@@ -223,7 +345,10 @@ namespace fscp
 			 */
 			buffer_type allocate_buffer()
 			{
-				return boost::asio::buffer(allocate(), block_size);
+				boost::unique_lock<boost::mutex> guard(m_pool_mutex);
+				const size_t size = m_block_size;
+
+				return boost::asio::buffer(allocate(guard), size);
 			}
 
 			/**
@@ -251,15 +376,103 @@ namespace fscp
 			{
 				boost::unique_lock<boost::mutex> guard(m_pool_mutex);
 
+				return allocate(guard);
+			}
+
+			/**
+			 * @brief Deallocate a buffer.
+			 * @param buffer The buffer to deallocate. If buffer was not allocated by this allocator (or if it was deallocated already), the behavior is undefined.
+			 *
+			 * This method is thread-safe.
+			 */
+			void deallocate(uint8_t* buffer)
+			{
+				// Declared first so that the memory is released once the lock is.
+				pool_type released_pool;
+
+				boost::unique_lock<boost::mutex> guard(m_pool_mutex);
+
+				if (contains(m_pool, buffer))
+				{
+					const unsigned int block = static_cast<unsigned int>(std::distance(m_pool.data(), buffer) / m_block_size);
+
+					// This should never happen (or we have a programming error).
+					assert(m_pool.data() + block * m_block_size == buffer);
+
+					m_available_blocks.insert(block);
+
+					return;
+				}
+
+				for (typename retired_pool_list::iterator retired_pool = m_retired_pools.begin(); retired_pool != m_retired_pools.end(); ++retired_pool)
+				{
+					if (contains(retired_pool->pool, buffer))
+					{
+						if (--retired_pool->blocks_in_use == 0)
+						{
+							released_pool.swap(retired_pool->pool);
+							m_retired_pools.erase(retired_pool);
+						}
+
+						return;
+					}
+				}
+
+				// The buffer was heap allocated: we don't need to keep the lock.
+				guard.unlock();
+
+				delete[] buffer;
+			}
+
+			/**
+			 * @brief Get the preallocated memory region.
+			 * @return The memory region that contains all the preallocated blocks.
+			 *
+			 * Heap allocated buffers are not part of it.
+			 */
+			boost::asio::mutable_buffer region()
+			{
+				return boost::asio::buffer(m_pool);
+			}
+
+		private:
+			typedef std::vector<uint8_t> pool_type;
+			typedef std::set<unsigned int> available_blocks_type;
+
+			// The memory of a previous geometry, kept until its blocks are all deallocated.
+			struct retired_pool_type
+			{
+				retired_pool_type() :
+					pool(),
+					blocks_in_use(0)
+				{}
+
+				pool_type pool;
+				unsigned int blocks_in_use;
+			};
+
+			typedef std::list<retired_pool_type> retired_pool_list;
+
+			static bool contains(const pool_type& pool, const uint8_t* buffer)
+			{
+				return ((buffer >= pool.data()) && (buffer < pool.data() + pool.size()));
+			}
+
+			uint8_t* allocate(boost::unique_lock<boost::mutex>& guard)
+			{
 				if (m_available_blocks.empty())
 				{
+					const size_t size = m_block_size;
+
 					// We can release the lock sooner since we won't modify the allocation table.
 					guard.unlock();
 
 					// There is no more room for this allocation: trying heap allocation if permitted.
 					if (use_heap_fallback)
 					{
-						return new uint8_t[block_size];
+						m_heap_allocation_count.add();
+
+						return new uint8_t[size];
 					}
 					else
 					{
@@ -272,43 +485,176 @@ namespace fscp
 
 					m_available_blocks.erase(m_available_blocks.begin());
 
-					return (&m_pool[0] + block_size * block);
+					return (m_pool.data() + m_block_size * block);
 				}
 			}
 
+			size_t m_block_size;
+			unsigned int m_block_count;
+			pool_type m_pool;
+			available_blocks_type m_available_blocks;
+			retired_pool_list m_retired_pools;
+			statistics_counter m_heap_allocation_count;
+			boost::mutex m_pool_mutex;
+	};
+
+	/**
+	 * @brief A memory pool per block size class.
+	 *
+	 * Each allocation is served by the smallest size class that can hold it, so that a small message never takes a large block.
+	 *
+	 * Most allocations are expected to fall in the main size class, which preallocates all the blocks: the other classes only preallocate a few of them and fall back to the heap beyond.
+	 */
+	template <unsigned int BlockCount = 32>
+	class size_class_memory_pool : public boost::noncopyable
+	{
+		public:
+
+			/**
+			 * @brief The memory pool type of each size class.
+			 */
+			typedef memory_pool<LARGE_BLOCK_SIZE, BlockCount> pool_type;
+
+			/**
+			 * @brief The default block count of the main size class.
+			 */
+			static const unsigned int default_block_count = BlockCount;
+
+			/**
+			 * @brief A mutable buffer type.
+			 */
+			typedef typename pool_type::buffer_type buffer_type;
+
+			/**
+			 * @brief A shared buffer type.
+			 */
+			typedef typename pool_type::shared_buffer_type shared_buffer_type;
+
+			/**
+			 * @brief Create a memory pool instance.
+			 * @param main_size The size that most allocations are expected to request.
+			 * @param _block_count The number of preallocated blocks of the main size class.
+			 */
+			explicit size_class_memory_pool(size_t main_size = LARGE_BLOCK_SIZE, unsigned int _block_count = BlockCount) :
+				m_small_pool(SMALL_BLOCK_SIZE, get_block_count(SMALL_BLOCK_SIZE, main_size, _block_count)),
+				m_jumbo_pool(JUMBO_BLOCK_SIZE, get_block_count(JUMBO_BLOCK_SIZE, main_size, _block_count)),
+				m_large_pool(LARGE_BLOCK_SIZE, get_block_count(LARGE_BLOCK_SIZE, main_size, _block_count))
+			{
+			}
+
+			/**
+			 * @brief Get the block count of the main size class.
+			 * @return The number of preallocated blocks of the main size class.
+			 */
+			unsigned int block_count() const
+			{
+				return std::max(std::max(m_small_pool.block_count(), m_jumbo_pool.block_count()), m_large_pool.block_count());
+			}
+
+			/**
+			 * @brief Get the count of heap allocations.
+			 * @return The number of allocations that did not fit in the preallocated blocks, in all the size classes.
+			 *
+			 * This method is thread-safe.
+			 */
+			uint64_t heap_allocation_count() const
+			{
+				return m_small_pool.heap_allocation_count() + m_jumbo_pool.heap_allocation_count() + m_large_pool.heap_allocation_count();
+			}
+
+			/**
+			 * @brief Change the main size class.
+			 * @param main_size The size that most allocations are expected to request.
+			 * @param _block_count The number of preallocated blocks of the main size class.
+			 *
+			 * This method is thread-safe: see memory_pool::resize().
+			 */
+			void resize(size_t main_size, unsigned int _block_count)
+			{
+				m_small_pool.resize(SMALL_BLOCK_SIZE, get_block_count(SMALL_BLOCK_SIZE, main_size, _block_count));
+				m_jumbo_pool.resize(JUMBO_BLOCK_SIZE, get_block_count(JUMBO_BLOCK_SIZE, main_size, _block_count));
+				m_large_pool.resize(LARGE_BLOCK_SIZE, get_block_count(LARGE_BLOCK_SIZE, main_size, _block_count));
+			}
+
+			/**
+			 * @brief Allocate a shared buffer.
+			 * @param size The size that the buffer must hold.
+			 * @return The allocated shared buffer, as large as the size class of size.
+			 *
+			 * This method is thread-safe.
+			 */
+			shared_buffer_type allocate_shared_buffer(size_t size)
+			{
+				return get_pool(size).allocate_shared_buffer();
+			}
+
+			/**
+			 * @brief Wrap a buffer into a shared buffer.
+			 * @param buffer A buffer obtained from allocate_buffer(). The shared buffer takes its ownership.
+			 * @return The shared buffer.
+			 *
+			 * This method is thread-safe.
+			 */
+			shared_buffer_type adopt_shared_buffer(buffer_type buffer)
+			{
+				return get_pool(boost::asio::buffer_size(buffer)).adopt_shared_buffer(buffer);
+			}
+
+			/**
+			 * @brief Allocate a buffer.
+			 * @param size The size that the buffer must hold.
+			 * @return The allocated buffer, as large as the size class of size.
+			 *
+			 * This method is thread-safe.
+			 *
+			 * The return buffer must be deallocated by passing it to deallocate_buffer() to avoid memory leaks.
+			 */
+			buffer_type allocate_buffer(size_t size)
+			{
+				return get_pool(size).allocate_buffer();
+			}
+
 			/**
 			 * @brief Deallocate a buffer.
-			 * @param buffer The buffer to deallocate. If buffer was not allocated by this allocator (or if it was deallocated already), the behavior is undefined.
+			 * @param buffer The buffer to deallocate, as returned by allocate_buffer().
 			 *
 			 * This method is thread-safe.
 			 */
-			void deallocate(uint8_t* buffer)
+			template <typename MutableBufferType>
+			void deallocate_buffer(MutableBufferType buffer)
 			{
-				if ((buffer < &m_pool[0]) || (buffer >= &m_pool[0] + m_pool.size()))
+				get_pool(boost::asio::buffer_size(buffer)).deallocate_buffer(buffer);
+			}
+
+		private:
+
+			static unsigned int get_block_count(size_t block_size, size_t main_size, unsigned int _block_count)
+			{
+				if (block_size == get_block_size_class(main_size))
 				{
-					// The buffer was heap allocated: we don't need to lock.
-					delete[] buffer;
+					return _block_count;
 				}
-				else
-				{
-					boost::lock_guard<boost::mutex> guard(m_pool_mutex);
 
-					const unsigned int block = static_cast<unsigned int>(std::distance(&m_pool[0], buffer) / block_size);
-
-					// This should never happen (or we have a programming error).
-					assert(&m_pool[0] + block * block_size == buffer);
+				return std::max(_block_count / 8, 1u);
+			}
 
-					m_available_blocks.insert(block);
+			pool_type& get_pool(size_t size)
+			{
+				if (size <= SMALL_BLOCK_SIZE)
+				{
+					return m_small_pool;
+				}
+				else if (size <= JUMBO_BLOCK_SIZE)
+				{
+					return m_jumbo_pool;
 				}
-			}
 
-		private:
-			typedef std::vector<uint8_t> pool_type;
-			typedef std::set<unsigned int> available_blocks_type;
+				return m_large_pool;
+			}
 
-			pool_type m_pool;
-			available_blocks_type m_available_blocks;
-			boost::mutex m_pool_mutex;
+			pool_type m_small_pool;
+			pool_type m_jumbo_pool;
+			pool_type m_large_pool;
 	};
 }
 
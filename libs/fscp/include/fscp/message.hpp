@@ -49,6 +49,7 @@
 #include "constants.hpp"
 
 #include <boost/asio.hpp>
+#include <boost/optional.hpp>
 
 #include <stdint.h>
 #include <cstring>
@@ -82,6 +83,16 @@ namespace fscp
 			 */
 			message(const void* buf, size_t buf_len);
 
+			/**
+			 * \brief Map a message on a buffer, without throwing.
+			 * \param buf The buffer.
+			 * \param buf_len The buffer length.
+			 * \return The message, or nothing if buf does not contain a valid message.
+			 *
+			 * This is the entry point to use on untrusted input: malformed messages are common and unwinding the stack for each of them is costly.
+			 */
+			static boost::optional<message> try_parse(const void* buf, size_t buf_len);
+
 			/**
 			 * \brief Get the version.
 			 * \return The version.
@@ -125,6 +136,27 @@ namespace fscp
 			 */
 			static const size_t HEADER_LENGTH = 4;
 
+			/**
+			 * \brief A tag to map a message without checking its format.
+			 *
+			 * The derived classes use it to implement their try_parse() functions.
+			 */
+			struct unchecked_tag {};
+
+			/**
+			 * \brief Create a message and map it on a buffer, without checking its format.
+			 * \param buf The buffer.
+			 */
+			message(const void* buf, unchecked_tag);
+
+			/**
+			 * \brief Check if a buffer contains a valid message.
+			 * \param buf The buffer.
+			 * \param buf_len The buffer length.
+			 * \return true if buf contains a valid message.
+			 */
+			static bool check_format(const void* buf, size_t buf_len);
+
 		private:
 
 			const void* m_data;
@@ -46,6 +46,7 @@
 #define FSCP_PEER_SESSION_HPP
 
 #include "constants.hpp"
+#include "statistics.hpp"
 
 #include <cryptoplus/buffer.hpp>
 #include <cryptoplus/random/random.hpp>
@@ -95,7 +96,8 @@ namespace fscp
 				explicit current_session_type(const session_parameters& _parameters) :
 					parameters(_parameters),
 					local_sequence_number(),
-					remote_sequence_number()
+					remote_sequence_number(),
+					start_date(boost::posix_time::microsec_clock::universal_time())
 				{}
 
 				bool is_old() const;
@@ -107,12 +109,23 @@ namespace fscp
 				cryptoplus::buffer remote_session_key;
 				cryptoplus::buffer local_nonce_prefix;
 				cryptoplus::buffer remote_nonce_prefix;
+				boost::posix_time::ptime start_date;
+			};
+
+			struct statistics_type
+			{
+				traffic_counter sent;
+				traffic_counter received;
+				statistics_counter decryption_failures;
+				statistics_counter replayed_messages;
+				statistics_counter session_renewals;
 			};
 
 			peer_session() :
 				m_local_host_identifier(),
 				m_remote_host_identifier(),
-				m_last_sign_of_life(boost::posix_time::microsec_clock::local_time())
+				m_last_sign_of_life(boost::posix_time::microsec_clock::local_time()),
+				m_statistics()
 			{
 				// Generate a random host identifier.
 				cryptoplus::random::get_random_bytes(m_local_host_identifier.data.data(), m_local_host_identifier.data.size());
@@ -220,6 +233,10 @@ namespace fscp
 			 */
 			bool clear();
 
+			statistics_type& statistics() { return m_statistics; }
+
+			const statistics_type& statistics() const { return m_statistics; }
+
 		private:
 
 			host_identifier_type m_local_host_identifier;
@@ -229,6 +246,8 @@ namespace fscp
 
 			boost::shared_ptr<next_session_type> m_next_session;
 			boost::shared_ptr<current_session_type> m_current_session;
+
+			statistics_type m_statistics;
 	};
 }
 
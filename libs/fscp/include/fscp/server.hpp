@@ -51,6 +51,9 @@
 #include "memory_pool.hpp"
 #include "presentation_store.hpp"
 #include "peer_session.hpp"
+#include "statistics.hpp"
+#include "latency.hpp"
+#include "tracepoints.hpp"
 
 #include <boost/bind.hpp>
 #include <boost/function.hpp>
@@ -63,6 +66,11 @@
 
 #include <stdint.h>
 
+namespace uringplus
+{
+	class uring;
+}
+
 namespace fscp
 {
 	class hello_message;
@@ -85,10 +93,15 @@ namespace fscp
 	{
 		private:
 
-			typedef memory_pool<65536, 32> socket_memory_pool;
+			typedef size_class_memory_pool<32> socket_memory_pool;
 
 		public:
 
+			/**
+			 * \brief The default number of preallocated socket buffers.
+			 */
+			static const unsigned int DEFAULT_SOCKET_BUFFER_COUNT = socket_memory_pool::default_block_count;
+
 			// General purpose type definitions
 
 			/**
@@ -153,6 +166,168 @@ namespace fscp
 			 */
 			typedef boost::function<void (const std::set<ep_type>&)> endpoints_handler_type;
 
+			// Statistics
+
+			/**
+			 * \brief The statistics of a peer.
+			 */
+			struct peer_statistics_type
+			{
+				peer_statistics_type() :
+					sent(),
+					received(),
+					decryption_failures(0),
+					replayed_messages(0),
+					session_age(),
+					session_renewals(0),
+					last_round_trip_time()
+				{}
+
+				/**
+				 * \brief The data sent to the peer, before encryption.
+				 */
+				traffic_statistics_type sent;
+
+				/**
+				 * \brief The data received from the peer, after decryption.
+				 */
+				traffic_statistics_type received;
+
+				/**
+				 * \brief The count of data messages from the peer that could not be decrypted.
+				 */
+				uint64_t decryption_failures;
+
+				/**
+				 * \brief The count of data messages from the peer that were dropped because their sequence number was outdated.
+				 */
+				uint64_t replayed_messages;
+
+				/**
+				 * \brief The time elapsed since the current session was established, if there is one.
+				 */
+				boost::optional<boost::posix_time::time_duration> session_age;
+
+				/**
+				 * \brief The count of times the session was renewed.
+				 */
+				uint64_t session_renewals;
+
+				/**
+				 * \brief The round-trip time of the last answered HELLO request to the peer, if any.
+				 */
+				boost::optional<boost::posix_time::time_duration> last_round_trip_time;
+			};
+
+			/**
+			 * \brief The latency of each stage of the data path, for the sampled packets.
+			 */
+			struct latency_statistics_type
+			{
+				/**
+				 * \brief From the data submission to the start of its encryption, in the session strand.
+				 */
+				latency_histogram_snapshot send_session_queue;
+
+				/**
+				 * \brief The encryption of the data.
+				 */
+				latency_histogram_snapshot send_encryption;
+
+				/**
+				 * \brief From the encryption end to the start of the socket write, in the write queue.
+				 */
+				latency_histogram_snapshot send_write_queue;
+
+				/**
+				 * \brief The socket write.
+				 */
+				latency_histogram_snapshot send_socket;
+
+				/**
+				 * \brief From the datagram reception to the start of its decryption, in the session strand.
+				 */
+				latency_histogram_snapshot receive_session_queue;
+
+				/**
+				 * \brief The decryption of the datagram.
+				 */
+				latency_histogram_snapshot receive_decryption;
+
+				/**
+				 * \brief From the decryption end to the data received callback, in the data strand.
+				 */
+				latency_histogram_snapshot receive_data_queue;
+			};
+
+			/**
+			 * \brief The server statistics.
+			 */
+			struct statistics_type
+			{
+				statistics_type() :
+					sent(),
+					received(),
+					malformed_messages(0),
+					decryption_failures(0),
+					replayed_messages(0),
+					socket_buffer_heap_allocations(0),
+					write_queue_depth(0),
+					peers(),
+					latency()
+				{}
+
+				/**
+				 * \brief The datagrams sent on the socket.
+				 */
+				traffic_statistics_type sent;
+
+				/**
+				 * \brief The datagrams received on the socket.
+				 */
+				traffic_statistics_type received;
+
+				/**
+				 * \brief The count of received datagrams that were not valid messages.
+				 */
+				uint64_t malformed_messages;
+
+				/**
+				 * \brief The count of data messages that could not be decrypted.
+				 */
+				uint64_t decryption_failures;
+
+				/**
+				 * \brief The count of data messages that were dropped because their sequence number was outdated.
+				 */
+				uint64_t replayed_messages;
+
+				/**
+				 * \brief The count of socket buffers that did not fit in the preallocated pool.
+				 */
+				uint64_t socket_buffer_heap_allocations;
+
+				/**
+				 * \brief The count of datagrams waiting to be written on the socket.
+				 */
+				uint64_t write_queue_depth;
+
+				/**
+				 * \brief The statistics of each known peer.
+				 */
+				std::map<ep_type, peer_statistics_type> peers;
+
+				/**
+				 * \brief The latency of each stage of the data path.
+				 */
+				latency_statistics_type latency;
+			};
+
+			/**
+			 * \brief A statistics handler.
+			 */
+			typedef boost::function<void (const statistics_type&)> statistics_handler_type;
+
 			// Callbacks
 
 			enum class debug_event
@@ -293,8 +468,11 @@ namespace fscp
 			 * \brief Create a new FSCP server.
 			 * \param io_service The Boost Asio io_service instance to associate with the server.
 			 * \param identity The identity store.
+			 * \param socket_buffer_count The number of preallocated socket buffers.
+			 *
+			 * Until async_set_maximum_data_size() is called, the receive buffers are large enough to hold any datagram. Sent messages always get a buffer of the smallest size class that fits them.
 			 */
-			server(boost::asio::io_service& io_service, const identity_store& identity);
+			server(boost::asio::io_service& io_service, const identity_store& identity, unsigned int socket_buffer_count = DEFAULT_SOCKET_BUFFER_COUNT);
 
 			/**
 			 * \brief Get the underlying socket.
@@ -390,6 +568,28 @@ namespace fscp
 			 */
 			void close();
 
+			/**
+			 * \brief Perform the socket I/O through io_uring rather than the io_service reactor.
+			 * \param entries The size of the submission ring.
+			 * \param ec The error code. Set to boost::asio::error::operation_not_supported if io_uring is not available.
+			 *
+			 * Datagrams are then received by a single multishot operation, in buffers that the kernel picks from the socket memory pool. If the kernel cannot do multishot receives, only the sends go through io_uring.
+			 *
+			 * When a peer closes its socket, the ICMP error that the kernel reports does not tell which peer it was: its session is not closed right away, as it is without io_uring, but times out.
+			 *
+			 * Must be called before open(). Only available on Linux.
+			 */
+			void enable_io_uring(unsigned int entries, boost::system::error_code& ec);
+
+			/**
+			 * \brief Check whether the socket I/O goes through io_uring.
+			 * \return true if io_uring is enabled.
+			 */
+			bool io_uring_enabled() const
+			{
+				return static_cast<bool>(m_uring);
+			}
+
 			/**
 			 * \brief Greet an host.
 			 * \param target The target to greet.
@@ -638,6 +838,56 @@ namespace fscp
 			 */
 			std::set<ep_type> sync_get_session_endpoints();
 
+			/**
+			 * \brief Get the server statistics.
+			 * \param handler The handler to call with the statistics.
+			 *
+			 * The counters are updated without any synchronization: the snapshot is not consistent across counters.
+			 */
+			void async_get_statistics(statistics_handler_type handler)
+			{
+				m_session_strand.post(boost::bind(&server::do_get_statistics, this, handler));
+			}
+
+			/**
+			 * \brief Get the server statistics.
+			 * \return The server statistics.
+			 * \warning If the io_service is not being run, the call will block undefinitely.
+			 * \warning This function must **NEVER** be called from inside a thread that runs one of the server's handlers.
+			 */
+			statistics_type sync_get_statistics();
+
+			/**
+			 * \brief Set the latency sampling rate.
+			 * \param rate One data message out of rate has its latency measured at each stage of the data path. 0 disables the measures.
+			 *
+			 * The measures cost two clock reads per stage and sampled message.
+			 */
+			void set_latency_sampling_rate(unsigned int rate)
+			{
+				m_latency_sampler.set_rate(rate);
+			}
+
+			/**
+			 * \brief Set the maximum size of the data that the peers send.
+			 * \param size The maximum size of the data of a data message, usually the largest frame that fits in the MTU.
+			 * \param handler The handler to call when the change is effective.
+			 *
+			 * The receive buffers are then sized to hold the largest data message instead of any datagram. If a larger datagram is received anyway, it is dropped and the receive buffers are made large enough to hold any datagram again.
+			 */
+			void async_set_maximum_data_size(size_t size, void_handler_type handler = void_handler_type())
+			{
+				m_socket_strand.post(boost::bind(&server::do_set_maximum_data_size, this, size, handler));
+			}
+
+			/**
+			 * \brief Set the maximum size of the data that the peers send.
+			 * \param size The maximum size of the data of a data message, usually the largest frame that fits in the MTU.
+			 * \warning If the io_service is not being run, the call will block undefinitely.
+			 * \warning This function must **NEVER** be called from inside a thread that runs one of the server's handlers.
+			 */
+			void sync_set_maximum_data_size(size_t size);
+
 			/**
 			 * \brief Check if a session exists with the specified endpoint.
 			 * \param handler The handler to call with the result.
@@ -1285,7 +1535,7 @@ namespace fscp
 
 		private:
 
-			void push_debug_event(debug_event event, const std::string& comment, boost::optional<ep_type> ep = boost::none)
+			void push_debug_event(debug_event event, const char* comment, boost::optional<ep_type> ep = boost::none)
 			{
 				if (m_debug_callback)
 				{
@@ -1304,6 +1554,12 @@ namespace fscp
 
 			void do_async_receive_from();
 			void handle_receive_from(const identity_store&, boost::shared_ptr<ep_type>, socket_memory_pool::shared_buffer_type, const boost::system::error_code&, size_t);
+			void handle_uring_receive_from(const identity_store&, unsigned int, const boost::system::error_code&, boost::asio::mutable_buffer, boost::asio::const_buffer, const sockaddr*, socklen_t);
+			void do_handle_uring_receive_error(unsigned int, const boost::system::error_code&);
+			void do_set_maximum_data_size(size_t, void_handler_type);
+			void do_handle_truncated_datagram();
+			void set_receive_block_size(size_t);
+			void handle_datagram_from(const identity_store&, const ep_type&, socket_memory_pool::shared_buffer_type, boost::asio::const_buffer);
 
 			ep_type to_socket_format(const ep_type& ep);
 
@@ -1311,22 +1567,78 @@ namespace fscp
 			{
 				public:
 					template <typename ConstBufferSequence, typename WriteHandler>
-					void operator()(boost::asio::ip::udp::socket* socket, const ConstBufferSequence& data, const ep_type& target, int flags, WriteHandler handler)
+					void operator()(server* _server, const ConstBufferSequence& data, const ep_type& target, WriteHandler handler)
 					{
-						assert(socket);
+						assert(_server);
 
-						socket->async_send_to(data, target, flags, handler);
+						_server->send_to(data, target, handler);
 					}
 			};
 
+			class sampled_async_sender
+			{
+				public:
+					sampled_async_sender(latency_stamp stamp, latency_histogram& write_queue_latency, latency_histogram& socket_latency) :
+						m_stamp(stamp),
+						m_write_queue_latency(&write_queue_latency),
+						m_socket_latency(&socket_latency)
+					{}
+
+					template <typename ConstBufferSequence, typename WriteHandler>
+					void operator()(server* _server, const ConstBufferSequence& data, const ep_type& target, WriteHandler handler)
+					{
+						assert(_server);
+
+						latency_stamp stamp = m_stamp;
+						stamp.lap(*m_write_queue_latency);
+
+						_server->send_to(data, target, make_latency_handler(stamp, *m_socket_latency, handler));
+					}
+
+				private:
+					latency_stamp m_stamp;
+					latency_histogram* m_write_queue_latency;
+					latency_histogram* m_socket_latency;
+			};
+
 			template <typename ConstBufferSequence, typename WriteHandler>
-			void async_send_to(const ConstBufferSequence& data, const ep_type& target, WriteHandler handler)
+			void async_send_to(const ConstBufferSequence& data, const ep_type& target, WriteHandler handler, latency_stamp stamp = latency_stamp())
 			{
-				const void_handler_type write_handler = boost::bind<void>(async_sender(), &m_socket, data, to_socket_format(target), 0, handler);
+				void_handler_type write_handler;
+
+				if (stamp.is_sampled())
+				{
+					write_handler = boost::bind<void>(sampled_async_sender(stamp, m_latency.send_write_queue, m_latency.send_socket), this, data, to_socket_format(target), handler);
+				}
+				else
+				{
+					write_handler = boost::bind<void>(async_sender(), this, data, to_socket_format(target), handler);
+				}
+
+				m_sent.add(boost::asio::buffer_size(data));
+				FSCP_TRACEPOINT(datagram_sent, FSCP_TRACEPOINT_ENDPOINT(target), boost::asio::buffer_size(data));
 
 				m_write_queue_strand.post(boost::bind(&server::push_write, this, write_handler));
 			}
 
+			template <typename ConstBufferSequence, typename WriteHandler>
+			void send_to(const ConstBufferSequence& data, const ep_type& target, WriteHandler handler)
+			{
+				if (m_uring)
+				{
+					// All the messages we send fit in a single buffer.
+					assert(boost::asio::buffer_size(*data.begin()) == boost::asio::buffer_size(data));
+
+					uring_send_to(*data.begin(), target, handler);
+				}
+				else
+				{
+					m_socket.async_send_to(data, target, 0, handler);
+				}
+			}
+
+			void uring_send_to(boost::asio::const_buffer, const ep_type&, boost::function<void (const boost::system::error_code&, size_t)>);
+
 			void push_write(void_handler_type);
 			void pop_write();
 
@@ -1335,6 +1647,10 @@ namespace fscp
 			socket_type m_socket;
 			boost::asio::strand m_socket_strand;
 			socket_memory_pool m_socket_memory_pool;
+			size_t m_receive_block_size;
+			boost::shared_ptr<uringplus::uring> m_uring;
+			bool m_uring_receive_enabled;
+			unsigned int m_uring_receive_generation;
 			std::queue<void_handler_type> m_write_queue;
 			boost::asio::strand m_write_queue_strand;
 
@@ -1397,6 +1713,15 @@ namespace fscp
 					 */
 					bool remove_reply_wait(uint32_t hello_unique_number, boost::posix_time::time_duration& duration);
 
+					/**
+					 * @brief Get the round-trip time of the last answered hello request.
+					 * @return The round-trip time, if a hello request was ever answered.
+					 */
+					const boost::optional<boost::posix_time::time_duration>& last_round_trip_time() const
+					{
+						return m_last_round_trip_time;
+					}
+
 				private:
 
 					struct pending_request_status
@@ -1422,6 +1747,7 @@ namespace fscp
 
 					uint32_t m_current_hello_unique_number;
 					pending_requests_map m_pending_requests;
+					boost::optional<boost::posix_time::time_duration> m_last_round_trip_time;
 			};
 
 			typedef memory_pool<16> greet_memory_pool;
@@ -1523,10 +1849,10 @@ namespace fscp
 
 		private: // DATA messages
 
-			void do_send_data(const ep_type&, channel_number_type, boost::asio::const_buffer, simple_handler_type);
+			void do_send_data(const ep_type&, channel_number_type, boost::asio::const_buffer, simple_handler_type, latency_stamp);
 			void do_send_data_to_list(const std::set<ep_type>&, channel_number_type, boost::asio::const_buffer, multiple_endpoints_handler_type);
 			void do_send_data_to_all(channel_number_type, boost::asio::const_buffer, multiple_endpoints_handler_type);
-			void do_send_data_to_session(peer_session&, const ep_type&, channel_number_type, boost::asio::const_buffer, simple_handler_type);
+			void do_send_data_to_session(peer_session&, const ep_type&, channel_number_type, boost::asio::const_buffer, simple_handler_type, latency_stamp = latency_stamp());
 			void do_send_contact_request(const ep_type&, const hash_list_type&, simple_handler_type);
 			void do_send_contact_request_to_list(const std::set<ep_type>&, const hash_list_type&, multiple_endpoints_handler_type);
 			void do_send_contact_request_to_all(const hash_list_type&, multiple_endpoints_handler_type);
@@ -1536,8 +1862,8 @@ namespace fscp
 			void do_send_contact_to_all(const contact_map_type&, multiple_endpoints_handler_type);
 			void do_send_contact_to_session(peer_session&, const ep_type&, const contact_map_type&, simple_handler_type);
 			void handle_data_message_from(const identity_store&, socket_memory_pool::shared_buffer_type, const data_message&, const ep_type&);
-			void do_handle_data(const identity_store&, const ep_type&, const data_message&);
-			void do_handle_data_message(const ep_type&, message_type, shared_buffer_type, boost::asio::const_buffer);
+			void do_handle_data(const identity_store&, const ep_type&, const data_message&, latency_stamp);
+			void do_handle_data_message(const ep_type&, message_type, shared_buffer_type, boost::asio::const_buffer, latency_stamp);
 			void do_handle_contact_request(const ep_type&, const std::set<hash_type>&);
 			void do_handle_contact(const ep_type&, const contact_map_type&);
 
@@ -1559,6 +1885,32 @@ namespace fscp
 
 			boost::asio::deadline_timer m_keep_alive_timer;
 
+		private: // Statistics
+
+			void do_get_statistics(statistics_handler_type);
+			void do_get_greet_statistics(const statistics_type&, statistics_handler_type);
+
+			traffic_counter m_sent;
+			traffic_counter m_received;
+			statistics_counter m_malformed_messages;
+			statistics_counter m_decryption_failures;
+			statistics_counter m_replayed_messages;
+			statistics_counter m_write_queue_depth;
+
+			struct latency_histograms_type
+			{
+				latency_histogram send_session_queue;
+				latency_histogram send_encryption;
+				latency_histogram send_write_queue;
+				latency_histogram send_socket;
+				latency_histogram receive_session_queue;
+				latency_histogram receive_decryption;
+				latency_histogram receive_data_queue;
+			};
+
+			latency_sampler m_latency_sampler;
+			latency_histograms_type m_latency;
+
 		private: // Misc
 
 			friend std::ostream& operator<<(std::ostream& os, presentation_status_type status)
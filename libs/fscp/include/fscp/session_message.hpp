@@ -80,12 +80,27 @@ namespace fscp
 			 */
 			static size_t write(void* buf, size_t buf_len, session_number_type session_number, const host_identifier_type& host_identifier, cipher_suite_type cs, elliptic_curve_type ec, const void* pub_key, size_t pub_key_len, cryptoplus::pkey::pkey sig_key);
 
+			/**
+			 * \brief Get the buffer length that write() requires.
+			 * \param pub_key_len The public key length.
+			 * \param sig_key The private key to use to sign the ciphertext.
+			 * \return The buffer length.
+			 */
+			static size_t get_buffer_size(size_t pub_key_len, cryptoplus::pkey::pkey sig_key);
+
 			/**
 			 * \brief Create a session_message from a message.
 			 * \param message The message.
 			 */
 			session_message(const message& message);
 
+			/**
+			 * \brief Create a session_message from a message, without throwing.
+			 * \param message The message.
+			 * \return The session_message, or nothing if message is not a valid session_message.
+			 */
+			static boost::optional<session_message> try_parse(const message& message);
+
 			/**
 			 * \brief Get the session number.
 			 * \return The session number.
@@ -153,6 +168,12 @@ namespace fscp
 			 * \brief The min length of the body.
 			 */
 			static const size_t MIN_BODY_LENGTH = sizeof(session_number_type) + host_identifier_type::data_type::static_size + sizeof(uint8_t) * 4 + sizeof(uint16_t);
+
+		private:
+
+			session_message(const message& message, unchecked_tag);
+
+			bool check_format() const;
 	};
 
 	inline session_number_type session_message::session_number() const
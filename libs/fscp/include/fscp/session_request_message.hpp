@@ -77,12 +77,28 @@ namespace fscp
 			 */
 			static size_t write(void* buf, size_t buf_len, session_number_type session_number, const host_identifier_type& host_identifier, const cipher_suite_list_type& cs_cap, const elliptic_curve_list_type& ec_cap, cryptoplus::pkey::pkey sig_key);
 
+			/**
+			 * \brief Get the buffer length that write() requires.
+			 * \param cs_cap The cipher suite capabilities.
+			 * \param ec_cap The elliptic curve capabilities.
+			 * \param sig_key The private key to use to sign the ciphertext.
+			 * \return The buffer length.
+			 */
+			static size_t get_buffer_size(const cipher_suite_list_type& cs_cap, const elliptic_curve_list_type& ec_cap, cryptoplus::pkey::pkey sig_key);
+
 			/**
 			 * \brief Create a session_request_message from a message.
 			 * \param message The message.
 			 */
 			session_request_message(const message& message);
 
+			/**
+			 * \brief Create a session_request_message from a message, without throwing.
+			 * \param message The message.
+			 * \return The session_request_message, or nothing if message is not a valid session_request_message.
+			 */
+			static boost::optional<session_request_message> try_parse(const message& message);
+
 			/**
 			 * \brief Get the session number.
 			 * \return The session number.
@@ -150,6 +166,12 @@ namespace fscp
 			 * \brief The min length of the body.
 			 */
 			static const size_t MIN_BODY_LENGTH = sizeof(session_number_type) + host_identifier_type::data_type::static_size + sizeof(uint16_t) * 2;
+
+		private:
+
+			session_request_message(const message& message, unchecked_tag);
+
+			bool check_format() const;
 	};
 
 	inline session_number_type session_request_message::session_number() const
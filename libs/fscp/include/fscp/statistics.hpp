@@ -0,0 +1,210 @@
+/*
+ * libfscp - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libfscp.
+ *
+ * libfscp is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libfscp is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libfscp in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file statistics.hpp
+ * \author Julien Kauffmann <julien.kauffmann@freelan.org>
+ * \brief Statistics counters.
+ */
+
+#ifndef FSCP_STATISTICS_HPP
+#define FSCP_STATISTICS_HPP
+
+#include <atomic>
+#include <cstddef>
+
+#include <stdint.h>
+
+namespace fscp
+{
+	/**
+	 * \brief The assumed size of a cache line.
+	 */
+	const size_t CACHE_LINE_SIZE = 64;
+
+	/**
+	 * \brief A statistics counter.
+	 *
+	 * Counters are updated with relaxed atomic operations: they never order anything and a snapshot of several counters is not consistent, which is fine for statistics.
+	 *
+	 * Each counter fills a whole cache line so that two counters updated by different threads never share one.
+	 */
+	class statistics_counter
+	{
+		public:
+
+			/**
+			 * \brief Create a new counter.
+			 */
+			statistics_counter() :
+				m_value()
+			{}
+
+			/**
+			 * \brief Copy a counter.
+			 * \param other The counter to copy.
+			 */
+			statistics_counter(const statistics_counter& other) :
+				m_value()
+			{
+				set(other.value());
+			}
+
+			/**
+			 * \brief Assign a counter.
+			 * \param other The counter to copy.
+			 * \return *this.
+			 */
+			statistics_counter& operator=(const statistics_counter& other)
+			{
+				set(other.value());
+
+				return *this;
+			}
+
+			/**
+			 * \brief Add a value to the counter.
+			 * \param count The value to add.
+			 */
+			void add(uint64_t count = 1)
+			{
+				m_value.value.fetch_add(count, std::memory_order_relaxed);
+			}
+
+			/**
+			 * \brief Subtract a value from the counter.
+			 * \param count The value to subtract.
+			 *
+			 * Only meaningful for counters that track a level, like a queue depth.
+			 */
+			void subtract(uint64_t count = 1)
+			{
+				m_value.value.fetch_sub(count, std::memory_order_relaxed);
+			}
+
+			/**
+			 * \brief Set the counter.
+			 * \param count The new value.
+			 */
+			void set(uint64_t count)
+			{
+				m_value.value.store(count, std::memory_order_relaxed);
+			}
+
+			/**
+			 * \brief Get the counter value.
+			 * \return The counter value.
+			 */
+			uint64_t value() const
+			{
+				return m_value.value.load(std::memory_order_relaxed);
+			}
+
+		private:
+
+			// The value comes first: as counters are CACHE_LINE_SIZE bytes apart, no two values share a cache line, whatever the alignment of the counters.
+			// Over-aligning the class instead would require an aligned operator new, which C++11 does not provide.
+			struct padded_value_type
+			{
+				std::atomic<uint64_t> value;
+				char padding[CACHE_LINE_SIZE - sizeof(std::atomic<uint64_t>)];
+			};
+
+			padded_value_type m_value;
+	};
+
+	/**
+	 * \brief A traffic statistics snapshot.
+	 */
+	struct traffic_statistics_type
+	{
+		traffic_statistics_type() :
+			packets(0),
+			bytes(0)
+		{}
+
+		/**
+		 * \brief The count of packets.
+		 */
+		uint64_t packets;
+
+		/**
+		 * \brief The count of bytes.
+		 */
+		uint64_t bytes;
+	};
+
+	/**
+	 * \brief A traffic statistics counter.
+	 */
+	class traffic_counter
+	{
+		public:
+
+			/**
+			 * \brief Count a packet.
+			 * \param size The size of the packet, in bytes.
+			 */
+			void add(size_t size)
+			{
+				m_packets.add();
+				m_bytes.add(size);
+			}
+
+			/**
+			 * \brief Get a snapshot of the counter.
+			 * \return The snapshot.
+			 */
+			traffic_statistics_type value() const
+			{
+				traffic_statistics_type result;
+
+				result.packets = m_packets.value();
+				result.bytes = m_bytes.value();
+
+				return result;
+			}
+
+		private:
+
+			statistics_counter m_packets;
+			statistics_counter m_bytes;
+	};
+}
+
+#endif /* FSCP_STATISTICS_HPP */
@@ -0,0 +1,101 @@
+/*
+ * libfscp - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libfscp.
+ *
+ * libfscp is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libfscp is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libfscp in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file tracepoints.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief Static tracepoints.
+ *
+ * On Linux, when <sys/sdt.h> is available, tracepoints are USDT probes: each one compiles to a single nop and can be attached to at runtime by tools like bpftrace or perf, without rebuilding nor enabling logs. Elsewhere, or when FREELAN_DISABLE_TRACEPOINTS is defined, they compile to nothing.
+ *
+ * The arguments of an USDT probe are evaluated even when nothing is attached to it, so they must remain cheap: endpoints are given as a pointer to their native socket address and its length, never as strings.
+ *
+ * The fscp provider has the following probes:
+ * - datagram_received(sockaddr, socklen, bytes): a datagram was received.
+ * - datagram_sent(sockaddr, socklen, bytes): a datagram was queued for sending.
+ * - data_decrypted(sockaddr, socklen, message_type, bytes): a data message was decrypted. Its cleartext size is given.
+ * - data_decryption_failed(sockaddr, socklen, bytes): a data message could not be decrypted.
+ * - session_established(sockaddr, socklen): a new session was established.
+ * - session_renewed(sockaddr, socklen): an existing session was renewed (rekeying).
+ * - session_lost(sockaddr, socklen, reason): a session was lost.
+ *
+ * For instance, to print the size of the datagrams received from each peer:
+ *
+ *     bpftrace -e 'usdt:/usr/bin/freelan:fscp:datagram_received { @[ntop(((struct sockaddr_in*)arg0)->sin_addr.s_addr)] = hist(arg2); }'
+ */
+
+#ifndef FSCP_TRACEPOINTS_HPP
+#define FSCP_TRACEPOINTS_HPP
+
+#if !defined(FREELAN_DISABLE_TRACEPOINTS) && defined(__linux__) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define FREELAN_HAS_TRACEPOINTS 1
+#endif
+#endif
+
+#ifdef FREELAN_HAS_TRACEPOINTS
+
+/**
+ * \brief Declare a tracepoint.
+ * \param provider The provider name.
+ * \param name The tracepoint name.
+ *
+ * At least one argument, and at most 12, must follow.
+ */
+#define FREELAN_PROVIDER_TRACEPOINT(provider, name, ...) STAP_PROBEV(provider, name, __VA_ARGS__)
+
+#else
+
+#define FREELAN_PROVIDER_TRACEPOINT(provider, name, ...) do {} while (false)
+
+#endif
+
+/**
+ * \brief Declare a tracepoint in the fscp provider.
+ * \param name The tracepoint name.
+ */
+#define FSCP_TRACEPOINT(name, ...) FREELAN_PROVIDER_TRACEPOINT(fscp, name, __VA_ARGS__)
+
+/**
+ * \brief Expand an endpoint into the two tracepoint arguments that describe it.
+ * \param ep The endpoint.
+ */
+#define FSCP_TRACEPOINT_ENDPOINT(ep) static_cast<const void*>((ep).data()), static_cast<unsigned int>((ep).size())
+
+#endif /* FSCP_TRACEPOINTS_HPP */
@@ -73,6 +73,9 @@ namespace fscp
 		{
 			return hash.data;
 		}
+
+		// A hash, an endpoint type and an IPv6 endpoint.
+		const size_t MAX_CONTACT_SIZE = hash_type::data_type::static_size + sizeof(uint8_t) + boost::asio::ip::address_v6::bytes_type().size() + sizeof(uint16_t);
 	}
 
 	using boost::make_transform_iterator;
@@ -99,7 +102,7 @@ namespace fscp
 	size_t data_message::write_contact(void* buf, size_t buf_len, sequence_number_type _sequence_number, data_message::calg_t cipher_algorithm, const contact_map_type& contact_map, const void* enc_key, size_t enc_key_len, const void* nonce_prefix, size_t nonce_prefix_len)
 	{
 		std::vector<uint8_t> cleartext;
-		cleartext.resize(contact_map.size() * 49);
+		cleartext.resize(contact_map.size() * MAX_CONTACT_SIZE);
 
 		std::vector<uint8_t>::iterator ptr = cleartext.begin();
 
@@ -139,13 +142,45 @@ namespace fscp
 		return raw_write(buf, buf_len, _sequence_number, cipher_algorithm, &cleartext[0], cleartext.size(), enc_key, enc_key_len, nonce_prefix, nonce_prefix_len, MESSAGE_TYPE_CONTACT);
 	}
 
+	size_t data_message::get_buffer_size(data_message::calg_t cipher_algorithm, size_t cleartext_len)
+	{
+		return HEADER_LENGTH + MIN_BODY_LENGTH + cleartext_len + cipher_algorithm.block_size();
+	}
+
+	size_t data_message::get_contact_request_buffer_size(data_message::calg_t cipher_algorithm, const hash_list_type& hash_list)
+	{
+		return get_buffer_size(cipher_algorithm, hash_list.size() * hash_type::data_type::static_size);
+	}
+
+	size_t data_message::get_contact_buffer_size(data_message::calg_t cipher_algorithm, const contact_map_type& contact_map)
+	{
+		return get_buffer_size(cipher_algorithm, contact_map.size() * MAX_CONTACT_SIZE);
+	}
+
+	size_t data_message::get_message_size(size_t cleartext_len)
+	{
+		return HEADER_LENGTH + MIN_BODY_LENGTH + cleartext_len;
+	}
+
 	hash_list_type data_message::parse_hash_list(const void* buf, size_t buflen)
+	{
+		const boost::optional<hash_list_type> result = try_parse_hash_list(buf, buflen);
+
+		if (!result)
+		{
+			throw std::runtime_error("Invalid message structure");
+		}
+
+		return *result;
+	}
+
+	boost::optional<hash_list_type> data_message::try_parse_hash_list(const void* buf, size_t buflen)
 	{
 		// Here we might loose duplicates but those are not allowed by the RFC anyway.
 
 		if ((buflen / hash_type::data_type::static_size) * hash_type::data_type::static_size != buflen)
 		{
-			throw std::runtime_error("Invalid message structure");
+			return boost::none;
 		}
 
 		hash_list_type result;
@@ -163,6 +198,18 @@ namespace fscp
 	}
 
 	contact_map_type data_message::parse_contact_map(const void* buf, size_t buflen)
+	{
+		const boost::optional<contact_map_type> result = try_parse_contact_map(buf, buflen);
+
+		if (!result)
+		{
+			throw std::runtime_error("Invalid message structure");
+		}
+
+		return *result;
+	}
+
+	boost::optional<contact_map_type> data_message::try_parse_contact_map(const void* buf, size_t buflen)
 	{
 		contact_map_type result;
 
@@ -172,7 +219,7 @@ namespace fscp
 
 			if (static_cast<const uint8_t*>(buf) + buflen - ptr < static_cast<ptrdiff_t>(hash_type::data_type::static_size) + 1)
 			{
-				throw std::runtime_error("Invalid message structure");
+				return boost::none;
 			}
 
 			std::copy(ptr, ptr + hash_type::data_type::static_size, hash.data.begin());
@@ -187,16 +234,16 @@ namespace fscp
 
 						boost::asio::ip::address_v4::bytes_type bytes;
 
-						if (static_cast<const uint8_t*>(buf) + buflen - ptr < static_cast<ptrdiff_t>(bytes.size()))
+						if (static_cast<const uint8_t*>(buf) + buflen - ptr < static_cast<ptrdiff_t>(bytes.size() + sizeof(uint16_t)))
 						{
-							throw std::runtime_error("Invalid message structure");
+							return boost::none;
 						}
 
 						std::copy(ptr, ptr + bytes.size(), bytes.begin());
 
 						ptr += bytes.size();
 
-						result[hash] = boost::asio::ip::udp::endpoint(boost::asio::ip::address_v4(bytes), ntohs(*reinterpret_cast<const uint16_t*>(ptr)));
+						result[hash] = boost::asio::ip::udp::endpoint(boost::asio::ip::address_v4(bytes), ntohs(buffer_tools::get<uint16_t>(ptr, 0)));
 
 						ptr += sizeof(uint16_t);
 
@@ -208,16 +255,16 @@ namespace fscp
 
 						boost::asio::ip::address_v6::bytes_type bytes;
 
-						if (static_cast<const uint8_t*>(buf) + buflen - ptr < static_cast<ptrdiff_t>(bytes.size()))
+						if (static_cast<const uint8_t*>(buf) + buflen - ptr < static_cast<ptrdiff_t>(bytes.size() + sizeof(uint16_t)))
 						{
-							throw std::runtime_error("Invalid message structure");
+							return boost::none;
 						}
 
 						std::copy(ptr, ptr + bytes.size(), bytes.begin());
 
 						ptr += bytes.size();
 
-						result[hash] = boost::asio::ip::udp::endpoint(boost::asio::ip::address_v6(bytes), ntohs(*reinterpret_cast<const uint16_t*>(ptr)));
+						result[hash] = boost::asio::ip::udp::endpoint(boost::asio::ip::address_v6(bytes), ntohs(buffer_tools::get<uint16_t>(ptr, 0)));
 
 						ptr += sizeof(uint16_t);
 
@@ -225,7 +272,7 @@ namespace fscp
 					}
 				default:
 					{
-						throw std::runtime_error("Invalid message structure");
+						return boost::none;
 					}
 			}
 		}
@@ -236,26 +283,51 @@ namespace fscp
 	data_message::data_message(const void* buf, size_t buf_len) :
 		message(buf, buf_len)
 	{
-		check_format();
+		if (!check_format())
+		{
+			throw std::runtime_error("buf_len");
+		}
 	}
 
 	data_message::data_message(const message& _message) :
 		message(_message)
 	{
-		check_format();
+		if (!check_format())
+		{
+			throw std::runtime_error("buf_len");
+		}
 	}
 
-	void data_message::check_format() const
+	boost::optional<data_message> data_message::try_parse(const message& _message)
 	{
-		if (length() < MIN_BODY_LENGTH)
+		const data_message result(_message, unchecked_tag());
+
+		if (!result.check_format())
 		{
-			throw std::runtime_error("buf_len");
+			return boost::none;
 		}
 
-		if (length() < MIN_BODY_LENGTH + ciphertext_size())
+		return result;
+	}
+
+	data_message::data_message(const message& _message, unchecked_tag) :
+		message(_message)
+	{
+	}
+
+	bool data_message::check_format() const
+	{
+		if (length() < MIN_BODY_LENGTH)
 		{
-			throw std::runtime_error("buf_len");
+			return false;
 		}
+
+		return (length() >= MIN_BODY_LENGTH + ciphertext_size());
+	}
+
+	size_t data_message::get_cleartext_buffer_size(data_message::calg_t cipher_algorithm) const
+	{
+		return ciphertext_size() + cipher_algorithm.block_size();
 	}
 
 	size_t data_message::get_cleartext(void* buf, size_t buf_len, data_message::calg_t cipher_algorithm, const void* enc_key, size_t enc_key_len, const void* nonce_prefix, size_t nonce_prefix_len) const
@@ -283,7 +355,7 @@ namespace fscp
 		}
 		else
 		{
-			return ciphertext_size();
+			return get_cleartext_buffer_size(cipher_algorithm);
 		}
 	}
 
@@ -312,7 +384,7 @@ namespace fscp
 
 		cipher_context.initialize(data_message::calg_t(), cryptoplus::cipher::cipher_context::unchanged, enc_key, enc_key_len, iv.data());
 
-		const size_t max_ciphertext_len = buf_len - HEADER_LENGTH - sizeof(sequence_number_type) - GCM_TAG_LENGTH - sizeof(uint16_t) - cipher_algorithm.block_size();
+		const size_t max_ciphertext_len = buf_len - HEADER_LENGTH - sizeof(sequence_number_type) - GCM_TAG_LENGTH - sizeof(uint16_t);
 
 		const cryptoplus::buffer cleartext(_cleartext, cleartext_len);
 
@@ -80,7 +80,7 @@ namespace fscp
 	hello_message::hello_message(const void* buf, size_t buf_len) :
 		message(buf, buf_len)
 	{
-		if (length() != BODY_LENGTH)
+		if (!check_format())
 		{
 			throw std::runtime_error("bad message length");
 		}
@@ -89,9 +89,31 @@ namespace fscp
 	hello_message::hello_message(const message& _message) :
 		message(_message)
 	{
-		if (length() != BODY_LENGTH)
+		if (!check_format())
 		{
 			throw std::runtime_error("bad message length");
 		}
 	}
+
+	boost::optional<hello_message> hello_message::try_parse(const message& _message)
+	{
+		const hello_message result(_message, unchecked_tag());
+
+		if (!result.check_format())
+		{
+			return boost::none;
+		}
+
+		return result;
+	}
+
+	hello_message::hello_message(const message& _message, unchecked_tag) :
+		message(_message)
+	{
+	}
+
+	bool hello_message::check_format() const
+	{
+		return (length() == BODY_LENGTH);
+	}
 }
@@ -0,0 +1,153 @@
+/*
+ * libfscp - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libfscp.
+ *
+ * libfscp is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libfscp is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libfscp in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file latency.cpp
+ * \author Julien Kauffmann <julien.kauffmann@freelan.org>
+ * \brief Latency histograms.
+ */
+
+#include "latency.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace fscp
+{
+	namespace
+	{
+		unsigned int most_significant_bit(uint64_t value)
+		{
+			unsigned int result = 0;
+
+			while (value >>= 1)
+			{
+				++result;
+			}
+
+			return result;
+		}
+	}
+
+	latency_clock::duration latency_histogram_snapshot::value_at_quantile(double quantile) const
+	{
+		if (count == 0)
+		{
+			return latency_clock::duration::zero();
+		}
+
+		const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(std::min(std::max(quantile, 0.0), 1.0) * count)));
+		uint64_t seen = 0;
+
+		for (size_t index = 0; index < counts.size(); ++index)
+		{
+			seen += counts[index];
+
+			if (seen >= rank)
+			{
+				return std::chrono::duration_cast<latency_clock::duration>(std::chrono::nanoseconds(latency_histogram::bucket_upper_bound(index)));
+			}
+		}
+
+		// The counts and the count were read at different times.
+		return std::chrono::duration_cast<latency_clock::duration>(std::chrono::nanoseconds(latency_histogram::bucket_upper_bound(counts.size() - 1)));
+	}
+
+	size_t latency_histogram::bucket_index(uint64_t value)
+	{
+		if (value < SUB_BUCKET_COUNT)
+		{
+			return static_cast<size_t>(value);
+		}
+
+		const unsigned int shift = most_significant_bit(value) - SUB_BUCKET_BITS;
+		const size_t index = shift * SUB_BUCKET_COUNT + static_cast<size_t>(value >> shift);
+
+		return std::min(index, BUCKET_COUNT - 1);
+	}
+
+	uint64_t latency_histogram::bucket_upper_bound(size_t index)
+	{
+		if (index < SUB_BUCKET_COUNT)
+		{
+			return index;
+		}
+
+		const unsigned int shift = static_cast<unsigned int>(index / SUB_BUCKET_COUNT) - 1;
+		const uint64_t sub_bucket = index % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT;
+
+		return ((sub_bucket + 1) << shift) - 1;
+	}
+
+	latency_histogram::latency_histogram() :
+		m_count(),
+		m_sum()
+	{
+		for (auto&& count : m_counts)
+		{
+			count.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	void latency_histogram::record(latency_clock::duration latency)
+	{
+		const int64_t value = std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count();
+		const uint64_t nanoseconds = (value > 0) ? static_cast<uint64_t>(value) : 0;
+
+		m_counts[bucket_index(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+		m_count.add();
+		m_sum.add(nanoseconds);
+	}
+
+	latency_histogram_snapshot latency_histogram::snapshot() const
+	{
+		latency_histogram_snapshot result;
+
+		result.counts.reserve(BUCKET_COUNT);
+
+		for (auto&& count : m_counts)
+		{
+			result.counts.push_back(count.load(std::memory_order_relaxed));
+		}
+
+		result.count = m_count.value();
+		result.sum = std::chrono::duration_cast<latency_clock::duration>(std::chrono::nanoseconds(m_sum.value()));
+
+		return result;
+	}
+}
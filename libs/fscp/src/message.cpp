@@ -66,15 +66,34 @@ namespace fscp
 	message::message(const void* buf, size_t buf_len) :
 		m_data(buf)
 	{
-		if (buf_len < HEADER_LENGTH)
+		if (!check_format(buf, buf_len))
 		{
 			throw std::runtime_error("buf_len");
 		}
+	}
 
-		if (buf_len < HEADER_LENGTH + length())
+	boost::optional<message> message::try_parse(const void* buf, size_t buf_len)
+	{
+		if (!check_format(buf, buf_len))
 		{
-			throw std::runtime_error("buf_len");
+			return boost::none;
 		}
+
+		return message(buf, unchecked_tag());
 	}
 
+	message::message(const void* buf, unchecked_tag) :
+		m_data(buf)
+	{
+	}
+
+	bool message::check_format(const void* buf, size_t buf_len)
+	{
+		if (buf_len < HEADER_LENGTH)
+		{
+			return false;
+		}
+
+		return (buf_len >= HEADER_LENGTH + ntohs(buffer_tools::get<uint16_t>(buf, 2)));
+	}
 }
@@ -139,6 +139,11 @@ namespace fscp
 			get_default_digest_algorithm()
 		);
 
+		if (m_current_session)
+		{
+			m_statistics.session_renewals.add();
+		}
+
 		m_next_session.reset();
 		swap(m_current_session, _current_session);
 
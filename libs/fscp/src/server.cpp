@@ -53,6 +53,10 @@
 #include "session_message.hpp"
 #include "data_message.hpp"
 
+#if defined(__linux__)
+#include <uringplus/uring.hpp>
+#endif
+
 #include <boost/random.hpp>
 #include <boost/make_shared.hpp>
 #include <boost/ref.hpp>
@@ -249,15 +253,36 @@ namespace fscp
 
 			return (lhs.write_der() == rhs.write_der());
 		}
+
+		unsigned int get_io_uring_receive_buffer_count(unsigned int socket_buffer_count)
+		{
+			// The kernel gets half the socket buffers: the other half holds the messages being sent or handled.
+			unsigned int result = 1;
+
+			while (result * 4 <= socket_buffer_count)
+			{
+				result *= 2;
+			}
+
+			return result;
+		}
+
+		// The io_uring receives write a header and the sender address before the datagram.
+		const size_t RECEIVE_BLOCK_HEADROOM = 256;
 	}
 
 	// Public methods
 
-	server::server(boost::asio::io_service& io_service, const identity_store& identity) :
+	server::server(boost::asio::io_service& io_service, const identity_store& identity, unsigned int socket_buffer_count) :
 		m_identity_store(identity),
 		m_debug_callback(),
 		m_socket(io_service),
 		m_socket_strand(io_service),
+		m_socket_memory_pool(LARGE_BLOCK_SIZE, socket_buffer_count),
+		m_receive_block_size(LARGE_BLOCK_SIZE),
+		m_uring(),
+		m_uring_receive_enabled(false),
+		m_uring_receive_generation(0),
 		m_write_queue_strand(io_service),
 		m_greet_strand(io_service),
 		m_accept_hello_messages_default(true),
@@ -280,7 +305,15 @@ namespace fscp
 		m_data_received_handler(),
 		m_contact_request_message_received_handler(),
 		m_contact_message_received_handler(),
-		m_keep_alive_timer(io_service, SESSION_KEEP_ALIVE_PERIOD)
+		m_keep_alive_timer(io_service, SESSION_KEEP_ALIVE_PERIOD),
+		m_sent(),
+		m_received(),
+		m_malformed_messages(),
+		m_decryption_failures(),
+		m_replayed_messages(),
+		m_write_queue_depth(),
+		m_latency_sampler(),
+		m_latency()
 	{
 		// These calls are needed in C++03 to ensure that static initializations are done in a single thread.
 		server_category();
@@ -308,6 +341,16 @@ namespace fscp
 		return promise.get_future().wait();
 	}
 
+	void server::sync_set_maximum_data_size(size_t size)
+	{
+		typedef boost::promise<void> promise_type;
+		promise_type promise;
+
+		async_set_maximum_data_size(size, boost::bind(&promise_type::set_value, &promise));
+
+		return promise.get_future().wait();
+	}
+
 	void server::open(const ep_type& listen_endpoint)
 	{
 		m_socket.open(listen_endpoint.protocol());
@@ -331,9 +374,37 @@ namespace fscp
 
 		m_keep_alive_timer.cancel();
 
+#if defined(__linux__)
+		if (m_uring)
+		{
+			m_uring->cancel();
+		}
+#endif
+
 		m_socket.close();
 	}
 
+	void server::enable_io_uring(unsigned int entries, boost::system::error_code& ec)
+	{
+#if defined(__linux__)
+		const boost::shared_ptr<uringplus::uring> new_uring = boost::make_shared<uringplus::uring>(boost::ref(get_io_service()));
+
+		new_uring->open(entries, ec);
+
+		if (ec)
+		{
+			return;
+		}
+
+		m_uring = new_uring;
+		m_uring_receive_enabled = true;
+#else
+		static_cast<void>(entries);
+
+		ec = boost::asio::error::operation_not_supported;
+#endif
+	}
+
 	void server::async_greet(const ep_type& target, duration_handler_type handler, const boost::posix_time::time_duration& timeout)
 	{
 		m_greet_strand.post(boost::bind(&server::do_greet, this, normalize(target), handler, timeout));
@@ -511,6 +582,19 @@ namespace fscp
 		return promise.get_future().get();
 	}
 
+	server::statistics_type server::sync_get_statistics()
+	{
+		typedef statistics_type result_type;
+		typedef boost::promise<result_type> promise_type;
+		promise_type promise;
+
+		void (promise_type::*setter)(const result_type&) = &promise_type::set_value;
+
+		async_get_statistics(boost::bind(setter, &promise, _1));
+
+		return promise.get_future().get();
+	}
+
 	bool server::sync_has_session_with_endpoint(const ep_type& host)
 	{
 		typedef bool result_type;
@@ -638,7 +722,7 @@ namespace fscp
 
 	void server::async_send_data(const ep_type& target, channel_number_type channel_number, boost::asio::const_buffer data, simple_handler_type handler)
 	{
-		m_session_strand.post(boost::bind(&server::do_send_data, this, normalize(target), channel_number, data, handler));
+		m_session_strand.post(boost::bind(&server::do_send_data, this, normalize(target), channel_number, data, handler, m_latency_sampler.sample()));
 	}
 
 	boost::system::error_code server::sync_send_data(const ep_type& target, channel_number_type channel_number, boost::asio::const_buffer data)
@@ -836,6 +920,16 @@ namespace fscp
 		// do_set_identity() is executed within the socket strand so this is safe.
 		set_identity(identity);
 
+#if defined(__linux__)
+		if (m_uring_receive_enabled && (m_uring_receive_generation > 0) && m_socket.is_open())
+		{
+			// The receive operation holds the identity it was started with: we start a new one.
+			m_uring->cancel_receives();
+
+			do_async_receive_from();
+		}
+#endif
+
 		async_reintroduce_to_all(&null_multiple_endpoints_handler);
 
 		if (handler)
@@ -847,9 +941,39 @@ namespace fscp
 	void server::do_async_receive_from()
 	{
 		// do_async_receive_from() is executed within the socket strand so this is safe.
+#if defined(__linux__)
+		if (m_uring_receive_enabled)
+		{
+			boost::system::error_code ec;
+
+			++m_uring_receive_generation;
+
+			// The buffers are allocated from the io_uring completions: the operation is started again when the block size changes.
+			const size_t block_size = m_receive_block_size;
+
+			// Like for the socket receives, the identity is read once, when the operation is started.
+			m_uring->async_receive_from(
+				m_socket.native_handle(),
+				get_io_uring_receive_buffer_count(m_socket_memory_pool.block_count()),
+				[this, block_size] () -> boost::asio::mutable_buffer { return m_socket_memory_pool.allocate_buffer(block_size); },
+				[this] (boost::asio::mutable_buffer block) { m_socket_memory_pool.deallocate_buffer(block); },
+				boost::bind(&server::handle_uring_receive_from, this, get_identity(), m_uring_receive_generation, _1, _2, _3, _4, _5),
+				ec
+			);
+
+			if (!ec)
+			{
+				return;
+			}
+
+			// The kernel cannot provide buffers to the receive operations: we receive through the socket instead.
+			m_uring_receive_enabled = false;
+		}
+#endif
+
 		boost::shared_ptr<ep_type> sender = boost::make_shared<ep_type>();
 
-		socket_memory_pool::shared_buffer_type receive_buffer = m_socket_memory_pool.allocate_shared_buffer();
+		socket_memory_pool::shared_buffer_type receive_buffer = m_socket_memory_pool.allocate_shared_buffer(m_receive_block_size);
 
 		m_socket.async_receive_from(
 			buffer(receive_buffer),
@@ -877,121 +1001,281 @@ namespace fscp
 
 			*sender = normalize(*sender);
 
-			if (!ec)
+			// Some systems truncate the datagrams that do not fit without reporting an error: a full buffer is assumed to hold a truncated one.
+			if ((ec == boost::asio::error::message_size) || (!ec && (bytes_received == buffer_size(data)) && (bytes_received < LARGE_BLOCK_SIZE)))
+			{
+				m_socket_strand.post(boost::bind(&server::do_handle_truncated_datagram, this));
+			}
+			else if (!ec)
+			{
+				handle_datagram_from(identity, *sender, data, buffer(data, bytes_received));
+			}
+			else if (ec == boost::asio::error::connection_refused)
+			{
+				// The host refused the connection, meaning it closed its socket so we can force-terminate the session.
+				async_close_session(*sender, &null_simple_handler);
+			}
+		}
+	}
+
+	void server::handle_uring_receive_from(const identity_store& identity, unsigned int generation, const boost::system::error_code& ec, boost::asio::mutable_buffer block, boost::asio::const_buffer datagram, const sockaddr* sender, socklen_t sender_length)
+	{
+		if (ec == boost::asio::error::message_size)
+		{
+			// The datagram was dropped but the operation goes on.
+			m_socket_strand.post(boost::bind(&server::do_handle_truncated_datagram, this));
+
+			return;
+		}
+
+		if (ec)
+		{
+			if (ec != boost::asio::error::operation_aborted)
+			{
+				m_socket_strand.post(boost::bind(&server::do_handle_uring_receive_error, this, generation, ec));
+			}
+
+			return;
+		}
+
+		const socket_memory_pool::shared_buffer_type data = m_socket_memory_pool.adopt_shared_buffer(boost::asio::buffer(block));
+
+		ep_type sender_endpoint;
+		std::memcpy(sender_endpoint.data(), sender, std::min(static_cast<size_t>(sender_length), sender_endpoint.capacity()));
+		sender_endpoint.resize(sender_length);
+
+		handle_datagram_from(identity, normalize(sender_endpoint), data, datagram);
+	}
+
+	void server::do_handle_uring_receive_error(unsigned int generation, const boost::system::error_code& ec)
+	{
+		// do_handle_uring_receive_error() is executed within the socket strand so this is safe.
+		if (generation != m_uring_receive_generation)
+		{
+			// A newer receive operation was started in the meantime.
+			return;
+		}
+
+		if (ec == boost::asio::error::invalid_argument)
+		{
+			// The kernel does not support multishot receives.
+			m_uring_receive_enabled = false;
+		}
+
+		// Any error ends the multishot receive, including the ICMP errors reported for a single peer: we start it again.
+		//
+		// Unlike with the socket receives, a connection_refused error does not tell which peer refused the datagram, so its session is not closed here and will time out instead.
+		do_async_receive_from();
+	}
+
+	void server::do_set_maximum_data_size(size_t size, void_handler_type handler)
+	{
+		// do_set_maximum_data_size() is executed within the socket strand so this is safe.
+		set_receive_block_size(get_block_size_class(data_message::get_message_size(size) + RECEIVE_BLOCK_HEADROOM));
+
+		if (handler)
+		{
+			handler();
+		}
+	}
+
+	void server::do_handle_truncated_datagram()
+	{
+		// do_handle_truncated_datagram() is executed within the socket strand so this is safe.
+		if (m_receive_block_size < LARGE_BLOCK_SIZE)
+		{
+			// A peer sends larger messages than expected: we fall back to buffers that can hold any datagram.
+			set_receive_block_size(LARGE_BLOCK_SIZE);
+		}
+	}
+
+	void server::set_receive_block_size(size_t block_size)
+	{
+		// set_receive_block_size() is executed within the socket strand so this is safe.
+		if (block_size == m_receive_block_size)
+		{
+			return;
+		}
+
+		m_receive_block_size = block_size;
+
+		// The buffers in use keep their memory until they are released.
+		m_socket_memory_pool.resize(block_size, m_socket_memory_pool.block_count());
+
+#if defined(__linux__)
+		if (m_uring_receive_enabled && (m_uring_receive_generation > 0) && m_socket.is_open())
+		{
+			// The buffers given to the kernel have the previous size: we start a new receive operation.
+			m_uring->cancel_receives();
+
+			do_async_receive_from();
+		}
+#endif
+	}
+
+	void server::handle_datagram_from(const identity_store& identity, const ep_type& sender, socket_memory_pool::shared_buffer_type data, boost::asio::const_buffer datagram)
+	{
+		const size_t bytes_received = boost::asio::buffer_size(datagram);
+
+		m_received.add(bytes_received);
+		FSCP_TRACEPOINT(datagram_received, FSCP_TRACEPOINT_ENDPOINT(sender), bytes_received);
+
+		// Malformed messages are common on an open socket: they are dropped without throwing.
+		const boost::optional<fscp::message> message = fscp::message::try_parse(boost::asio::buffer_cast<const uint8_t*>(datagram), bytes_received);
+
+		if (!message)
+		{
+			m_malformed_messages.add();
+
+			return;
+		}
+
+		switch (message->type())
+		{
+			case MESSAGE_TYPE_DATA_0:
+			case MESSAGE_TYPE_DATA_1:
+			case MESSAGE_TYPE_DATA_2:
+			case MESSAGE_TYPE_DATA_3:
+			case MESSAGE_TYPE_DATA_4:
+			case MESSAGE_TYPE_DATA_5:
+			case MESSAGE_TYPE_DATA_6:
+			case MESSAGE_TYPE_DATA_7:
+			case MESSAGE_TYPE_DATA_8:
+			case MESSAGE_TYPE_DATA_9:
+			case MESSAGE_TYPE_DATA_10:
+			case MESSAGE_TYPE_DATA_11:
+			case MESSAGE_TYPE_DATA_12:
+			case MESSAGE_TYPE_DATA_13:
+			case MESSAGE_TYPE_DATA_14:
+			case MESSAGE_TYPE_DATA_15:
+			case MESSAGE_TYPE_CONTACT_REQUEST:
+			case MESSAGE_TYPE_CONTACT:
+			case MESSAGE_TYPE_KEEP_ALIVE:
+			{
+				const boost::optional<fscp::data_message> data_message = fscp::data_message::try_parse(*message);
+
+				if (data_message)
+				{
+					m_session_strand.post(
+						make_shared_buffer_handler(
+							data,
+							boost::bind(
+								&server::do_handle_data,
+								this,
+								identity,
+								sender,
+								*data_message,
+								m_latency_sampler.sample()
+							)
+						)
+					);
+				}
+				else
+				{
+					m_malformed_messages.add();
+				}
+
+				break;
+			}
+			case MESSAGE_TYPE_HELLO_REQUEST:
+			case MESSAGE_TYPE_HELLO_RESPONSE:
+			{
+				const boost::optional<fscp::hello_message> hello_message = fscp::hello_message::try_parse(*message);
+
+				if (hello_message)
+				{
+					handle_hello_message_from(*hello_message, sender);
+				}
+				else
+				{
+					m_malformed_messages.add();
+				}
+
+				break;
+			}
+			case MESSAGE_TYPE_PRESENTATION:
 			{
 				try
 				{
-					message message(buffer_cast<const uint8_t*>(data), bytes_received);
+					presentation_message presentation_message(*message);
 
-					switch (message.type())
-					{
-						case MESSAGE_TYPE_DATA_0:
-						case MESSAGE_TYPE_DATA_1:
-						case MESSAGE_TYPE_DATA_2:
-						case MESSAGE_TYPE_DATA_3:
-						case MESSAGE_TYPE_DATA_4:
-						case MESSAGE_TYPE_DATA_5:
-						case MESSAGE_TYPE_DATA_6:
-						case MESSAGE_TYPE_DATA_7:
-						case MESSAGE_TYPE_DATA_8:
-						case MESSAGE_TYPE_DATA_9:
-						case MESSAGE_TYPE_DATA_10:
-						case MESSAGE_TYPE_DATA_11:
-						case MESSAGE_TYPE_DATA_12:
-						case MESSAGE_TYPE_DATA_13:
-						case MESSAGE_TYPE_DATA_14:
-						case MESSAGE_TYPE_DATA_15:
-						case MESSAGE_TYPE_CONTACT_REQUEST:
-						case MESSAGE_TYPE_CONTACT:
-						case MESSAGE_TYPE_KEEP_ALIVE:
-						{
-							data_message data_message(message);
-
-							m_session_strand.post(
-								make_shared_buffer_handler(
-									data,
-									boost::bind(
-										&server::do_handle_data,
-										this,
-										identity,
-										*sender,
-										data_message
-									)
-								)
-							);
-
-							break;
-						}
-						case MESSAGE_TYPE_HELLO_REQUEST:
-						case MESSAGE_TYPE_HELLO_RESPONSE:
-						{
-							hello_message hello_message(message);
+					handle_presentation_message_from(presentation_message, sender);
+				}
+				catch (std::runtime_error&)
+				{
+					// Presentation messages are rare and their certificates can only be checked by parsing them.
+					m_malformed_messages.add();
+				}
 
-							handle_hello_message_from(hello_message, *sender);
+				break;
+			}
+			case MESSAGE_TYPE_SESSION_REQUEST:
+			{
+				const boost::optional<fscp::session_request_message> session_request_message = fscp::session_request_message::try_parse(*message);
 
-							break;
-						}
-						case MESSAGE_TYPE_PRESENTATION:
-						{
-							presentation_message presentation_message(message);
+				if (session_request_message)
+				{
+					m_presentation_strand.post(
+						boost::bind(
+							&server::do_handle_session_request,
+							this,
+							data,
+							identity,
+							sender,
+							*session_request_message
+						)
+					);
+				}
+				else
+				{
+					m_malformed_messages.add();
+				}
 
-							handle_presentation_message_from(presentation_message, *sender);
+				break;
+			}
+			case MESSAGE_TYPE_SESSION:
+			{
+				const boost::optional<fscp::session_message> session_message = fscp::session_message::try_parse(*message);
 
-							break;
-						}
-						case MESSAGE_TYPE_SESSION_REQUEST:
-						{
-							session_request_message session_request_message(message);
-
-							m_presentation_strand.post(
-								boost::bind(
-									&server::do_handle_session_request,
-									this,
-									data,
-									identity,
-									*sender,
-									session_request_message
-								)
-							);
-
-							break;
-						}
-						case MESSAGE_TYPE_SESSION:
-						{
-							session_message session_message(message);
-
-							m_presentation_strand.post(
-								boost::bind(
-									&server::do_handle_session,
-									this,
-									data,
-									identity,
-									*sender,
-									session_message
-								)
-							);
-
-							break;
-						}
-						default:
-						{
-							break;
-						}
-					}
+				if (session_message)
+				{
+					m_presentation_strand.post(
+						boost::bind(
+							&server::do_handle_session,
+							this,
+							data,
+							identity,
+							sender,
+							*session_message
+						)
+					);
 				}
-				catch (std::runtime_error&)
+				else
 				{
-					// These errors can happen in normal situations (for instance when a crypto operation fails due to invalid input).
+					m_malformed_messages.add();
 				}
+
+				break;
 			}
-			else if (ec == boost::asio::error::connection_refused)
+			default:
 			{
-				// The host refused the connection, meaning it closed its socket so we can force-terminate the session.
-				async_close_session(*sender, &null_simple_handler);
+				break;
 			}
 		}
 	}
 
+	void server::uring_send_to(boost::asio::const_buffer data, const ep_type& target, boost::function<void (const boost::system::error_code&, size_t)> handler)
+	{
+#if defined(__linux__)
+		m_uring->async_send_to(m_socket.native_handle(), boost::asio::buffer(data), target.data(), static_cast<socklen_t>(target.size()), handler);
+#else
+		static_cast<void>(data);
+		static_cast<void>(target);
+
+		get_io_service().post(boost::bind(handler, boost::asio::error::operation_not_supported, 0));
+#endif
+	}
+
 	void server::push_write(void_handler_type handler)
 	{
 		// All push_write() calls are done in the same strand so the following is thread-safe.
@@ -1002,12 +1286,14 @@ namespace fscp
 		}
 
 		m_write_queue.push(handler);
+		m_write_queue_depth.set(m_write_queue.size());
 	}
 
 	void server::pop_write()
 	{
 		// All pop_write() calls are done in the same strand so the following is thread-safe.
 		m_write_queue.pop();
+		m_write_queue_depth.set(m_write_queue.size());
 
 		if (!m_write_queue.empty())
 		{
@@ -1042,7 +1328,9 @@ namespace fscp
 	}
 
 	server::ep_hello_context_type::ep_hello_context_type() :
-		m_current_hello_unique_number(generate_unique_number())
+		m_current_hello_unique_number(generate_unique_number()),
+		m_pending_requests(),
+		m_last_round_trip_time()
 	{
 	}
 
@@ -1072,6 +1360,11 @@ namespace fscp
 				// At least one handler was cancelled which means we can set the success flag.
 				request->second.success = success;
 
+				if (success)
+				{
+					m_last_round_trip_time = boost::posix_time::microsec_clock::universal_time() - request->second.start_date;
+				}
+
 				return true;
 			}
 		}
@@ -1498,7 +1791,7 @@ namespace fscp
 			return;
 		}
 
-		const socket_memory_pool::shared_buffer_type send_buffer = m_socket_memory_pool.allocate_shared_buffer();
+		const socket_memory_pool::shared_buffer_type send_buffer = m_socket_memory_pool.allocate_shared_buffer(session_request_message::get_buffer_size(m_cipher_suites, m_elliptic_curves, identity.signature_key()));
 
 		try
 		{
@@ -1538,6 +1831,8 @@ namespace fscp
 		{
 			handler(server_error::success);
 
+			FSCP_TRACEPOINT(session_lost, FSCP_TRACEPOINT_ENDPOINT(target), static_cast<unsigned int>(session_loss_reason::manual_termination));
+
 			if (m_session_lost_handler)
 			{
 				m_session_lost_handler(target, session_loss_reason::manual_termination);
@@ -1685,6 +1980,64 @@ namespace fscp
 		handler(get_session_endpoints());
 	}
 
+	void server::do_get_statistics(statistics_handler_type handler)
+	{
+		// All do_get_statistics() calls are done in the session strand so the following is thread-safe.
+		statistics_type statistics;
+
+		statistics.sent = m_sent.value();
+		statistics.received = m_received.value();
+		statistics.malformed_messages = m_malformed_messages.value();
+		statistics.decryption_failures = m_decryption_failures.value();
+		statistics.replayed_messages = m_replayed_messages.value();
+		statistics.socket_buffer_heap_allocations = m_socket_memory_pool.heap_allocation_count();
+		statistics.write_queue_depth = m_write_queue_depth.value();
+		statistics.latency.send_session_queue = m_latency.send_session_queue.snapshot();
+		statistics.latency.send_encryption = m_latency.send_encryption.snapshot();
+		statistics.latency.send_write_queue = m_latency.send_write_queue.snapshot();
+		statistics.latency.send_socket = m_latency.send_socket.snapshot();
+		statistics.latency.receive_session_queue = m_latency.receive_session_queue.snapshot();
+		statistics.latency.receive_decryption = m_latency.receive_decryption.snapshot();
+		statistics.latency.receive_data_queue = m_latency.receive_data_queue.snapshot();
+
+		for (auto&& p_session: m_peer_sessions)
+		{
+			peer_statistics_type& peer_statistics = statistics.peers[p_session.first];
+
+			peer_statistics.sent = p_session.second.statistics().sent.value();
+			peer_statistics.received = p_session.second.statistics().received.value();
+			peer_statistics.decryption_failures = p_session.second.statistics().decryption_failures.value();
+			peer_statistics.replayed_messages = p_session.second.statistics().replayed_messages.value();
+			peer_statistics.session_renewals = p_session.second.statistics().session_renewals.value();
+
+			if (p_session.second.has_current_session())
+			{
+				peer_statistics.session_age = boost::posix_time::microsec_clock::universal_time() - p_session.second.current_session().start_date;
+			}
+		}
+
+		// The round-trip times belong to the greet strand.
+		m_greet_strand.post(boost::bind(&server::do_get_greet_statistics, this, statistics, handler));
+	}
+
+	void server::do_get_greet_statistics(const statistics_type& session_statistics, statistics_handler_type handler)
+	{
+		// All do_get_greet_statistics() calls are done in the greet strand so the following is thread-safe.
+		statistics_type statistics = session_statistics;
+
+		for (auto&& peer_statistics: statistics.peers)
+		{
+			const ep_hello_context_map::const_iterator ep_hello_context = m_ep_hello_contexts.find(peer_statistics.first);
+
+			if (ep_hello_context != m_ep_hello_contexts.end())
+			{
+				peer_statistics.second.last_round_trip_time = ep_hello_context->second.last_round_trip_time();
+			}
+		}
+
+		handler(statistics);
+	}
+
 	void server::do_has_session_with_endpoint(const ep_type& host, boolean_handler_type handler)
 	{
 		// All do_has_session_with_endpoint() calls are done in the same strand so the following is thread-safe.
@@ -1741,7 +2094,7 @@ namespace fscp
 
 		peer_session& p_session = m_peer_sessions[target];
 
-		const socket_memory_pool::shared_buffer_type send_buffer = m_socket_memory_pool.allocate_shared_buffer();
+		const socket_memory_pool::shared_buffer_type send_buffer = m_socket_memory_pool.allocate_shared_buffer(session_message::get_buffer_size(buffer_size(parameters.public_key), identity.signature_key()));
 
 		try
 		{
@@ -1909,6 +2262,15 @@ namespace fscp
 			{
 				do_send_session(identity, sender, p_session.current_session_parameters());
 
+				if (session_is_new)
+				{
+					FSCP_TRACEPOINT(session_established, FSCP_TRACEPOINT_ENDPOINT(sender));
+				}
+				else
+				{
+					FSCP_TRACEPOINT(session_renewed, FSCP_TRACEPOINT_ENDPOINT(sender));
+				}
+
 				if (m_session_established_handler)
 				{
 					m_session_established_handler(sender, session_is_new, p_session.current_session().parameters.cipher_suite, p_session.current_session().parameters.elliptic_curve);
@@ -1983,12 +2345,14 @@ namespace fscp
 		}
 	}
 
-	void server::do_send_data(const ep_type& target, channel_number_type channel_number, boost::asio::const_buffer data, simple_handler_type handler)
+	void server::do_send_data(const ep_type& target, channel_number_type channel_number, boost::asio::const_buffer data, simple_handler_type handler, latency_stamp stamp)
 	{
 		// All do_send_data() calls are done in the session strand so the following is thread-safe.
+		stamp.lap(m_latency.send_session_queue);
+
 		peer_session& p_session = m_peer_sessions[target];
 
-		do_send_data_to_session(p_session, target, channel_number, data, handler);
+		do_send_data_to_session(p_session, target, channel_number, data, handler, stamp);
 	}
 
 	void server::do_send_data_to_list(const std::set<ep_type>& targets, channel_number_type channel_number, boost::asio::const_buffer data, multiple_endpoints_handler_type handler)
@@ -2013,7 +2377,7 @@ namespace fscp
 		do_send_data_to_list(get_session_endpoints(), channel_number, data, handler);
 	}
 
-	void server::do_send_data_to_session(peer_session& p_session, const ep_type& target, channel_number_type channel_number, boost::asio::const_buffer data, simple_handler_type handler)
+	void server::do_send_data_to_session(peer_session& p_session, const ep_type& target, channel_number_type channel_number, boost::asio::const_buffer data, simple_handler_type handler, latency_stamp stamp)
 	{
 		// All do_send_data_to_session() calls are done in the session strand so the following is thread-safe.
 		if (!m_socket.is_open())
@@ -2030,7 +2394,7 @@ namespace fscp
 			return;
 		}
 
-		const socket_memory_pool::shared_buffer_type send_buffer = m_socket_memory_pool.allocate_shared_buffer();
+		const socket_memory_pool::shared_buffer_type send_buffer = m_socket_memory_pool.allocate_shared_buffer(data_message::get_buffer_size(p_session.current_session().parameters.cipher_suite.to_cipher_algorithm(), buffer_size(data)));
 
 		try
 		{
@@ -2048,6 +2412,9 @@ namespace fscp
 				buffer_size(p_session.current_session().local_nonce_prefix)
 			);
 
+			p_session.statistics().sent.add(buffer_size(data));
+			stamp.lap(m_latency.send_encryption);
+
 			async_send_to(
 				buffer(send_buffer, size),
 				target,
@@ -2057,7 +2424,8 @@ namespace fscp
 						handler,
 						boost::asio::placeholders::error
 					)
-				)
+				),
+				stamp
 			);
 		}
 		catch (const cryptoplus::error::cryptographic_exception&)
@@ -2113,7 +2481,7 @@ namespace fscp
 			return;
 		}
 
-		const socket_memory_pool::shared_buffer_type send_buffer = m_socket_memory_pool.allocate_shared_buffer();
+		const socket_memory_pool::shared_buffer_type send_buffer = m_socket_memory_pool.allocate_shared_buffer(data_message::get_contact_request_buffer_size(p_session.current_session().parameters.cipher_suite.to_cipher_algorithm(), hash_list));
 
 		try
 		{
@@ -2194,7 +2562,7 @@ namespace fscp
 			return;
 		}
 
-		const socket_memory_pool::shared_buffer_type send_buffer = m_socket_memory_pool.allocate_shared_buffer();
+		const socket_memory_pool::shared_buffer_type send_buffer = m_socket_memory_pool.allocate_shared_buffer(data_message::get_contact_buffer_size(p_session.current_session().parameters.cipher_suite.to_cipher_algorithm(), contact_map));
 
 		try
 		{
@@ -2228,9 +2596,11 @@ namespace fscp
 		}
 	}
 
-	void server::do_handle_data(const identity_store& identity, const ep_type& sender, const data_message& _data_message)
+	void server::do_handle_data(const identity_store& identity, const ep_type& sender, const data_message& _data_message, latency_stamp stamp)
 	{
 		// All do_handle_data() calls are done in the same strand so the following is thread-safe.
+		stamp.lap(m_latency.receive_session_queue);
+
 		peer_session& p_session = m_peer_sessions[sender];
 
 		if (!p_session.has_current_session())
@@ -2241,10 +2611,13 @@ namespace fscp
 		if (_data_message.sequence_number() <= p_session.current_session().remote_sequence_number)
 		{
 			// The message is outdated: we ignore it.
+			p_session.statistics().replayed_messages.add();
+			m_replayed_messages.add();
+
 			return;
 		}
 
-		socket_memory_pool::shared_buffer_type cleartext_buffer = m_socket_memory_pool.allocate_shared_buffer();
+		socket_memory_pool::shared_buffer_type cleartext_buffer = m_socket_memory_pool.allocate_shared_buffer(_data_message.get_cleartext_buffer_size(p_session.current_session().parameters.cipher_suite.to_cipher_algorithm()));
 
 		try
 		{
@@ -2260,6 +2633,9 @@ namespace fscp
 
 			p_session.set_remote_sequence_number(_data_message.sequence_number());
 			p_session.keep_alive();
+			p_session.statistics().received.add(cleartext_len);
+			stamp.lap(m_latency.receive_decryption);
+			FSCP_TRACEPOINT(data_decrypted, FSCP_TRACEPOINT_ENDPOINT(sender), static_cast<unsigned int>(_data_message.type()), cleartext_len);
 
 			if (p_session.current_session().is_old())
 			{
@@ -2284,19 +2660,25 @@ namespace fscp
 					sender,
 					type,
 					cleartext_buffer,
-					buffer(cleartext_buffer, cleartext_len)
+					buffer(cleartext_buffer, cleartext_len),
+					stamp
 				)
 			);
 		}
 		catch (const cryptoplus::error::cryptographic_exception&)
 		{
 			// This can happen if a message is decoded after a session rekeying.
+			p_session.statistics().decryption_failures.add();
+			m_decryption_failures.add();
+			FSCP_TRACEPOINT(data_decryption_failed, FSCP_TRACEPOINT_ENDPOINT(sender), _data_message.ciphertext_size());
 		}
 	}
 
-	void server::do_handle_data_message(const ep_type& sender, message_type type, shared_buffer_type buffer, boost::asio::const_buffer data)
+	void server::do_handle_data_message(const ep_type& sender, message_type type, shared_buffer_type buffer, boost::asio::const_buffer data, latency_stamp stamp)
 	{
 		// All do_handle_data_message() calls are done in the same strand so the following is thread-safe.
+		stamp.lap(m_latency.receive_data_queue);
+
 		if (is_data_message_type(type))
 		{
 			// This is safe only because type is a DATA message type.
@@ -2309,29 +2691,35 @@ namespace fscp
 		}
 		else if (type == MESSAGE_TYPE_CONTACT_REQUEST)
 		{
-			const hash_list_type hash_list = data_message::parse_hash_list(buffer_cast<const uint8_t*>(data), buffer_size(data));
+			const boost::optional<hash_list_type> hash_list = data_message::try_parse_hash_list(buffer_cast<const uint8_t*>(data), buffer_size(data));
 
-			m_presentation_strand.post(
-				boost::bind(
-					&server::do_handle_contact_request,
-					this,
-					sender,
-					hash_list
-				)
-			);
+			if (hash_list)
+			{
+				m_presentation_strand.post(
+					boost::bind(
+						&server::do_handle_contact_request,
+						this,
+						sender,
+						*hash_list
+					)
+				);
+			}
 		}
 		else if (type == MESSAGE_TYPE_CONTACT)
 		{
-			const contact_map_type contact_map = data_message::parse_contact_map(buffer_cast<const uint8_t*>(data), buffer_size(data));
+			const boost::optional<contact_map_type> contact_map = data_message::try_parse_contact_map(buffer_cast<const uint8_t*>(data), buffer_size(data));
 
-			m_contact_strand.post(
-				boost::bind(
-					&server::do_handle_contact,
-					this,
-					sender,
-					contact_map
-				)
-			);
+			if (contact_map)
+			{
+				m_contact_strand.post(
+					boost::bind(
+						&server::do_handle_contact,
+						this,
+						sender,
+						*contact_map
+					)
+				);
+			}
 		}
 	}
 
@@ -2420,6 +2808,8 @@ namespace fscp
 				{
 					if (p_session.second.clear())
 					{
+						FSCP_TRACEPOINT(session_lost, FSCP_TRACEPOINT_ENDPOINT(p_session.first), static_cast<unsigned int>(session_loss_reason::timeout));
+
 						if (m_session_lost_handler)
 						{
 							m_session_lost_handler(p_session.first, session_loss_reason::timeout);
@@ -2456,7 +2846,7 @@ namespace fscp
 			return;
 		}
 
-		const socket_memory_pool::shared_buffer_type send_buffer = m_socket_memory_pool.allocate_shared_buffer();
+		const socket_memory_pool::shared_buffer_type send_buffer = m_socket_memory_pool.allocate_shared_buffer(data_message::get_buffer_size(p_session.current_session().parameters.cipher_suite.to_cipher_algorithm(), SESSION_KEEP_ALIVE_DATA_SIZE));
 
 		try
 		{
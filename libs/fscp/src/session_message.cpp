@@ -105,23 +105,51 @@ namespace fscp
 		return message::write(buf, buf_len, CURRENT_PROTOCOL_VERSION, MESSAGE_TYPE_SESSION, signed_payload_size) + signed_payload_size;
 	}
 
+	size_t session_message::get_buffer_size(size_t pub_key_len, cryptoplus::pkey::pkey sig_key)
+	{
+		// The signature is never larger than the key size.
+		return HEADER_LENGTH + MIN_BODY_LENGTH + pub_key_len + sizeof(uint16_t) + sig_key.size();
+	}
+
 	session_message::session_message(const message& _message) :
 		message(_message)
 	{
-		if (length() < MIN_BODY_LENGTH)
+		if (!check_format())
 		{
 			throw std::runtime_error("buf_len");
 		}
+	}
 
-		if (length() < MIN_BODY_LENGTH + public_key_size())
+	boost::optional<session_message> session_message::try_parse(const message& _message)
+	{
+		const session_message result(_message, unchecked_tag());
+
+		if (!result.check_format())
 		{
-			throw std::runtime_error("buf_len");
+			return boost::none;
 		}
 
-		if (length() < MIN_BODY_LENGTH + public_key_size() + header_signature_size())
+		return result;
+	}
+
+	session_message::session_message(const message& _message, unchecked_tag) :
+		message(_message)
+	{
+	}
+
+	bool session_message::check_format() const
+	{
+		if (length() < MIN_BODY_LENGTH)
 		{
-			throw std::runtime_error("buf_len");
+			return false;
 		}
+
+		if (length() < MIN_BODY_LENGTH + public_key_size())
+		{
+			return false;
+		}
+
+		return (length() >= MIN_BODY_LENGTH + public_key_size() + header_signature_size());
 	}
 
 	bool session_message::check_signature(cryptoplus::pkey::pkey key) const
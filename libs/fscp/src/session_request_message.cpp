@@ -120,28 +120,56 @@ namespace fscp
 		return message::write(buf, buf_len, CURRENT_PROTOCOL_VERSION, MESSAGE_TYPE_SESSION_REQUEST, signed_payload_size) + signed_payload_size;
 	}
 
+	size_t session_request_message::get_buffer_size(const cipher_suite_list_type& cs_cap, const elliptic_curve_list_type& ec_cap, cryptoplus::pkey::pkey sig_key)
+	{
+		// The signature is never larger than the key size.
+		return HEADER_LENGTH + MIN_BODY_LENGTH + cs_cap.size() + ec_cap.size() + sizeof(uint16_t) + sig_key.size();
+	}
+
 	session_request_message::session_request_message(const message& _message) :
 		message(_message)
 	{
-		if (length() < MIN_BODY_LENGTH)
+		if (!check_format())
 		{
 			throw std::runtime_error("buf_len");
 		}
+	}
 
-		if (length() < MIN_BODY_LENGTH + cipher_suite_capabilities_size())
+	boost::optional<session_request_message> session_request_message::try_parse(const message& _message)
+	{
+		const session_request_message result(_message, unchecked_tag());
+
+		if (!result.check_format())
 		{
-			throw std::runtime_error("buf_len");
+			return boost::none;
 		}
 
-		if (length() < MIN_BODY_LENGTH + cipher_suite_capabilities_size() + elliptic_curve_capabilities_size())
+		return result;
+	}
+
+	session_request_message::session_request_message(const message& _message, unchecked_tag) :
+		message(_message)
+	{
+	}
+
+	bool session_request_message::check_format() const
+	{
+		if (length() < MIN_BODY_LENGTH)
 		{
-			throw std::runtime_error("buf_len");
+			return false;
 		}
 
-		if (length() < MIN_BODY_LENGTH + cipher_suite_capabilities_size() + elliptic_curve_capabilities_size() + header_signature_size())
+		if (length() < MIN_BODY_LENGTH + cipher_suite_capabilities_size())
 		{
-			throw std::runtime_error("buf_len");
+			return false;
+		}
+
+		if (length() < MIN_BODY_LENGTH + cipher_suite_capabilities_size() + elliptic_curve_capabilities_size())
+		{
+			return false;
 		}
+
+		return (length() >= MIN_BODY_LENGTH + cipher_suite_capabilities_size() + elliptic_curve_capabilities_size() + header_signature_size());
 	}
 
 	cipher_suite_list_type session_request_message::cipher_suite_capabilities() const
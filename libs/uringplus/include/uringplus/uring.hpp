@@ -0,0 +1,294 @@
+/*
+ * liburingplus - An io_uring extension for Boost::ASIO.
+ * Copyright (C) 2010-2011 Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ *
+ * This file is part of liburingplus.
+ *
+ * liburingplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * liburingplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use liburingplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file uring.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief An io_uring instance that completes its operations in an io_service.
+ */
+
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/enable_shared_from_this.hpp>
+
+#include <atomic>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+struct io_uring_sqe;
+
+namespace uringplus
+{
+	/**
+	 * \brief An io_uring instance.
+	 *
+	 * Operations are queued in the submission ring and submitted together, once per io_service wakeup. Completions are signaled through an eventfd that is watched by the io_service, so the handlers are called from the threads that run it, like any other asynchronous operation.
+	 *
+	 * A single instance may serve any number of file descriptors and sockets.
+	 *
+	 * All methods are thread-safe. Instances must be managed by a boost::shared_ptr.
+	 */
+	class uring : public boost::noncopyable, public boost::enable_shared_from_this<uring>
+	{
+		public:
+
+			/**
+			 * \brief The maximum number of buffers of an operation. Extra buffers are ignored.
+			 */
+			static const size_t MAX_BUFFERS = 4;
+
+			/**
+			 * \brief The handler type.
+			 */
+			typedef boost::function<void (const boost::system::error_code&, size_t)> handler_type;
+
+			/**
+			 * \brief The buffer allocation function type.
+			 *
+			 * Called from the completion threads to feed the kernel with receive buffers.
+			 */
+			typedef boost::function<boost::asio::mutable_buffer ()> allocate_buffer_type;
+
+			/**
+			 * \brief The buffer deallocation function type.
+			 *
+			 * Called with the receive buffers that the kernel did not use.
+			 */
+			typedef boost::function<void (boost::asio::mutable_buffer)> deallocate_buffer_type;
+
+			/**
+			 * \brief The receive handler type.
+			 * \param ec The error code. Any error ends the receive operation, except boost::asio::error::message_size which reports a datagram that did not fit in a buffer and was dropped.
+			 * \param block The buffer the datagram was received in, as returned by the allocation function. The handler takes its ownership.
+			 * \param data The datagram, within block.
+			 * \param sender The sender address, within block.
+			 * \param sender_length The length of the sender address.
+			 *
+			 * On error, block and data are empty and sender is null.
+			 */
+			typedef boost::function<void (const boost::system::error_code& ec, boost::asio::mutable_buffer block, boost::asio::const_buffer data, const sockaddr* sender, socklen_t sender_length)> receive_handler_type;
+
+			/**
+			 * \brief Create a new closed io_uring instance.
+			 * \param io_service The io_service to complete the operations in.
+			 */
+			explicit uring(boost::asio::io_service& io_service);
+
+			/**
+			 * \brief Destroy the instance, closing it if needed.
+			 */
+			~uring();
+
+			/**
+			 * \brief Open the instance.
+			 * \param entries The size of the submission ring.
+			 * \param ec The error code. Set to boost::asio::error::operation_not_supported if the kernel has no io_uring support.
+			 */
+			void open(unsigned int entries, boost::system::error_code& ec);
+
+			/**
+			 * \brief Check whether the instance is open.
+			 * \return true if the instance is open.
+			 */
+			bool is_open() const
+			{
+				return (m_fd >= 0);
+			}
+
+			/**
+			 * \brief Cancel all the pending operations.
+			 *
+			 * Their handlers are called with boost::asio::error::operation_aborted.
+			 */
+			void cancel();
+
+			/**
+			 * \brief Cancel the pending receive operations only.
+			 *
+			 * Their handlers are called with boost::asio::error::operation_aborted.
+			 */
+			void cancel_receives();
+
+			/**
+			 * \brief Close the instance.
+			 *
+			 * Pending operations are cancelled and waited for before the call returns.
+			 */
+			void close();
+
+			/**
+			 * \brief Register a memory region with the kernel.
+			 * \param region The memory region. Must outlive the instance.
+			 * \param ec The error code.
+			 *
+			 * Single-buffer reads and writes whose buffer lies within region then use fixed buffers, sparing the kernel a page lookup per operation.
+			 *
+			 * Must be called before any operation is started.
+			 */
+			void register_buffer(boost::asio::mutable_buffer region, boost::system::error_code& ec);
+
+			/**
+			 * \brief Read some data from a file descriptor.
+			 * \param fd The file descriptor.
+			 * \param buffers The buffers into which the data will be read.
+			 * \param handler The handler to be called when the read operation completes.
+			 */
+			template <typename MutableBufferSequence>
+			void async_read(int fd, const MutableBufferSequence& buffers, handler_type handler)
+			{
+				iovec iovecs[MAX_BUFFERS];
+				const size_t count = to_iovecs(buffers, iovecs);
+
+				submit(operation_type::read, fd, iovecs, count, nullptr, 0, handler);
+			}
+
+			/**
+			 * \brief Write some data to a file descriptor.
+			 * \param fd The file descriptor.
+			 * \param buffers One or more buffers to be written.
+			 * \param handler The handler to be called when the write operation completes.
+			 */
+			template <typename ConstBufferSequence>
+			void async_write(int fd, const ConstBufferSequence& buffers, handler_type handler)
+			{
+				iovec iovecs[MAX_BUFFERS];
+				const size_t count = to_iovecs(buffers, iovecs);
+
+				submit(operation_type::write, fd, iovecs, count, nullptr, 0, handler);
+			}
+
+			/**
+			 * \brief Send a datagram on a socket.
+			 * \param fd The socket.
+			 * \param buffers One or more buffers that make the datagram.
+			 * \param target The target address.
+			 * \param target_length The length of the target address.
+			 * \param handler The handler to be called when the send operation completes.
+			 */
+			template <typename ConstBufferSequence>
+			void async_send_to(int fd, const ConstBufferSequence& buffers, const sockaddr* target, socklen_t target_length, handler_type handler)
+			{
+				iovec iovecs[MAX_BUFFERS];
+				const size_t count = to_iovecs(buffers, iovecs);
+
+				submit(operation_type::send_to, fd, iovecs, count, target, target_length, handler);
+			}
+
+			/**
+			 * \brief Receive datagrams from a socket until an error occurs or the operation is cancelled.
+			 * \param fd The socket.
+			 * \param buffer_count The number of buffers to keep at the disposal of the kernel. Must be a power of two.
+			 * \param allocate_buffer The function that provides the receive buffers.
+			 * \param deallocate_buffer The function that takes back the receive buffers that were not used.
+			 * \param handler The handler to be called for every received datagram and, at last, with the error that ended the operation.
+			 * \param ec The error code. Set to boost::asio::error::operation_not_supported if the kernel cannot provide buffers to receive operations.
+			 *
+			 * A single multishot operation receives all the datagrams: the kernel picks a buffer from the provided ones for each datagram, and every consumed buffer is replaced by a newly allocated one. Truncated datagrams are dropped and reported to the handler.
+			 */
+			void async_receive_from(int fd, unsigned int buffer_count, allocate_buffer_type allocate_buffer, deallocate_buffer_type deallocate_buffer, receive_handler_type handler, boost::system::error_code& ec);
+
+		private:
+
+			enum class operation_type
+			{
+				read,
+				write,
+				send_to,
+				receive_from
+			};
+
+			struct operation;
+			struct completion;
+			struct ring;
+			struct buffer_ring;
+
+			template <typename BufferSequence>
+			static size_t to_iovecs(const BufferSequence& buffers, iovec* iovecs)
+			{
+				size_t count = 0;
+
+				for (auto it = buffers.begin(); (it != buffers.end()) && (count < MAX_BUFFERS); ++it)
+				{
+					const boost::asio::const_buffer buf(*it);
+
+					iovecs[count++] = iovec{ const_cast<void*>(boost::asio::buffer_cast<const void*>(buf)), boost::asio::buffer_size(buf) };
+				}
+
+				return count;
+			}
+
+			void submit(operation_type, int, const iovec*, size_t, const sockaddr*, socklen_t, handler_type);
+			bool start_locked(operation*);
+			void schedule_flush_locked();
+			void flush();
+			void flush_locked();
+			void cancel_locked();
+			void cancel_operations_locked(bool);
+			struct io_uring_sqe* get_sqe_locked();
+			void push_sqe_locked();
+			void async_wait_completions();
+			void handle_completions(const boost::system::error_code&);
+			size_t reap_completions_locked(std::vector<completion>&);
+			void complete(const completion&, bool);
+			void complete_receive(const completion&, bool);
+			void destroy_buffer_ring(buffer_ring*);
+			void destroy_ring();
+
+			boost::asio::io_service& m_io_service;
+			int m_fd;
+			ring* m_ring;
+			boost::asio::posix::stream_descriptor m_event_descriptor;
+			boost::mutex m_submission_mutex;
+			boost::mutex m_completion_mutex;
+			bool m_flush_scheduled;
+			unsigned int m_unsubmitted;
+			unsigned int m_cancel_generation;
+			unsigned int m_receive_cancel_generation;
+			uint16_t m_next_buffer_group;
+			operation* m_pending_operations;
+			std::atomic<size_t> m_pending_operation_count;
+			boost::asio::mutable_buffer m_registered_region;
+	};
+}
+
@@ -0,0 +1,1062 @@
+/*
+ * liburingplus - An io_uring extension for Boost::ASIO.
+ * Copyright (C) 2010-2011 Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ *
+ * This file is part of liburingplus.
+ *
+ * liburingplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * liburingplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use liburingplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file uring.cpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief An io_uring instance that completes its operations in an io_service.
+ */
+
+#include "uring.hpp"
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <unistd.h>
+
+namespace uringplus
+{
+	namespace
+	{
+		int io_uring_setup(unsigned int entries, struct io_uring_params* params)
+		{
+			return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+		}
+
+		int io_uring_enter(int fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags)
+		{
+			return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0));
+		}
+
+		int io_uring_register(int fd, unsigned int opcode, const void* arg, unsigned int nr_args)
+		{
+			return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+		}
+
+		boost::system::error_code last_error()
+		{
+			return boost::system::error_code(errno, boost::system::system_category());
+		}
+
+		boost::system::error_code result_to_error_code(int result)
+		{
+			if (result >= 0)
+			{
+				return boost::system::error_code();
+			}
+			else if (result == -ECANCELED)
+			{
+				return boost::asio::error::operation_aborted;
+			}
+
+			return boost::system::error_code(-result, boost::system::system_category());
+		}
+	}
+
+	struct uring::buffer_ring
+	{
+		uint16_t group;
+		void* memory;
+		size_t size;
+		unsigned int entries;
+		std::vector<boost::asio::mutable_buffer> blocks;
+		allocate_buffer_type allocate_buffer;
+		deallocate_buffer_type deallocate_buffer;
+
+#if defined(IORING_RECV_MULTISHOT)
+		void provide(uint16_t id, boost::asio::mutable_buffer block)
+		{
+			// The ring tail overlays the reserved field of the first entry, which we must leave untouched.
+			struct io_uring_buf* const buffers = static_cast<struct io_uring_buf*>(memory);
+			uint16_t* const tail = reinterpret_cast<uint16_t*>(static_cast<uint8_t*>(memory) + offsetof(struct io_uring_buf, resv));
+			struct io_uring_buf& buffer = buffers[*tail & (entries - 1)];
+
+			buffer.addr = reinterpret_cast<uint64_t>(boost::asio::buffer_cast<void*>(block));
+			buffer.len = static_cast<uint32_t>(boost::asio::buffer_size(block));
+			buffer.bid = id;
+			blocks[id] = block;
+
+			__atomic_store_n(tail, static_cast<uint16_t>(*tail + 1), __ATOMIC_RELEASE);
+		}
+#endif
+	};
+
+	struct uring::operation
+	{
+		operation_type type;
+		int fd;
+		iovec iovecs[MAX_BUFFERS];
+		msghdr message;
+		sockaddr_storage address;
+		handler_type handler;
+		receive_handler_type receive_handler;
+		buffer_ring* buffers;
+		unsigned int cancel_generation;
+		unsigned int receive_cancel_generation;
+		operation* previous;
+		operation* next;
+	};
+
+	struct uring::completion
+	{
+		operation* op;
+		int result;
+		unsigned int flags;
+		boost::asio::mutable_buffer block;
+
+		bool is_final() const
+		{
+#if defined(IORING_RECV_MULTISHOT)
+			// Multishot operations keep going as long as the kernel says so.
+			return ((op->type != operation_type::receive_from) || !(flags & IORING_CQE_F_MORE));
+#else
+			return true;
+#endif
+		}
+	};
+
+	struct uring::ring
+	{
+		void* sq_ring;
+		size_t sq_ring_size;
+		void* cq_ring;
+		size_t cq_ring_size;
+		struct io_uring_sqe* sqes;
+		size_t sqes_size;
+
+		unsigned int* sq_head;
+		unsigned int* sq_tail;
+		unsigned int* sq_flags;
+		unsigned int* sq_array;
+		unsigned int sq_mask;
+		unsigned int sq_entries;
+
+		unsigned int* cq_head;
+		unsigned int* cq_tail;
+		struct io_uring_cqe* cqes;
+		unsigned int cq_mask;
+		unsigned int cq_entries;
+	};
+
+	uring::uring(boost::asio::io_service& io_service) :
+		m_io_service(io_service),
+		m_fd(-1),
+		m_ring(nullptr),
+		m_event_descriptor(io_service),
+		m_submission_mutex(),
+		m_completion_mutex(),
+		m_flush_scheduled(false),
+		m_unsubmitted(0),
+		m_cancel_generation(0),
+		m_receive_cancel_generation(0),
+		m_next_buffer_group(0),
+		m_pending_operations(nullptr),
+		m_pending_operation_count(0),
+		m_registered_region()
+	{
+	}
+
+	uring::~uring()
+	{
+		close();
+	}
+
+	void uring::open(unsigned int entries, boost::system::error_code& ec)
+	{
+		ec = boost::system::error_code();
+
+		boost::mutex::scoped_lock lock(m_submission_mutex);
+
+		if (is_open())
+		{
+			ec = boost::asio::error::already_open;
+
+			return;
+		}
+
+		struct io_uring_params params {};
+
+		m_fd = io_uring_setup(entries, &params);
+
+		if (m_fd < 0)
+		{
+			ec = (errno == ENOSYS) ? boost::asio::error::operation_not_supported : last_error();
+
+			return;
+		}
+
+		m_ring = new ring();
+
+		m_ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+		m_ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+		m_ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+		if (params.features & IORING_FEAT_SINGLE_MMAP)
+		{
+			// Both rings live in the same mapping.
+			m_ring->sq_ring_size = m_ring->cq_ring_size = std::max(m_ring->sq_ring_size, m_ring->cq_ring_size);
+		}
+
+		m_ring->sq_ring = ::mmap(0, m_ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+
+		if (m_ring->sq_ring == MAP_FAILED)
+		{
+			ec = last_error();
+			m_ring->sq_ring = nullptr;
+			destroy_ring();
+
+			return;
+		}
+
+		if (params.features & IORING_FEAT_SINGLE_MMAP)
+		{
+			m_ring->cq_ring = m_ring->sq_ring;
+		}
+		else
+		{
+			m_ring->cq_ring = ::mmap(0, m_ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+
+			if (m_ring->cq_ring == MAP_FAILED)
+			{
+				ec = last_error();
+				m_ring->cq_ring = nullptr;
+				destroy_ring();
+
+				return;
+			}
+		}
+
+		void* const sqes = ::mmap(0, m_ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+
+		if (sqes == MAP_FAILED)
+		{
+			ec = last_error();
+			destroy_ring();
+
+			return;
+		}
+
+		uint8_t* const sq_ring = static_cast<uint8_t*>(m_ring->sq_ring);
+		uint8_t* const cq_ring = static_cast<uint8_t*>(m_ring->cq_ring);
+
+		m_ring->sqes = static_cast<struct io_uring_sqe*>(sqes);
+		m_ring->sq_head = reinterpret_cast<unsigned int*>(sq_ring + params.sq_off.head);
+		m_ring->sq_tail = reinterpret_cast<unsigned int*>(sq_ring + params.sq_off.tail);
+		m_ring->sq_flags = reinterpret_cast<unsigned int*>(sq_ring + params.sq_off.flags);
+		m_ring->sq_array = reinterpret_cast<unsigned int*>(sq_ring + params.sq_off.array);
+		m_ring->sq_mask = *reinterpret_cast<unsigned int*>(sq_ring + params.sq_off.ring_mask);
+		m_ring->sq_entries = *reinterpret_cast<unsigned int*>(sq_ring + params.sq_off.ring_entries);
+		m_ring->cq_head = reinterpret_cast<unsigned int*>(cq_ring + params.cq_off.head);
+		m_ring->cq_tail = reinterpret_cast<unsigned int*>(cq_ring + params.cq_off.tail);
+		m_ring->cqes = reinterpret_cast<struct io_uring_cqe*>(cq_ring + params.cq_off.cqes);
+		m_ring->cq_mask = *reinterpret_cast<unsigned int*>(cq_ring + params.cq_off.ring_mask);
+		m_ring->cq_entries = *reinterpret_cast<unsigned int*>(cq_ring + params.cq_off.ring_entries);
+
+		// The kernel signals the completions through an eventfd, which the io_service watches for us.
+		const int event_fd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+		if (event_fd < 0)
+		{
+			ec = last_error();
+			destroy_ring();
+
+			return;
+		}
+
+		if (io_uring_register(m_fd, IORING_REGISTER_EVENTFD, &event_fd, 1) < 0)
+		{
+			ec = last_error();
+			::close(event_fd);
+			destroy_ring();
+
+			return;
+		}
+
+		if (m_event_descriptor.assign(event_fd, ec))
+		{
+			::close(event_fd);
+			destroy_ring();
+
+			return;
+		}
+
+		lock.unlock();
+
+		async_wait_completions();
+	}
+
+	void uring::cancel()
+	{
+		boost::mutex::scoped_lock lock(m_submission_mutex);
+
+		if (is_open())
+		{
+			cancel_locked();
+			flush_locked();
+		}
+	}
+
+	void uring::cancel_receives()
+	{
+		boost::mutex::scoped_lock lock(m_submission_mutex);
+
+		if (is_open())
+		{
+			++m_receive_cancel_generation;
+
+			cancel_operations_locked(true);
+			flush_locked();
+		}
+	}
+
+	void uring::close()
+	{
+		{
+			boost::mutex::scoped_lock lock(m_submission_mutex);
+
+			if (!is_open())
+			{
+				return;
+			}
+
+			cancel_locked();
+			flush_locked();
+		}
+
+		std::vector<completion> completions;
+
+		{
+			// Holding the completion lock prevents the completions from being reaped elsewhere while we wait for them.
+			boost::mutex::scoped_lock lock(m_completion_mutex);
+
+			while (m_pending_operation_count > 0)
+			{
+				if (reap_completions_locked(completions) == 0)
+				{
+					if ((io_uring_enter(m_fd, 0, 1, IORING_ENTER_GETEVENTS) < 0) && (errno != EINTR))
+					{
+						break;
+					}
+				}
+			}
+
+			boost::system::error_code ec;
+			m_event_descriptor.close(ec);
+
+			boost::mutex::scoped_lock submission_lock(m_submission_mutex);
+
+			destroy_ring();
+		}
+
+		// The handlers are never called from within close().
+		for (const completion& c : completions)
+		{
+			complete(c, true);
+		}
+	}
+
+	void uring::register_buffer(boost::asio::mutable_buffer region, boost::system::error_code& ec)
+	{
+		ec = boost::system::error_code();
+
+		boost::mutex::scoped_lock lock(m_submission_mutex);
+
+		if (!is_open())
+		{
+			ec = boost::asio::error::bad_descriptor;
+
+			return;
+		}
+
+		const iovec region_iovec = { boost::asio::buffer_cast<void*>(region), boost::asio::buffer_size(region) };
+
+		if (io_uring_register(m_fd, IORING_REGISTER_BUFFERS, &region_iovec, 1) < 0)
+		{
+			ec = last_error();
+
+			return;
+		}
+
+		m_registered_region = region;
+	}
+
+	void uring::async_receive_from(int fd, unsigned int buffer_count, allocate_buffer_type allocate_buffer, deallocate_buffer_type deallocate_buffer, receive_handler_type handler, boost::system::error_code& ec)
+	{
+		ec = boost::system::error_code();
+
+#if defined(IORING_RECV_MULTISHOT)
+		if ((buffer_count == 0) || (buffer_count > 32768) || ((buffer_count & (buffer_count - 1)) != 0))
+		{
+			ec = boost::asio::error::invalid_argument;
+
+			return;
+		}
+
+		boost::mutex::scoped_lock lock(m_submission_mutex);
+
+		if (!is_open())
+		{
+			ec = boost::asio::error::bad_descriptor;
+
+			return;
+		}
+
+		buffer_ring* const buffers = new buffer_ring();
+
+		buffers->group = m_next_buffer_group++;
+		buffers->size = buffer_count * sizeof(struct io_uring_buf);
+		buffers->entries = buffer_count;
+		buffers->blocks.resize(buffer_count);
+		buffers->allocate_buffer = allocate_buffer;
+		buffers->deallocate_buffer = deallocate_buffer;
+
+		// The buffer ring must be page-aligned.
+		buffers->memory = ::mmap(0, buffers->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if (buffers->memory == MAP_FAILED)
+		{
+			ec = last_error();
+
+			delete buffers;
+
+			return;
+		}
+
+		struct io_uring_buf_reg registration {};
+
+		registration.ring_addr = reinterpret_cast<uint64_t>(buffers->memory);
+		registration.ring_entries = buffer_count;
+		registration.bgid = buffers->group;
+
+		if (io_uring_register(m_fd, IORING_REGISTER_PBUF_RING, &registration, 1) < 0)
+		{
+			// Kernels older than 5.19 do not know about buffer rings.
+			ec = (errno == EINVAL) ? boost::asio::error::operation_not_supported : last_error();
+
+			::munmap(buffers->memory, buffers->size);
+			delete buffers;
+
+			return;
+		}
+
+		for (unsigned int id = 0; id < buffer_count; ++id)
+		{
+			buffers->provide(static_cast<uint16_t>(id), allocate_buffer());
+		}
+
+		operation* const op = new operation();
+
+		op->type = operation_type::receive_from;
+		op->fd = fd;
+		op->message.msg_namelen = sizeof(op->address);
+		op->receive_handler = handler;
+		op->buffers = buffers;
+
+		if (!start_locked(op))
+		{
+			ec = boost::asio::error::no_buffer_space;
+
+			lock.unlock();
+
+			destroy_buffer_ring(buffers);
+			delete op;
+		}
+#else
+		static_cast<void>(fd);
+		static_cast<void>(buffer_count);
+		static_cast<void>(allocate_buffer);
+		static_cast<void>(deallocate_buffer);
+		static_cast<void>(handler);
+
+		ec = boost::asio::error::operation_not_supported;
+#endif
+	}
+
+	void uring::submit(operation_type type, int fd, const iovec* iovecs, size_t count, const sockaddr* address, socklen_t address_length, handler_type handler)
+	{
+		operation* const op = new operation();
+
+		op->type = type;
+		op->fd = fd;
+		std::copy(iovecs, iovecs + count, op->iovecs);
+		op->message.msg_iov = op->iovecs;
+		op->message.msg_iovlen = count;
+		op->handler = handler;
+
+		if (address)
+		{
+			std::memcpy(&op->address, address, std::min(static_cast<size_t>(address_length), sizeof(op->address)));
+			op->message.msg_name = &op->address;
+			op->message.msg_namelen = address_length;
+		}
+
+		boost::mutex::scoped_lock lock(m_submission_mutex);
+
+		if (!start_locked(op))
+		{
+			const boost::system::error_code ec = is_open() ? boost::asio::error::no_buffer_space : boost::asio::error::bad_descriptor;
+
+			m_io_service.post(boost::bind(handler, ec, 0));
+
+			delete op;
+		}
+	}
+
+	bool uring::start_locked(operation* op)
+	{
+		struct io_uring_sqe* sqe = is_open() ? get_sqe_locked() : nullptr;
+
+		if (!sqe && is_open())
+		{
+			// The submission ring is full: make room by submitting what it contains.
+			flush_locked();
+			sqe = get_sqe_locked();
+		}
+
+		if (!sqe)
+		{
+			return false;
+		}
+
+		const size_t count = op->message.msg_iovlen;
+		const uint8_t* const region_begin = boost::asio::buffer_cast<const uint8_t*>(m_registered_region);
+		const uint8_t* const region_end = region_begin + boost::asio::buffer_size(m_registered_region);
+		const uint8_t* const buffer_begin = static_cast<const uint8_t*>(op->iovecs[0].iov_base);
+		const bool is_fixed = (count == 1) && (buffer_begin >= region_begin) && (buffer_begin + op->iovecs[0].iov_len <= region_end);
+
+		std::memset(sqe, 0, sizeof(*sqe));
+
+		sqe->fd = op->fd;
+		sqe->user_data = reinterpret_cast<uint64_t>(op);
+
+		switch (op->type)
+		{
+			case operation_type::read:
+			case operation_type::write:
+			{
+				if (is_fixed)
+				{
+					sqe->opcode = (op->type == operation_type::read) ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+					sqe->addr = reinterpret_cast<uint64_t>(op->iovecs[0].iov_base);
+					sqe->len = static_cast<uint32_t>(op->iovecs[0].iov_len);
+					sqe->buf_index = 0;
+				}
+				else
+				{
+					sqe->opcode = (op->type == operation_type::read) ? IORING_OP_READV : IORING_OP_WRITEV;
+					sqe->addr = reinterpret_cast<uint64_t>(op->iovecs);
+					sqe->len = static_cast<uint32_t>(count);
+				}
+
+				break;
+			}
+			case operation_type::send_to:
+			{
+				sqe->opcode = IORING_OP_SENDMSG;
+				sqe->addr = reinterpret_cast<uint64_t>(&op->message);
+				sqe->len = 1;
+
+				break;
+			}
+			case operation_type::receive_from:
+			{
+#if defined(IORING_RECV_MULTISHOT)
+				// The kernel writes the sender address and the datagram in a buffer it picks from the group.
+				sqe->opcode = IORING_OP_RECVMSG;
+				sqe->addr = reinterpret_cast<uint64_t>(&op->message);
+				sqe->len = 1;
+				sqe->flags = IOSQE_BUFFER_SELECT;
+				sqe->buf_group = op->buffers->group;
+				sqe->ioprio = IORING_RECV_MULTISHOT;
+#endif
+
+				break;
+			}
+		}
+
+		push_sqe_locked();
+
+		op->cancel_generation = m_cancel_generation;
+		op->receive_cancel_generation = m_receive_cancel_generation;
+		op->previous = nullptr;
+		op->next = m_pending_operations;
+
+		if (m_pending_operations)
+		{
+			m_pending_operations->previous = op;
+		}
+
+		m_pending_operations = op;
+		++m_pending_operation_count;
+
+		schedule_flush_locked();
+
+		return true;
+	}
+
+	void uring::schedule_flush_locked()
+	{
+		// The operations started before the flush runs are all submitted with the same system call.
+		if (!m_flush_scheduled)
+		{
+			m_flush_scheduled = true;
+
+			m_io_service.post(boost::bind(&uring::flush, shared_from_this()));
+		}
+	}
+
+	void uring::flush()
+	{
+		boost::mutex::scoped_lock lock(m_submission_mutex);
+
+		m_flush_scheduled = false;
+
+		if (is_open())
+		{
+			flush_locked();
+		}
+	}
+
+	void uring::flush_locked()
+	{
+		while (m_unsubmitted > 0)
+		{
+			const int result = io_uring_enter(m_fd, m_unsubmitted, 0, 0);
+
+			if (result < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+
+				if ((errno == EAGAIN) || (errno == EBUSY))
+				{
+					// The kernel is short on resources: we will try again later.
+					schedule_flush_locked();
+				}
+
+				break;
+			}
+
+			if (result == 0)
+			{
+				break;
+			}
+
+			m_unsubmitted -= static_cast<unsigned int>(result);
+		}
+	}
+
+	void uring::cancel_locked()
+	{
+		// Multishot operations that are about to be started again check this to know they were cancelled in between.
+		++m_cancel_generation;
+
+		cancel_operations_locked(false);
+	}
+
+	void uring::cancel_operations_locked(bool receives_only)
+	{
+		for (operation* op = m_pending_operations; op; op = op->next)
+		{
+			if (receives_only && (op->type != operation_type::receive_from))
+			{
+				continue;
+			}
+
+			struct io_uring_sqe* sqe = get_sqe_locked();
+
+			if (!sqe)
+			{
+				flush_locked();
+				sqe = get_sqe_locked();
+
+				if (!sqe)
+				{
+					break;
+				}
+			}
+
+			std::memset(sqe, 0, sizeof(*sqe));
+
+			sqe->opcode = IORING_OP_ASYNC_CANCEL;
+			sqe->fd = -1;
+			sqe->addr = reinterpret_cast<uint64_t>(op);
+			sqe->user_data = 0;
+
+			push_sqe_locked();
+		}
+	}
+
+	struct io_uring_sqe* uring::get_sqe_locked()
+	{
+		const unsigned int head = __atomic_load_n(m_ring->sq_head, __ATOMIC_ACQUIRE);
+		const unsigned int tail = *m_ring->sq_tail;
+
+		if (tail - head >= m_ring->sq_entries)
+		{
+			return nullptr;
+		}
+
+		return &m_ring->sqes[tail & m_ring->sq_mask];
+	}
+
+	void uring::push_sqe_locked()
+	{
+		const unsigned int tail = *m_ring->sq_tail;
+
+		m_ring->sq_array[tail & m_ring->sq_mask] = tail & m_ring->sq_mask;
+
+		__atomic_store_n(m_ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+		++m_unsubmitted;
+	}
+
+	void uring::async_wait_completions()
+	{
+		m_event_descriptor.async_read_some(boost::asio::null_buffers(), boost::bind(&uring::handle_completions, shared_from_this(), boost::asio::placeholders::error));
+	}
+
+	void uring::handle_completions(const boost::system::error_code& ec)
+	{
+		if (ec)
+		{
+			return;
+		}
+
+		std::vector<completion> completions;
+
+		{
+			boost::mutex::scoped_lock lock(m_completion_mutex);
+
+			if (!is_open())
+			{
+				return;
+			}
+
+			uint64_t value;
+
+			if (::read(m_event_descriptor.native_handle(), &value, sizeof(value)) < 0)
+			{
+				// The counter was reset by a concurrent reap: we check the ring anyway.
+			}
+
+			while (reap_completions_locked(completions) > 0)
+			{
+				// When the completion ring was full, the kernel kept the extra completions aside and will not signal them again: we have to ask for them.
+#if defined(IORING_SQ_CQ_OVERFLOW)
+				const bool overflowed = (__atomic_load_n(m_ring->sq_flags, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW) != 0;
+#else
+				const bool overflowed = (completions.size() >= m_ring->cq_entries);
+#endif
+
+				if (!overflowed)
+				{
+					break;
+				}
+
+				io_uring_enter(m_fd, 0, 0, IORING_ENTER_GETEVENTS);
+			}
+
+			async_wait_completions();
+		}
+
+		for (const completion& c : completions)
+		{
+			complete(c, false);
+		}
+	}
+
+	size_t uring::reap_completions_locked(std::vector<completion>& completions)
+	{
+		unsigned int head = *m_ring->cq_head;
+		const unsigned int tail = __atomic_load_n(m_ring->cq_tail, __ATOMIC_ACQUIRE);
+		const size_t first = completions.size();
+
+		for (; head != tail; ++head)
+		{
+			const struct io_uring_cqe& cqe = m_ring->cqes[head & m_ring->cq_mask];
+			operation* const op = reinterpret_cast<operation*>(cqe.user_data);
+
+			// Cancellation requests have no operation.
+			if (op)
+			{
+				completion c = { op, cqe.res, cqe.flags, boost::asio::mutable_buffer() };
+
+#if defined(IORING_RECV_MULTISHOT)
+				if (op->buffers && (cqe.flags & IORING_CQE_F_BUFFER))
+				{
+					const uint16_t id = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+
+					c.block = op->buffers->blocks[id];
+
+					// The kernel consumed the buffer: we give it a new one in its place.
+					op->buffers->provide(id, op->buffers->allocate_buffer());
+				}
+#endif
+
+				completions.push_back(c);
+			}
+		}
+
+		__atomic_store_n(m_ring->cq_head, head, __ATOMIC_RELEASE);
+
+		if (completions.size() > first)
+		{
+			boost::mutex::scoped_lock lock(m_submission_mutex);
+
+			for (size_t i = first; i < completions.size(); ++i)
+			{
+				if (!completions[i].is_final())
+				{
+					continue;
+				}
+
+				operation* const op = completions[i].op;
+
+				if (op->previous)
+				{
+					op->previous->next = op->next;
+				}
+				else
+				{
+					m_pending_operations = op->next;
+				}
+
+				if (op->next)
+				{
+					op->next->previous = op->previous;
+				}
+
+				--m_pending_operation_count;
+			}
+		}
+
+		return completions.size() - first;
+	}
+
+	void uring::complete(const completion& c, bool post)
+	{
+		if (c.op->type == operation_type::receive_from)
+		{
+			complete_receive(c, post);
+
+			return;
+		}
+
+		const handler_type handler = c.op->handler;
+		const boost::system::error_code ec = result_to_error_code(c.result);
+		const size_t bytes_transferred = static_cast<size_t>(std::max(c.result, 0));
+
+		delete c.op;
+
+		if (post)
+		{
+			m_io_service.post(boost::bind(handler, ec, bytes_transferred));
+		}
+		else
+		{
+			handler(ec, bytes_transferred);
+		}
+	}
+
+	void uring::complete_receive(const completion& c, bool post)
+	{
+		operation* const op = c.op;
+
+#if defined(IORING_RECV_MULTISHOT)
+		if (boost::asio::buffer_size(c.block) > 0)
+		{
+			// The buffer starts with a header, followed by the sender address and the datagram.
+			const uint8_t* const block = boost::asio::buffer_cast<const uint8_t*>(c.block);
+			const struct io_uring_recvmsg_out* const header = reinterpret_cast<const struct io_uring_recvmsg_out*>(block);
+			const uint8_t* const sender = block + sizeof(*header);
+			const uint8_t* const data = sender + op->message.msg_namelen + op->message.msg_controllen;
+
+			if (c.result < 0)
+			{
+				op->buffers->deallocate_buffer(c.block);
+			}
+			else if (header->flags & MSG_TRUNC)
+			{
+				op->buffers->deallocate_buffer(c.block);
+
+				const boost::system::error_code ec = boost::asio::error::message_size;
+
+				if (post)
+				{
+					m_io_service.post(boost::bind(op->receive_handler, ec, boost::asio::mutable_buffer(), boost::asio::const_buffer(), static_cast<const sockaddr*>(nullptr), 0));
+				}
+				else
+				{
+					op->receive_handler(ec, boost::asio::mutable_buffer(), boost::asio::const_buffer(), nullptr, 0);
+				}
+			}
+			else
+			{
+				const boost::asio::const_buffer datagram(data, header->payloadlen);
+				const socklen_t sender_length = std::min(header->namelen, op->message.msg_namelen);
+
+				if (post)
+				{
+					m_io_service.post(boost::bind(op->receive_handler, boost::system::error_code(), c.block, datagram, reinterpret_cast<const sockaddr*>(sender), sender_length));
+				}
+				else
+				{
+					op->receive_handler(boost::system::error_code(), c.block, datagram, reinterpret_cast<const sockaddr*>(sender), sender_length);
+				}
+			}
+		}
+#endif
+
+		if (!c.is_final())
+		{
+			return;
+		}
+
+		boost::system::error_code ec = result_to_error_code(c.result);
+
+		{
+			boost::mutex::scoped_lock lock(m_submission_mutex);
+
+			const bool cancelled = (op->cancel_generation != m_cancel_generation) || (op->receive_cancel_generation != m_receive_cancel_generation) || !is_open();
+
+			if (cancelled)
+			{
+				ec = boost::asio::error::operation_aborted;
+			}
+			else if ((c.result >= 0) || (c.result == -ENOBUFS))
+			{
+				// The kernel ends multishot operations when it runs out of buffers or of completion entries: we start them again.
+				if (start_locked(op))
+				{
+					return;
+				}
+
+				if (!ec)
+				{
+					ec = boost::asio::error::no_buffer_space;
+				}
+			}
+		}
+
+		const receive_handler_type handler = op->receive_handler;
+
+		destroy_buffer_ring(op->buffers);
+		delete op;
+
+		if (post)
+		{
+			m_io_service.post(boost::bind(handler, ec, boost::asio::mutable_buffer(), boost::asio::const_buffer(), static_cast<const sockaddr*>(nullptr), 0));
+		}
+		else
+		{
+			handler(ec, boost::asio::mutable_buffer(), boost::asio::const_buffer(), nullptr, 0);
+		}
+	}
+
+	void uring::destroy_buffer_ring(buffer_ring* buffers)
+	{
+#if defined(IORING_RECV_MULTISHOT)
+		{
+			boost::mutex::scoped_lock lock(m_submission_mutex);
+
+			if (is_open())
+			{
+				struct io_uring_buf_reg registration {};
+
+				registration.bgid = buffers->group;
+
+				io_uring_register(m_fd, IORING_UNREGISTER_PBUF_RING, &registration, 1);
+			}
+		}
+
+		// The ring holds exactly one buffer per identifier.
+		for (const boost::asio::mutable_buffer& block : buffers->blocks)
+		{
+			buffers->deallocate_buffer(block);
+		}
+
+		::munmap(buffers->memory, buffers->size);
+#endif
+
+		delete buffers;
+	}
+
+	void uring::destroy_ring()
+	{
+		if (m_ring)
+		{
+			if (m_ring->sqes)
+			{
+				::munmap(m_ring->sqes, m_ring->sqes_size);
+			}
+
+			if (m_ring->cq_ring && (m_ring->cq_ring != m_ring->sq_ring))
+			{
+				::munmap(m_ring->cq_ring, m_ring->cq_ring_size);
+			}
+
+			if (m_ring->sq_ring)
+			{
+				::munmap(m_ring->sq_ring, m_ring->sq_ring_size);
+			}
+
+			delete m_ring;
+			m_ring = nullptr;
+		}
+
+		if (m_fd >= 0)
+		{
+			::close(m_fd);
+			m_fd = -1;
+		}
+
+		m_unsubmitted = 0;
+		m_registered_region = boost::asio::mutable_buffer();
+	}
+}